@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstdlib>
+#include <regex>
+
+#include "AdaptiveBitrateController.h"
+
+using logging::Logger;
+using namespace std::chrono_literals;
+
+#define BACKLOG_HIGH_MS   500
+#define BACKLOG_LOW_MS    100
+
+// RTT thresholds relative to the lowest RTT of the client
+#define RTT_HIGH_FACTOR   2.0
+#define RTT_HIGH_US       50000
+#define RTT_LOW_FACTOR    1.5
+#define RTT_LOW_US        20000
+
+#define CONGESTED_SAMPLES_BEFORE_DECREASE   2
+#define DECREASE_FACTOR                     0.75
+#define MAX_DECREASE_FACTOR                 0.5    // lowest fraction of the bitrate in one step
+#define DELIVERY_RATE_MARGIN                0.9
+#define MIN_DECREASE_INTERVAL               1s
+
+#define INCREASE_FACTOR       1.15
+#define MIN_INCREASE_BITS     100000
+#define INCREASE_DELAY        5s                   // clear time before the first increase
+#define INCREASE_INTERVAL     2s
+
+#define MAX_BITRATE_KBITS   100000
+
+AdaptiveBitrateController::AdaptiveBitrateController(unsigned int minBitrate, unsigned int maxBitrate,
+                                                     BitrateSetter setter)
+   : log("AdaptiveBitrateController"),
+     minBitrate(minBitrate),
+     maxBitrate(maxBitrate),
+     setter(setter),
+     bitrate(maxBitrate),
+     congestedSampleCount(0),
+     clear(false),
+     decreaseCount(0),
+     increaseCount(0),
+     congestedClientCount(0),
+     lastMaxBacklogBytes(0) {
+   log.info("bitrate range [", minBitrate / 1000, ",", maxBitrate / 1000, "] kbit/s");
+   setter(bitrate);
+}
+
+bool AdaptiveBitrateController::parseBitrateRange(const char* envVarName, unsigned int& minBitrate,
+                                                  unsigned int& maxBitrate) {
+   Logger log("AdaptiveBitrateController");
+   char*  envVar = std::getenv(envVarName);
+
+   if (envVar == nullptr) {
+      return false;
+   }
+
+   std::string      inputText(envVar);
+   const std::regex regex("\\s*(\\d{1,6})\\s*-\\s*(\\d{1,6})\\s*");
+   std::smatch      captureGroups;
+   if (std::regex_match(inputText, captureGroups, regex) && (captureGroups.size() >= 3)) {
+      unsigned int min = std::stoul(captureGroups[1].str());
+      unsigned int max = std::stoul(captureGroups[2].str());
+      if ((min > 0) && (min <= max) && (max <= MAX_BITRATE_KBITS)) {
+         minBitrate = min * 1000;
+         maxBitrate = max * 1000;
+         return true;
+      }
+      log.warning("ignoring bitrate range requested via env var because it's not in the range [1,",
+                  MAX_BITRATE_KBITS, "] or min > max.");
+   } else {
+      log.warning("ignoring bitrate range requested via env var because it's not in the format \"<min>-<max>\".");
+   }
+   return false;
+}
+
+AdaptiveBitrateController::ClientState AdaptiveBitrateController::classify(const CongestionSample& sample) const {
+   // the caller holds the mutex
+   uint64_t backlogBytes = getBacklogBytes(sample);
+   uint64_t highBytes    = (uint64_t)bitrate / 8 * BACKLOG_HIGH_MS / 1000;
+   uint64_t lowBytes     = (uint64_t)bitrate / 8 * BACKLOG_LOW_MS / 1000;
+
+   bool rttHigh = false;
+   bool rttLow  = true;
+   if (sample.transportAvailable && (sample.transport.minRtt_us > 0)) {
+      double minRtt = sample.transport.minRtt_us;
+      rttHigh = sample.transport.rtt_us > minRtt * RTT_HIGH_FACTOR + RTT_HIGH_US;
+      rttLow  = sample.transport.rtt_us < minRtt * RTT_LOW_FACTOR + RTT_LOW_US;
+   }
+
+   if ((backlogBytes > highBytes) || rttHigh) {
+      return ClientState::CONGESTED;
+   }
+   if ((backlogBytes < lowBytes) && rttLow) {
+      return ClientState::CLEAR;
+   }
+   return ClientState::NEUTRAL;
+}
+
+void AdaptiveBitrateController::update(const std::vector<CongestionSample>& samples, Clock::time_point now) {
+   const std::lock_guard<std::mutex> lock(mutex);
+
+   unsigned int congestedCount     = 0;
+   bool         allClear           = true;
+   uint64_t     lowestDeliveryRate = 0;   // bits per second of the congested clients, 0 if unknown
+   uint64_t     maxBacklogBytes    = 0;
+   for (auto& sample : samples) {
+      maxBacklogBytes = std::max(maxBacklogBytes, getBacklogBytes(sample));
+      ClientState state = classify(sample);
+      allClear = allClear && (state == ClientState::CLEAR);
+      if (state != ClientState::CONGESTED) {
+         continue;
+      }
+      congestedCount++;
+      // a delivery rate limited by the sender says nothing about the capacity of the path
+      if (sample.transportAvailable && !sample.transport.deliveryAppLimited && (sample.transport.deliveryRate > 0)) {
+         uint64_t deliveryRate = sample.transport.deliveryRate * 8;
+         if ((lowestDeliveryRate == 0) || (deliveryRate < lowestDeliveryRate)) {
+            lowestDeliveryRate = deliveryRate;
+         }
+      }
+   }
+   congestedClientCount = congestedCount;
+   
+   // A backlog that built up before the last decrease takes a while to drain.
+   // As long as it shrinks, the current bitrate fits the path.
+   bool draining       = maxBacklogBytes < lastMaxBacklogBytes;
+   lastMaxBacklogBytes = maxBacklogBytes;
+
+   if (congestedCount > 0) {
+      clear = false;
+      if (draining) {
+         congestedSampleCount = 0;
+         return;
+      }
+      congestedSampleCount++;
+      if ((congestedSampleCount < CONGESTED_SAMPLES_BEFORE_DECREASE) || (now - lastChange < MIN_DECREASE_INTERVAL) ||
+          (bitrate <= minBitrate)) {
+         return;
+      }
+      double newBitrate = bitrate * DECREASE_FACTOR;
+      if (lowestDeliveryRate > 0) {
+         newBitrate = std::max(lowestDeliveryRate * DELIVERY_RATE_MARGIN, bitrate * MAX_DECREASE_FACTOR);
+         newBitrate = std::min(newBitrate, bitrate * DELIVERY_RATE_MARGIN);
+      }
+      decreaseCount++;
+      changeBitrate(std::max((unsigned int)newBitrate, minBitrate),
+                    std::to_string(congestedCount) + " congested client(s), delivery rate " +
+                    ((lowestDeliveryRate > 0) ? std::to_string(lowestDeliveryRate / 1000) + " kbit/s" : "unknown"),
+                    now);
+      return;
+   }
+
+   congestedSampleCount = 0;
+   if (!allClear) {
+      clear = false;
+      return;
+   }
+   if (!clear) {
+      clear      = true;
+      clearSince = now;
+   }
+   if ((bitrate >= maxBitrate) || (now - clearSince < INCREASE_DELAY) || (now - lastChange < INCREASE_INTERVAL)) {
+      return;
+   }
+   unsigned int newBitrate = std::max((unsigned int)(bitrate * INCREASE_FACTOR), bitrate + MIN_INCREASE_BITS);
+   increaseCount++;
+   changeBitrate(std::min(newBitrate, maxBitrate), "all clients clear", now);
+}
+
+uint64_t AdaptiveBitrateController::getBacklogBytes(const CongestionSample& sample) const {
+   // the caller holds the mutex
+   uint64_t backlogBytes = sample.queuedBytes;
+   if (!sample.transportAvailable) {
+      return backlogBytes;
+   }
+   backlogBytes += sample.transport.notSentBytes;
+   
+   // Data in flight beyond the bandwidth-delay product waits in the buffers
+   // along the path (e.g. of a router), that's a backlog too. Unlike the
+   // smoothed RTT it does not lag behind.
+   if (sample.transport.minRtt_us > 0) {
+      uint64_t inFlightBytes = (uint64_t)sample.transport.unackedSegments * sample.transport.sendMss;
+      uint64_t pathBytes     = (uint64_t)bitrate / 8 * sample.transport.minRtt_us / 1000000;
+      if (inFlightBytes > pathBytes) {
+         backlogBytes += inFlightBytes - pathBytes;
+      }
+   }
+   return backlogBytes;
+}
+
+void AdaptiveBitrateController::changeBitrate(unsigned int newBitrate, const std::string& reason,
+                                              Clock::time_point now) {
+   // the caller holds the mutex
+   log.info("changing bitrate from", bitrate / 1000, "to", newBitrate / 1000, "kbit/s (", reason, ")");
+   bitrate              = newBitrate;
+   lastChange           = now;
+   congestedSampleCount = 0;
+   setter(bitrate);
+}
+
+unsigned int AdaptiveBitrateController::getBitrate() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return bitrate;
+}
+
+unsigned int AdaptiveBitrateController::getMaxBitrate() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return maxBitrate;
+}
+
+void AdaptiveBitrateController::setMaxBitrate(unsigned int newMaxBitrate) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   maxBitrate = newMaxBitrate;
+   minBitrate = std::min(minBitrate, newMaxBitrate);
+   log.info("bitrate range [", minBitrate / 1000, ",", maxBitrate / 1000, "] kbit/s");
+   changeBitrate(maxBitrate, "maximum changed", Clock::now());
+}
+
+void AdaptiveBitrateController::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   output << "# TYPE octowatch_h264_bitrate_bits_per_second gauge" << "\n";
+   output << "octowatch_h264_bitrate_bits_per_second{value=\"current\"} " << bitrate << "\n";
+   output << "octowatch_h264_bitrate_bits_per_second{value=\"min\"} " << minBitrate << "\n";
+   output << "octowatch_h264_bitrate_bits_per_second{value=\"max\"} " << maxBitrate << "\n";
+   output << "# TYPE octowatch_h264_bitrate_changes_total counter" << "\n";
+   output << "octowatch_h264_bitrate_changes_total{direction=\"down\"} " << decreaseCount << "\n";
+   output << "octowatch_h264_bitrate_changes_total{direction=\"up\"} " << increaseCount << "\n";
+   output << "# TYPE octowatch_h264_congested_clients gauge" << "\n";
+   output << "octowatch_h264_congested_clients " << congestedClientCount << "\n";
+}
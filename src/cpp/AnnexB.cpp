@@ -0,0 +1,38 @@
+#include "AnnexB.h"
+
+using h264::AnnexB;
+using h264::NalUnitPosition;
+
+/**
+ * Returns the position of the first byte after the next start code (00 00 01)
+ * at or after position or the size of the data if there is none.
+ */
+static size_t findNalUnitStart(const uint8_t* data, size_t size, size_t position) {
+   while (position + 3 <= size) {
+      if (data[position + 2] > 1) {
+         position += 3;
+      } else if ((data[position] == 0) && (data[position + 1] == 0) && (data[position + 2] == 1)) {
+         return position + 3;
+      } else {
+         position++;
+      }
+   }
+   return size;
+}
+
+void AnnexB::findNalUnits(const uint8_t* data, size_t size, std::vector<NalUnitPosition>& nalUnits) {
+   nalUnits.clear();
+   size_t start = findNalUnitStart(data, size, 0);
+   while (start < size) {
+      size_t nextStart = findNalUnitStart(data, size, start);
+      size_t end       = (nextStart < size) ? nextStart - 3 : size;
+      // the zero byte of a 4 byte start code (00 00 00 01) or trailing_zero_8bits
+      while ((end > start) && (data[end - 1] == 0)) {
+         end--;
+      }
+      if (end > start) {
+         nalUnits.push_back(NalUnitPosition{start, end - start, (uint8_t)(data[start] & 0x1f)});
+      }
+      start = nextStart;
+   }
+}
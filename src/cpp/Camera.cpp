@@ -11,7 +11,7 @@
 #include "Camera.h"
 #include "Logging.h"
 
-#define REQUEST_COUNT   3
+#define REQUEST_COUNT   4
 
 using capabilities::CameraCapabilities;
 using libcamera::CameraConfiguration;
@@ -184,6 +184,14 @@ libcamera::StreamConfiguration const & Camera::getStreamConfiguration(StreamType
    return streamConfigs->at(static_cast<int>(streamType));
 }
 
+std::vector<FrameBuffer*> Camera::getFrameBuffers(StreamType streamType) {
+   std::vector<FrameBuffer*> buffers;
+   for (unsigned int index = static_cast<unsigned int>(streamType); index < frameBuffers.size(); index += 2) {
+      buffers.push_back(frameBuffers[index].get());
+   }
+   return buffers;
+}
+
 void Camera::enqueueRequest(libcamera::Request *request) {
    request->reuse(Request::ReuseFlag::ReuseBuffers);
    
@@ -208,6 +216,23 @@ void Camera::enqueueRequest(libcamera::Request *request) {
    }
 }
 
+void Camera::releaseLease(libcamera::Request *request) {
+   // stop() must not miss a request that gets queued again and start() must 
+   // not queue a request that is still leased
+   std::lock_guard<std::mutex> stateGuard(stateMutex);
+   {
+      std::lock_guard<std::mutex> guard(leasesMutex);
+      leasedRequests.erase(request);
+      leaseReleased.notify_all();
+   }
+   
+   // the request gets queued in the current run, even if the camera got 
+   // restarted while the request was leased (start() skipped it)
+   if (started) {
+      enqueueRequest(request);
+   }
+}
+
 void Camera::requestCompleted(Request *request) {
    {
       std::lock_guard<std::mutex> guard(pendingRequestsMutex);
@@ -236,8 +261,15 @@ void Camera::requestCompleted(Request *request) {
       auto ts                        = request->metadata().get(libcamera::controls::SensorTimestamp);
       int64_t timestamp_ns           = ts ? *ts : highResolutionFrameBuffer->metadata().timestamp;
 		
-      frameConsumer(highResolutionFrameBuffer, lowResolutionFrameBuffer, timestamp_ns / 1000);   
-      enqueueRequest(request);
+      {
+         std::lock_guard<std::mutex> guard(leasesMutex);
+         leasedRequests.insert(request);
+      }
+      // the request gets enqueued again when the last copy of the lease got destroyed
+      FrameLease lease(request, [this](Request *leasedRequest) { 
+         releaseLease(leasedRequest); 
+      });
+      frameConsumer(highResolutionFrameBuffer, lowResolutionFrameBuffer, timestamp_ns / 1000, lease);   
    }
 }
 
@@ -247,6 +279,7 @@ bool Camera::start(FrameConsumer consumer) {
       return false;
    }
    
+   std::lock_guard<std::mutex> guard(stateMutex);
    frameConsumer = consumer;
    
    log.info("starting capturing from camera");
@@ -257,8 +290,18 @@ bool Camera::start(FrameConsumer consumer) {
    }
    
    log.info("enqueuing requests");
-   for (unsigned int index = 0; index < requests.size(); index++) {
-      enqueueRequest(requests[index].get());     
+   {
+      // requests still leased by consumers of the previous run (stop() timed 
+      // out) get enqueued when their lease gets released
+      std::lock_guard<std::mutex> leasesGuard(leasesMutex);
+      for (unsigned int index = 0; index < requests.size(); index++) {
+         if (leasedRequests.count(requests[index].get()) == 0) {
+            enqueueRequest(requests[index].get());
+         }
+      }
+      if (!leasedRequests.empty()) {
+         log.warning(leasedRequests.size(), "request(s) still leased -> enqueuing them when released");
+      }
    }
    
    started = true;
@@ -271,8 +314,23 @@ void Camera::stop() {
    }
    
    log.info("stop called -> waiting for completion of pending requests");
-   started = false;
-   while(pendingRequests > 0) {
+   {
+      std::lock_guard<std::mutex> guard(stateMutex);
+      started = false;
+   }
+   {
+      std::unique_lock<std::mutex> lock(leasesMutex);
+      if (!leaseReleased.wait_for(lock, 3s, [this]{ return leasedRequests.empty(); })) {
+         log.warning(leasedRequests.size(), "request(s) still leased after stopping");
+      }
+   }
+   while(true) {
+      {
+         std::lock_guard<std::mutex> guard(pendingRequestsMutex);
+         if (pendingRequests == 0) {
+            break;
+         }
+      }
       std::this_thread::sleep_for(100ms);
    }
    log.info("stopping camera");
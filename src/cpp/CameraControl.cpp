@@ -1,16 +1,28 @@
 
+#include <limits>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "CameraControl.h"
 #include "StringUtils.h"
 
 using capabilities::CameraCapabilities;
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using network::Connection;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SharedBuffer;
 
-CameraControl::CameraControl(Camera &camera) : 
+#define MAX_QUEUED_EVENTS   4
+
+CameraControl::CameraControl(Camera &camera, HttpServer& httpServer) : 
    log("CameraControl"),
    camera(camera),
+   httpServer(httpServer),
    capabilitiesMessage(std::optional<std::string>()),
    currentValuesMessage(std::optional<std::string>()),
    capabilitiesMessageNotYetSent(true),
@@ -18,9 +30,17 @@ CameraControl::CameraControl(Camera &camera) :
    remoteControl(remotecontrol::RemoteControl())
    {}
 
+CameraControl::~CameraControl() {
+   httpServer.removeRoutes(*this);
+   const std::lock_guard<std::mutex> lock(messagesMutex);
+   eventSubscribers.clear();
+}
+
 void CameraControl::start() {
    remoteControl.start(*this);
    camera.setCapabilitiesListener(*this);
+   httpServer.addRoute("/controls", *this);
+   httpServer.addRoute("/events", *this);
 }
 
 std::string CameraControl::encodeCapabilities(std::map<std::string, CameraCapabilities::Properties>& capabilities) const {
@@ -58,6 +78,51 @@ std::string CameraControl::encodeCurrentValues(const std::map<std::string, float
    return json.str();
 }
 
+std::string CameraControl::encodeEncoderCapabilities() const {
+   // the caller holds the encodersMutex
+   std::ostringstream json;
+   json << "{\"type\":\"encoderCapabilities\",\"content\":{";
+   unsigned int addedEncoders = 0;
+   for (auto& encoder : encoderControls) {
+      json << "\"" << encoder.first << "\":{";
+      auto         parameters      = encoder.second->getEncoderParameters();
+      unsigned int addedParameters = 0;
+      for (auto& parameter : parameters) {
+         json << "\"" << parameter.first << "\":{";
+         json << "\"type\":\""    << parameter.second.type << "\",";
+         json << "\"minimum\":"   << parameter.second.minimum << ",";
+         json << "\"maximum\":"   << parameter.second.maximum << ",";
+         json << "\"step\":"      << parameter.second.step << ",";
+         json << "\"default\":"   << parameter.second.defaultValue << ",";
+         json << "\"value\":"     << parameter.second.value;
+         if (!parameter.second.menuEntries.empty()) {
+            json << ",\"options\":{";
+            unsigned int addedEntries = 0;
+            for (auto& entry : parameter.second.menuEntries) {
+               json << "\"" << entry.first << "\":\"" << entry.second << "\"";
+               addedEntries++;
+               if (addedEntries < parameter.second.menuEntries.size()) {
+                  json << ",";
+               }
+            }
+            json << "}";
+         }
+         json << "}";
+         addedParameters++;
+         if (addedParameters < parameters.size()) {
+            json << ",";
+         }
+      }
+      json << "}";
+      addedEncoders++;
+      if (addedEncoders < encoderControls.size()) {
+         json << ",";
+      }
+   }
+   json << "}}";
+   return json.str();
+}
+
 std::string CameraControl::error(const std::string& message) {
    std::ostringstream json;
    json << "{\"type\":\"error\", \"content\":{\"message\":\"" << message << "\"}}";
@@ -65,6 +130,7 @@ std::string CameraControl::error(const std::string& message) {
 }
 
 void CameraControl::sendCapabilitiesMessage() {
+   const std::lock_guard<std::mutex> lock(messagesMutex);
    if (remoteControlConnected && capabilitiesMessageNotYetSent && capabilitiesMessage.has_value()) {
       capabilitiesMessageNotYetSent = false;
       remoteControl.asyncSend(capabilitiesMessage.value());
@@ -72,14 +138,49 @@ void CameraControl::sendCapabilitiesMessage() {
 }
       
 void CameraControl::sendCurrentValuesMessage() {
+   const std::lock_guard<std::mutex> lock(messagesMutex);
    if (remoteControlConnected && currentValuesMessage.has_value()) {
       remoteControl.asyncSend(currentValuesMessage.value());
    }
 }
       
+void CameraControl::sendEncoderCapabilitiesMessage() {
+   const std::lock_guard<std::mutex> lock(messagesMutex);
+   if (remoteControlConnected && encoderCapabilitiesMessage.has_value()) {
+      remoteControl.asyncSend(encoderCapabilitiesMessage.value());
+   }
+}
+
+void CameraControl::setEncoderControl(const std::string& name, EncoderControl* control) {
+   const std::lock_guard<std::mutex> lock(encodersMutex);
+   if (control == nullptr) {
+      encoderControls.erase(name);
+   } else {
+      encoderControls[name] = control;
+   }
+   updateEncoderCapabilities();
+}
+
+void CameraControl::updateEncoderCapabilities() {
+   // the caller holds the encodersMutex
+   std::string message = encodeEncoderCapabilities();
+   {
+      const std::lock_guard<std::mutex> lock(messagesMutex);
+      encoderCapabilitiesMessage = message;
+      encoderCapabilitiesEvent   = createEvent("encoderCapabilities", message);
+      publishEvent(encoderCapabilitiesEvent, false);
+   }
+   sendEncoderCapabilitiesMessage();
+}
+
 void CameraControl::onCapabilitiesChanged(std::map<std::string, 
                         CameraCapabilities::Properties>& capabilities) {
-   capabilitiesMessage = encodeCapabilities(capabilities);
+   {
+      const std::lock_guard<std::mutex> lock(messagesMutex);
+      capabilitiesMessage = encodeCapabilities(capabilities);
+      capabilitiesEvent   = createEvent("capabilities", capabilitiesMessage.value());
+      publishEvent(capabilitiesEvent, false);
+   }
    sendCapabilitiesMessage();
 }
 
@@ -90,7 +191,13 @@ void CameraControl::onCurrentValuesChanged(std::map<std::string, float> currentV
       message << tuple.first << "=" << tuple.second << " ";
    }
    log.info(message.str());
-   currentValuesMessage = encodeCurrentValues(currentValues);
+   {
+      const std::lock_guard<std::mutex> lock(messagesMutex);
+      currentValuesMessage = encodeCurrentValues(currentValues);
+      currentValuesEvent   = createEvent("currentValues", currentValuesMessage.value());
+      this->currentValues  = currentValues;
+      publishEvent(currentValuesEvent, true);
+   }
    sendCurrentValuesMessage();
 }
 
@@ -98,6 +205,7 @@ void CameraControl::onNewConnection() {
    remoteControlConnected = true;
    sendCapabilitiesMessage();
    sendCurrentValuesMessage();
+   sendEncoderCapabilitiesMessage();
 }
 
 void CameraControl::onConnectionClosed() {
@@ -105,11 +213,26 @@ void CameraControl::onConnectionClosed() {
    remoteControlConnected = false;
 }
 
-// command example: {"type":"setControl","content":{"control":"brightness","value":4.7}}
-void CameraControl::onCommandReceived(const std::string& command) {
+// command examples: {"type":"setControl","content":{"control":"brightness","value":4.7}}
+//                   {"type":"setEncoder","content":{"encoder":"h264","parameter":"bitrate","value":4000000}}
+void CameraControl::onCommandReceived(std::string_view command) {
+   switch (executeCommand(command)) {
+      case CommandResult::EXECUTED:
+         break;
+      case CommandResult::UNKNOWN_COMMAND:
+         remoteControl.asyncSend(error("unknown command: " + std::string(command)));
+         break;
+      case CommandResult::FAILED:
+         remoteControl.asyncSend(error("failed to execute command: " + std::string(command)));
+         break;
+   }
+}
+
+CameraControl::CommandResult CameraControl::executeCommand(std::string_view command) {
    const std::regex regex("\\{\"type\":\"([a-zA-Z0-9]+)\",\"content\":\\{\"control\":\"([a-zA-Z0-9]+)\",\"value\":(-?[0-9]+(\\.[0-9]+)?)\\}\\}");
+   const std::regex encoderRegex("\\{\"type\":\"setEncoder\",\"content\":\\{\"encoder\":\"([a-z0-9]+)\",\"parameter\":\"([a-zA-Z0-9]+)\",\"value\":(-?[0-9]{1,10})\\}\\}");
    std::smatch captureGroups;
-   std::string commandWithoutWhitespaces = command;
+   std::string commandWithoutWhitespaces(command);
    
    commandWithoutWhitespaces.erase(std::remove_if(commandWithoutWhitespaces.begin(),
       commandWithoutWhitespaces.end(), [](auto t) {
@@ -122,11 +245,146 @@ void CameraControl::onCommandReceived(const std::string& command) {
          float       value   = std::stof(captureGroups[3].str());
          if (!camera.setControl(control, value)) {
             log.error("failed to execute command:", command);
-            remoteControl.asyncSend(error("failed to execute command: " + command));
+            return CommandResult::FAILED;
          }
       }
-   } else {
-      log.error("ignoring unknown command (regex does not match):", command);
-      remoteControl.asyncSend(error("unknown command: " + command));
+      return CommandResult::EXECUTED;
+   }
+   if (std::regex_match(commandWithoutWhitespaces, captureGroups, encoderRegex)) {
+      std::string encoder   = captureGroups[1].str();
+      std::string parameter = captureGroups[2].str();
+      long long   value     = std::stoll(captureGroups[3].str());
+      
+      const std::lock_guard<std::mutex> lock(encodersMutex);
+      auto entry = encoderControls.find(encoder);
+      if (entry == encoderControls.end()) {
+         log.error("failed to execute command (unknown encoder):", command);
+         return CommandResult::FAILED;
+      }
+      if ((value < std::numeric_limits<int>::min()) || (value > std::numeric_limits<int>::max()) || 
+          (entry->second->setEncoderParameter(parameter, (int)value) != EncoderControl::Result::APPLIED)) {
+         log.error("failed to execute command:", command);
+         return CommandResult::FAILED;
+      }
+      updateEncoderCapabilities();
+      return CommandResult::EXECUTED;
+   }
+   log.error("ignoring unknown command (regex does not match):", command);
+   return CommandResult::UNKNOWN_COMMAND;
+}
+
+SharedBuffer CameraControl::createEvent(const std::string& type, const std::string& message) {
+   // the messages do not contain line breaks, therefore one data line is sufficient
+   return SharedBuffer::copyOf("event: " + type + "\ndata: " + message + "\n\n");
+}
+
+void CameraControl::publishEvent(const SharedBuffer& event, bool droppable) {
+   for (auto& entry : eventSubscribers) {
+      if (droppable) {
+         entry.second->asyncSendFrame({event});
+      } else {
+         entry.second->asyncSend(event);
+      }
+   }
+}
+
+CameraControl::Result CameraControl::onRequest(const HttpRequest& request, std::shared_ptr<Connection> connection,
+                                               HttpResponse& response) {
+   if (request.path == "/events") {
+      if (request.method == "HEAD") {
+         response.contentType = "text/event-stream";
+         return Result::RESPONDED;
+      }
+      if (request.method != "GET") {
+         response = HttpResponse::text(405, "only GET is supported\n");
+         response.headers.emplace_back("Allow", "GET, HEAD");
+         return Result::RESPONDED;
+      }
+      
+      // Only the latest current values matter, older ones can get dropped.
+      SendQueueLimits limits;
+      limits.maxQueuedFrames = MAX_QUEUED_EVENTS;
+      limits.overflowPolicy  = OverflowPolicy::DROP_OLDEST_FRAME;
+      connection->setSendQueueLimits(limits);
+      connection->asyncSend(HttpServer::createStreamHeader("text/event-stream"));
+      
+      const std::lock_guard<std::mutex> lock(messagesMutex);
+      if (capabilitiesEvent.size() > 0) {
+         connection->asyncSend(capabilitiesEvent);
+      }
+      if (encoderCapabilitiesEvent.size() > 0) {
+         connection->asyncSend(encoderCapabilitiesEvent);
+      }
+      if (currentValuesEvent.size() > 0) {
+         connection->asyncSendFrame({currentValuesEvent});
+      }
+      eventSubscribers[connection->getId()] = connection;
+      log.info("connection", connection->getId(), "subscribed to events (subscribers:", eventSubscribers.size(), ")");
+      return Result::STREAMING;
    }
-}
\ No newline at end of file
+   
+   if ((request.method == "GET") || (request.method == "HEAD")) {
+      std::string messages = "[";
+      {
+         const std::lock_guard<std::mutex> lock(messagesMutex);
+         for (auto message : {capabilitiesMessage, currentValuesMessage, encoderCapabilitiesMessage}) {
+            if (message.has_value()) {
+               messages += ((messages.size() > 1) ? "," : "") + message.value();
+            }
+         }
+      }
+      messages += "]";
+      response.contentType = "application/json";
+      response.body        = SharedBuffer::copyOf(messages);
+      return Result::RESPONDED;
+   }
+   
+   if (request.method == "POST") {
+      std::string contentType = request.getHeader("content-type");
+      if (!contentType.empty() && (contentType.rfind("application/json", 0) != 0) && 
+          (contentType.rfind("text/plain", 0) != 0)) {
+         response = HttpResponse::text(415, "expected application/json\n");
+         return Result::RESPONDED;
+      }
+      switch (executeCommand(request.body)) {
+         case CommandResult::EXECUTED:
+            response.status = 204;
+            break;
+         case CommandResult::UNKNOWN_COMMAND:
+            response.status      = 400;
+            response.contentType = "application/json";
+            response.body        = SharedBuffer::copyOf(error("unknown command"));
+            break;
+         case CommandResult::FAILED:
+            response.status      = 422;
+            response.contentType = "application/json";
+            response.body        = SharedBuffer::copyOf(error("failed to execute command"));
+            break;
+      }
+      return Result::RESPONDED;
+   }
+   
+   response = HttpResponse::text(405, "only GET and POST are supported\n");
+   response.headers.emplace_back("Allow", "GET, HEAD, POST");
+   return Result::RESPONDED;
+}
+
+void CameraControl::onConnectionClosed(int connectionId) {
+   const std::lock_guard<std::mutex> lock(messagesMutex);
+   if (eventSubscribers.erase(connectionId) > 0) {
+      log.info("connection", connectionId, "unsubscribed from events (subscribers:", eventSubscribers.size(), ")");
+   }
+}
+
+void CameraControl::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(messagesMutex);
+   output << "# TYPE octowatch_camera_control_event_subscribers gauge" << "\n";
+   output << "octowatch_camera_control_event_subscribers " << eventSubscribers.size() << "\n";
+   if (currentValues.empty()) {
+      return;
+   }
+   output << "# TYPE octowatch_camera_control gauge" << "\n";
+   for (auto& entry : currentValues) {
+      output << "octowatch_camera_control{control=\"" << entry.first << "\"} " << entry.second << "\n";
+   }
+}
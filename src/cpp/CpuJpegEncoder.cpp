@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <memory>
 #include <vector>
 #include <sys/mman.h>
 
@@ -10,7 +12,10 @@ CpuJpegEncoder::CpuJpegEncoder(StreamConfiguration const &streamConfig, int qual
    : log("CpuJpegEncoder"), 
      inputHeight(streamConfig.size.height), 
      inputStride(streamConfig.stride), 
-     firstFrame(true) {
+     firstFrame(true),
+     initialQuality(quality),
+     quality(quality),
+     requestedQuality(quality) {
         
    cinfo.err = jpeg_std_error(&jerr);
 	jpeg_create_compress(&cinfo);
@@ -35,7 +40,37 @@ void CpuJpegEncoder::setOutputReadyCallback(JpegOutputReadyCallback callback) {
    outputReadyCallback = callback; 
 }
 
+std::map<std::string, EncoderParameter> CpuJpegEncoder::getEncoderParameters() {
+   EncoderParameter parameter;
+   parameter.type         = "integer";
+   parameter.minimum      = 0;
+   parameter.maximum      = 100;
+   parameter.defaultValue = initialQuality;
+   parameter.value        = requestedQuality;
+   return {{"quality", parameter}};
+}
+
+CpuJpegEncoder::Result CpuJpegEncoder::setEncoderParameter(const std::string& name, int value) {
+   if (name != "quality") {
+      log.warning("ignoring unsupported parameter", name);
+      return Result::UNKNOWN_PARAMETER;
+   }
+   if ((value < 0) || (value > 100)) {
+      log.warning("ignoring quality", value, "because it is not within [0,100]");
+      return Result::INVALID_VALUE;
+   }
+   requestedQuality = value;
+   return Result::APPLIED;
+}
+
 void CpuJpegEncoder::encode(FrameBuffer *frameBuffer, int64_t timestamp_us) {
+   int newQuality = requestedQuality;
+   if (newQuality != quality) {
+      quality = newQuality;
+      jpeg_set_quality(&cinfo, quality, true);
+      log.info("quality =", quality);
+   }
+   
    auto firstPlane          = frameBuffer->planes()[0];
    void* frameBufferContent = mmap(nullptr, firstPlane.length, PROT_READ, MAP_SHARED,
                                    firstPlane.fd.get(), firstPlane.offset);
@@ -88,5 +123,9 @@ void CpuJpegEncoder::encode(FrameBuffer *frameBuffer, int64_t timestamp_us) {
    std::chrono::duration<double> diff = end - start;
    log.debug("JPEG encoding duration =", (int)(diff.count() * 1000), "ms"); 
       
-   outputReadyCallback(jpegBuffer, jpegLength, timestamp_us);
+   // jpeg_mem_dest allocated the buffer using malloc
+   std::shared_ptr<const uint8_t> jpeg(jpegBuffer, [](const uint8_t* data) { 
+      std::free((void*)data); 
+   });
+   outputReadyCallback(std::move(jpeg), jpegLength, timestamp_us);
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstring>
+
+#include <sys/mman.h>
+
+#include "BufferPool.h"
+#include "EncoderOutputBuffers.h"
+
+using logging::Logger;
+using network::BufferPool;
+using network::PoolAllocator;
+
+using namespace std::chrono_literals;
+
+EncoderOutputBuffers::EncoderOutputBuffers(const char* name, unsigned int maxLentBuffers)
+   : log(name), maxLentBuffers(maxLentBuffers), state(new State()) {
+   state->lentBufferCount    = 0;
+   state->requeuesInProgress = 0;
+   state->closed             = false;
+}
+
+EncoderOutputBuffers::State::~State() {
+   for (auto& mapping : mappings) {
+      munmap(mapping.address, mapping.length);
+   }
+}
+
+void* EncoderOutputBuffers::map(int fileDescriptor, size_t length, off_t offset) {
+   void* address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, offset);
+   if (address != MAP_FAILED) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->mappings.push_back(Mapping{address, length});
+   }
+   return address;
+}
+
+std::shared_ptr<const uint8_t> EncoderOutputBuffers::lend(void *data, size_t bytesCount,
+                                                         RequeueFunction requeue) {
+   {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (state->lentBufferCount < maxLentBuffers) {
+         state->lentBufferCount++;
+         // the deleter keeps the state and therefore the mappings alive
+         std::shared_ptr<State> sharedState = state;
+         return std::shared_ptr<const uint8_t>((const uint8_t*)data,
+            [sharedState, requeue](const uint8_t*) {
+               bool closed;
+               {
+                  std::lock_guard<std::mutex> lock(sharedState->mutex);
+                  closed = sharedState->closed;
+                  if (!closed) {
+                     sharedState->requeuesInProgress++;
+                  }
+               }
+               // the requeuing (VIDIOC_QBUF) does not block the other buffers
+               if (!closed) {
+                  requeue();
+               }
+               std::lock_guard<std::mutex> lock(sharedState->mutex);
+               sharedState->lentBufferCount--;
+               if (!closed) {
+                  sharedState->requeuesInProgress--;
+               }
+               sharedState->bufferReleased.notify_all();
+            }, PoolAllocator<uint8_t>(BufferPool::getDefault()));
+      }
+   }
+
+   log.debug("all lendable output buffers in use -> copying", bytesCount, "bytes");
+   std::shared_ptr<uint8_t> copy = BufferPool::getDefault().allocate(bytesCount);
+   std::memcpy(copy.get(), data, bytesCount);
+   requeue();
+   return copy;
+}
+
+void EncoderOutputBuffers::close() {
+   std::unique_lock<std::mutex> lock(state->mutex);
+   if (!state->bufferReleased.wait_for(lock, 3s, [this]{ return state->lentBufferCount == 0; })) {
+      log.warning(state->lentBufferCount, "output buffer(s) still in use after closing");
+   }
+   state->closed = true;
+   // the encoder must not get destroyed while one of its requeue functions executes
+   state->bufferReleased.wait(lock, [this]{ return state->requeuesInProgress == 0; });
+}
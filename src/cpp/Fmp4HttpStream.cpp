@@ -0,0 +1,152 @@
+#include <cstdlib>
+#include <regex>
+#include <string>
+
+#include "Fmp4HttpStream.h"
+
+#define PATH   "/h264.mp4"
+
+#define DEFAULT_FRAMES_PER_FRAGMENT   1
+#define MAX_FRAMES_PER_FRAGMENT       30
+
+#define MAX_QUEUED_FRAGMENTS   60
+#define MAX_QUEUED_BYTES       (8 * 1024 * 1024)
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using logging::Logger;
+using mp4::Fmp4Fragment;
+using network::Connection;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SendQueueStatistics;
+using network::SharedBuffer;
+
+Fmp4HttpStream::Fmp4HttpStream(HttpServer& httpServer, unsigned int width, unsigned int height, 
+                               ClientsChangedCallback callback)
+   : log("Fmp4HttpStream"),
+     httpServer(httpServer),
+     muxer(width, height, getConfiguredFramesPerFragment()),
+     clientsChangedCallback(callback) {}
+
+Fmp4HttpStream::~Fmp4HttpStream() {
+   httpServer.removeRoutes(*this);
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients.clear();
+   }
+}
+
+unsigned int Fmp4HttpStream::getConfiguredFramesPerFragment() {
+   Logger log("Fmp4HttpStream");
+   char* framesEnvVar = std::getenv("OCTOWATCH_FMP4_FRAMES_PER_FRAGMENT");
+   
+   if (framesEnvVar == nullptr) {
+      return DEFAULT_FRAMES_PER_FRAGMENT;
+   }
+   
+   std::string inputText(framesEnvVar);
+   const std::regex regex("\\s*(\\d+)\\s*");
+   std::smatch captureGroups;
+   if (std::regex_match(inputText, captureGroups, regex) && (captureGroups.size() >= 2)) {
+      int frameCount = std::stoi(captureGroups[1].str());
+      if ((frameCount >= 1) && (frameCount <= MAX_FRAMES_PER_FRAGMENT)) {
+         return frameCount;
+      }
+      log.warning("ignoring frames per fragment requested via env var because it's out of range [1,", 
+                  MAX_FRAMES_PER_FRAGMENT, "].");
+   } else {
+      log.warning("ignoring frames per fragment requested via env var because it's not an integer.");
+   }
+   return DEFAULT_FRAMES_PER_FRAGMENT;
+}
+
+void Fmp4HttpStream::start() {
+   httpServer.addRoute(PATH, *this);
+}
+
+void Fmp4HttpStream::send(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe) {
+   bool clientsStreaming = false;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clientsStreaming = !clients.empty();
+   }
+   if (!clientsStreaming) {
+      muxer.reset();
+      return;
+   }
+   
+   Fmp4Fragment fragment;
+   if (!muxer.add(accessUnit, timestamp_us, keyframe, fragment)) {
+      return;
+   }
+   
+   SharedBuffer initSegment = muxer.getInitSegment();
+   const std::lock_guard<std::mutex> lock(clientsMutex);
+   for (auto& entry : clients) {
+      Client& client = entry.second;
+      if (client.waitingForKeyframe) {
+         if (!fragment.startsWithKeyframe) {
+            continue;
+         }
+         client.connection->asyncSend(initSegment);
+         client.waitingForKeyframe = false;
+      }
+      client.connection->asyncSendFrame({fragment.data});
+   }
+}
+
+Fmp4HttpStream::Result Fmp4HttpStream::onRequest(const HttpRequest& request, std::shared_ptr<Connection> connection,
+                                                 HttpResponse& response) {
+   if (request.method == "HEAD") {
+      response.contentType = "video/mp4";
+      return Result::RESPONDED;
+   }
+   if (request.method != "GET") {
+      response = HttpResponse::text(405, "only GET is supported\n");
+      response.headers.emplace_back("Allow", "GET, HEAD");
+      return Result::RESPONDED;
+   }
+   
+   // Dropping single fragments would corrupt the stream until the next 
+   // keyframe, therefore a client that can't keep up gets disconnected.
+   SendQueueLimits limits;
+   limits.maxQueuedFrames = MAX_QUEUED_FRAGMENTS;
+   limits.maxQueuedBytes  = MAX_QUEUED_BYTES;
+   limits.overflowPolicy  = OverflowPolicy::DISCONNECT;
+   connection->setSendQueueLimits(limits);
+   connection->setEgressStream("h264");
+   
+   log.info("received new HTTP request on connection", connection->getId(), "-> starting to send fMP4 response");
+   connection->asyncSend(HttpServer::createStreamHeader("video/mp4"));
+   unsigned int clientCount = 0;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients[connection->getId()] = Client{connection, true};
+      clientCount = clients.size();
+   }
+   clientsChangedCallback(clientCount, true);
+   return Result::STREAMING;
+}
+
+void Fmp4HttpStream::onConnectionClosed(int connectionId) {
+   bool                clientRemoved = false;
+   unsigned int        clientCount   = 0;
+   SendQueueStatistics statistics;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      auto entry = clients.find(connectionId);
+      if (entry != clients.end()) {
+         statistics    = entry->second.connection->getSendQueueStatistics();
+         clientRemoved = true;
+         clients.erase(entry);
+      }
+      clientCount = clients.size();
+   }
+   if (clientRemoved) {
+      log.info("connection", connectionId, "lost (sent fragments:", statistics.sentFrames, 
+               ", dropped fragments:", statistics.droppedFrames, ")");
+      clientsChangedCallback(clientCount, false);
+   }
+}
@@ -60,7 +60,18 @@ void H264Encoder::setOutputReadyCallback(OutputReadyCallback callback) {
 }
 
 H264Encoder::H264Encoder(StreamConfiguration const &streamConfig)
-	: log("H264Encoder"), quitPollThread(false), quitOutputThread(false), v4l2CommandError(false) {
+	: log("H264Encoder"), 
+     outputBuffers("H264EncoderOutputBuffers", H264_MAX_LENT_OUTPUT_BUFFERS),
+     controls("H264EncoderControls", {{"bitrate",      V4L2_CID_MPEG_VIDEO_BITRATE},
+                                      {"bitrateMode",  V4L2_CID_MPEG_VIDEO_BITRATE_MODE},
+                                      {"iFramePeriod", V4L2_CID_MPEG_VIDEO_H264_I_PERIOD},
+                                      {"profile",      V4L2_CID_MPEG_VIDEO_H264_PROFILE},
+                                      {"level",        V4L2_CID_MPEG_VIDEO_H264_LEVEL},
+                                      {"minQp",        V4L2_CID_MPEG_VIDEO_H264_MIN_QP},
+                                      {"maxQp",        V4L2_CID_MPEG_VIDEO_H264_MAX_QP}}),
+     quitPollThread(false), 
+     quitOutputThread(false), 
+     v4l2CommandError(false) {
       
    std::string deviceName = "/dev/video11";
 	encoderFileDescriptor = open(deviceName.c_str(), O_RDWR, 0);
@@ -141,8 +152,8 @@ H264Encoder::H264Encoder(StreamConfiguration const &streamConfig)
       
 		v4l2Cmd(VIDIOC_QUERYBUF, &buffer, "failed to capture query buffer " + std::to_string(i));
       
-		outputBufferData[i] = mmap(0, buffer.m.planes[0].length, PROT_READ | PROT_WRITE, MAP_SHARED, encoderFileDescriptor,
-							   buffer.m.planes[0].m.mem_offset);
+		outputBufferData[i] = outputBuffers.map(encoderFileDescriptor, buffer.m.planes[0].length,
+		                                        buffer.m.planes[0].m.mem_offset);
 		if (outputBufferData[i] == MAP_FAILED) {
 			throw std::runtime_error("failed to mmap capture buffer " + std::to_string(i));
       }
@@ -167,6 +178,7 @@ H264Encoder::~H264Encoder() {
 	quitOutputThread = true;
 	pollThread.join();
 	outputThread.join();
+   outputBuffers.close();
 
 	v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
 	v4l2Cmd(VIDIOC_STREAMOFF, &type, "failed to stop output streaming");
@@ -220,6 +232,42 @@ void H264Encoder::encode(FrameBuffer *frameBuffer, int64_t timestamp_us) {
    v4l2Cmd(VIDIOC_QBUF, &buf, "failed to queue input to codec");
 }
 
+void H264Encoder::requestKeyframe() {
+   v4l2_control ctrl = {};
+   ctrl.id           = V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME;
+   ctrl.value        = 1;
+   
+   // no exception gets thrown here because a missing keyframe only delays
+   // the start of the stream
+   if (ioctl(encoderFileDescriptor, VIDIOC_S_CTRL, &ctrl) == -1) {
+      log.error("failed to force keyframe: errno", errno);
+   } else {
+      log.debug("forced keyframe");
+   }
+}
+
+void H264Encoder::setBitrate(unsigned int bitrate) {
+   v4l2_control ctrl = {};
+   ctrl.id           = V4L2_CID_MPEG_VIDEO_BITRATE;
+   ctrl.value        = bitrate;
+   
+   // no exception gets thrown here because the encoder keeps working with
+   // the previous bitrate
+   if (ioctl(encoderFileDescriptor, VIDIOC_S_CTRL, &ctrl) == -1) {
+      log.error("failed to set bitrate to", bitrate, ": errno", errno);
+   } else {
+      log.debug("bitrate set to", bitrate);
+   }
+}
+
+std::map<std::string, EncoderParameter> H264Encoder::getEncoderParameters() {
+   return controls.query(encoderFileDescriptor);
+}
+
+H264Encoder::Result H264Encoder::setEncoderParameter(const std::string& name, int value) {
+   return controls.set(encoderFileDescriptor, name, value);
+}
+
 /**
  * This task waits for the completion of encoding a NAL. As soon as a NAL
  * is available it moves one input buffer back to the queue of available 
@@ -288,10 +336,29 @@ void H264Encoder::pollThreadTask() {
 	}
 }
 
+void H264Encoder::requeueOutputBuffer(unsigned int index, size_t length) {
+   v4l2_buffer buf = {};
+   v4l2_plane planes[VIDEO_MAX_PLANES] = {};
+   
+   buf.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+   buf.memory                 = V4L2_MEMORY_MMAP;
+   buf.index                  = index;
+   buf.length                 = 1;
+   buf.m.planes               = planes;
+   buf.m.planes[0].bytesused  = 0;
+   buf.m.planes[0].length     = length;
+   
+   // no exception gets thrown here because this method gets called by 
+   // whoever releases the last reference to the NAL
+   if (ioctl(encoderFileDescriptor, VIDIOC_QBUF, &buf) == -1) {
+      log.error("failed to re-queue encoded buffer", index, ": errno", errno);
+   }
+}
+
 /**
  * This task waits for NALs enqueued by pollThreadTask and provides
- * them to the consumer/callback. After consumption the output buffer
- * gets enqueue again.
+ * them to the consumer/callback. The output buffer gets enqueued again
+ * as soon as the consumer released all references to the NAL.
  */
 void H264Encoder::outputThreadTask() {
 	H264Nal nal;
@@ -312,21 +379,14 @@ void H264Encoder::outputThreadTask() {
 			}
 		}
 
+      unsigned int index  = nal.index;
+      size_t       length = nal.length;
+      auto data = outputBuffers.lend(nal.mem, nal.bytes_used, [this, index, length]() {
+         requeueOutputBuffer(index, length);
+      });
+      
       if (outputReadyCallback) {
-         outputReadyCallback(nal.mem, nal.bytes_used, nal.timestamp_us, nal.keyframe);
+         outputReadyCallback(std::move(data), nal.bytes_used, nal.timestamp_us, nal.keyframe);
 		}
-      
-      v4l2_buffer buf = {};
-		v4l2_plane planes[VIDEO_MAX_PLANES] = {};
-      
-		buf.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-		buf.memory                 = V4L2_MEMORY_MMAP;
-		buf.index                  = nal.index;
-		buf.length                 = 1;
-		buf.m.planes               = planes;
-		buf.m.planes[0].bytesused  = 0;
-		buf.m.planes[0].length     = nal.length;
-      
-		v4l2Cmd(VIDIOC_QBUF, &buf, "failed to re-queue encoded buffer");
 	}
 }
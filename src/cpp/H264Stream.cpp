@@ -1,16 +1,77 @@
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
+#include <stdexcept>
 
 #include "H264Stream.h"
 
-#define PORT 8888
+#define PORT              8888
+#define MAX_CONNECTIONS   8
 
+#define RTSP_PORT              8554
+#define MAX_RTSP_CONNECTIONS   8
+
+#define WEBSOCKET_PATH   "/h264.ws"
+
+#define MAX_QUEUED_FRAMES   300
+#define MAX_QUEUED_BYTES    (8 * 1024 * 1024)
+
+// A client skips to the next keyframe if its send queue holds more than
+// RECOVERY_BACKLOG_MS of the current bitrate (or more than RECOVERY_QUEUED_FRAMES)
+// for longer than RECOVERY_DELAY_MS. The limits are well below the ones 
+// causing a disconnect.
+#define RECOVERY_BACKLOG_MS          1000
+#define RECOVERY_MIN_BACKLOG_BYTES   (256 * 1024)
+#define RECOVERY_QUEUED_FRAMES       (MAX_QUEUED_FRAMES / 2)
+#define RECOVERY_DELAY_MS            1000
+
+#define DEFAULT_MIN_BITRATE               1000000
+#define DEFAULT_MAX_BITRATE               10000000
+#define CONGESTION_SAMPLE_INTERVAL_MS     500
+
+#define FRAME_RING_DATA_SIZE     (16 * 1024 * 1024)
+#define FRAME_RING_SLOT_COUNT    512
+#define MAX_FRAME_RING_READERS   8
+
+using hls::HlsServer;
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
 using libcamera::StreamConfiguration;
 using logging::Logger;
+using mpegts::MpegTsUdpStream;
 using network::Connection;
+using network::ConnectionSettings;
+using network::ListenAddress;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SendQueueStatistics;
+using network::SharedBuffer;
+using network::SocketOptions;
 using network::TcpServer;
+using rtsp::RtspServer;
+using sharedmemory::FrameRingPublisher;
+using websocket::PayloadFormat;
+using websocket::WebSocketStream;
 
-H264Stream::H264Stream(StreamConfiguration const &streamConfig, ConnectedCallback callback) 
+H264Stream::H264Stream(StreamConfiguration const &streamConfig, HttpServer& httpServer, 
+                       ConnectedCallback callback) 
    : log("H264Stream"), 
+     httpServer(httpServer),
+     accessUnitCount(0),
+     recoveryCountOfClosedClients(0),
+     recoveryDroppedBytesOfClosedClients(0),
+     frameRingReaderCount(0),
+     rtspSessionCount(0),
+     fmp4ClientCount(0),
+     fmp4Stream(new Fmp4HttpStream(httpServer, streamConfig.size.width, streamConfig.size.height,
+        std::bind(&H264Stream::onFmp4ClientsChanged, this, std::placeholders::_1, std::placeholders::_2))),
+     hlsConsumerCount(0),
+     hlsServer(new HlsServer(httpServer, streamConfig.size.width, streamConfig.size.height,
+        std::bind(&H264Stream::onHlsActivityChanged, this, std::placeholders::_1),
+        std::bind(&H264Encoder::requestKeyframe, &h264encoder))),
+     webSocketClientCount(0),
+     mpegTsConsumerCount(0),
      h264encoder(streamConfig),
      connectedCallback(callback) {
         
@@ -19,50 +80,346 @@ H264Stream::H264Stream(StreamConfiguration const &streamConfig, ConnectedCallbac
                                                 std::placeholders::_2,
                                                 std::placeholders::_3,
                                                 std::placeholders::_4));
+   
+   unsigned int minBitrate = DEFAULT_MIN_BITRATE;
+   unsigned int maxBitrate = DEFAULT_MAX_BITRATE;
+   AdaptiveBitrateController::parseBitrateRange("OCTOWATCH_H264_BITRATE", minBitrate, maxBitrate);
+   bitrateController.reset(new AdaptiveBitrateController(minBitrate, maxBitrate, 
+      std::bind(&H264Encoder::setBitrate, &h264encoder, std::placeholders::_1)));
 }
 
 H264Stream::~H264Stream() {
    connectedCallback(false);
+   httpServer.removeRoutes(*this);
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients.clear();
+   }
    if (tcpServer) {
       tcpServer->stop();
    }
+   frameRingPublisher.reset();
+   rtspServer.reset();
+   fmp4Stream.reset();
+   hlsServer.reset();
+   webSocketStream.reset();
+   mpegTsStream.reset();
 }
  
 void H264Stream::start() {
    connectedCallback(false);
-   tcpServer.reset(new TcpServer(PORT, "H.264", *this));
+   
+   // Dropping single NAL units would corrupt the stream until the next 
+   // keyframe, therefore a client that can't keep up skips to the next 
+   // keyframe (see onEncoderOutputReady). If its queue overflows nonetheless,
+   // it gets disconnected. This policy also keeps the egress scheduler from 
+   // dropping single NAL units.
+   ConnectionSettings settings;
+   settings.sendQueueLimits.maxQueuedFrames = MAX_QUEUED_FRAMES;
+   settings.sendQueueLimits.maxQueuedBytes  = MAX_QUEUED_BYTES;
+   settings.sendQueueLimits.overflowPolicy  = OverflowPolicy::DISCONNECT;
+   settings.socketOptions                   = SocketOptions::streamingProfile();
+   // no MSG_ZEROCOPY, the NAL units reside in memory mapped output buffers
+   // of the encoder, which the kernel can't pin
+   settings.egressStream                    = "h264";
+   
+   tcpServer.reset(new TcpServer(ListenAddress::fromEnvironment("OCTOWATCH_H264_ADDRESSES", PORT), 
+                                 "H.264", *this, MAX_CONNECTIONS, settings));
    tcpServer->start();
+   httpServer.addRoute("/h264", *this);
+   
+   char* frameRingSocketEnvVar = std::getenv("OCTOWATCH_H264_FRAME_RING_SOCKET");
+   if (frameRingSocketEnvVar != nullptr) {
+      try {
+         frameRingPublisher.reset(new FrameRingPublisher("h264", frameRingSocketEnvVar, 
+            FRAME_RING_DATA_SIZE, FRAME_RING_SLOT_COUNT, MAX_FRAME_RING_READERS,
+            std::bind(&H264Stream::onFrameRingReadersChanged, this, std::placeholders::_1, std::placeholders::_2)));
+         frameRingPublisher->start();
+      } catch (const std::runtime_error& e) {
+         log.error("failed to create frame ring:", e.what());
+      }
+   }
+   
+   rtspServer.reset(new RtspServer(ListenAddress::fromEnvironment("OCTOWATCH_RTSP_ADDRESSES", RTSP_PORT),
+      MAX_RTSP_CONNECTIONS, 
+      std::bind(&H264Stream::onRtspSessionsChanged, this, std::placeholders::_1, std::placeholders::_2)));
+   rtspServer->start();
+   fmp4Stream->start();
+   hlsServer->start();
+   
+   webSocketStream.reset(new WebSocketStream("H.264-WebSocket", PayloadFormat::H264,
+      httpServer, WEBSOCKET_PATH,
+      std::bind(&H264Stream::onWebSocketClientsChanged, this, std::placeholders::_1, std::placeholders::_2)));
+   webSocketStream->start();
+   
+   char* mpegTsDestinationEnvVar = std::getenv("OCTOWATCH_MPEGTS_DESTINATION");
+   if (mpegTsDestinationEnvVar != nullptr) {
+      boost::asio::ip::udp::endpoint destination;
+      if (MpegTsUdpStream::parseDestination(mpegTsDestinationEnvVar, destination)) {
+         mpegTsStream.reset(new MpegTsUdpStream(destination));
+         mpegTsStream->start();
+         onConsumersChanged(mpegTsConsumerCount, 1, true);
+      } else {
+         log.warning("ignoring MPEG-TS destination because it's not in the format \"<IPv4 address>:<port>\".");
+      }
+   }
 }
 
 void H264Stream::send(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us) {
-   if (connection) {
+   bool clientsConnected = false;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clientsConnected = hasConsumers();
+   }
+   if (clientsConnected) {
       h264encoder.encode(frameBuffer, timestamp_us);
    }
 }
 
-void H264Stream::onNewConnection(std::unique_ptr<Connection> conn) {
-   log.info("accepted new connection");
+void H264Stream::onNewConnection(std::shared_ptr<Connection> conn) {
+   log.info("accepted new connection", conn->getId());
    {
-      const std::lock_guard<std::mutex> lock(connectionMutex);
-      connection = std::move(conn);
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients.emplace(conn->getId(), Client{conn, KeyframeGate(conn->getId(), 
+         std::chrono::milliseconds(RECOVERY_DELAY_MS), std::chrono::steady_clock::now())});
    }
+   // Without a keyframe the new client would have to wait for the next 
+   // regular one (up to a full GOP) before it is able to decode the stream.
+   h264encoder.requestKeyframe();
    connectedCallback(true);
 }
 
-void H264Stream::onConnectionClosed() {
-   log.info("connection lost");
+void H264Stream::onConnectionClosed(int connectionId) {
+   bool noClientsLeft = false;
+   SendQueueStatistics statistics;
+   KeyframeGate::Statistics gateStatistics;
    {
-      const std::lock_guard<std::mutex> lock(connectionMutex);
-      connection.reset();
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      auto entry = clients.find(connectionId);
+      if (entry != clients.end()) {
+         statistics     = entry->second.connection->getSendQueueStatistics();
+         gateStatistics = entry->second.keyframeGate.getStatistics();
+         recoveryCountOfClosedClients        += gateStatistics.recoveryCount;
+         recoveryDroppedBytesOfClosedClients += gateStatistics.droppedBytes;
+         clients.erase(entry);
+      }
+      noClientsLeft = !hasConsumers();
+   }
+   log.info("connection", connectionId, "lost (sent NAL units:", statistics.sentFrames, 
+            ", dropped NAL units:", statistics.droppedFrames, ", recoveries:", gateStatistics.recoveryCount, 
+            ", bytes dropped by recoveries:", gateStatistics.droppedBytes, ")");
+   if (noClientsLeft) {
+      connectedCallback(false);
    }
-   connectedCallback(false);
 }
 
-void H264Stream::onEncoderOutputReady(void *mem, size_t size, int64_t timestamp_us, bool keyframe) {
-   if (connection) {
-      log.debug("output ready: size =", size, ", timestamp_us = ", timestamp_us);
-      connection->asyncSend(mem, size);
+void H264Stream::onEncoderOutputReady(std::shared_ptr<const uint8_t> data, size_t size, 
+                                      int64_t timestamp_us, bool keyframe) {
+   log.debug("output ready: size =", size, ", timestamp_us = ", timestamp_us);
+   // memory mapped output buffer of the encoder (the kernel can't pin it)
+   SharedBuffer nal(std::move(data), size, false);
+   sampleCongestion();
+   
+   if (frameRingPublisher) {
+      frameRingPublisher->publish(nal.data(), size, timestamp_us, keyframe);
+   }
+   
+   if (rtspServer) {
+      rtspServer->send(nal, timestamp_us, keyframe);
+   }
+   
+   if (fmp4Stream) {
+      fmp4Stream->send(nal, timestamp_us, keyframe);
+   }
+   
+   if (hlsServer) {
+      hlsServer->send(nal, timestamp_us, keyframe);
+   }
+   
+   if (webSocketStream) {
+      webSocketStream->send(nal, timestamp_us, keyframe);
+   }
+   
+   if (mpegTsStream) {
+      mpegTsStream->send(nal, timestamp_us, keyframe);
+   }
+   
+   bool keyframeNeeded = false;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      accessUnitCount++;
+      if (clients.empty()) {
+         return;
+      }
+      auto                       now   = std::chrono::steady_clock::now();
+      KeyframeGate::BacklogLimit limit = {
+         std::max<size_t>((uint64_t)bitrateController->getBitrate() / 8 * RECOVERY_BACKLOG_MS / 1000, 
+                          RECOVERY_MIN_BACKLOG_BYTES), 
+         RECOVERY_QUEUED_FRAMES};
+      for (auto& entry : clients) {
+         Client& client = entry.second;
+         switch (client.keyframeGate.decide(size, keyframe, client.connection->getSendQueueStatistics(), 
+                                            limit, now)) {
+            case KeyframeGate::Decision::SEND:
+               client.connection->asyncSendFrame({nal});
+               break;
+            case KeyframeGate::Decision::RECOVER:
+               client.keyframeGate.onQueueDiscarded(client.connection->discardQueuedFrames());
+               keyframeNeeded = true;
+               break;
+            case KeyframeGate::Decision::SKIP:
+               break;
+         }
+      }
+   }
+   if (keyframeNeeded) {
+      h264encoder.requestKeyframe();
    }
 }
 
-void H264Stream::onCommandReceived(const std::string& command) {}
+void H264Stream::sampleCongestion() {
+   auto now = std::chrono::steady_clock::now();
+   std::vector<CongestionSample> samples;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      if (now - lastCongestionSample < std::chrono::milliseconds(CONGESTION_SAMPLE_INTERVAL_MS)) {
+         return;
+      }
+      lastCongestionSample = now;
+      for (auto& entry : clients) {
+         CongestionSample sample;
+         sample.transportAvailable = entry.second.connection->getTransportStatistics(sample.transport);
+         sample.queuedBytes        = entry.second.connection->getSendQueueStatistics().queuedBytes;
+         samples.push_back(sample);
+      }
+   }
+   bitrateController->update(samples, now);
+}
+
+void H264Stream::onFrameRingReadersChanged(unsigned int readerCount, bool readerAttached) {
+   onConsumersChanged(frameRingReaderCount, readerCount, readerAttached);
+}
+
+void H264Stream::onRtspSessionsChanged(unsigned int playingSessionCount, bool sessionStarted) {
+   onConsumersChanged(rtspSessionCount, playingSessionCount, sessionStarted);
+}
+
+void H264Stream::onFmp4ClientsChanged(unsigned int clientCount, bool clientAdded) {
+   onConsumersChanged(fmp4ClientCount, clientCount, clientAdded);
+}
+
+void H264Stream::onHlsActivityChanged(bool active) {
+   onConsumersChanged(hlsConsumerCount, active ? 1 : 0, active);
+}
+
+void H264Stream::onWebSocketClientsChanged(unsigned int clientCount, bool clientAdded) {
+   onConsumersChanged(webSocketClientCount, clientCount, clientAdded);
+}
+
+void H264Stream::onConsumersChanged(unsigned int& consumerCount, unsigned int newConsumerCount, 
+                                    bool consumerAdded) {
+   bool noClientsLeft = false;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      consumerCount = newConsumerCount;
+      noClientsLeft = !hasConsumers();
+   }
+   if (consumerAdded) {
+      h264encoder.requestKeyframe();
+      connectedCallback(true);
+   } else if (noClientsLeft) {
+      connectedCallback(false);
+   }
+}
+
+bool H264Stream::hasConsumers() const {
+   return !clients.empty() || (frameRingReaderCount > 0) || (rtspSessionCount > 0) || (fmp4ClientCount > 0) ||
+          (hlsConsumerCount > 0) || (webSocketClientCount > 0) || (mpegTsConsumerCount > 0);
+}
+
+void H264Stream::onCommandReceived(int connectionId, std::string_view command) {}
+
+H264Stream::Result H264Stream::onRequest(const HttpRequest& request, std::shared_ptr<Connection> connection,
+                                         HttpResponse& response) {
+   if (request.method == "HEAD") {
+      response.contentType = "video/h264";
+      return Result::RESPONDED;
+   }
+   if (request.method != "GET") {
+      response = HttpResponse::text(405, "only GET is supported\n");
+      response.headers.emplace_back("Allow", "GET, HEAD");
+      return Result::RESPONDED;
+   }
+   
+   // same limits as the connections of the raw TCP server
+   SendQueueLimits limits;
+   limits.maxQueuedFrames = MAX_QUEUED_FRAMES;
+   limits.maxQueuedBytes  = MAX_QUEUED_BYTES;
+   limits.overflowPolicy  = OverflowPolicy::DISCONNECT;
+   connection->setSendQueueLimits(limits);
+   connection->setEgressStream("h264");
+   
+   // the body is the raw Annex B byte stream
+   connection->asyncSend(HttpServer::createStreamHeader("video/h264"));
+   onNewConnection(connection);
+   return Result::STREAMING;
+}
+
+void H264Stream::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(clientsMutex);
+   uint64_t recoveryCount        = recoveryCountOfClosedClients;
+   uint64_t recoveryDroppedBytes = recoveryDroppedBytesOfClosedClients;
+   for (auto& entry : clients) {
+      recoveryCount        += entry.second.keyframeGate.getStatistics().recoveryCount;
+      recoveryDroppedBytes += entry.second.keyframeGate.getStatistics().droppedBytes;
+   }
+   output << "# TYPE octowatch_h264_access_units_total counter" << "\n";
+   output << "octowatch_h264_access_units_total " << accessUnitCount << "\n";
+   output << "# TYPE octowatch_h264_recoveries_total counter" << "\n";
+   output << "octowatch_h264_recoveries_total " << recoveryCount << "\n";
+   output << "# TYPE octowatch_h264_recovery_dropped_bytes_total counter" << "\n";
+   output << "octowatch_h264_recovery_dropped_bytes_total " << recoveryDroppedBytes << "\n";
+   output << "# TYPE octowatch_h264_consumers gauge" << "\n";
+   output << "octowatch_h264_consumers{transport=\"tcp\"} " << clients.size() << "\n";
+   output << "octowatch_h264_consumers{transport=\"rtsp\"} " << rtspSessionCount << "\n";
+   output << "octowatch_h264_consumers{transport=\"fmp4\"} " << fmp4ClientCount << "\n";
+   output << "octowatch_h264_consumers{transport=\"hls\"} " << hlsConsumerCount << "\n";
+   output << "octowatch_h264_consumers{transport=\"websocket\"} " << webSocketClientCount << "\n";
+   output << "octowatch_h264_consumers{transport=\"frame_ring\"} " << frameRingReaderCount << "\n";
+   output << "octowatch_h264_consumers{transport=\"mpegts\"} " << mpegTsConsumerCount << "\n";
+   bitrateController->writeMetrics(output);
+}
+
+std::map<std::string, EncoderParameter> H264Stream::getEncoderParameters() {
+   auto parameters = h264encoder.getEncoderParameters();
+   auto bitrate    = parameters.find("bitrate");
+   if (bitrate != parameters.end()) {
+      // the encoder reports the adapted bitrate but the clients set the maximum
+      bitrate->second.value = bitrateController->getMaxBitrate();
+   }
+   return parameters;
+}
+
+EncoderControl::Result H264Stream::setEncoderParameter(const std::string& name, int value) {
+   if (name == "bitrate") {
+      auto parameters = h264encoder.getEncoderParameters();
+      auto bitrate    = parameters.find(name);
+      if (bitrate == parameters.end()) {
+         return EncoderControl::Result::UNKNOWN_PARAMETER;
+      }
+      if (!bitrate->second.accepts(value)) {
+         log.warning("ignoring invalid bitrate", value);
+         return EncoderControl::Result::INVALID_VALUE;
+      }
+      bitrateController->setMaxBitrate(value);
+      return EncoderControl::Result::APPLIED;
+   }
+   
+   EncoderControl::Result result = h264encoder.setEncoderParameter(name, value);
+   if ((result == EncoderControl::Result::APPLIED) && 
+       ((name == "profile") || (name == "level") || (name == "iFramePeriod"))) {
+      // the clients need the new sequence headers (part of every keyframe)
+      h264encoder.requestKeyframe();
+   }
+   return result;
+}
@@ -129,7 +129,7 @@ void HardwareJpegEncoder::configureOutputFormat() {
 
 void HardwareJpegEncoder::createInputBuffers() {
    struct v4l2_requestbuffers inputBufferRequest = {};
-	inputBufferRequest.count                      = HARDWARE_JPEG_ENCODER_BUFFER_COUNT;
+	inputBufferRequest.count                      = HARDWARE_JPEG_ENCODER_INPUT_BUFFER_COUNT;
 	inputBufferRequest.type                       = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
 	inputBufferRequest.memory                     = V4L2_MEMORY_DMABUF;
 
@@ -177,7 +177,7 @@ void HardwareJpegEncoder::createInputBuffers() {
 
 void HardwareJpegEncoder::createOutputBuffers() {
    struct v4l2_requestbuffers outputBufferRequest = {};
-	outputBufferRequest.count                      = HARDWARE_JPEG_ENCODER_BUFFER_COUNT;
+	outputBufferRequest.count                      = HARDWARE_JPEG_ENCODER_OUTPUT_BUFFER_COUNT;
 	outputBufferRequest.type                       = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 	outputBufferRequest.memory                     = V4L2_MEMORY_MMAP;
 
@@ -216,8 +216,9 @@ void HardwareJpegEncoder::createOutputBuffers() {
       log.info("\t* length    =", outputBufferSize);   
       log.info("\t* offset    =", outputBufferOffset);   
    
-      unsigned char* outputBuffer = (u_int8_t*) mmap(NULL, outputBufferSize, 
-                                       PROT_READ | PROT_WRITE, MAP_SHARED, encoderFileDescriptor, outputBufferOffset);
+      // the mapping outlives the encoder as long as lent buffers are in use
+      unsigned char* outputBuffer = (u_int8_t*) outputBuffers.map(encoderFileDescriptor, outputBufferSize, 
+                                                                   outputBufferOffset);
       if (outputBuffer == MAP_FAILED) {
          std::ostringstream message;
          message << "failed to map output buffer: errno " << errno;
@@ -241,7 +242,12 @@ void HardwareJpegEncoder::startOutputStream() {
 }
    
 HardwareJpegEncoder::HardwareJpegEncoder(StreamConfiguration const &streamConfig, int quality)
-	: log("HardwareJpegEncoder"), quitPollThread(false), quitOutputThread(false), v4l2CommandError(false) {
+	: log("HardwareJpegEncoder"), 
+     outputBuffers("HardwareJpegEncoderOutputBuffers", HARDWARE_JPEG_ENCODER_MAX_LENT_OUTPUT_BUFFERS),
+     controls("HardwareJpegEncoderControls", {{"quality", V4L2_CID_JPEG_COMPRESSION_QUALITY}}),
+     quitPollThread(false), 
+     quitOutputThread(false), 
+     v4l2CommandError(false) {
    
    if ((quality < 1) || (quality > 100)) {
       std::ostringstream message;
@@ -271,6 +277,7 @@ HardwareJpegEncoder::~HardwareJpegEncoder() {
    log.info("poll thread finished");
 	outputThread.join();
    log.info("output thread finished");
+   outputBuffers.close();
 
 	unsigned int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
 	v4l2Cmd(VIDIOC_STREAMOFF, &type, "failed to stop input");
@@ -340,7 +347,7 @@ void HardwareJpegEncoder::pollThreadTask() {
 		int returnValue = poll(&driverEvent, 1, 200);
 		{
 			std::lock_guard<std::mutex> lock(availableInputBuffersMutex);
-			if (quitPollThread && availableInputBuffers.size() == HARDWARE_JPEG_ENCODER_BUFFER_COUNT) {
+			if (quitPollThread && availableInputBuffers.size() == HARDWARE_JPEG_ENCODER_INPUT_BUFFER_COUNT) {
 				break;
          }
 		}
@@ -391,10 +398,37 @@ void HardwareJpegEncoder::pollThreadTask() {
 	}
 }
 
+std::map<std::string, EncoderParameter> HardwareJpegEncoder::getEncoderParameters() {
+   return controls.query(encoderFileDescriptor);
+}
+
+HardwareJpegEncoder::Result HardwareJpegEncoder::setEncoderParameter(const std::string& name, int value) {
+   return controls.set(encoderFileDescriptor, name, value);
+}
+
+void HardwareJpegEncoder::requeueOutputBuffer(unsigned int index, size_t length) {
+   v4l2_buffer buf      = {};
+   v4l2_plane planes[1] = {};
+   
+   buf.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+   buf.memory                 = V4L2_MEMORY_MMAP;
+   buf.index                  = index;
+   buf.length                 = 1;
+   buf.m.planes               = planes;
+   buf.m.planes[0].bytesused  = 0;
+   buf.m.planes[0].length     = length;
+   
+   // no exception gets thrown here because this method gets called by 
+   // whoever releases the last reference to the JPEG
+   if (ioctl(encoderFileDescriptor, VIDIOC_QBUF, &buf) == -1) {
+      log.error("failed to enqueue output buffer", index, ": errno", errno);
+   }
+}
+
 /**
  * This task waits for JPEGs enqueued by pollThreadTask and provides
- * them to the consumer/callback. After consumption the output buffer
- * gets enqueue again.
+ * them to the consumer/callback. The output buffer gets enqueued again
+ * as soon as the consumer released all references to the JPEG.
  */
 void HardwareJpegEncoder::outputThreadTask() {
 	JpegImage jpegImage;
@@ -415,23 +449,16 @@ void HardwareJpegEncoder::outputThreadTask() {
 			}
 		}
 
+      unsigned int index  = jpegImage.index;
+      size_t       length = jpegImage.length;
+      auto data = outputBuffers.lend(jpegImage.data, jpegImage.bytesUsed, [this, index, length]() {
+         requeueOutputBuffer(index, length);
+      });
+      
       if (outputReadyCallback) {
-         outputReadyCallback(jpegImage.data, jpegImage.bytesUsed, jpegImage.timestamp_us);
+         outputReadyCallback(std::move(data), jpegImage.bytesUsed, jpegImage.timestamp_us);
 		}
       
-      v4l2_buffer buf      = {};
-		v4l2_plane planes[1] = {};
-      
-		buf.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-		buf.memory                 = V4L2_MEMORY_MMAP;
-		buf.index                  = jpegImage.index;
-		buf.length                 = 1;
-		buf.m.planes               = planes;
-		buf.m.planes[0].bytesused  = 0;
-		buf.m.planes[0].length     = jpegImage.length;
-      
-		v4l2Cmd(VIDIOC_QBUF, &buf, "failed to enqueue output buffer");
-      
       int inputBufferIndex = -1;
       std::lock_guard<std::mutex> lock(inputBuffersReadyToReuseMutex);
       {
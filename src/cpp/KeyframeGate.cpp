@@ -0,0 +1,84 @@
+#include "KeyframeGate.h"
+
+using network::SendQueueStatistics;
+
+KeyframeGate::KeyframeGate(int connectionId, std::chrono::milliseconds recoveryDelay, 
+                           Clock::time_point connectTime)
+   : log("KeyframeGate"),
+     connectionId(connectionId),
+     recoveryDelay(recoveryDelay),
+     connectTime(connectTime),
+     waitingForKeyframe(true),
+     backlogged(false),
+     recovering(false),
+     recoveryDroppedBytes(0) {}
+
+KeyframeGate::Decision KeyframeGate::decide(size_t size, bool keyframe, const SendQueueStatistics& queue,
+                                            const BacklogLimit& limit, Clock::time_point now) {
+   if (!waitingForKeyframe && !keyframe && hasSustainedBacklog(queue, limit, now)) {
+      waitingForKeyframe   = true;
+      recovering           = true;
+      backlogged           = false;
+      recoveryStart        = now;
+      recoveryDroppedBytes = size;
+      statistics.droppedBytes += size;
+      statistics.recoveryCount++;
+      return Decision::RECOVER;
+   }
+
+   if (!waitingForKeyframe) {
+      return Decision::SEND;
+   }
+
+   if (!keyframe) {
+      if (recovering) {
+         recoveryDroppedBytes    += size;
+         statistics.droppedBytes += size;
+      }
+      return Decision::SKIP;
+   }
+
+   if (recovering) {
+      log.info("connection", connectionId, "resumes with keyframe after", 
+               std::chrono::duration_cast<std::chrono::milliseconds>(now - recoveryStart).count(), 
+               "ms (dropped", recoveryDroppedBytes, "bytes)");
+      recovering = false;
+   } else {
+      statistics.timeToFirstKeyframe = now - connectTime;
+      log.info("connection", connectionId, "starts with keyframe after", 
+               std::chrono::duration_cast<std::chrono::milliseconds>(statistics.timeToFirstKeyframe).count(), 
+               "ms");
+   }
+   waitingForKeyframe = false;
+   return Decision::SEND;
+}
+
+void KeyframeGate::onQueueDiscarded(size_t discardedBytes) {
+   // The queued access units directly follow the ones already sent, therefore
+   // discarding all of them leaves a gap the next keyframe closes.
+   recoveryDroppedBytes    += discardedBytes;
+   statistics.droppedBytes += discardedBytes;
+   log.warning("connection", connectionId, "can't keep up -> skipping to the next keyframe (discarded", 
+               discardedBytes, "queued bytes)");
+}
+
+bool KeyframeGate::isWaitingForKeyframe() const {
+   return waitingForKeyframe;
+}
+
+const KeyframeGate::Statistics& KeyframeGate::getStatistics() const {
+   return statistics;
+}
+
+bool KeyframeGate::hasSustainedBacklog(const SendQueueStatistics& queue, const BacklogLimit& limit,
+                                       Clock::time_point now) {
+   if ((queue.queuedBytes <= limit.bytes) && (queue.queuedFrames <= limit.frames)) {
+      backlogged = false;
+      return false;
+   }
+   if (!backlogged) {
+      backlogged   = true;
+      backlogSince = now;
+   }
+   return now - backlogSince >= recoveryDelay;
+}
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
@@ -14,83 +15,129 @@
 
 #include "Camera.h"
 #include "CameraControl.h"
+#include "FrameGrabber.h"
 #include "H264Stream.h"
+#include "HttpServer.h"
 #include "Logging.h"
 #include "MultipartJpegHttpStream.h"
 #include "SingleThreadedExecutor.h"
 #include "SystemTemperature.h"
 
+using http::HttpServer;
 using libcamera::FrameBuffer;
 using logging::Logger;
+using sharedmemory::FrameGrabber;
 
 using namespace std::chrono_literals;
 
+#define MAX_FRAME_GRABBER_READERS   4
+
 class Impl {
    public:
       Impl() : log("Impl"),
+               httpServer(),
                camera(),
-               cameraControl(camera),
+               cameraControl(camera, httpServer),
                mpjpegConnected(false),
                h264Connected(false),
-               systemTemperature() {
+               frameGrabberReaderCount(0),
+               systemTemperature(),
+               cameraStateExecutor(new SingleThreadedExecutor([](int id){})) {
                
+         httpServer.start();
          startVideoStreams();
+         startFrameGrabber();
          cameraControl.start();
          systemTemperature.start(std::bind(&Impl::systemTemperatureTooHigh, this, std::placeholders::_1));
       }
       
       ~Impl() { 
+         cameraStateExecutor.reset();
+         cameraControl.setEncoderControl("h264", nullptr);
+         cameraControl.setEncoderControl("jpeg", nullptr);
+         frameGrabber.reset();
          camera.stop();
       }
       
       void startVideoStreams() {
          if (!h264Stream) {
             h264Stream.reset(new H264Stream(camera.getStreamConfiguration(StreamType::HIGH_RESOLUTION), 
-                          std::bind(&Impl::onH264Connected, this, std::placeholders::_1)));
+                          httpServer, std::bind(&Impl::onH264Connected, this, std::placeholders::_1)));
             h264Stream->start();
+            cameraControl.setEncoderControl("h264", h264Stream.get());
          }
          if (!mpjegStream) {
             mpjegStream.reset(new MultipartJpegHttpStream(
-                          camera.getStreamConfiguration(StreamType::LOW_RESOLUTION), 
+                          camera.getStreamConfiguration(StreamType::LOW_RESOLUTION), httpServer,
                           std::bind(&Impl::onMpjpegConnected, this, std::placeholders::_1)));
             mpjegStream->start();
+            cameraControl.setEncoderControl("jpeg", &mpjegStream->getEncoderControl());
+         }
+      }
+      
+      void startFrameGrabber() {
+         char* socketEnvVar = std::getenv("OCTOWATCH_FRAME_GRABBER_SOCKET");
+         if (socketEnvVar != nullptr) {
+            frameGrabber.reset(new FrameGrabber(socketEnvVar, camera, MAX_FRAME_GRABBER_READERS,
+                          std::bind(&Impl::onFrameGrabberReadersChanged, this, std::placeholders::_1, 
+                                    std::placeholders::_2)));
+            frameGrabber->start();
          }
       }
       
       void stopVideoStreams() {
+         cameraControl.setEncoderControl("h264", nullptr);
+         cameraControl.setEncoderControl("jpeg", nullptr);
          h264Stream.reset();
          mpjegStream.reset();
       }
       
       void updateCameraState() {
-         if (!mpjpegConnected && !h264Connected) {
+         if (!mpjpegConnected && !h264Connected && (frameGrabberReaderCount == 0)) {
             camera.stop();
             return;
          }
          
-         if (!camera.isStarted() && (mpjegStream || h264Stream)) {
+         if (!camera.isStarted() && (mpjegStream || h264Stream || frameGrabber)) {
             auto frameConsumer = std::bind(&Impl::onNewFrame, this, std::placeholders::_1, 
-                                           std::placeholders::_2, std::placeholders::_3);
+                                           std::placeholders::_2, std::placeholders::_3,
+                                           std::placeholders::_4);
             if(!camera.start(frameConsumer)) {
                log.error("failed to start camera");
             }
          }
       }
       
+      /**
+       * The streams report their state while holding locks of the network
+       * code, and stopping the camera waits for the frames still in use by
+       * the streams. Therefore the camera gets started/stopped by its own
+       * thread. Only the latest state matters, hence a pending update gets
+       * replaced by the next one.
+       */
+      void requestCameraStateUpdate() {
+         cameraStateExecutor->execute(std::bind(&Impl::updateCameraState, this), 0);
+      }
+      
       void onMpjpegConnected(bool connected) {
          log.info("MJPEG-stream state =", connected ? "connected" : "disconnected");
          mpjpegConnected = connected;
-         updateCameraState();
+         requestCameraStateUpdate();
       }
       
       void onH264Connected(bool connected) {
          log.info("H.264-stream state =", connected ? "connected" : "disconnected");
          h264Connected = connected;
-         updateCameraState();
+         requestCameraStateUpdate();
+      }
+      
+      void onFrameGrabberReadersChanged(unsigned int readerCount, bool readerAttached) {
+         frameGrabberReaderCount = readerCount;
+         requestCameraStateUpdate();
       }
       
-      void onNewFrame(FrameBuffer *highResolutionFrameBuffer, 
-                      FrameBuffer *lowResolutionFrameBuffer, int64_t timestamp) {
+      void onNewFrame(FrameBuffer *highResolutionFrameBuffer, FrameBuffer *lowResolutionFrameBuffer, 
+                      int64_t timestamp, const FrameLease& lease) {
 
          log.debug("new frame with timestamp ", timestamp);
                          
@@ -101,6 +148,10 @@ class Impl {
          if (mpjpegConnected) {
             mpjegStream->send(lowResolutionFrameBuffer, timestamp);
          }
+         
+         if (frameGrabberReaderCount > 0) {
+            frameGrabber->onNewFrame(highResolutionFrameBuffer, timestamp, lease);
+         }
       }
 
       void systemTemperatureTooHigh(bool tooHigh) {
@@ -114,13 +165,17 @@ class Impl {
       
    private:
       Logger                                   log;
+      HttpServer                               httpServer;   // destroyed after its handlers
       Camera                                   camera;
       CameraControl                            cameraControl;
-      bool                                     mpjpegConnected;
-      bool                                     h264Connected;
+      std::atomic<bool>                        mpjpegConnected;
+      std::atomic<bool>                        h264Connected;
+      std::atomic<unsigned int>                frameGrabberReaderCount;
       std::unique_ptr<H264Stream>              h264Stream;
       std::unique_ptr<MultipartJpegHttpStream> mpjegStream;
+      std::unique_ptr<FrameGrabber>            frameGrabber;
       SystemTemperature                        systemTemperature;
+      std::unique_ptr<SingleThreadedExecutor>  cameraStateExecutor;
 };
 
 int main() {
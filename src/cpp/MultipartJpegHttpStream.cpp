@@ -3,6 +3,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <regex>
+#include <stdexcept>
 #include <string>
 #include <thread>
 
@@ -10,24 +11,49 @@
 #include "HardwareJpegEncoder.h"
 #include "MultipartJpegHttpStream.h"
 
-#define PORT 8887
-#define CRLF "\r\n"
+#define CRLF              "\r\n"
 
 #define WIDTH              800
 #define HEIGHT             600
 #define DEFAULT_QUALITY    95
 #define RESTART_INTERVAL   0
 
+#define MAX_QUEUED_FRAMES   2
+#define MAX_QUEUED_BYTES    (2 * 1024 * 1024)
+
+#define FRAME_RING_DATA_SIZE     (8 * 1024 * 1024)
+#define FRAME_RING_SLOT_COUNT    64
+#define MAX_FRAME_RING_READERS   8
+
+#define WEBSOCKET_PATH   "/mjpeg.ws"
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
 using libcamera::StreamConfiguration;
 using logging::Logger;
 using network::Connection;
-using network::TcpServer;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SendQueueStatistics;
+using network::SharedBuffer;
+using sharedmemory::FrameRingPublisher;
+using websocket::PayloadFormat;
+using websocket::WebSocketStream;
 
 using namespace std::chrono_literals;
 
 MultipartJpegHttpStream::MultipartJpegHttpStream(StreamConfiguration const &streamConfig,
-                                                 ConnectedCallback callback) 
+                                                 HttpServer& httpServer, ConnectedCallback callback) 
    : log("MultipartJpegHttpStream"), 
+     jpegsPinnable(false),
+     httpServer(httpServer),
+     jpegCount(0),
+     snapshotCount(0),
+     droppedFramesOfClosedClients(0),
+     frameRingReaderCount(0),
+     webSocketClientCount(0),
+     partTrailer(SharedBuffer::copyOf(std::string(CRLF).append(CRLF))),
      connectedCallback(callback) {
         
    char* qualityEnvVar = std::getenv("OCTOWATCH_JPEG_QUALITY");
@@ -56,6 +82,7 @@ MultipartJpegHttpStream::MultipartJpegHttpStream(StreamConfiguration const &stre
    char* jpegEncoderEnvVar = std::getenv("OCTOWATCH_JPEG_ENCODER");
    if (jpegEncoderEnvVar && (strcmp(jpegEncoderEnvVar, "CPU") == 0)) {
       jpegEncoder.reset(new CpuJpegEncoder(streamConfig, quality));
+      jpegsPinnable = true;
    } else {
       jpegEncoder.reset(new HardwareJpegEncoder(streamConfig, quality));
    }
@@ -66,18 +93,46 @@ MultipartJpegHttpStream::MultipartJpegHttpStream(StreamConfiguration const &stre
 
 MultipartJpegHttpStream::~MultipartJpegHttpStream() {
    connectedCallback(false);
-   if (connection != nullptr) {
-      connection.reset(); 
-   }
-   if (tcpServer) {
-      tcpServer->stop();
+   httpServer.removeRoutes(*this);
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients.clear();
+      snapshotRequests.clear();
    }
+   frameRingPublisher.reset();
+   webSocketStream.reset();
 }
  
 void MultipartJpegHttpStream::start() {
    connectedCallback(false);
-   tcpServer.reset(new TcpServer(PORT, "MPJPEG", *this));
-   tcpServer->start();
+   
+   // "/" for clients of the former MPJPEG-only server
+   httpServer.addRoute("/", *this);
+   httpServer.addRoute("/mjpeg", *this);
+   httpServer.addRoute("/snapshot.jpg", *this);
+   
+   char* frameRingSocketEnvVar = std::getenv("OCTOWATCH_MPJPEG_FRAME_RING_SOCKET");
+   if (frameRingSocketEnvVar != nullptr) {
+      try {
+         frameRingPublisher.reset(new FrameRingPublisher("mpjpeg", frameRingSocketEnvVar, 
+            FRAME_RING_DATA_SIZE, FRAME_RING_SLOT_COUNT, MAX_FRAME_RING_READERS,
+            std::bind(&MultipartJpegHttpStream::onFrameRingReadersChanged, this, 
+                      std::placeholders::_1, std::placeholders::_2)));
+         frameRingPublisher->start();
+      } catch (const std::runtime_error& e) {
+         log.error("failed to create frame ring:", e.what());
+      }
+   }
+   
+   webSocketStream.reset(new WebSocketStream("MPJPEG-WebSocket", PayloadFormat::JPEG,
+      httpServer, WEBSOCKET_PATH,
+      std::bind(&MultipartJpegHttpStream::onWebSocketClientsChanged, this, 
+                std::placeholders::_1, std::placeholders::_2)));
+   webSocketStream->start();
+}
+
+EncoderControl& MultipartJpegHttpStream::getEncoderControl() {
+   return *jpegEncoder;
 }
 
 void MultipartJpegHttpStream::send(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us) {
@@ -85,54 +140,169 @@ void MultipartJpegHttpStream::send(libcamera::FrameBuffer *frameBuffer, int64_t
    jpegEncoder->encode(frameBuffer, timestamp_us);
 }
 
-void MultipartJpegHttpStream::onJpegAvailable(void *data, size_t bytesCount, int64_t timestamp) {
-   sendJpeg(data, bytesCount);
+void MultipartJpegHttpStream::onJpegAvailable(std::shared_ptr<const uint8_t> data, size_t bytesCount, 
+                                              int64_t timestamp) {
+   SharedBuffer jpeg(std::move(data), bytesCount, jpegsPinnable);
+   
+   if (frameRingPublisher) {
+      frameRingPublisher->publish(jpeg.data(), bytesCount, timestamp, true);
+   }
+   sendJpeg(jpeg);
+   sendSnapshot(jpeg);
+   
+   if (webSocketStream) {
+      webSocketStream->send(jpeg, timestamp, true);
+   }
+}
+
+void MultipartJpegHttpStream::onFrameRingReadersChanged(unsigned int readerCount, bool readerAttached) {
+   onConsumersChanged(frameRingReaderCount, readerCount, readerAttached);
+}
+
+void MultipartJpegHttpStream::onWebSocketClientsChanged(unsigned int clientCount, bool clientAdded) {
+   onConsumersChanged(webSocketClientCount, clientCount, clientAdded);
+}
+
+void MultipartJpegHttpStream::onConsumersChanged(unsigned int& consumerCount, unsigned int newConsumerCount,
+                                                 bool consumerAdded) {
+   bool noClientsLeft = false;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      consumerCount = newConsumerCount;
+      noClientsLeft = !hasConsumers();
+   }
+   if (consumerAdded) {
+      connectedCallback(true);
+   } else if (noClientsLeft) {
+      connectedCallback(false);
+   }
+}
+
+bool MultipartJpegHttpStream::hasConsumers() const {
+   return !clients.empty() || !snapshotRequests.empty() || (frameRingReaderCount > 0) || (webSocketClientCount > 0);
 }
 
-void MultipartJpegHttpStream::sendJpeg(void *data, size_t size) {
+void MultipartJpegHttpStream::sendJpeg(const SharedBuffer& jpeg) {
    std::ostringstream messageToSend;
    messageToSend << "--FRAME" << CRLF;
    messageToSend << "Content-Type: image/jpeg" << CRLF;
-   messageToSend << "Content-Length: " << size << CRLF << CRLF;   
+   messageToSend << "Content-Length: " << jpeg.size() << CRLF << CRLF;   
+   
+   // all clients share the same header and JPEG
+   SharedBuffer header = SharedBuffer::copyOf(messageToSend.str());
    {
-      const std::lock_guard<std::mutex> lock(connectionMutex);
-      if (connection != nullptr) {
-         connection->asyncSend(messageToSend.str()); 
-         connection->asyncSend(data, size);   
-         connection->asyncSend(std::string(CRLF).append(CRLF));
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      jpegCount++;
+      for (auto& entry : clients) {
+         entry.second.connection->asyncSendFrame({header, jpeg, partTrailer});
       }
    }
 }
 
-void MultipartJpegHttpStream::onNewConnection(std::unique_ptr<Connection> conn) {
-   log.info("accepted new connection");
+void MultipartJpegHttpStream::sendSnapshot(const SharedBuffer& jpeg) {
+   std::set<int> connectionIds;
+   bool          noClientsLeft = false;
    {
-      const std::lock_guard<std::mutex> lock(connectionMutex);
-      connection = std::move(conn);
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      if (snapshotRequests.empty()) {
+         return;
+      }
+      connectionIds.swap(snapshotRequests);
+      snapshotCount += connectionIds.size();
+      noClientsLeft  = !hasConsumers();
+   }
+   
+   HttpResponse response;
+   response.contentType = "image/jpeg";
+   response.body        = jpeg;
+   for (int connectionId : connectionIds) {
+      httpServer.respond(connectionId, response);
+   }
+   if (noClientsLeft) {
+      connectedCallback(false);
    }
-   connectedCallback(true);
 }
 
-void MultipartJpegHttpStream::onConnectionClosed() {
-   log.info("connection lost");
+MultipartJpegHttpStream::Result MultipartJpegHttpStream::onRequest(const HttpRequest& request, 
+                                                                   std::shared_ptr<Connection> connection,
+                                                                   HttpResponse& response) {
+   if ((request.method != "GET") && (request.method != "HEAD")) {
+      response = HttpResponse::text(405, "only GET is supported\n");
+      response.headers.emplace_back("Allow", "GET, HEAD");
+      return Result::RESPONDED;
+   }
+   
+   if (request.path == "/snapshot.jpg") {
+      log.debug("snapshot requested on connection", connection->getId());
+      {
+         const std::lock_guard<std::mutex> lock(clientsMutex);
+         snapshotRequests.insert(connection->getId());
+      }
+      connectedCallback(true);
+      return Result::DEFERRED;
+   }
+   
+   if (request.method == "HEAD") {
+      response.contentType = "multipart/x-mixed-replace;boundary=FRAME";
+      return Result::RESPONDED;
+   }
+   
+   // A slow client should always get the latest JPEG instead of an ever 
+   // growing backlog of old ones.
+   SendQueueLimits limits;
+   limits.maxQueuedFrames = MAX_QUEUED_FRAMES;
+   limits.maxQueuedBytes  = MAX_QUEUED_BYTES;
+   limits.overflowPolicy  = OverflowPolicy::DROP_OLDEST_FRAME;
+   connection->setSendQueueLimits(limits);
+   connection->setEgressStream("mjpeg");
+   
+   log.info("received new HTTP request on connection", connection->getId(), "-> starting to send multipart response");
+   connection->asyncSend(HttpServer::createStreamHeader("multipart/x-mixed-replace;boundary=FRAME"));
    {
-      const std::lock_guard<std::mutex> lock(connectionMutex);
-      connection.reset();
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      clients[connection->getId()] = Client{connection};
    }
-   connectedCallback(false);
+   connectedCallback(true);
+   return Result::STREAMING;
 }
 
-void MultipartJpegHttpStream::onCommandReceived(const std::string& command) {
-   if (command == std::string("\r")) {
-      log.info("received new HTTP request -> starting to send multipart response");
-      std::ostringstream messageToSend;
-      messageToSend << "HTTP/1.1 200 OK" << CRLF;
-      messageToSend << "Content-Type: multipart/x-mixed-replace;boundary=FRAME" << CRLF << CRLF;
-      {
-         const std::lock_guard<std::mutex> lock(connectionMutex);
-         if (connection != nullptr) {
-            connection->asyncSend(messageToSend.str());
-         }
+void MultipartJpegHttpStream::onConnectionClosed(int connectionId) {
+   bool noClientsLeft = false;
+   bool streaming     = false;
+   SendQueueStatistics statistics;
+   {
+      const std::lock_guard<std::mutex> lock(clientsMutex);
+      auto entry = clients.find(connectionId);
+      if (entry != clients.end()) {
+         statistics = entry->second.connection->getSendQueueStatistics();
+         droppedFramesOfClosedClients += statistics.droppedFrames;
+         clients.erase(entry);
+         streaming = true;
       }
+      snapshotRequests.erase(connectionId);
+      noClientsLeft = !hasConsumers();
+   }
+   if (streaming) {
+      log.info("connection", connectionId, "lost (sent frames:", statistics.sentFrames, 
+               ", dropped frames:", statistics.droppedFrames, ")");
+   }
+   if (noClientsLeft) {
+      connectedCallback(false);
+   }
+}
+
+void MultipartJpegHttpStream::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(clientsMutex);
+   uint64_t droppedFrames = droppedFramesOfClosedClients;
+   for (auto& entry : clients) {
+      droppedFrames += entry.second.connection->getSendQueueStatistics().droppedFrames;
    }
+   output << "# TYPE octowatch_mjpeg_clients gauge" << "\n";
+   output << "octowatch_mjpeg_clients " << clients.size() << "\n";
+   output << "# TYPE octowatch_mjpeg_frames_total counter" << "\n";
+   output << "octowatch_mjpeg_frames_total " << jpegCount << "\n";
+   output << "# TYPE octowatch_mjpeg_dropped_frames_total counter" << "\n";
+   output << "octowatch_mjpeg_dropped_frames_total " << droppedFrames << "\n";
+   output << "# TYPE octowatch_mjpeg_snapshots_total counter" << "\n";
+   output << "octowatch_mjpeg_snapshots_total " << snapshotCount << "\n";
 }
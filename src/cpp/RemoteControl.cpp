@@ -5,8 +5,14 @@
 
 #define PORT 8889
 
+#define MAX_QUEUED_BYTES (1024 * 1024)
+
 using logging::Logger;
 using network::Connection;
+using network::ConnectionSettings;
+using network::ListenAddress;
+using network::OverflowPolicy;
+using network::SocketOptions;
 using network::TcpConnection;
 using network::TcpServer;
 using remotecontrol::RemoteControl;
@@ -14,6 +20,10 @@ using remotecontrol::RemoteControl;
 RemoteControl::RemoteControl() : log("RemoteControl") {}
 
 RemoteControl::~RemoteControl() {
+   {
+      const std::lock_guard<std::mutex> lock(connectionMutex);
+      connection.reset();
+   }
    if (tcpServer) {
       tcpServer->stop();
    }
@@ -21,12 +31,22 @@ RemoteControl::~RemoteControl() {
 
 void RemoteControl::start(RemoteControl::Listener& remoteControlListener) {
    listener = remoteControlListener;
-   tcpServer.reset(new TcpServer(PORT, "RemoteControl", *this));
+   ConnectionSettings settings;
+   settings.sendQueueLimits.maxQueuedBytes = MAX_QUEUED_BYTES;
+   settings.sendQueueLimits.overflowPolicy = OverflowPolicy::DISCONNECT;
+   settings.socketOptions                  = SocketOptions::lowLatencyProfile();
+   
+   tcpServer.reset(new TcpServer(ListenAddress::fromEnvironment("OCTOWATCH_REMOTE_CONTROL_ADDRESSES", PORT), 
+                                 "RemoteControl", *this, 1, settings));
    tcpServer->start();
 }
          
 void RemoteControl::asyncSend(const std::string& message, bool appendEndl) {
-   auto conn = connection.get();
+   std::shared_ptr<Connection> conn;
+   {
+      const std::lock_guard<std::mutex> lock(connectionMutex);
+      conn = connection;
+   }
    if (!conn) {
       log.info("discarding message because no remote connection exists");
    } else {
@@ -40,19 +60,28 @@ void RemoteControl::asyncSend(const std::string& message, bool appendEndl) {
    }
 }
 
-void RemoteControl::onNewConnection(std::unique_ptr<Connection> connection) {
+void RemoteControl::onNewConnection(std::shared_ptr<Connection> connection) {
    log.info("accepted new connection");
-   this->connection = std::move(connection);
+   {
+      const std::lock_guard<std::mutex> lock(connectionMutex);
+      this->connection = connection;
+   }
    listener.get().onNewConnection();
 }
 
-void RemoteControl::onConnectionClosed() {
+void RemoteControl::onConnectionClosed(int connectionId) {
+   {
+      const std::lock_guard<std::mutex> lock(connectionMutex);
+      if (!connection || (connection->getId() != connectionId)) {
+         return;
+      }
+      connection.reset();
+   }
    log.info("connection lost");
    listener.get().onConnectionClosed();
-   connection.release();
 }
 
-void RemoteControl::onCommandReceived(const std::string& command) {
+void RemoteControl::onCommandReceived(int connectionId, std::string_view command) {
    log.info("received command:", command);
    listener.get().onCommandReceived(command);
 }
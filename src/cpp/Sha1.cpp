@@ -0,0 +1,81 @@
+#include <cstring>
+#include <vector>
+
+#include "Sha1.h"
+
+#define BLOCK_SIZE   64
+
+static uint32_t rotateLeft(uint32_t value, unsigned int bits) {
+   return (value << bits) | (value >> (32 - bits));
+}
+
+std::array<uint8_t, SHA1_DIGEST_SIZE> utils::Sha1::digest(const std::string& data) {
+   uint32_t state[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+   
+   // padding: 0x80, zeros and the message length in bits (big endian)
+   std::vector<uint8_t> message(data.begin(), data.end());
+   uint64_t             bitCount = (uint64_t)data.size() * 8;
+   message.push_back(0x80);
+   while ((message.size() % BLOCK_SIZE) != (BLOCK_SIZE - 8)) {
+      message.push_back(0);
+   }
+   for (int shift = 56; shift >= 0; shift -= 8) {
+      message.push_back((bitCount >> shift) & 0xff);
+   }
+   
+   for (size_t blockStart = 0; blockStart < message.size(); blockStart += BLOCK_SIZE) {
+      uint32_t w[80];
+      for (int index = 0; index < 16; index++) {
+         const uint8_t* word = &message[blockStart + index * 4];
+         w[index] = (word[0] << 24) | (word[1] << 16) | (word[2] << 8) | word[3];
+      }
+      for (int index = 16; index < 80; index++) {
+         w[index] = rotateLeft(w[index - 3] ^ w[index - 8] ^ w[index - 14] ^ w[index - 16], 1);
+      }
+      
+      uint32_t a = state[0];
+      uint32_t b = state[1];
+      uint32_t c = state[2];
+      uint32_t d = state[3];
+      uint32_t e = state[4];
+      
+      for (int index = 0; index < 80; index++) {
+         uint32_t f;
+         uint32_t k;
+         if (index < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+         } else if (index < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+         } else if (index < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+         } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+         }
+         uint32_t temp = rotateLeft(a, 5) + f + e + k + w[index];
+         e = d;
+         d = c;
+         c = rotateLeft(b, 30);
+         b = a;
+         a = temp;
+      }
+      
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+   }
+   
+   std::array<uint8_t, SHA1_DIGEST_SIZE> result;
+   for (int index = 0; index < 5; index++) {
+      result[index * 4]     = state[index] >> 24;
+      result[index * 4 + 1] = (state[index] >> 16) & 0xff;
+      result[index * 4 + 2] = (state[index] >> 8) & 0xff;
+      result[index * 4 + 3] = state[index] & 0xff;
+   }
+   return result;
+}
@@ -4,8 +4,8 @@ using namespace std::chrono_literals;
 
 
 SingleThreadedExecutor::SingleThreadedExecutor(FinishedCallback callback) 
-   : thread(std::bind(&SingleThreadedExecutor::mainLoop, this)), 
-     finishedCallback(callback), quit(false) {}
+   : finishedCallback(callback), quit(false),
+     thread(std::bind(&SingleThreadedExecutor::mainLoop, this)) {}
       
 SingleThreadedExecutor::~SingleThreadedExecutor() {
    quit = true;
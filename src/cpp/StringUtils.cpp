@@ -9,3 +9,32 @@ std::string utils::String::toLowerCase(const std::string& text) {
                      [](unsigned char c){ return std::tolower(c); });
    return result;
 }
+
+std::string utils::String::trim(std::string_view text) {
+   size_t start = text.find_first_not_of(" \t\r");
+   if (start == std::string_view::npos) {
+      return "";
+   }
+   size_t end = text.find_last_not_of(" \t\r");
+   return std::string(text.substr(start, end - start + 1));
+}
+
+std::string utils::String::toBase64(const uint8_t* data, size_t size) {
+   static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+   std::string result;
+   result.reserve(((size + 2) / 3) * 4);
+   for (size_t index = 0; index < size; index += 3) {
+      uint32_t value = data[index] << 16;
+      if (index + 1 < size) {
+         value |= data[index + 1] << 8;
+      }
+      if (index + 2 < size) {
+         value |= data[index + 2];
+      }
+      result.push_back(alphabet[(value >> 18) & 0x3f]);
+      result.push_back(alphabet[(value >> 12) & 0x3f]);
+      result.push_back((index + 1 < size) ? alphabet[(value >> 6) & 0x3f] : '=');
+      result.push_back((index + 2 < size) ? alphabet[value & 0x3f] : '=');
+   }
+   return result;
+}
@@ -0,0 +1,96 @@
+#include <cerrno>
+#include <cstring>
+
+#include <sys/ioctl.h>
+
+#include <linux/videodev2.h>
+
+#include "V4l2Controls.h"
+
+V4l2Controls::V4l2Controls(const std::string& loggerName, const std::map<std::string, uint32_t>& controlIds)
+   : log(loggerName.c_str()),
+     controlIds(controlIds) {}
+
+std::map<std::string, EncoderParameter> V4l2Controls::query(int fileDescriptor) {
+   std::map<std::string, EncoderParameter> parameters;
+   for (auto& entry : controlIds) {
+      EncoderParameter parameter;
+      if (query(fileDescriptor, entry.second, parameter)) {
+         parameters[entry.first] = parameter;
+      }
+   }
+   return parameters;
+}
+
+bool V4l2Controls::query(int fileDescriptor, uint32_t controlId, EncoderParameter& parameter) {
+   v4l2_queryctrl queryControl = {};
+   queryControl.id             = controlId;
+   if ((ioctl(fileDescriptor, VIDIOC_QUERYCTRL, &queryControl) == -1) ||
+       (queryControl.flags & V4L2_CTRL_FLAG_DISABLED)) {
+      return false;
+   }
+
+   switch (queryControl.type) {
+      case V4L2_CTRL_TYPE_INTEGER:      parameter.type = "integer";
+                                        break;
+      case V4L2_CTRL_TYPE_BOOLEAN:      parameter.type = "boolean";
+                                        break;
+      case V4L2_CTRL_TYPE_MENU:
+      case V4L2_CTRL_TYPE_INTEGER_MENU: parameter.type = "menu";
+                                        break;
+      default:                          return false;
+   }
+   parameter.minimum      = queryControl.minimum;
+   parameter.maximum      = queryControl.maximum;
+   parameter.step         = (queryControl.step > 0) ? queryControl.step : 1;
+   parameter.defaultValue = queryControl.default_value;
+
+   if (parameter.type == "menu") {
+      // the driver skips the entries it does not support
+      for (int index = queryControl.minimum; index <= queryControl.maximum; index++) {
+         v4l2_querymenu menu = {};
+         menu.id             = controlId;
+         menu.index          = index;
+         if (ioctl(fileDescriptor, VIDIOC_QUERYMENU, &menu) == 0) {
+            parameter.menuEntries[index] = (queryControl.type == V4L2_CTRL_TYPE_MENU) 
+                                              ? std::string((const char*)menu.name) 
+                                              : std::to_string(menu.value);
+         }
+      }
+   }
+
+   v4l2_control control = {};
+   control.id           = controlId;
+   if (ioctl(fileDescriptor, VIDIOC_G_CTRL, &control) == -1) {
+      log.warning("failed to get value of control", controlId, ": errno", errno);
+      control.value = queryControl.default_value;
+   }
+   parameter.value = control.value;
+   return true;
+}
+
+EncoderControl::Result V4l2Controls::set(int fileDescriptor, const std::string& name, int value) {
+   auto entry = controlIds.find(name);
+   EncoderParameter parameter;
+   if ((entry == controlIds.end()) || !query(fileDescriptor, entry->second, parameter)) {
+      log.warning("ignoring unsupported parameter", name);
+      return EncoderControl::Result::UNKNOWN_PARAMETER;
+   }
+
+   if (!parameter.accepts(value)) {
+      log.warning("ignoring invalid value", value, "of parameter", name, "( range [", parameter.minimum, ",",
+                  parameter.maximum, "], step", parameter.step, ")");
+      return EncoderControl::Result::INVALID_VALUE;
+   }
+
+   v4l2_control control = {};
+   control.id           = entry->second;
+   control.value        = value;
+   if (ioctl(fileDescriptor, VIDIOC_S_CTRL, &control) == -1) {
+      // e.g. EBUSY if the driver does not allow the change while streaming
+      log.error("failed to set parameter", name, "to", value, ":", std::strerror(errno));
+      return EncoderControl::Result::FAILED;
+   }
+   log.info("parameter", name, "set to", value);
+   return EncoderControl::Result::APPLIED;
+}
@@ -0,0 +1,194 @@
+#include <iomanip>
+#include <sstream>
+
+#include "HlsSegmentCache.h"
+
+using hls::HlsPart;
+using hls::HlsSegment;
+using hls::HlsSegmentCache;
+using hls::HlsSegmentCacheStatistics;
+using mp4::Fmp4Fragment;
+using network::SharedBuffer;
+
+#define HLS_VERSION   6
+
+// Segments (including the one in progress) listing their parts. The parts of
+// older segments are not of interest for clients playing at the live edge.
+#define SEGMENTS_WITH_PARTS   3
+
+static double toSeconds(uint64_t duration) {
+   return (double)duration / FMP4_TIMESCALE;
+}
+
+HlsSegmentCache::HlsSegmentCache(unsigned int maxSegmentCount, unsigned int targetDuration_s,
+                                 uint64_t partTargetDuration)
+   : maxSegmentCount(maxSegmentCount),
+     targetDuration_s(targetDuration_s),
+     partTargetDuration(partTargetDuration),
+     nextSequenceNumber(0),
+     keyframeRequested(false) {}
+
+bool HlsSegmentCache::addPart(const Fmp4Fragment& fragment) {
+   HlsPart  part           = {fragment.data, fragment.duration, fragment.startsWithKeyframe};
+   uint64_t targetDuration = (uint64_t)targetDuration_s * FMP4_TIMESCALE;
+
+   if (segments.empty() && !part.independent) {
+      // a playlist has to start with a keyframe
+      return false;
+   }
+
+   if (segments.empty() || part.independent || (segments.back().duration >= targetDuration)) {
+      if (!segments.empty()) {
+         segments.back().complete = true;
+      }
+      segments.push_back(HlsSegment{nextSequenceNumber++, {}, 0, 0, false});
+      keyframeRequested = false;
+      while (segments.size() > maxSegmentCount + 1) {
+         segments.pop_front();
+      }
+   }
+
+   HlsSegment& segment = segments.back();
+   segment.parts.push_back(part);
+   segment.duration += part.duration;
+   segment.size     += part.data.size();
+
+   // The keyframe gets requested one part in advance because the encoder
+   // needs some time to provide it. The tolerance covers the jitter of the
+   // timestamps.
+   uint64_t tolerance = partTargetDuration / 10;
+   if (!keyframeRequested && ((segment.duration + partTargetDuration + tolerance) >= targetDuration)) {
+      keyframeRequested = true;
+      return true;
+   }
+   return false;
+}
+
+void HlsSegmentCache::setInitSegment(const SharedBuffer& initSegment) {
+   this->initSegment = initSegment;
+}
+
+SharedBuffer HlsSegmentCache::getInitSegment() const {
+   return initSegment;
+}
+
+void HlsSegmentCache::clear() {
+   segments.clear();
+   keyframeRequested = false;
+}
+
+bool HlsSegmentCache::empty() const {
+   return segments.empty();
+}
+
+HlsSegmentCache::Availability HlsSegmentCache::getPlaylistAvailability(uint64_t sequenceNumber,
+                                                                       int partIndex) const {
+   if (segments.empty()) {
+      return (sequenceNumber <= nextSequenceNumber + 2) ? Availability::PENDING : Availability::UNAVAILABLE;
+   }
+
+   uint64_t lastSequenceNumber = segments.back().sequenceNumber;
+   if (sequenceNumber > lastSequenceNumber + 2) {
+      return Availability::UNAVAILABLE;
+   }
+   if (sequenceNumber > lastSequenceNumber) {
+      return Availability::PENDING;
+   }
+
+   const HlsSegment* segment = findSegment(sequenceNumber);
+   if (segment == nullptr) {
+      // older than the first segment of the playlist
+      return Availability::AVAILABLE;
+   }
+   if (partIndex < 0) {
+      return segment->complete ? Availability::AVAILABLE : Availability::PENDING;
+   }
+   if ((size_t)partIndex < segment->parts.size()) {
+      return Availability::AVAILABLE;
+   }
+   // the following segment exists and contains at least one part if the segment is complete
+   return segment->complete ? Availability::AVAILABLE : Availability::PENDING;
+}
+
+HlsSegmentCache::Availability HlsSegmentCache::getSegment(uint64_t sequenceNumber, HlsSegment& segment) const {
+   const HlsSegment* cachedSegment = findSegment(sequenceNumber);
+   if (cachedSegment == nullptr) {
+      return Availability::UNAVAILABLE;
+   }
+   if (!cachedSegment->complete) {
+      return Availability::PENDING;
+   }
+   segment = *cachedSegment;
+   return Availability::AVAILABLE;
+}
+
+HlsSegmentCache::Availability HlsSegmentCache::getPart(uint64_t sequenceNumber, unsigned int partIndex,
+                                                       HlsPart& part) const {
+   const HlsSegment* segment = findSegment(sequenceNumber);
+   if (segment == nullptr) {
+      bool nextSegment = segments.empty() && (sequenceNumber == nextSequenceNumber) && (partIndex == 0);
+      return nextSegment ? Availability::PENDING : Availability::UNAVAILABLE;
+   }
+   if (partIndex < segment->parts.size()) {
+      part = segment->parts[partIndex];
+      return Availability::AVAILABLE;
+   }
+   // The preload hint of a segment might refer to a part that never gets
+   // added because the next part starts a new segment.
+   bool preloadHint = !segment->complete && (partIndex == segment->parts.size());
+   return preloadHint ? Availability::PENDING : Availability::UNAVAILABLE;
+}
+
+std::string HlsSegmentCache::createPlaylist() const {
+   std::ostringstream playlist;
+   playlist << std::fixed << std::setprecision(5);
+   playlist << "#EXTM3U\n";
+   playlist << "#EXT-X-VERSION:" << HLS_VERSION << "\n";
+   playlist << "#EXT-X-TARGETDURATION:" << targetDuration_s << "\n";
+   playlist << "#EXT-X-PART-INF:PART-TARGET=" << toSeconds(partTargetDuration) << "\n";
+   playlist << "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK="
+            << toSeconds(3 * partTargetDuration) << "\n";
+   playlist << "#EXT-X-MEDIA-SEQUENCE:" << (segments.empty() ? nextSequenceNumber : segments.front().sequenceNumber)
+            << "\n";
+   playlist << "#EXT-X-MAP:URI=\"init.mp4\"\n";
+
+   for (size_t index = 0; index < segments.size(); index++) {
+      const HlsSegment& segment = segments[index];
+      if (index + SEGMENTS_WITH_PARTS >= segments.size()) {
+         for (size_t partIndex = 0; partIndex < segment.parts.size(); partIndex++) {
+            const HlsPart& part = segment.parts[partIndex];
+            playlist << "#EXT-X-PART:DURATION=" << toSeconds(part.duration)
+                     << ",URI=\"part" << segment.sequenceNumber << "." << partIndex << ".m4s\""
+                     << (part.independent ? ",INDEPENDENT=YES" : "") << "\n";
+         }
+      }
+      if (segment.complete) {
+         playlist << "#EXTINF:" << toSeconds(segment.duration) << ",\n";
+         playlist << "segment" << segment.sequenceNumber << ".m4s\n";
+      }
+   }
+
+   if (!segments.empty()) {
+      playlist << "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part" << segments.back().sequenceNumber << "."
+               << segments.back().parts.size() << ".m4s\"\n";
+   }
+   return playlist.str();
+}
+
+const HlsSegment* HlsSegmentCache::findSegment(uint64_t sequenceNumber) const {
+   if (segments.empty() || (sequenceNumber < segments.front().sequenceNumber) ||
+       (sequenceNumber > segments.back().sequenceNumber)) {
+      return nullptr;
+   }
+   return &segments[sequenceNumber - segments.front().sequenceNumber];
+}
+
+HlsSegmentCacheStatistics HlsSegmentCache::getStatistics() const {
+   HlsSegmentCacheStatistics statistics;
+   for (auto& segment : segments) {
+      statistics.segmentCount++;
+      statistics.partCount += segment.parts.size();
+      statistics.size      += segment.size;
+   }
+   return statistics;
+}
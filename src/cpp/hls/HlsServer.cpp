@@ -0,0 +1,340 @@
+#include <cstdlib>
+#include <regex>
+
+#include "HlsServer.h"
+
+using hls::HlsPart;
+using hls::HlsSegment;
+using hls::HlsSegmentCache;
+using hls::HlsServer;
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using logging::Logger;
+using mp4::Fmp4Fragment;
+using network::Connection;
+using network::SharedBuffer;
+
+#define PATH_PREFIX   "/hls/"
+
+#define TARGET_DURATION_S   2
+#define FRAMES_PER_PART     6
+#define FRAME_RATE          30   // configured in H264Encoder
+
+#define DEFAULT_SEGMENT_COUNT   6
+#define MIN_SEGMENT_COUNT       2
+#define MAX_SEGMENT_COUNT       20
+
+#define BLOCKING_TIMEOUT_MS        (3 * TARGET_DURATION_S * 1000)
+#define IDLE_TIMEOUT_MS            10000
+#define HOUSEKEEPING_INTERVAL_MS   250
+
+typedef HlsSegmentCache::Availability Availability;
+
+HlsServer::HlsServer(HttpServer& httpServer, unsigned int width, unsigned int height,
+                     ActivityChangedCallback activityChangedCallback, KeyframeRequest keyframeRequest)
+   : log("HlsServer"),
+     httpServer(httpServer),
+     muxer(width, height, FRAMES_PER_PART),
+     cache(getConfiguredSegmentCount(), TARGET_DURATION_S, (FRAMES_PER_PART * FMP4_TIMESCALE) / FRAME_RATE),
+     active(false),
+     activityChangedCallback(activityChangedCallback),
+     keyframeRequest(keyframeRequest),
+     quitHousekeeping(false) {}
+
+HlsServer::~HlsServer() {
+   // answers the pending requests with 503
+   httpServer.removeRoutes(*this);
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      quitHousekeeping = true;
+      pendingRequests.clear();
+   }
+   housekeepingCondition.notify_all();
+   if (housekeepingThread.joinable()) {
+      housekeepingThread.join();
+   }
+}
+
+unsigned int HlsServer::getConfiguredSegmentCount() {
+   Logger log("HlsServer");
+   char* segmentCountEnvVar = std::getenv("OCTOWATCH_HLS_SEGMENT_COUNT");
+
+   if (segmentCountEnvVar == nullptr) {
+      return DEFAULT_SEGMENT_COUNT;
+   }
+
+   std::string inputText(segmentCountEnvVar);
+   const std::regex regex("\\s*(\\d+)\\s*");
+   std::smatch captureGroups;
+   if (std::regex_match(inputText, captureGroups, regex) && (captureGroups.size() >= 2)) {
+      int segmentCount = std::stoi(captureGroups[1].str());
+      if ((segmentCount >= MIN_SEGMENT_COUNT) && (segmentCount <= MAX_SEGMENT_COUNT)) {
+         return segmentCount;
+      }
+      log.warning("ignoring HLS segment count requested via env var because it's out of range [",
+                  MIN_SEGMENT_COUNT, ",", MAX_SEGMENT_COUNT, "].");
+   } else {
+      log.warning("ignoring HLS segment count requested via env var because it's not an integer.");
+   }
+   return DEFAULT_SEGMENT_COUNT;
+}
+
+void HlsServer::start() {
+   httpServer.addPrefixRoute(PATH_PREFIX, *this);
+   housekeepingThread = std::thread(&HlsServer::runHousekeeping, this);
+}
+
+void HlsServer::send(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe) {
+   bool serverActive = false;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      serverActive = active;
+   }
+   if (!serverActive) {
+      muxer.reset();
+      return;
+   }
+
+   Fmp4Fragment fragment;
+   if (!muxer.add(accessUnit, timestamp_us, keyframe, fragment)) {
+      return;
+   }
+
+   bool keyframeRequired = false;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (!active) {
+         return;
+      }
+      if (cache.getInitSegment().size() == 0) {
+         cache.setInitSegment(muxer.getInitSegment());
+      }
+      keyframeRequired = cache.addPart(fragment);
+   }
+   respondToPendingRequests();
+   if (keyframeRequired) {
+      keyframeRequest();
+   }
+}
+
+HlsServer::Result HlsServer::onRequest(const HttpRequest& httpRequest, std::shared_ptr<Connection> connection,
+                                       HttpResponse& response) {
+   if ((httpRequest.method != "GET") && (httpRequest.method != "HEAD")) {
+      response = HttpResponse::text(405, "only GET is supported\n");
+      response.headers.emplace_back("Allow", "GET, HEAD");
+      return Result::RESPONDED;
+   }
+
+   // keeps the budget if the connection already sent a part
+   connection->setEgressStream("h264");
+
+   auto    now = std::chrono::steady_clock::now();
+   Request request;
+   parseRequest(httpRequest, request);
+   request.deadline = now + std::chrono::milliseconds(BLOCKING_TIMEOUT_MS);
+
+   Result result    = Result::RESPONDED;
+   bool   activated = false;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      lastRequestTime = now;
+      if (!active) {
+         log.info("received request on connection", connection->getId(), "-> starting to create segments");
+         active    = true;
+         activated = true;
+      }
+      if (!createResponse(request, response)) {
+         pendingRequests[connection->getId()] = request;
+         result = Result::DEFERRED;
+      }
+   }
+   if (activated) {
+      activityChangedCallback(true);
+   }
+   return result;
+}
+
+void HlsServer::onConnectionClosed(int connectionId) {
+   log.debug("connection", connectionId, "closed");
+   const std::lock_guard<std::mutex> lock(mutex);
+   pendingRequests.erase(connectionId);
+}
+
+void HlsServer::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   auto statistics = cache.getStatistics();
+   output << "# TYPE octowatch_hls_active gauge" << "\n";
+   output << "octowatch_hls_active " << (active ? 1 : 0) << "\n";
+   output << "# TYPE octowatch_hls_cached_segments gauge" << "\n";
+   output << "octowatch_hls_cached_segments " << statistics.segmentCount << "\n";
+   output << "# TYPE octowatch_hls_cached_parts gauge" << "\n";
+   output << "octowatch_hls_cached_parts " << statistics.partCount << "\n";
+   output << "# TYPE octowatch_hls_cached_bytes gauge" << "\n";
+   output << "octowatch_hls_cached_bytes " << statistics.size << "\n";
+   output << "# TYPE octowatch_hls_pending_requests gauge" << "\n";
+   output << "octowatch_hls_pending_requests " << pendingRequests.size() << "\n";
+}
+
+void HlsServer::parseRequest(const HttpRequest& httpRequest, Request& request) {
+   request.resource       = Resource::BAD_REQUEST;
+   request.sequenceNumber = 0;
+   request.partIndex      = -1;
+   request.blockingReload = false;
+
+   const std::string& path  = httpRequest.path;
+   const std::string& query = httpRequest.query;
+   std::string        name  = path.substr(path.rfind('/') + 1);
+   std::smatch        captureGroups;
+
+   if ((name.size() > 5) && (name.compare(name.size() - 5, 5, ".m3u8") == 0)) {
+      const std::regex sequenceNumberRegex("(?:^|&)_HLS_msn=(\\d{1,15})(?:&|$)");
+      const std::regex partIndexRegex("(?:^|&)_HLS_part=(\\d{1,6})(?:&|$)");
+      bool sequenceNumberDefined = std::regex_search(query, captureGroups, sequenceNumberRegex);
+      if (sequenceNumberDefined) {
+         request.sequenceNumber = std::stoull(captureGroups[1].str());
+      }
+      bool partIndexDefined = std::regex_search(query, captureGroups, partIndexRegex);
+      if (partIndexDefined) {
+         request.partIndex = std::stoi(captureGroups[1].str());
+      }
+      if (partIndexDefined && !sequenceNumberDefined) {
+         return;
+      }
+      request.blockingReload = sequenceNumberDefined;
+      request.resource       = Resource::PLAYLIST;
+
+   } else if (name == "init.mp4") {
+      request.resource = Resource::INIT_SEGMENT;
+
+   } else if (std::regex_match(name, captureGroups, std::regex("segment(\\d{1,15})\\.m4s"))) {
+      request.sequenceNumber = std::stoull(captureGroups[1].str());
+      request.resource       = Resource::SEGMENT;
+
+   } else if (std::regex_match(name, captureGroups, std::regex("part(\\d{1,15})\\.(\\d{1,6})\\.m4s"))) {
+      request.sequenceNumber = std::stoull(captureGroups[1].str());
+      request.partIndex      = std::stoi(captureGroups[2].str());
+      request.resource       = Resource::PART;
+
+   } else {
+      request.resource = Resource::NOT_FOUND;
+   }
+}
+
+void HlsServer::respondToPendingRequests() {
+   std::map<int, HttpResponse> responses;   // by connection ID
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      for (auto entry = pendingRequests.begin(); entry != pendingRequests.end();) {
+         HttpResponse response;
+         if (createResponse(entry->second, response)) {
+            responses[entry->first] = response;
+            entry = pendingRequests.erase(entry);
+         } else {
+            entry++;
+         }
+      }
+   }
+   // the server might pass the next pipelined request of the connection
+   for (auto& entry : responses) {
+      httpServer.respond(entry.first, entry.second);
+   }
+}
+
+bool HlsServer::createResponse(const Request& request, HttpResponse& response) {
+   Availability availability = Availability::PENDING;
+
+   // Parts and segments never change, but the playlist does.
+   response.cacheControl = "max-age=60";
+   response.contentType  = "video/mp4";
+
+   switch (request.resource) {
+      case Resource::PLAYLIST:
+         if (request.blockingReload) {
+            availability = cache.getPlaylistAvailability(request.sequenceNumber, request.partIndex);
+         } else if (!cache.empty()) {
+            availability = Availability::AVAILABLE;
+         }
+         if (availability == Availability::AVAILABLE) {
+            response.cacheControl = "no-cache";
+            response.contentType  = "application/vnd.apple.mpegurl";
+            response.body         = SharedBuffer::copyOf(cache.createPlaylist());
+         } else if (availability == Availability::UNAVAILABLE) {
+            response = HttpResponse::text(400, "_HLS_msn too far in the future\n");
+            return true;
+         }
+         break;
+
+      case Resource::INIT_SEGMENT:
+         response.body = cache.getInitSegment();
+         if (response.body.size() > 0) {
+            availability = Availability::AVAILABLE;
+         }
+         break;
+
+      case Resource::SEGMENT: {
+         HlsSegment segment;
+         availability = cache.getSegment(request.sequenceNumber, segment);
+         if (availability == Availability::AVAILABLE) {
+            for (auto& part : segment.parts) {
+               response.bodyParts.push_back(part.data);
+            }
+         }
+         break;
+      }
+
+      case Resource::PART: {
+         HlsPart part;
+         availability = cache.getPart(request.sequenceNumber, request.partIndex, part);
+         if (availability == Availability::AVAILABLE) {
+            response.body = part.data;
+         }
+         break;
+      }
+
+      case Resource::NOT_FOUND:
+         availability = Availability::UNAVAILABLE;
+         break;
+
+      case Resource::BAD_REQUEST:
+         response = HttpResponse::text(400, "bad request\n");
+         return true;
+   }
+
+   if (availability == Availability::UNAVAILABLE) {
+      response = HttpResponse::text(404, "not found\n");
+      return true;
+   }
+   if (availability == Availability::PENDING) {
+      if (std::chrono::steady_clock::now() < request.deadline) {
+         return false;
+      }
+      response = HttpResponse::text(503, "not available in time\n");
+   }
+   return true;
+}
+
+void HlsServer::runHousekeeping() {
+   std::unique_lock<std::mutex> lock(mutex);
+   while (!quitHousekeeping) {
+      housekeepingCondition.wait_for(lock, std::chrono::milliseconds(HOUSEKEEPING_INTERVAL_MS));
+      if (quitHousekeeping) {
+         break;
+      }
+
+      // responds to the blocking requests whose deadline passed
+      lock.unlock();
+      respondToPendingRequests();
+      lock.lock();
+
+      auto idleTime = std::chrono::steady_clock::now() - lastRequestTime;
+      if (active && (idleTime > std::chrono::milliseconds(IDLE_TIMEOUT_MS))) {
+         log.info("no requests received recently -> dropping segments");
+         active = false;
+         cache.clear();
+         lock.unlock();
+         activityChangedCallback(false);
+         lock.lock();
+      }
+   }
+}
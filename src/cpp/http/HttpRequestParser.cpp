@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cctype>
+
+#include "HttpRequestParser.h"
+#include "StringUtils.h"
+
+using http::HttpRequest;
+using http::HttpRequestParser;
+using utils::String;
+
+#define MAX_CONTENT_LENGTH_DIGITS   15
+
+/**
+ * Returns true if the comma separated header value contains the token
+ * (case-insensitive).
+ */
+static bool containsToken(const std::string& value, const std::string& token) {
+   size_t start = 0;
+   while (start <= value.size()) {
+      size_t end = value.find(',', start);
+      if (end == std::string::npos) {
+         end = value.size();
+      }
+      if (String::toLowerCase(String::trim(std::string_view(value).substr(start, end - start))) == token) {
+         return true;
+      }
+      start = end + 1;
+   }
+   return false;
+}
+
+std::string HttpRequest::getHeader(const std::string& name) const {
+   auto entry = headers.find(name);
+   return (entry == headers.end()) ? "" : entry->second;
+}
+
+HttpRequestParser::HttpRequestParser(size_t maxHeaderSize, size_t maxBodySize)
+   : maxHeaderSize(maxHeaderSize),
+     maxBodySize(maxBodySize),
+     state(State::REQUEST_LINE),
+     headerSize(0),
+     contentLength(0),
+     errorStatus(0) {}
+
+HttpRequestParser::Result HttpRequestParser::parse(std::string_view& data) {
+   if (state == State::FAILED) {
+      return Result::INVALID;
+   }
+   if (state == State::DONE) {
+      state         = State::REQUEST_LINE;
+      headerSize    = 0;
+      contentLength = 0;
+      request       = HttpRequest();
+   }
+
+   while (!data.empty()) {
+      if (state == State::BODY) {
+         size_t byteCount = std::min(data.size(), contentLength - request.body.size());
+         request.body.append(data.data(), byteCount);
+         data.remove_prefix(byteCount);
+         if (request.body.size() == contentLength) {
+            state = State::DONE;
+            return Result::COMPLETE;
+         }
+         continue;
+      }
+
+      size_t lineEnd   = data.find('\n');
+      size_t byteCount = (lineEnd == std::string_view::npos) ? data.size() : lineEnd;
+      headerSize += byteCount + ((lineEnd == std::string_view::npos) ? 0 : 1);
+      if (headerSize > maxHeaderSize) {
+         return fail((state == State::REQUEST_LINE) ? 414 : 431);
+      }
+      line.append(data.data(), byteCount);
+      if (lineEnd == std::string_view::npos) {
+         data.remove_prefix(byteCount);
+         return Result::INCOMPLETE;
+      }
+      data.remove_prefix(lineEnd + 1);
+
+      std::string_view completeLine(line);
+      if (!completeLine.empty() && (completeLine.back() == '\r')) {
+         completeLine.remove_suffix(1);
+      }
+      Result result = processLine(completeLine);
+      line.clear();
+      if (result != Result::INCOMPLETE) {
+         return result;
+      }
+   }
+   return Result::INCOMPLETE;
+}
+
+const HttpRequest& HttpRequestParser::getRequest() const {
+   return request;
+}
+
+unsigned int HttpRequestParser::getErrorStatus() const {
+   return errorStatus;
+}
+
+HttpRequestParser::Result HttpRequestParser::fail(unsigned int status) {
+   state       = State::FAILED;
+   errorStatus = status;
+   return Result::INVALID;
+}
+
+HttpRequestParser::Result HttpRequestParser::processLine(std::string_view line) {
+   if (state == State::REQUEST_LINE) {
+      if (line.empty()) {
+         headerSize = 0;   // empty lines preceding a request
+         return Result::INCOMPLETE;
+      }
+      return processRequestLine(line);
+   }
+   if (line.empty()) {
+      return processEndOfHeaders();
+   }
+   return processHeaderLine(line);
+}
+
+HttpRequestParser::Result HttpRequestParser::processRequestLine(std::string_view line) {
+   // method SP request-target SP HTTP-version
+   size_t firstSpace  = line.find(' ');
+   size_t secondSpace = (firstSpace == std::string_view::npos) ? firstSpace : line.find(' ', firstSpace + 1);
+   if ((firstSpace == 0) || (secondSpace == std::string_view::npos) || (secondSpace == firstSpace + 1) ||
+       (line.find(' ', secondSpace + 1) != std::string_view::npos)) {
+      return fail(400);
+   }
+
+   std::string_view method  = line.substr(0, firstSpace);
+   std::string_view target  = line.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+   std::string_view version = line.substr(secondSpace + 1);
+
+   if (!std::all_of(method.begin(), method.end(), [](char c) { return std::isupper((unsigned char)c); }) ||
+       (target[0] != '/')) {
+      return fail(400);
+   }
+   if (version.substr(0, 5) != "HTTP/") {
+      return fail(400);
+   }
+   if ((version != "HTTP/1.1") && (version != "HTTP/1.0")) {
+      return fail(505);
+   }
+
+   size_t queryStart = target.find('?');
+   request.method  = std::string(method);
+   request.path    = std::string(target.substr(0, queryStart));
+   request.query   = (queryStart == std::string_view::npos) ? "" : std::string(target.substr(queryStart + 1));
+   request.version = std::string(version);
+   state           = State::HEADERS;
+   return Result::INCOMPLETE;
+}
+
+HttpRequestParser::Result HttpRequestParser::processHeaderLine(std::string_view line) {
+   // obsolete line folding and whitespace in front of the colon are not allowed
+   size_t colon = line.find(':');
+   if ((line[0] == ' ') || (line[0] == '\t') || (colon == std::string_view::npos) || (colon == 0) ||
+       (line.substr(0, colon).find_first_of(" \t") != std::string_view::npos)) {
+      return fail(400);
+   }
+
+   std::string name  = String::toLowerCase(std::string(line.substr(0, colon)));
+   std::string value = String::trim(line.substr(colon + 1));
+   auto        entry = request.headers.find(name);
+   if (entry == request.headers.end()) {
+      request.headers[name] = value;
+   } else if (name == "content-length") {
+      if (entry->second != value) {
+         return fail(400);
+      }
+   } else {
+      entry->second += ", " + value;
+   }
+   return Result::INCOMPLETE;
+}
+
+HttpRequestParser::Result HttpRequestParser::processEndOfHeaders() {
+   if ((request.version == "HTTP/1.1") && (request.headers.find("host") == request.headers.end())) {
+      return fail(400);
+   }
+   if (request.headers.find("transfer-encoding") != request.headers.end()) {
+      return fail(501);
+   }
+
+   std::string connection = request.getHeader("connection");
+   request.keepAlive = (request.version == "HTTP/1.1") ? !containsToken(connection, "close")
+                                                       : containsToken(connection, "keep-alive");
+
+   auto contentLengthHeader = request.headers.find("content-length");
+   if (contentLengthHeader != request.headers.end()) {
+      const std::string& value = contentLengthHeader->second;
+      if (value.empty() || (value.size() > MAX_CONTENT_LENGTH_DIGITS) ||
+          !std::all_of(value.begin(), value.end(), [](char c) { return std::isdigit((unsigned char)c); })) {
+         return fail(400);
+      }
+      contentLength = std::stoull(value);
+      if (contentLength > maxBodySize) {
+         return fail(413);
+      }
+   }
+
+   if (contentLength > 0) {
+      request.body.reserve(contentLength);
+      state = State::BODY;
+      return Result::INCOMPLETE;
+   }
+   state = State::DONE;
+   return Result::COMPLETE;
+}
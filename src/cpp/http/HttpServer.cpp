@@ -0,0 +1,509 @@
+#include <set>
+#include <sstream>
+
+#include "BufferPool.h"
+#include "HttpServer.h"
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using http::RequestHandler;
+using network::BufferPool;
+using network::Connection;
+using network::ConnectionSettings;
+using network::EgressScheduler;
+using network::ListenAddress;
+using network::OverflowPolicy;
+using network::SharedBuffer;
+using network::SocketOptions;
+using network::TcpServer;
+
+#define PORT              8887
+#define MAX_CONNECTIONS   64
+#define CRLF              "\r\n"
+
+#define MAX_HEADER_SIZE       8192
+#define MAX_BODY_SIZE         (64 * 1024)
+#define MAX_QUEUED_REQUESTS   16
+
+#define MAX_QUEUED_BYTES      (16 * 1024 * 1024)
+#define ZERO_COPY_THRESHOLD   (64 * 1024)
+
+#define METRICS_PATH   "/metrics"
+
+static const char* getReasonPhrase(unsigned int status) {
+   switch (status) {
+      case 101: return "Switching Protocols";
+      case 200: return "OK";
+      case 204: return "No Content";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 413: return "Content Too Large";
+      case 414: return "URI Too Long";
+      case 415: return "Unsupported Media Type";
+      case 422: return "Unprocessable Content";
+      case 426: return "Upgrade Required";
+      case 431: return "Request Header Fields Too Large";
+      case 500: return "Internal Server Error";
+      case 501: return "Not Implemented";
+      case 503: return "Service Unavailable";
+      case 505: return "HTTP Version Not Supported";
+      default:  return "Unknown";
+   }
+}
+
+HttpResponse HttpResponse::text(unsigned int status, const std::string& body) {
+   HttpResponse response;
+   response.status      = status;
+   response.contentType = "text/plain";
+   response.body        = SharedBuffer::copyOf(body);
+   return response;
+}
+
+HttpServer::HttpServer()
+   : log("HttpServer"),
+     acceptedConnections(0) {}
+
+HttpServer::~HttpServer() {
+   if (tcpServer) {
+      tcpServer->stop();
+   }
+}
+
+void HttpServer::start() {
+   // Plain responses must not get dropped. The handlers streaming frames
+   // replace the limits of their connections.
+   ConnectionSettings settings;
+   settings.sendQueueLimits.maxQueuedBytes = MAX_QUEUED_BYTES;
+   settings.sendQueueLimits.overflowPolicy = OverflowPolicy::DISCONNECT;
+   settings.socketOptions                  = SocketOptions::streamingProfile();
+   settings.zeroCopyThreshold              = ZERO_COPY_THRESHOLD;
+   settings.maxLineLength                  = MAX_HEADER_SIZE;
+
+   tcpServer.reset(new TcpServer(ListenAddress::fromEnvironment("OCTOWATCH_HTTP_ADDRESSES", PORT),
+                                 "HTTP", *this, MAX_CONNECTIONS, settings));
+   tcpServer->start();
+}
+
+void HttpServer::addRoute(const std::string& path, RequestHandler& handler) {
+   const std::lock_guard<std::mutex> lock(handlersMutex);
+   routes[path] = &handler;
+}
+
+void HttpServer::addPrefixRoute(const std::string& prefix, RequestHandler& handler) {
+   const std::lock_guard<std::mutex> lock(handlersMutex);
+   prefixRoutes[prefix] = &handler;
+}
+
+void HttpServer::removeRoutes(RequestHandler& handler) {
+   {
+      std::unique_lock<std::mutex> handlersLock(handlersMutex);
+      for (auto entry = routes.begin(); entry != routes.end();) {
+         entry = (entry->second == &handler) ? routes.erase(entry) : std::next(entry);
+      }
+      for (auto entry = prefixRoutes.begin(); entry != prefixRoutes.end();) {
+         entry = (entry->second == &handler) ? prefixRoutes.erase(entry) : std::next(entry);
+      }
+      // Requests already passed to the handler might still become DEFERRED
+      // or STREAMING, hence the clients get checked after the calls returned.
+      callReturned.wait(handlersLock, [this, &handler]{ return activeCalls.count(&handler) == 0; });
+   }
+
+   std::vector<int> connectionsToProcess;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      for (auto& entry : clients) {
+         Client& client = entry.second;
+         if (client.handler != &handler) {
+            continue;
+         }
+         client.handler = nullptr;
+         if (client.requestInProgress) {
+            sendResponse(client, HttpResponse::text(503, "service stopped\n"));
+            connectionsToProcess.push_back(entry.first);
+         } else {
+            client.connection->close();
+         }
+      }
+   }
+   for (int connectionId : connectionsToProcess) {
+      processRequests(connectionId);
+   }
+}
+
+void HttpServer::respond(int connectionId, const HttpResponse& response) {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if ((entry == clients.end()) || !entry->second.requestInProgress) {
+         return;
+      }
+      entry->second.handler = nullptr;
+      sendResponse(entry->second, response);
+   }
+   processRequests(connectionId);
+}
+
+std::string HttpServer::createStreamHeader(const std::string& contentType) {
+   std::ostringstream header;
+   header << "HTTP/1.1 200 OK" << CRLF;
+   header << "Content-Type: " << contentType << CRLF;
+   header << "Cache-Control: no-cache" << CRLF;
+   header << "Access-Control-Allow-Origin: *" << CRLF;
+   header << "Connection: close" << CRLF << CRLF;
+   return header.str();
+}
+
+void HttpServer::onNewConnection(std::shared_ptr<Connection> connection) {
+   log.debug("accepted new connection", connection->getId());
+   const std::lock_guard<std::mutex> lock(mutex);
+   HttpRequestParser parser(MAX_HEADER_SIZE, MAX_BODY_SIZE);
+   clients.emplace(connection->getId(), Client{connection, parser, false, {}, false, nullptr, false, false, false, ""});
+   acceptedConnections++;
+}
+
+void HttpServer::onConnectionClosed(int connectionId) {
+   log.debug("connection", connectionId, "closed");
+   RequestHandler* handler = nullptr;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if (entry == clients.end()) {
+         return;
+      }
+      handler = entry->second.handler;
+      clients.erase(entry);
+   }
+   if (handler == nullptr) {
+      return;
+   }
+
+   // the handler might have been removed in the meantime
+   if (acquireHandler(handler) != nullptr) {
+      handler->onConnectionClosed(connectionId);
+      releaseHandler(handler);
+   }
+}
+
+void HttpServer::onCommandReceived(int connectionId, std::string_view command) {
+   RequestHandler* upgradedHandler = nullptr;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if (entry == clients.end()) {
+         return;
+      }
+      Client& client = entry->second;
+      if (client.upgraded) {
+         upgradedHandler = client.handler;
+      } else if (client.ignoringInput) {
+         return;
+      } else if (client.upgradePending) {
+         // gets passed to the handler if it upgrades the connection
+         if (client.bufferedInput.size() + command.size() > MAX_BODY_SIZE) {
+            log.warning("closing connection", connectionId, "because of too much data following an upgrade request");
+            client.ignoringInput = true;
+            client.connection->close();
+            return;
+         }
+         client.bufferedInput.append(command);
+         return;
+      } else {
+         // The request line got provided by the line framer, the following
+         // bytes (e.g. a body without a line terminator) get provided as they
+         // arrive.
+         if (!client.rawInput) {
+            client.connection->switchToRawInput();
+            client.rawInput = true;
+            parseInput(connectionId, client, std::string(command) + "\n");
+         } else {
+            parseInput(connectionId, client, command);
+         }
+      }
+   }
+
+   if (upgradedHandler != nullptr) {
+      if (acquireHandler(upgradedHandler) != nullptr) {
+         upgradedHandler->onDataReceived(connectionId, command);
+         releaseHandler(upgradedHandler);
+      }
+      return;
+   }
+   processRequests(connectionId);
+}
+
+void HttpServer::parseInput(int connectionId, Client& client, std::string_view data) {
+   while (!data.empty()) {
+      HttpRequestParser::Result result = client.parser.parse(data);
+      if (result == HttpRequestParser::Result::INCOMPLETE) {
+         return;
+      }
+      if (client.requests.size() >= MAX_QUEUED_REQUESTS) {
+         log.warning("closing connection", connectionId, "because of too many pipelined requests");
+         client.ignoringInput = true;
+         client.connection->close();
+         return;
+      }
+      if (result == HttpRequestParser::Result::INVALID) {
+         log.info("received invalid request on connection", connectionId, "-> responding with",
+                  client.parser.getErrorStatus());
+         client.requests.push_back(nullptr);
+         client.ignoringInput = true;
+         return;
+      }
+      client.requests.push_back(std::make_shared<HttpRequest>(client.parser.getRequest()));
+      if (!client.requests.back()->getHeader("upgrade").empty()) {
+         // the following data might belong to another protocol
+         client.upgradePending = true;
+         client.bufferedInput.assign(data);
+         return;
+      }
+   }
+}
+
+void HttpServer::completeUpgrade(int connectionId, RequestHandler* handler) {
+   // New data gets appended to the buffered input until it got passed to the
+   // handler completely (keeps the order of the data).
+   while (true) {
+      std::string data;
+      {
+         const std::lock_guard<std::mutex> lock(mutex);
+         auto entry = clients.find(connectionId);
+         if (entry == clients.end()) {
+            return;
+         }
+         Client& client = entry->second;
+         if (client.bufferedInput.empty()) {
+            client.upgradePending = false;
+            client.upgraded       = true;
+            return;
+         }
+         data.swap(client.bufferedInput);
+      }
+      handler->onDataReceived(connectionId, data);
+   }
+}
+
+void HttpServer::processRequests(int connectionId) {
+   while (true) {
+      std::shared_ptr<HttpRequest> request;
+      std::shared_ptr<Connection>  connection;
+      {
+         const std::lock_guard<std::mutex> lock(mutex);
+         auto entry = clients.find(connectionId);
+         if ((entry == clients.end()) || entry->second.requestInProgress || entry->second.requests.empty()) {
+            return;
+         }
+         Client& client = entry->second;
+         if (client.requests.front() == nullptr) {
+            client.requestInProgress = true;
+            sendResponse(client, HttpResponse::text(client.parser.getErrorStatus(), "invalid request\n"));
+            return;
+         }
+         request                  = client.requests.front();
+         connection               = client.connection;
+         client.requestInProgress = true;
+      }
+
+      HttpResponse           response;
+      RequestHandler::Result result  = RequestHandler::Result::RESPONDED;
+      RequestHandler*        handler = nullptr;
+      if (request->path == METRICS_PATH) {
+         if ((request->method == "GET") || (request->method == "HEAD")) {
+            response = createMetricsResponse();
+         } else {
+            response = HttpResponse::text(405, "only GET is supported\n");
+            response.headers.emplace_back("Allow", "GET, HEAD");
+         }
+      } else {
+         handler = acquireHandler(request->path);
+         if (handler == nullptr) {
+            response = HttpResponse::text(404, "not found\n");
+         } else {
+            result = handler->onRequest(*request, connection, response);
+         }
+      }
+
+      bool connectionClosed = false;
+      {
+         const std::lock_guard<std::mutex> lock(mutex);
+         auto entry = clients.find(connectionId);
+         if (entry == clients.end()) {
+            connectionClosed = true;
+         } else {
+            Client& client = entry->second;
+            switch (result) {
+               case RequestHandler::Result::RESPONDED:
+                  sendResponse(client, response);
+                  break;
+
+               case RequestHandler::Result::DEFERRED:
+                  if (client.requestInProgress && (client.requests.front() == request)) {
+                     client.handler = handler;
+                  }
+                  break;
+
+               case RequestHandler::Result::STREAMING:
+                  responseCounts[200]++;
+                  client.handler           = handler;
+                  client.requestInProgress = false;
+                  client.ignoringInput     = true;
+                  client.requests.clear();
+                  break;
+
+               case RequestHandler::Result::UPGRADED:
+                  responseCounts[101]++;
+                  client.handler           = handler;
+                  client.requestInProgress = false;
+                  client.requests.clear();
+                  break;
+            }
+         }
+      }
+      if (connectionClosed && (result != RequestHandler::Result::RESPONDED)) {
+         // closed while the handler processed the request
+         handler->onConnectionClosed(connectionId);
+      } else if (result == RequestHandler::Result::UPGRADED) {
+         completeUpgrade(connectionId, handler);
+      }
+      if (handler != nullptr) {
+         releaseHandler(handler);
+      }
+      if (connectionClosed || (result == RequestHandler::Result::UPGRADED)) {
+         return;
+      }
+   }
+}
+
+RequestHandler* HttpServer::acquireHandler(const std::string& path) {
+   const std::lock_guard<std::mutex> handlersLock(handlersMutex);
+   RequestHandler* handler = nullptr;
+   auto            route   = routes.find(path);
+   if (route != routes.end()) {
+      handler = route->second;
+   } else {
+      size_t longestPrefix = 0;
+      for (auto& prefixRoute : prefixRoutes) {
+         if ((prefixRoute.first.size() > longestPrefix) && (path.rfind(prefixRoute.first, 0) == 0)) {
+            handler       = prefixRoute.second;
+            longestPrefix = prefixRoute.first.size();
+         }
+      }
+   }
+   if (handler != nullptr) {
+      activeCalls[handler]++;
+   }
+   return handler;
+}
+
+RequestHandler* HttpServer::acquireHandler(RequestHandler* handler) {
+   const std::lock_guard<std::mutex> handlersLock(handlersMutex);
+   for (auto* routeMap : {&routes, &prefixRoutes}) {
+      for (auto& route : *routeMap) {
+         if (route.second == handler) {
+            activeCalls[handler]++;
+            return handler;
+         }
+      }
+   }
+   return nullptr;
+}
+
+void HttpServer::releaseHandler(RequestHandler* handler) {
+   const std::lock_guard<std::mutex> handlersLock(handlersMutex);
+   auto entry = activeCalls.find(handler);
+   if (--entry->second == 0) {
+      activeCalls.erase(entry);
+      callReturned.notify_all();
+   }
+}
+
+void HttpServer::sendResponse(Client& client, const HttpResponse& response) {
+   std::shared_ptr<HttpRequest> request = client.requests.front();
+   client.requests.pop_front();
+   client.requestInProgress = false;
+
+   // a connection whose upgrade got rejected gets closed
+   bool keepAlive = (request != nullptr) && request->keepAlive && request->getHeader("upgrade").empty();
+   bool sendBody  = ((request == nullptr) || (request->method != "HEAD")) && (response.status != 204);
+
+   size_t contentLength = response.body.size();
+   for (auto& part : response.bodyParts) {
+      contentLength += part.size();
+   }
+
+   std::ostringstream header;
+   header << "HTTP/1.1 " << response.status << " " << getReasonPhrase(response.status) << CRLF;
+   if (response.status != 204) {
+      if (!response.contentType.empty()) {
+         header << "Content-Type: " << response.contentType << CRLF;
+      }
+      header << "Content-Length: " << contentLength << CRLF;
+   }
+   header << "Cache-Control: " << response.cacheControl << CRLF;
+   header << "Access-Control-Allow-Origin: *" << CRLF;
+   for (auto& field : response.headers) {
+      header << field.first << ": " << field.second << CRLF;
+   }
+   // Without keep-alive the connection gets closed after the response got
+   // sent, at the latest after the linger timeout of the connection.
+   header << "Connection: " << (keepAlive ? "keep-alive" : "close") << CRLF << CRLF;
+
+   client.connection->asyncSend(header.str());
+   if (sendBody && (response.body.size() > 0)) {
+      client.connection->asyncSend(response.body);
+   }
+   if (sendBody) {
+      for (auto& part : response.bodyParts) {
+         client.connection->asyncSend(part);
+      }
+   }
+   responseCounts[response.status]++;
+
+   if (!keepAlive) {
+      client.ignoringInput = true;
+      client.requests.clear();
+      client.bufferedInput.clear();
+      client.connection->closeAfterSending();
+   }
+}
+
+HttpResponse HttpServer::createMetricsResponse() {
+   std::ostringstream metrics;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      metrics << "# TYPE octowatch_http_connections gauge" << "\n";
+      metrics << "octowatch_http_connections " << clients.size() << "\n";
+      metrics << "# TYPE octowatch_http_accepted_connections_total counter" << "\n";
+      metrics << "octowatch_http_accepted_connections_total " << acceptedConnections << "\n";
+      metrics << "# TYPE octowatch_http_responses_total counter" << "\n";
+      for (auto& entry : responseCounts) {
+         metrics << "octowatch_http_responses_total{status=\"" << entry.first << "\"} " << entry.second << "\n";
+      }
+   }
+
+   EgressScheduler::get().writeMetrics(metrics);
+   BufferPool::getDefault().writeMetrics(metrics);
+
+   std::set<RequestHandler*> handlers;
+   {
+      const std::lock_guard<std::mutex> handlersLock(handlersMutex);
+      for (auto* routeMap : {&routes, &prefixRoutes}) {
+         for (auto& route : *routeMap) {
+            if (handlers.insert(route.second).second) {
+               activeCalls[route.second]++;
+            }
+         }
+      }
+   }
+   for (RequestHandler* handler : handlers) {
+      handler->writeMetrics(metrics);
+      releaseHandler(handler);
+   }
+
+   HttpResponse response;
+   response.contentType = "text/plain; version=0.0.4";
+   response.body        = SharedBuffer::copyOf(metrics.str());
+   return response;
+}
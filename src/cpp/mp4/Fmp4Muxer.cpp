@@ -0,0 +1,340 @@
+#include <cstring>
+
+#include "AnnexB.h"
+#include "BufferPool.h"
+#include "Fmp4Muxer.h"
+
+using h264::AnnexB;
+using mp4::Fmp4Fragment;
+using mp4::Fmp4Muxer;
+using network::SharedBuffer;
+
+#define TRACK_ID   1
+
+#define SAMPLE_FLAGS_SYNC       0x02000000   // sample_depends_on = 2 (I-frame)
+#define SAMPLE_FLAGS_NON_SYNC   0x01010000   // sample_depends_on = 1, sample_is_non_sync_sample
+
+// used as duration of the last sample if there is no following one (e.g. 30 fps)
+#define DEFAULT_SAMPLE_DURATION   (FMP4_TIMESCALE / 30)
+
+namespace {
+
+   /**
+    * Appends ISO BMFF boxes to a byte vector. The size of a box gets written
+    * when the box gets closed.
+    */
+   class BoxWriter {
+      public:
+         BoxWriter(std::vector<uint8_t>& output) : output(output) {}
+
+         void u8(uint8_t value) { output.push_back(value); }
+
+         void u16(uint16_t value) { u8(value >> 8); u8(value & 0xff); }
+
+         void u32(uint32_t value) { u16(value >> 16); u16(value & 0xffff); }
+
+         void u64(uint64_t value) { u32(value >> 32); u32(value & 0xffffffff); }
+
+         void zeros(size_t count) { output.insert(output.end(), count, 0); }
+
+         void bytes(const std::string& data) { output.insert(output.end(), data.begin(), data.end()); }
+
+         size_t open(const char type[5]) {
+            size_t start = output.size();
+            u32(0);
+            output.insert(output.end(), type, type + 4);
+            return start;
+         }
+
+         size_t openFull(const char type[5], uint8_t version, uint32_t flags) {
+            size_t start = open(type);
+            u32((version << 24) | flags);
+            return start;
+         }
+
+         void close(size_t start) {
+            uint32_t size = output.size() - start;
+            output[start]     = size >> 24;
+            output[start + 1] = (size >> 16) & 0xff;
+            output[start + 2] = (size >> 8) & 0xff;
+            output[start + 3] = size & 0xff;
+         }
+
+         void patchU32(size_t position, uint32_t value) {
+            output[position]     = value >> 24;
+            output[position + 1] = (value >> 16) & 0xff;
+            output[position + 2] = (value >> 8) & 0xff;
+            output[position + 3] = value & 0xff;
+         }
+
+         size_t size() const { return output.size(); }
+
+      private:
+         std::vector<uint8_t>& output;
+   };
+
+   void writeUnityMatrix(BoxWriter& box) {
+      const uint32_t matrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+      for (uint32_t value : matrix) {
+         box.u32(value);
+      }
+   }
+}
+
+Fmp4Muxer::Fmp4Muxer(unsigned int width, unsigned int height, unsigned int framesPerFragment)
+   : width(width),
+     height(height),
+     framesPerFragment(framesPerFragment),
+     firstTimestamp_us(-1),
+     sequenceNumber(1) {}
+
+bool Fmp4Muxer::add(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe, Fmp4Fragment& fragment) {
+   if (!keyframe && samples.empty()) {
+      return false;
+   }
+
+   if (firstTimestamp_us < 0) {
+      firstTimestamp_us = timestamp_us;
+   }
+   // relative to the first access unit to avoid accumulating rounding errors
+   int64_t decodeTime = ((timestamp_us - firstTimestamp_us) * FMP4_TIMESCALE) / 1000000;
+
+   bool fragmentCompleted = false;
+   if (!samples.empty()) {
+      Sample& previous  = samples.back();
+      int64_t duration  = decodeTime - previous.decodeTime;
+      previous.duration = (duration > 0) ? duration : DEFAULT_SAMPLE_DURATION;
+      if (keyframe || (samples.size() >= framesPerFragment)) {
+         createFragment(fragment);
+         fragmentCompleted = true;
+      }
+   }
+
+   // convert the NAL units from Annex B to length prefixed ones (AVCC)
+   const uint8_t* data   = accessUnit.data();
+   Sample         sample = {mdatPayload.size(), 0, decodeTime, DEFAULT_SAMPLE_DURATION, keyframe};
+   std::string    sps;
+   std::string    pps;
+
+   AnnexB::findNalUnits(data, accessUnit.size(), nalUnits);
+   for (auto& nalUnit : nalUnits) {
+      const uint8_t* start = data + nalUnit.offset;
+      if (nalUnit.type == NAL_TYPE_SPS) {
+         sps.assign((const char*)start, nalUnit.size);
+      } else if (nalUnit.type == NAL_TYPE_PPS) {
+         pps.assign((const char*)start, nalUnit.size);
+      } else if (nalUnit.type != NAL_TYPE_AUD) {
+         uint8_t prefix[4] = {(uint8_t)(nalUnit.size >> 24), (uint8_t)(nalUnit.size >> 16),
+                              (uint8_t)(nalUnit.size >> 8),  (uint8_t)nalUnit.size};
+         mdatPayload.insert(mdatPayload.end(), prefix, prefix + 4);
+         mdatPayload.insert(mdatPayload.end(), start, start + nalUnit.size);
+      }
+   }
+
+   if (keyframe && (initSegment.size() == 0)) {
+      if ((sps.size() < 4) || pps.empty()) {
+         mdatPayload.resize(sample.offset);
+         return fragmentCompleted;
+      }
+      createInitSegment(sps, pps);
+   }
+
+   sample.size = mdatPayload.size() - sample.offset;
+   samples.push_back(sample);
+   return fragmentCompleted;
+}
+
+SharedBuffer Fmp4Muxer::getInitSegment() const {
+   return initSegment;
+}
+
+void Fmp4Muxer::reset() {
+   samples.clear();
+   mdatPayload.clear();
+}
+
+void Fmp4Muxer::createInitSegment(const std::string& sps, const std::string& pps) {
+   std::vector<uint8_t> output;
+   BoxWriter box(output);
+
+   size_t ftyp = box.open("ftyp");
+   box.bytes("iso6");
+   box.u32(0);
+   box.bytes("iso6cmfcisomavc1");
+   box.close(ftyp);
+
+   size_t moov = box.open("moov");
+
+   size_t mvhd = box.openFull("mvhd", 0, 0);
+   box.u32(0);                // creation time
+   box.u32(0);                // modification time
+   box.u32(FMP4_TIMESCALE);
+   box.u32(0);                // duration (unknown)
+   box.u32(0x00010000);       // rate 1.0
+   box.u16(0x0100);           // volume 1.0
+   box.zeros(10);
+   writeUnityMatrix(box);
+   box.zeros(24);             // pre_defined
+   box.u32(TRACK_ID + 1);     // next track ID
+   box.close(mvhd);
+
+   size_t trak = box.open("trak");
+   size_t tkhd = box.openFull("tkhd", 0, 0x000003); // enabled, in movie
+   box.u32(0);
+   box.u32(0);
+   box.u32(TRACK_ID);
+   box.u32(0);
+   box.u32(0);                // duration
+   box.zeros(8);
+   box.u16(0);                // layer
+   box.u16(0);                // alternate group
+   box.u16(0);                // volume
+   box.u16(0);
+   writeUnityMatrix(box);
+   box.u32(width << 16);
+   box.u32(height << 16);
+   box.close(tkhd);
+
+   size_t mdia = box.open("mdia");
+   size_t mdhd = box.openFull("mdhd", 0, 0);
+   box.u32(0);
+   box.u32(0);
+   box.u32(FMP4_TIMESCALE);
+   box.u32(0);
+   box.u16(0x55c4);           // language "und"
+   box.u16(0);
+   box.close(mdhd);
+
+   size_t hdlr = box.openFull("hdlr", 0, 0);
+   box.u32(0);
+   box.bytes("vide");
+   box.zeros(12);
+   box.bytes(std::string("VideoHandler", 13));
+   box.close(hdlr);
+
+   size_t minf = box.open("minf");
+   size_t vmhd = box.openFull("vmhd", 0, 1);
+   box.zeros(8);
+   box.close(vmhd);
+
+   size_t dinf = box.open("dinf");
+   size_t dref = box.openFull("dref", 0, 0);
+   box.u32(1);
+   size_t url = box.openFull("url ", 0, 1); // data in same file
+   box.close(url);
+   box.close(dref);
+   box.close(dinf);
+
+   size_t stbl = box.open("stbl");
+   size_t stsd = box.openFull("stsd", 0, 0);
+   box.u32(1);
+   size_t avc1 = box.open("avc1");
+   box.zeros(6);
+   box.u16(1);                // data reference index
+   box.zeros(16);
+   box.u16(width);
+   box.u16(height);
+   box.u32(0x00480000);       // 72 dpi
+   box.u32(0x00480000);
+   box.u32(0);
+   box.u16(1);                // frame count
+   box.zeros(32);             // compressor name
+   box.u16(0x0018);           // depth
+   box.u16(0xffff);
+   size_t avcC = box.open("avcC");
+   box.u8(1);                 // configuration version
+   box.u8(sps[1]);            // profile
+   box.u8(sps[2]);            // profile compatibility
+   box.u8(sps[3]);            // level
+   box.u8(0xff);              // 4 bytes NAL unit length
+   box.u8(0xe1);              // 1 SPS
+   box.u16(sps.size());
+   box.bytes(sps);
+   box.u8(1);                 // 1 PPS
+   box.u16(pps.size());
+   box.bytes(pps);
+   box.close(avcC);
+   box.close(avc1);
+   box.close(stsd);
+
+   for (const char* type : {"stts", "stsc", "stco"}) {
+      size_t emptyTable = box.openFull(type, 0, 0);
+      box.u32(0);
+      box.close(emptyTable);
+   }
+   size_t stsz = box.openFull("stsz", 0, 0);
+   box.u32(0);
+   box.u32(0);
+   box.close(stsz);
+   box.close(stbl);
+   box.close(minf);
+   box.close(mdia);
+   box.close(trak);
+
+   size_t mvex = box.open("mvex");
+   size_t trex = box.openFull("trex", 0, 0);
+   box.u32(TRACK_ID);
+   box.u32(1);                // default sample description index
+   box.u32(0);
+   box.u32(0);
+   box.u32(0);
+   box.close(trex);
+   box.close(mvex);
+   box.close(moov);
+
+   initSegment = SharedBuffer::copyOf(output.data(), output.size());
+}
+
+void Fmp4Muxer::createFragment(Fmp4Fragment& fragment) {
+   uint64_t decodeTime = samples[0].decodeTime;
+   uint64_t duration   = 0;
+
+   moof.clear();
+   BoxWriter box(moof);
+   size_t moofBox = box.open("moof");
+   size_t mfhd    = box.openFull("mfhd", 0, 0);
+   box.u32(sequenceNumber++);
+   box.close(mfhd);
+
+   size_t traf = box.open("traf");
+   size_t tfhd = box.openFull("tfhd", 0, 0x020000); // default-base-is-moof
+   box.u32(TRACK_ID);
+   box.close(tfhd);
+
+   size_t tfdt = box.openFull("tfdt", 1, 0);
+   box.u64(decodeTime);
+   box.close(tfdt);
+
+   // data offset, sample duration, sample size and sample flags present
+   size_t trun = box.openFull("trun", 0, 0x000701);
+   box.u32(samples.size());
+   size_t dataOffsetPosition = box.size();
+   box.u32(0);
+   for (auto& sample : samples) {
+      box.u32(sample.duration);
+      box.u32(sample.size);
+      box.u32(sample.keyframe ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+      duration += sample.duration;
+   }
+   box.close(trun);
+   box.close(traf);
+   box.close(moofBox);
+
+   size_t mdatHeaderSize = 8;
+   box.patchU32(dataOffsetPosition, moof.size() + mdatHeaderSize);
+   box.u32(mdatHeaderSize + mdatPayload.size());
+   box.bytes("mdat");
+
+   std::shared_ptr<uint8_t> memory = network::BufferPool::getDefault().allocate(moof.size() + mdatPayload.size());
+   std::memcpy(memory.get(), moof.data(), moof.size());
+   std::memcpy(memory.get() + moof.size(), mdatPayload.data(), mdatPayload.size());
+
+   fragment.data               = SharedBuffer(std::move(memory), moof.size() + mdatPayload.size());
+   fragment.startsWithKeyframe = samples[0].keyframe;
+   fragment.decodeTime         = decodeTime;
+   fragment.duration           = duration;
+   fragment.sampleCount        = samples.size();
+
+   samples.clear();
+   mdatPayload.clear();
+}
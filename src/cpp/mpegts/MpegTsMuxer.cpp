@@ -0,0 +1,208 @@
+#include <cstring>
+
+#include "MpegTsMuxer.h"
+
+using h264::AnnexB;
+using mpegts::MpegTsMuxer;
+using network::SharedBuffer;
+
+#define TS_HEADER_SIZE    4
+#define TS_PAYLOAD_SIZE   (TS_PACKET_SIZE - TS_HEADER_SIZE)
+#define TS_SYNC_BYTE      0x47
+
+#define TRANSPORT_STREAM_ID   1
+#define PROGRAM_NUMBER        1
+#define STREAM_TYPE_H264      0x1b
+#define STREAM_ID_VIDEO       0xe0
+
+#define PTS_DELAY                    (TS_CLOCK_RATE / 10)   // 100 ms
+#define PROGRAM_TABLES_INTERVAL_US   100000
+
+#define ADAPTATION_FLAG_RANDOM_ACCESS   0x40
+#define ADAPTATION_FLAG_PCR             0x10
+#define PCR_SIZE                        6
+
+#define PCR_CLOCK_RATE    27000000
+#define PTS_MASK          ((1ULL << 33) - 1)
+
+static const uint8_t ACCESS_UNIT_DELIMITER[] = {0x00, 0x00, 0x00, 0x01, NAL_TYPE_AUD, 0xf0};
+
+/**
+ * CRC-32/MPEG-2 (polynomial 0x04c11db7, not reflected) of the PSI sections.
+ */
+static uint32_t crc32(const uint8_t* data, size_t size) {
+   uint32_t crc = 0xffffffff;
+   for (size_t index = 0; index < size; index++) {
+      crc ^= (uint32_t)data[index] << 24;
+      for (int bit = 0; bit < 8; bit++) {
+         crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04c11db7) : (crc << 1);
+      }
+   }
+   return crc;
+}
+
+static void appendCrc(std::vector<uint8_t>& section) {
+   uint32_t crc = crc32(section.data(), section.size());
+   for (int shift = 24; shift >= 0; shift -= 8) {
+      section.push_back((crc >> shift) & 0xff);
+   }
+}
+
+MpegTsMuxer::MpegTsMuxer()
+   : firstTimestamp_us(-1),
+     previousTimestamp_us(0),
+     lastProgramTablesTimestamp_us(0),
+     patContinuityCounter(0),
+     pmtContinuityCounter(0),
+     videoContinuityCounter(0) {}
+
+void MpegTsMuxer::mux(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe,
+                      std::vector<uint8_t>& output) {
+   if (firstTimestamp_us < 0) {
+      firstTimestamp_us             = timestamp_us;
+      previousTimestamp_us          = timestamp_us;
+      lastProgramTablesTimestamp_us = timestamp_us - 2 * PROGRAM_TABLES_INTERVAL_US;
+   }
+   // The tables get sent already if the next access unit (assuming the
+   // current frame interval) would exceed the interval.
+   int64_t frameInterval_us = (timestamp_us > previousTimestamp_us) ? (timestamp_us - previousTimestamp_us) : 0;
+   previousTimestamp_us     = timestamp_us;
+   if (keyframe ||
+       (timestamp_us + frameInterval_us - lastProgramTablesTimestamp_us > PROGRAM_TABLES_INTERVAL_US)) {
+      writeProgramTables(output);
+      lastProgramTablesTimestamp_us = timestamp_us;
+   }
+
+   // 27 MHz clock relative to the first access unit
+   int64_t  elapsed_us = (timestamp_us > firstTimestamp_us) ? (timestamp_us - firstTimestamp_us) : 0;
+   uint64_t pcr        = (uint64_t)elapsed_us * (PCR_CLOCK_RATE / 1000000);
+   uint64_t pts        = (pcr / 300 + PTS_DELAY) & PTS_MASK;
+
+   pesHeader.assign({0x00, 0x00, 0x01, STREAM_ID_VIDEO,
+                     0x00, 0x00,    // unbounded length (allowed for video)
+                     0x80,          // marker bits
+                     0x80,          // PTS present
+                     0x05,          // header data length
+                     (uint8_t)(0x21 | ((pts >> 29) & 0x0e)),
+                     (uint8_t)((pts >> 22) & 0xff),
+                     (uint8_t)(0x01 | ((pts >> 14) & 0xfe)),
+                     (uint8_t)((pts >> 7) & 0xff),
+                     (uint8_t)(0x01 | ((pts << 1) & 0xfe))});
+
+   AnnexB::findNalUnits(accessUnit.data(), accessUnit.size(), nalUnits);
+   if (nalUnits.empty() || (nalUnits[0].type != NAL_TYPE_AUD)) {
+      pesHeader.insert(pesHeader.end(), ACCESS_UNIT_DELIMITER,
+                       ACCESS_UNIT_DELIMITER + sizeof(ACCESS_UNIT_DELIMITER));
+   }
+
+   writePes(pesHeader, accessUnit.data(), accessUnit.size(), pcr, keyframe, output);
+}
+
+void MpegTsMuxer::writeProgramTables(std::vector<uint8_t>& output) {
+   std::vector<uint8_t> pat = {
+      0x00,                                      // table ID
+      0xb0, 0x0d,                                // section length
+      TRANSPORT_STREAM_ID >> 8, TRANSPORT_STREAM_ID & 0xff,
+      0xc1,                                      // version 0, current
+      0x00, 0x00,                                // section number, last section number
+      PROGRAM_NUMBER >> 8, PROGRAM_NUMBER & 0xff,
+      0xe0 | (TS_PID_PMT >> 8), TS_PID_PMT & 0xff};
+   appendCrc(pat);
+   writeSection(TS_PID_PAT, pat, output);
+
+   std::vector<uint8_t> pmt = {
+      0x02,                                      // table ID
+      0xb0, 0x12,                                // section length
+      PROGRAM_NUMBER >> 8, PROGRAM_NUMBER & 0xff,
+      0xc1,                                      // version 0, current
+      0x00, 0x00,                                // section number, last section number
+      0xe0 | (TS_PID_VIDEO >> 8), TS_PID_VIDEO & 0xff,   // PCR PID
+      0xf0, 0x00,                                // program info length
+      STREAM_TYPE_H264,
+      0xe0 | (TS_PID_VIDEO >> 8), TS_PID_VIDEO & 0xff,
+      0xf0, 0x00};                               // ES info length
+   appendCrc(pmt);
+   writeSection(TS_PID_PMT, pmt, output);
+}
+
+void MpegTsMuxer::writeSection(uint16_t pid, const std::vector<uint8_t>& section, std::vector<uint8_t>& output) {
+   size_t packetStart = output.size();
+   output.resize(packetStart + TS_PACKET_SIZE, 0xff);
+
+   uint8_t* packet = &output[packetStart];
+   packet[0] = TS_SYNC_BYTE;
+   packet[1] = 0x40 | (pid >> 8);   // payload unit start
+   packet[2] = pid & 0xff;
+   packet[3] = 0x10 | nextContinuityCounter(pid);
+   packet[4] = 0x00;                // pointer field
+   std::memcpy(packet + 5, section.data(), section.size());
+}
+
+void MpegTsMuxer::writePes(const std::vector<uint8_t>& header, const uint8_t* data, size_t size, uint64_t pcr,
+                           bool keyframe, std::vector<uint8_t>& output) {
+   size_t totalSize = header.size() + size;
+   size_t offset    = 0;   // in the concatenation of header and data
+
+   while (offset < totalSize) {
+      bool   firstPacket   = (offset == 0);
+      size_t remainingSize = totalSize - offset;
+
+      // The adaptation field carries the PCR in the first packet and the
+      // stuffing in the last one.
+      size_t adaptationFieldSize = firstPacket ? (2 + PCR_SIZE) : 0;
+      if (remainingSize < TS_PAYLOAD_SIZE - adaptationFieldSize) {
+         adaptationFieldSize = TS_PAYLOAD_SIZE - remainingSize;
+      }
+      size_t payloadSize = TS_PAYLOAD_SIZE - adaptationFieldSize;
+
+      size_t packetStart = output.size();
+      output.resize(packetStart + TS_PACKET_SIZE);
+
+      uint8_t* packet = &output[packetStart];
+      packet[0] = TS_SYNC_BYTE;
+      packet[1] = (firstPacket ? 0x40 : 0x00) | (TS_PID_VIDEO >> 8);
+      packet[2] = TS_PID_VIDEO & 0xff;
+      packet[3] = (adaptationFieldSize > 0 ? 0x30 : 0x10) | nextContinuityCounter(TS_PID_VIDEO);
+
+      uint8_t* position = packet + TS_HEADER_SIZE;
+      if (adaptationFieldSize > 0) {
+         position[0] = adaptationFieldSize - 1;
+         if (adaptationFieldSize > 1) {
+            std::memset(position + 1, 0xff, adaptationFieldSize - 1);
+            position[1] = 0x00;
+            if (firstPacket) {
+               uint64_t base      = (pcr / 300) & PTS_MASK;
+               uint64_t extension = pcr % 300;
+               position[1] = ADAPTATION_FLAG_PCR | (keyframe ? ADAPTATION_FLAG_RANDOM_ACCESS : 0);
+               position[2] = (base >> 25) & 0xff;
+               position[3] = (base >> 17) & 0xff;
+               position[4] = (base >> 9) & 0xff;
+               position[5] = (base >> 1) & 0xff;
+               position[6] = ((base & 0x01) << 7) | 0x7e | ((extension >> 8) & 0x01);
+               position[7] = extension & 0xff;
+            }
+         }
+         position += adaptationFieldSize;
+      }
+
+      size_t payloadEnd = offset + payloadSize;
+      if (offset < header.size()) {
+         size_t headerPart = std::min(payloadEnd, header.size()) - offset;
+         std::memcpy(position, header.data() + offset, headerPart);
+         position += headerPart;
+         offset   += headerPart;
+      }
+      if (offset < payloadEnd) {
+         std::memcpy(position, data + (offset - header.size()), payloadEnd - offset);
+         offset = payloadEnd;
+      }
+   }
+}
+
+uint8_t MpegTsMuxer::nextContinuityCounter(uint16_t pid) {
+   uint8_t& counter = (pid == TS_PID_PAT) ? patContinuityCounter :
+                      (pid == TS_PID_PMT) ? pmtContinuityCounter : videoContinuityCounter;
+   uint8_t  current = counter;
+   counter = (counter + 1) & 0x0f;
+   return current;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <regex>
+
+#include "MpegTsUdpStream.h"
+#include "Reactor.h"
+
+#define PACKETS_PER_DATAGRAM   7
+#define DATAGRAM_SIZE          (PACKETS_PER_DATAGRAM * TS_PACKET_SIZE)
+#define MULTICAST_TTL          1
+#define SEND_BUFFER_SIZE       (1024 * 1024)
+
+using boost::asio::ip::udp;
+using mpegts::MpegTsUdpStream;
+using network::Reactor;
+using network::SharedBuffer;
+
+MpegTsUdpStream::MpegTsUdpStream(const udp::endpoint& destination)
+   : log("MpegTsUdpStream"),
+     destination(destination),
+     sentDatagrams(0),
+     droppedDatagrams(0) {}
+
+MpegTsUdpStream::~MpegTsUdpStream() {
+   log.info("sent", sentDatagrams, "datagrams, dropped", droppedDatagrams);
+   if (socket) {
+      boost::system::error_code error;
+      socket->close(error);
+   }
+}
+
+void MpegTsUdpStream::start() {
+   try {
+      std::unique_ptr<udp::socket> newSocket(new udp::socket(Reactor::get().getIoContext(), udp::v4()));
+      newSocket->set_option(boost::asio::socket_base::send_buffer_size(SEND_BUFFER_SIZE));
+      if (destination.address().is_multicast()) {
+         newSocket->set_option(boost::asio::ip::multicast::hops(MULTICAST_TTL));
+         newSocket->set_option(boost::asio::ip::multicast::enable_loopback(true));
+      }
+      newSocket->non_blocking(true);
+      socket = std::move(newSocket);
+      log.info("sending MPEG-TS to", destination.address().to_string() + ":" + std::to_string(destination.port()));
+   } catch (const boost::system::system_error& e) {
+      log.error("failed to open UDP socket:", e.what());
+   }
+}
+
+void MpegTsUdpStream::send(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe) {
+   if (!socket) {
+      return;
+   }
+
+   packets.clear();
+   muxer.mux(accessUnit, timestamp_us, keyframe, packets);
+
+   for (size_t offset = 0; offset < packets.size(); offset += DATAGRAM_SIZE) {
+      size_t size = std::min((size_t)DATAGRAM_SIZE, packets.size() - offset);
+      boost::system::error_code error;
+      socket->send_to(boost::asio::buffer(packets.data() + offset, size), destination, 0, error);
+      if (error) {
+         if (droppedDatagrams == 0) {
+            log.warning("failed to send datagram:", error.message());
+         }
+         droppedDatagrams++;
+      } else {
+         sentDatagrams++;
+      }
+   }
+}
+
+bool MpegTsUdpStream::parseDestination(const std::string& text, udp::endpoint& destination) {
+   const std::regex regex("\\s*(\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}):(\\d{1,5})\\s*");
+   std::smatch captureGroups;
+   if (!std::regex_match(text, captureGroups, regex)) {
+      return false;
+   }
+   boost::system::error_code error;
+   boost::asio::ip::address_v4 address = boost::asio::ip::make_address_v4(captureGroups[1].str(), error);
+   int port = std::stoi(captureGroups[2].str());
+   if (error || (port < 1) || (port > 65535)) {
+      return false;
+   }
+   destination = udp::endpoint(address, port);
+   return true;
+}
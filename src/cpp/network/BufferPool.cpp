@@ -0,0 +1,136 @@
+#include <string>
+
+#include "BufferPool.h"
+
+#define MIN_SIZE_CLASS_EXPONENT    6    //  64 bytes
+#define MAX_SIZE_CLASS_EXPONENT    22   //   4 MB
+#define SIZE_CLASS_COUNT           (MAX_SIZE_CLASS_EXPONENT - MIN_SIZE_CLASS_EXPONENT + 1)
+
+#define DEFAULT_MAX_RETAINED_BYTES (32 * 1024 * 1024)
+
+using logging::Logger;
+using network::BufferPool;
+using network::BufferPoolStatistics;
+using network::PoolAllocator;
+using network::SizeClassStatistics;
+
+static size_t getSizeOfClass(int sizeClass) {
+   return ((size_t)1) << (sizeClass + MIN_SIZE_CLASS_EXPONENT);
+}
+
+BufferPool::BufferPool(size_t maxRetainedBytes) 
+   : log("BufferPool"),
+     maxRetainedBytes(maxRetainedBytes),
+     freeBlocks(SIZE_CLASS_COUNT),
+     statistics(),
+     sizeClassStatistics(SIZE_CLASS_COUNT + 1),
+     highWaterMarkReached(false) {}
+
+BufferPool::~BufferPool() {
+   for (auto& blocks : freeBlocks) {
+      for (void* block : blocks) {
+         ::operator delete(block);
+      }
+   }
+}
+
+BufferPool& BufferPool::getDefault() {
+   static BufferPool* pool = new BufferPool(DEFAULT_MAX_RETAINED_BYTES);
+   return *pool;
+}
+
+int BufferPool::getSizeClass(size_t size) {
+   for (int sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+      if (size <= getSizeOfClass(sizeClass)) {
+         return sizeClass;
+      }
+   }
+   return -1;
+}
+
+std::shared_ptr<uint8_t> BufferPool::allocate(size_t size) {
+   uint8_t* memory = static_cast<uint8_t*>(acquireBlock(size));
+   return std::shared_ptr<uint8_t>(memory, [this, size](uint8_t* memory) { 
+      releaseBlock(memory, size); 
+   }, PoolAllocator<uint8_t>(*this));
+}
+
+void* BufferPool::acquireBlock(size_t size) {
+   int sizeClass = getSizeClass(size);
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      SizeClassStatistics& sizeClassEntry = sizeClassStatistics[(sizeClass >= 0) ? sizeClass : SIZE_CLASS_COUNT];
+      statistics.allocations++;
+      if (sizeClass >= 0) {
+         size_t              blockSize = getSizeOfClass(sizeClass);
+         std::vector<void*>& blocks    = freeBlocks[sizeClass];
+         statistics.outstandingBytes += blockSize;
+         if (!blocks.empty()) {
+            void* block = blocks.back();
+            blocks.pop_back();
+            statistics.retainedBytes -= blockSize;
+            sizeClassEntry.reusedBlocks++;
+            return block;
+         }
+      } else {
+         statistics.outstandingBytes += size;
+      }
+      statistics.heapAllocations++;
+      sizeClassEntry.heapAllocations++;
+   }
+   return ::operator new((sizeClass >= 0) ? getSizeOfClass(sizeClass) : size);
+}
+
+void BufferPool::releaseBlock(void* block, size_t size) {
+   int sizeClass = getSizeClass(size);
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (sizeClass < 0) {
+         statistics.outstandingBytes -= size;
+      } else {
+         size_t blockSize             = getSizeOfClass(sizeClass);
+         statistics.outstandingBytes -= blockSize;
+         if (statistics.retainedBytes + blockSize <= maxRetainedBytes) {
+            freeBlocks[sizeClass].push_back(block);
+            statistics.retainedBytes += blockSize;
+            return;
+         }
+         statistics.discardedBlocks++;
+         if (!highWaterMarkReached) {
+            highWaterMarkReached = true;
+            log.warning("high-water mark of", maxRetainedBytes, "bytes reached -> freeing released blocks");
+         }
+      }
+   }
+   ::operator delete(block);
+}
+
+BufferPoolStatistics BufferPool::getStatistics() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return statistics;
+}
+
+void BufferPool::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   // the size classes not used so far are left out
+   output << "# TYPE octowatch_buffer_pool_allocations_total counter" << "\n";
+   for (int sizeClass = 0; sizeClass <= SIZE_CLASS_COUNT; sizeClass++) {
+      const SizeClassStatistics& entry = sizeClassStatistics[sizeClass];
+      if ((entry.reusedBlocks == 0) && (entry.heapAllocations == 0)) {
+         continue;
+      }
+      std::string label = (sizeClass < SIZE_CLASS_COUNT) ? std::to_string(getSizeOfClass(sizeClass)) : "larger";
+      output << "octowatch_buffer_pool_allocations_total{size_class=\"" << label << "\",result=\"reused\"} "
+             << entry.reusedBlocks << "\n";
+      output << "octowatch_buffer_pool_allocations_total{size_class=\"" << label << "\",result=\"heap\"} "
+             << entry.heapAllocations << "\n";
+   }
+   output << "# TYPE octowatch_buffer_pool_discarded_blocks_total counter" << "\n";
+   output << "octowatch_buffer_pool_discarded_blocks_total " << statistics.discardedBlocks << "\n";
+   output << "# TYPE octowatch_buffer_pool_retained_bytes gauge" << "\n";
+   output << "octowatch_buffer_pool_retained_bytes " << statistics.retainedBytes << "\n";
+   output << "# TYPE octowatch_buffer_pool_max_retained_bytes gauge" << "\n";
+   output << "octowatch_buffer_pool_max_retained_bytes " << maxRetainedBytes << "\n";
+   output << "# TYPE octowatch_buffer_pool_outstanding_bytes gauge" << "\n";
+   output << "octowatch_buffer_pool_outstanding_bytes " << statistics.outstandingBytes << "\n";
+}
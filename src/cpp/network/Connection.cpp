@@ -2,12 +2,23 @@
 #include "TcpServer.h"
 
 using network::Connection;
+using network::SendQueueLimits;
+using network::SharedBuffer;
 using network::TcpConnection;
+using network::TransportStatistics;
 
 
-Connection::Connection(std::unique_ptr<TcpConnection> tcpConnection)
+Connection::Connection(std::shared_ptr<TcpConnection> tcpConnection)
    : tcpConnection(std::move(tcpConnection)) {}
 
+Connection::~Connection() {
+   tcpConnection->close();
+}
+
+int Connection::getId() const {
+   return tcpConnection->getId();
+}
+
 void Connection::asyncSend(const std::string& message) {
    tcpConnection->asyncSend(message);
 }
@@ -20,6 +31,54 @@ void Connection::asyncSendAndFree(void *mem, size_t size) {
    tcpConnection->asyncSendAndFree(mem, size);
 }
 
+void Connection::asyncSend(const SharedBuffer& buffer) {
+   tcpConnection->asyncSend(buffer);
+}
+
+void Connection::asyncSendFrame(std::initializer_list<SharedBuffer> parts) {
+   tcpConnection->asyncSendFrame(parts);
+}
+
+void Connection::asyncSendFileDescriptor(int fileDescriptor, const std::string& message) {
+   tcpConnection->asyncSendFileDescriptor(fileDescriptor, message);
+}
+
 bool Connection::outputBufferEmpty() const {
    return tcpConnection->outputBufferEmpty();
+}
+
+network::SendQueueStatistics Connection::getSendQueueStatistics() const {
+   return tcpConnection->getSendQueueStatistics();
+}
+
+size_t Connection::discardQueuedFrames() {
+   return tcpConnection->discardQueuedFrames();
+}
+
+bool Connection::getTransportStatistics(TransportStatistics& statistics) const {
+   return tcpConnection->getTransportStatistics(statistics);
+}
+
+void Connection::setSendQueueLimits(const SendQueueLimits& limits) {
+   tcpConnection->setSendQueueLimits(limits);
+}
+
+void Connection::setEgressStream(const std::string& streamName) {
+   tcpConnection->setEgressStream(streamName);
+}
+
+bool Connection::getRemoteIpAddress(boost::asio::ip::address& address) const {
+   return tcpConnection->getRemoteIpAddress(address);
+}
+
+void Connection::switchToRawInput() {
+   tcpConnection->switchToRawInput();
+}
+
+void Connection::close() {
+   tcpConnection->close();
+}
+
+void Connection::closeAfterSending() {
+   tcpConnection->closeAfterSending();
 }
\ No newline at end of file
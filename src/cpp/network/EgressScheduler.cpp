@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdlib>
+#include <regex>
+#include <sstream>
+
+#include "EgressScheduler.h"
+
+using logging::Logger;
+using network::EgressBudget;
+using network::EgressLimits;
+using network::EgressScheduler;
+using network::TokenBucket;
+
+#define CONTROL_STREAM   "control"
+
+// The burst allows a frame to get sent as a whole (e.g. a keyframe or JPEG).
+#define BURST_DURATION_MS   200
+#define MIN_BURST_BYTES     (64 * 1024)
+
+EgressLimits EgressLimits::fromEnvironment(const char* envVarName) {
+   Logger       log("EgressLimits");
+   EgressLimits limits;
+   char*        envVar = std::getenv(envVarName);
+
+   if (envVar == nullptr) {
+      return limits;
+   }
+
+   std::istringstream input(envVar);
+   std::string        entry;
+   const std::regex   regex("\\s*([a-z0-9]+):(\\d{1,9})\\s*");
+
+   while (std::getline(input, entry, ',')) {
+      std::smatch captureGroups;
+      if (std::regex_match(entry, captureGroups, regex)) {
+         std::string name           = captureGroups[1].str();
+         uint64_t    bytesPerSecond = std::stoull(captureGroups[2].str()) * 1000 / 8;
+         if (name == "link") {
+            limits.linkBytesPerSecond = bytesPerSecond;
+            continue;
+         }
+         if (name == "client") {
+            limits.clientBytesPerSecond = bytesPerSecond;
+            continue;
+         }
+         if ((name == "h264") || (name == "mjpeg")) {
+            limits.streamBytesPerSecond[name] = bytesPerSecond;
+            continue;
+         }
+      }
+      log.warning("ignoring invalid limit", entry, "in env var", envVarName);
+   }
+   return limits;
+}
+
+EgressScheduler& EgressScheduler::get() {
+   static EgressScheduler scheduler(EgressLimits::fromEnvironment("OCTOWATCH_EGRESS_LIMITS"));
+   return scheduler;
+}
+
+EgressScheduler::EgressScheduler(const EgressLimits& limits)
+   : log("EgressScheduler"),
+     limits(limits),
+     linkBucket(createBucket(limits.linkBytesPerSecond)) {
+   streams[CONTROL_STREAM].control = true;
+   if (limits.linkBytesPerSecond > 0) {
+      log.info("link limited to", limits.linkBytesPerSecond * 8 / 1000, "kbit/s");
+   }
+   if (limits.clientBytesPerSecond > 0) {
+      log.info("stream clients limited to", limits.clientBytesPerSecond * 8 / 1000, "kbit/s");
+   }
+   for (auto& entry : limits.streamBytesPerSecond) {
+      log.info("stream", entry.first, "limited to", entry.second * 8 / 1000, "kbit/s");
+   }
+}
+
+std::unique_ptr<TokenBucket> EgressScheduler::createBucket(uint64_t bytesPerSecond) {
+   if (bytesPerSecond == 0) {
+      return nullptr;
+   }
+   size_t burstBytes = std::max<uint64_t>(bytesPerSecond * BURST_DURATION_MS / 1000, MIN_BURST_BYTES);
+   return std::unique_ptr<TokenBucket>(new TokenBucket(bytesPerSecond, burstBytes));
+}
+
+EgressScheduler::Stream& EgressScheduler::getStream(const std::string& streamName) {
+   // the caller holds the mutex
+   auto entry = streams.find(streamName);
+   if (entry != streams.end()) {
+      return entry->second;
+   }
+   Stream& stream = streams[streamName];
+   auto    limit  = limits.streamBytesPerSecond.find(streamName);
+   if (limit != limits.streamBytesPerSecond.end()) {
+      stream.bucket = createBucket(limit->second);
+   }
+   return stream;
+}
+
+std::shared_ptr<EgressBudget> EgressScheduler::createStreamBudget(const std::string& streamName) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return std::shared_ptr<EgressBudget>(new EgressBudget(*this, getStream(streamName),
+                                                         createBucket(limits.clientBytesPerSecond)));
+}
+
+std::shared_ptr<EgressBudget> EgressScheduler::createControlBudget() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return std::shared_ptr<EgressBudget>(new EgressBudget(*this, streams[CONTROL_STREAM], nullptr));
+}
+
+bool EgressScheduler::admit(Stream& stream, TokenBucket* clientBucket, size_t bytes,
+                            TokenBucket::Clock::time_point now) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   if (!stream.control &&
+       ((clientBucket && !clientBucket->conforms(bytes, now)) ||
+        (stream.bucket && !stream.bucket->conforms(bytes, now)) ||
+        (linkBucket && !linkBucket->conforms(bytes, now)))) {
+      stream.droppedFrames++;
+      stream.droppedBytes += bytes;
+      return false;
+   }
+   if (clientBucket) {
+      clientBucket->consume(bytes);
+   }
+   if (stream.bucket) {
+      stream.bucket->consume(bytes);
+   }
+   if (linkBucket) {
+      linkBucket->consume(bytes);
+   }
+   stream.sentFrames++;
+   stream.sentBytes += bytes;
+   return true;
+}
+
+void EgressScheduler::account(Stream& stream, TokenBucket* clientBucket, size_t bytes) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   if (clientBucket) {
+      clientBucket->consume(bytes);
+   }
+   if (stream.bucket) {
+      stream.bucket->consume(bytes);
+   }
+   if (linkBucket) {
+      linkBucket->consume(bytes);
+   }
+   stream.sentFrames++;
+   stream.sentBytes += bytes;
+}
+
+void EgressScheduler::writeMetrics(std::ostream& output) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   output << "# TYPE octowatch_egress_limit_bytes_per_second gauge" << "\n";
+   output << "octowatch_egress_limit_bytes_per_second{bucket=\"link\"} " << limits.linkBytesPerSecond << "\n";
+   output << "octowatch_egress_limit_bytes_per_second{bucket=\"client\"} " << limits.clientBytesPerSecond << "\n";
+   for (auto& entry : limits.streamBytesPerSecond) {
+      output << "octowatch_egress_limit_bytes_per_second{bucket=\"" << entry.first << "\"} " << entry.second << "\n";
+   }
+   output << "# TYPE octowatch_egress_frames_total counter" << "\n";
+   for (auto& entry : streams) {
+      output << "octowatch_egress_frames_total{stream=\"" << entry.first << "\",result=\"sent\"} "
+             << entry.second.sentFrames << "\n";
+      output << "octowatch_egress_frames_total{stream=\"" << entry.first << "\",result=\"dropped\"} "
+             << entry.second.droppedFrames << "\n";
+   }
+   output << "# TYPE octowatch_egress_bytes_total counter" << "\n";
+   for (auto& entry : streams) {
+      output << "octowatch_egress_bytes_total{stream=\"" << entry.first << "\",result=\"sent\"} "
+             << entry.second.sentBytes << "\n";
+      output << "octowatch_egress_bytes_total{stream=\"" << entry.first << "\",result=\"dropped\"} "
+             << entry.second.droppedBytes << "\n";
+   }
+}
+
+EgressBudget::EgressBudget(EgressScheduler& scheduler, EgressScheduler::Stream& stream,
+                           std::unique_ptr<TokenBucket> clientBucket)
+   : scheduler(scheduler),
+     stream(stream),
+     clientBucket(std::move(clientBucket)) {}
+
+bool EgressBudget::admit(size_t bytes) {
+   return admit(bytes, TokenBucket::Clock::now());
+}
+
+bool EgressBudget::admit(size_t bytes, TokenBucket::Clock::time_point now) {
+   return scheduler.admit(stream, clientBucket.get(), bytes, now);
+}
+
+void EgressBudget::account(size_t bytes) {
+   scheduler.account(stream, clientBucket.get(), bytes);
+}
@@ -0,0 +1,68 @@
+#include <cstring>
+
+#include "LineFramer.h"
+
+using network::LineFramer;
+
+LineFramer::LineFramer(size_t maxLineLength)
+   : buffer(maxLineLength + 1),   // + 1 for the '\n'
+     usedByteCount(0),
+     discardingLine(false),
+     rawMode(false) {}
+
+boost::asio::mutable_buffer LineFramer::prepare() {
+   return boost::asio::mutable_buffer(buffer.data() + usedByteCount, buffer.size() - usedByteCount);
+}
+
+unsigned int LineFramer::commit(size_t byteCount, const LineConsumer& consumer) {
+   if (rawMode) {
+      consumer(std::string_view(buffer.data(), byteCount));
+      return 0;
+   }
+   
+   unsigned int discardedLineCount = 0;
+   size_t       searchStart        = usedByteCount;
+   size_t       lineStart          = 0;
+   
+   usedByteCount += byteCount;
+   
+   for (size_t index = searchStart; index < usedByteCount; index++) {
+      if (buffer[index] != '\n') {
+         continue;
+      }
+      if (discardingLine) {
+         discardingLine = false;
+      } else {
+         consumer(std::string_view(buffer.data() + lineStart, index - lineStart));
+      }
+      lineStart = index + 1;
+      
+      if (rawMode) {
+         if (lineStart < usedByteCount) {
+            consumer(std::string_view(buffer.data() + lineStart, usedByteCount - lineStart));
+         }
+         usedByteCount = 0;
+         return discardedLineCount;
+      }
+   }
+   
+   size_t remainingByteCount = usedByteCount - lineStart;
+   
+   if (discardingLine) {
+      remainingByteCount = 0;
+   } else if (remainingByteCount == buffer.size()) {
+      // the buffer is full but does not contain a complete line
+      discardedLineCount++;
+      discardingLine     = true;
+      remainingByteCount = 0;
+   } else if ((remainingByteCount > 0) && (lineStart > 0)) {
+      std::memmove(buffer.data(), buffer.data() + lineStart, remainingByteCount);
+   }
+   
+   usedByteCount = remainingByteCount;
+   return discardedLineCount;
+}
+
+void LineFramer::switchToRawMode() {
+   rawMode = true;
+}
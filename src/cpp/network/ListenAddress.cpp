@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <regex>
+#include <sstream>
+
+#include "ListenAddress.h"
+#include "Logging.h"
+
+using logging::Logger;
+using network::ListenAddress;
+
+ListenAddress ListenAddress::tcp(unsigned int port) {
+   return tcp(boost::asio::ip::address_v4::any(), port);
+}
+
+ListenAddress ListenAddress::tcp(const boost::asio::ip::address& ipAddress, unsigned int port) {
+   return ListenAddress{Type::TCP, port, std::string(), ipAddress};
+}
+
+ListenAddress ListenAddress::unixDomain(const std::string& path) {
+   return ListenAddress{Type::UNIX_DOMAIN, 0, path, boost::asio::ip::address()};
+}
+
+boost::asio::generic::stream_protocol::endpoint ListenAddress::toEndpoint() const {
+   if (type == Type::UNIX_DOMAIN) {
+      return boost::asio::local::stream_protocol::endpoint(path);
+   }
+   return boost::asio::ip::tcp::endpoint(ipAddress, port);
+}
+
+std::string ListenAddress::toString() const {
+   if (type == Type::UNIX_DOMAIN) {
+      return std::string("unix:").append(path);
+   }
+   if (ipAddress == boost::asio::ip::address(boost::asio::ip::address_v4::any())) {
+      return std::string("tcp:").append(std::to_string(port));
+   }
+   if (ipAddress.is_v6()) {
+      return std::string("tcp:[").append(ipAddress.to_string()).append("]:").append(std::to_string(port));
+   }
+   return std::string("tcp:").append(ipAddress.to_string()).append(":").append(std::to_string(port));
+}
+
+bool ListenAddress::parse(const std::string& text, ListenAddress& address) {
+   const std::regex tcpRegex("\\s*tcp:(?:(\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}):"   // IPv4 address
+                             "|\\[([0-9a-fA-F:.]+)\\]:)?"                                // IPv6 address
+                             "(\\d{1,5})\\s*");
+   const std::regex unixRegex("\\s*unix:(\\S+)\\s*");
+   std::smatch      captureGroups;
+   
+   if (std::regex_match(text, captureGroups, unixRegex)) {
+      address = unixDomain(captureGroups[1].str());
+      return true;
+   }
+   if (!std::regex_match(text, captureGroups, tcpRegex)) {
+      return false;
+   }
+   int port = std::stoi(captureGroups[3].str());
+   if ((port < 1) || (port > 65535)) {
+      return false;
+   }
+   boost::system::error_code error;
+   boost::asio::ip::address  ipAddress = boost::asio::ip::address_v4::any();
+   if (captureGroups[1].matched) {
+      ipAddress = boost::asio::ip::make_address_v4(captureGroups[1].str(), error);
+   } else if (captureGroups[2].matched) {
+      ipAddress = boost::asio::ip::make_address_v6(captureGroups[2].str(), error);
+   }
+   if (error) {
+      return false;
+   }
+   address = tcp(ipAddress, port);
+   return true;
+}
+
+std::vector<ListenAddress> ListenAddress::fromEnvironment(const char* envVarName, unsigned int defaultTcpPort) {
+   Logger                     log("ListenAddress");
+   std::vector<ListenAddress> addresses;
+   char*                      envVar = std::getenv(envVarName);
+   
+   if (envVar != nullptr) {
+      std::istringstream input(envVar);
+      std::string        entry;
+      
+      while (std::getline(input, entry, ',')) {
+         ListenAddress address;
+         if (parse(entry, address)) {
+            addresses.push_back(address);
+         } else {
+            log.warning("ignoring invalid address", entry, "in env var", envVarName);
+         }
+      }
+   }
+   
+   if (addresses.empty()) {
+      addresses.push_back(tcp(defaultTcpPort));
+   }
+   return addresses;
+}
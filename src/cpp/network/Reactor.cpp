@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <regex>
+#include <string>
+
+#include "Reactor.h"
+
+#define DEFAULT_THREAD_COUNT   2
+#define MAX_THREAD_COUNT       16
+
+using logging::Logger;
+using network::Reactor;
+
+Reactor& Reactor::get() {
+   static Reactor reactor(getConfiguredThreadCount());
+   return reactor;
+}
+
+unsigned int Reactor::getConfiguredThreadCount() {
+   Logger log("Reactor");
+   char* threadsEnvVar = std::getenv("OCTOWATCH_NETWORK_THREADS");
+   
+   if (threadsEnvVar == nullptr) {
+      return DEFAULT_THREAD_COUNT;
+   }
+   
+   std::string inputText(threadsEnvVar);
+   const std::regex regex("\\s*(\\d+)\\s*");
+   std::smatch captureGroups;
+   if (std::regex_match(inputText, captureGroups, regex) && (captureGroups.size() >= 2)) {
+      int threadCount = std::stoi(captureGroups[1].str());
+      if ((threadCount >= 1) && (threadCount <= MAX_THREAD_COUNT)) {
+         return threadCount;
+      }
+      log.warning("ignoring thread count requested via env var because it's out of range [1,", 
+                  MAX_THREAD_COUNT, "].");
+   } else {
+      log.warning("ignoring thread count requested via env var because it's not an integer.");
+   }
+   return DEFAULT_THREAD_COUNT;
+}
+
+Reactor::Reactor(unsigned int threadCount) 
+   : log("Reactor"),
+     ioContext(threadCount),
+     workGuard(ioContext.get_executor()) {
+   
+#if defined(BOOST_ASIO_HAS_IO_URING_AS_DEFAULT)
+   log.info("starting", threadCount, "thread(s) using io_uring");
+#else
+   log.info("starting", threadCount, "thread(s) using epoll");
+#endif
+   for (unsigned int index = 0; index < threadCount; index++) {
+      threads.emplace_back([this]() {
+         ioContext.run();
+      });
+   }
+}
+
+Reactor::~Reactor() {
+   log.info("stopping");
+   workGuard.reset();
+   ioContext.stop();
+   for (auto& thread : threads) {
+      thread.join();
+   }
+   log.info("stopped");
+}
+
+boost::asio::io_context& Reactor::getIoContext() {
+   return ioContext;
+}
+
+unsigned int Reactor::getThreadCount() const {
+   return threads.size();
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+
+#include "SendQueue.h"
+
+using network::Frame;
+using network::SendQueue;
+using network::SendQueueLimits;
+using network::SendQueueStatistics;
+
+#define INITIAL_CAPACITY   32
+
+SendQueue::SendQueue(const SendQueueLimits& limits)
+   : limits(limits),
+     statistics(),
+     ringBuffer(std::min(limits.maxQueuedFrames, (size_t)INITIAL_CAPACITY) + 1),
+     head(0),
+     count(0) {}
+
+SendQueue::PushResult SendQueue::push(std::initializer_list<SharedBuffer> buffers, bool droppable) {
+   if (buffers.size() > MAX_FRAME_PART_COUNT) {
+      return PushResult::TOO_MANY_PARTS;
+   }
+
+   size_t size = 0;
+   for (auto& buffer : buffers) {
+      size += buffer.size();
+   }
+
+   if (exceedsLimits(size)) {
+      switch (limits.overflowPolicy) {
+         case OverflowPolicy::DISCONNECT:
+            statistics.droppedFrames++;
+            statistics.droppedBytes += size;
+            return PushResult::REJECTED;
+
+         case OverflowPolicy::DROP_NEWEST_FRAME:
+            if (droppable) {
+               statistics.droppedFrames++;
+               statistics.droppedBytes += size;
+               return PushResult::DROPPED;
+            }
+            break;
+
+         case OverflowPolicy::DROP_OLDEST_FRAME:
+            while (exceedsLimits(size) && dropOldestDroppableFrame()) {}
+            if (exceedsLimits(size) && droppable) {
+               statistics.droppedFrames++;
+               statistics.droppedBytes += size;
+               return PushResult::DROPPED;
+            }
+            break;
+      }
+   }
+
+   if (count == ringBuffer.size()) {
+      grow();
+   }
+
+   Frame& frame    = ringBuffer[(head + count) % ringBuffer.size()];
+   frame.partCount = 0;
+   frame.size      = size;
+   frame.droppable = droppable;
+   for (auto& buffer : buffers) {
+      frame.parts[frame.partCount++] = buffer;
+   }
+   count++;
+
+   statistics.queuedFrames++;
+   statistics.queuedBytes += size;
+   return PushResult::QUEUED;
+}
+
+void SendQueue::setLimits(const SendQueueLimits& newLimits) {
+   limits = newLimits;
+}
+
+const SendQueueLimits& SendQueue::getLimits() const {
+   return limits;
+}
+
+void SendQueue::recordDroppedFrame(size_t size) {
+   statistics.droppedFrames++;
+   statistics.droppedBytes += size;
+}
+
+bool SendQueue::empty() const {
+   return count == 0;
+}
+
+void SendQueue::pop(std::vector<SharedBuffer>& buffers) {
+   if (count == 0) {
+      return;
+   }
+
+   Frame& frame = ringBuffer[head];
+   for (unsigned int index = 0; index < frame.partCount; index++) {
+      buffers.push_back(std::move(frame.parts[index]));
+   }
+
+   statistics.sentFrames++;
+   statistics.sentBytes    += frame.size;
+   statistics.queuedFrames--;
+   statistics.queuedBytes  -= frame.size;
+
+   frame = Frame();
+   head  = (head + 1) % ringBuffer.size();
+   count--;
+}
+
+size_t SendQueue::popForWrite(std::vector<SharedBuffer>& buffers, size_t maxBytes, size_t maxBuffers) {
+   size_t byteCount   = 0;
+   size_t bufferCount = 0;
+   while (count > 0) {
+      const Frame& frame = ringBuffer[head];
+      if ((bufferCount > 0) &&
+          ((byteCount + frame.size > maxBytes) || (bufferCount + frame.partCount > maxBuffers))) {
+         break;
+      }
+      byteCount   += frame.size;
+      bufferCount += frame.partCount;
+      pop(buffers);
+   }
+   return byteCount;
+}
+
+size_t SendQueue::frontSize() const {
+   return (count == 0) ? 0 : ringBuffer[head].size;
+}
+
+unsigned int SendQueue::frontPartCount() const {
+   return (count == 0) ? 0 : ringBuffer[head].partCount;
+}
+
+void SendQueue::clear() {
+   while (count > 0) {
+      statistics.droppedFrames++;
+      statistics.droppedBytes += ringBuffer[head].size;
+      ringBuffer[head] = Frame();
+      head = (head + 1) % ringBuffer.size();
+      count--;
+   }
+   statistics.queuedFrames = 0;
+   statistics.queuedBytes  = 0;
+}
+
+size_t SendQueue::dropDroppableFrames() {
+   size_t capacity     = ringBuffer.size();
+   size_t keptCount    = 0;
+   size_t droppedBytes = 0;
+   for (size_t offset = 0; offset < count; offset++) {
+      Frame& frame = ringBuffer[(head + offset) % capacity];
+      if (frame.droppable) {
+         statistics.droppedFrames++;
+         statistics.droppedBytes += frame.size;
+         statistics.queuedFrames--;
+         statistics.queuedBytes  -= frame.size;
+         droppedBytes            += frame.size;
+         frame = Frame();
+         continue;
+      }
+      if (keptCount != offset) {
+         ringBuffer[(head + keptCount) % capacity] = std::move(frame);
+         frame = Frame();
+      }
+      keptCount++;
+   }
+   count = keptCount;
+   return droppedBytes;
+}
+
+const SendQueueStatistics& SendQueue::getStatistics() const {
+   return statistics;
+}
+
+bool SendQueue::exceedsLimits(size_t additionalBytes) const {
+   if (count == 0) {
+      return false;  // a single frame always fits to avoid starvation of large frames
+   }
+   return ((statistics.queuedBytes + additionalBytes) > limits.maxQueuedBytes) ||
+          ((statistics.queuedFrames + 1) > limits.maxQueuedFrames);
+}
+
+bool SendQueue::dropOldestDroppableFrame() {
+   size_t capacity = ringBuffer.size();
+   for (size_t offset = 0; offset < count; offset++) {
+      Frame& frame = ringBuffer[(head + offset) % capacity];
+      if (!frame.droppable) {
+         continue;
+      }
+
+      statistics.droppedFrames++;
+      statistics.droppedBytes += frame.size;
+      statistics.queuedFrames--;
+      statistics.queuedBytes  -= frame.size;
+
+      // close the gap by moving the older frames one position towards the end
+      for (size_t index = offset; index > 0; index--) {
+         ringBuffer[(head + index) % capacity] = std::move(ringBuffer[(head + index - 1) % capacity]);
+      }
+      ringBuffer[head] = Frame();
+      head = (head + 1) % capacity;
+      count--;
+      return true;
+   }
+   return false;
+}
+
+void SendQueue::grow() {
+   std::vector<Frame> biggerRingBuffer(ringBuffer.size() * 2);
+   for (size_t index = 0; index < count; index++) {
+      biggerRingBuffer[index] = std::move(ringBuffer[(head + index) % ringBuffer.size()]);
+   }
+   ringBuffer.swap(biggerRingBuffer);
+   head = 0;
+}
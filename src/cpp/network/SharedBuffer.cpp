@@ -0,0 +1,42 @@
+#include <cstring>
+
+#include "BufferPool.h"
+#include "SharedBuffer.h"
+
+using network::BufferPool;
+using network::SharedBuffer;
+
+SharedBuffer::SharedBuffer() : memory(), byteCount(0), pinnable(true) {}
+
+SharedBuffer::SharedBuffer(std::shared_ptr<const uint8_t> memory, size_t size, bool pinnable)
+   : memory(std::move(memory)), byteCount(size), pinnable(pinnable) {}
+
+SharedBuffer SharedBuffer::copyOf(const void *mem, size_t size) {
+   std::shared_ptr<uint8_t> copy = BufferPool::getDefault().allocate(size);
+   std::memcpy(copy.get(), mem, size);
+   return SharedBuffer(std::move(copy), size);
+}
+
+SharedBuffer SharedBuffer::copyOf(const std::string& text) {
+   return copyOf(text.data(), text.size());
+}
+
+SharedBuffer SharedBuffer::slice(size_t offset, size_t size) const {
+   return SharedBuffer(std::shared_ptr<const uint8_t>(memory, memory.get() + offset), size, pinnable);
+}
+
+const uint8_t* SharedBuffer::data() const {
+   return memory.get();
+}
+
+size_t SharedBuffer::size() const {
+   return byteCount;
+}
+
+bool SharedBuffer::isPinnable() const {
+   return pinnable;
+}
+
+boost::asio::const_buffer SharedBuffer::asAsioBuffer() const {
+   return boost::asio::const_buffer(memory.get(), byteCount);
+}
@@ -0,0 +1,85 @@
+#include <cerrno>
+#include <cstring>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "SocketOptions.h"
+
+#define USER_TIMEOUT_MS              10000
+#define KEEPALIVE_IDLE_SECONDS       10
+#define KEEPALIVE_INTERVAL_SECONDS   5
+#define KEEPALIVE_PROBE_COUNT        3
+#define INTERACTIVE_PRIORITY         6   // TC_PRIO_INTERACTIVE
+
+#define STREAMING_SEND_BUFFER_SIZE   (1024 * 1024)
+#define STREAMING_NOTSENT_LOWAT      (128 * 1024)
+
+using logging::Logger;
+using network::SocketOptions;
+
+static void setIntOption(int fd, int level, int option, int value, const char* optionName, Logger& log) {
+   if (setsockopt(fd, level, option, &value, sizeof(value)) != 0) {
+      log.warning("failed to set socket option", optionName, "to", value, ":", std::strerror(errno));
+   }
+}
+
+SocketOptions SocketOptions::lowLatencyProfile() {
+   SocketOptions options;
+   options.noDelay                  = true;
+   options.userTimeoutMs            = USER_TIMEOUT_MS;
+   options.keepAlive                = true;
+   options.keepAliveIdleSeconds     = KEEPALIVE_IDLE_SECONDS;
+   options.keepAliveIntervalSeconds = KEEPALIVE_INTERVAL_SECONDS;
+   options.keepAliveProbeCount      = KEEPALIVE_PROBE_COUNT;
+   options.priority                 = INTERACTIVE_PRIORITY;
+   return options;
+}
+
+SocketOptions SocketOptions::streamingProfile() {
+   SocketOptions options;
+   options.noDelay             = true;
+   options.sendBufferSize      = STREAMING_SEND_BUFFER_SIZE;
+   options.notSentLowWatermark = STREAMING_NOTSENT_LOWAT;
+   options.userTimeoutMs       = USER_TIMEOUT_MS;
+   return options;
+}
+
+void SocketOptions::applyTo(boost::asio::generic::stream_protocol::socket& socket, Logger& log) const {
+   int fd = socket.native_handle();
+   
+   if (sendBufferSize > 0) {
+      setIntOption(fd, SOL_SOCKET, SO_SNDBUF, sendBufferSize, "SO_SNDBUF", log);
+   }
+   
+   boost::system::error_code error;
+   if (socket.local_endpoint(error).protocol().family() == AF_UNIX) {
+      return;
+   }
+   
+   if (noDelay) {
+      setIntOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", log);
+   }
+   if (notSentLowWatermark > 0) {
+      setIntOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, notSentLowWatermark, "TCP_NOTSENT_LOWAT", log);
+   }
+   if (priority > 0) {
+      setIntOption(fd, SOL_SOCKET, SO_PRIORITY, priority, "SO_PRIORITY", log);
+   }
+   if (userTimeoutMs > 0) {
+      setIntOption(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, userTimeoutMs, "TCP_USER_TIMEOUT", log);
+   }
+   if (keepAlive) {
+      setIntOption(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE", log);
+      if (keepAliveIdleSeconds > 0) {
+         setIntOption(fd, IPPROTO_TCP, TCP_KEEPIDLE, keepAliveIdleSeconds, "TCP_KEEPIDLE", log);
+      }
+      if (keepAliveIntervalSeconds > 0) {
+         setIntOption(fd, IPPROTO_TCP, TCP_KEEPINTVL, keepAliveIntervalSeconds, "TCP_KEEPINTVL", log);
+      }
+      if (keepAliveProbeCount > 0) {
+         setIntOption(fd, IPPROTO_TCP, TCP_KEEPCNT, keepAliveProbeCount, "TCP_KEEPCNT", log);
+      }
+   }
+}
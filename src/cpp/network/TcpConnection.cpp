@@ -1,239 +1,573 @@
+#include <cerrno>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <thread>
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+
 #include "TcpServer.h"
 
 using network::Connection;
+using network::EgressBudget;
+using network::EgressScheduler;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SharedBuffer;
 using network::TcpConnection;
 using network::TcpServer;
+using network::TransportStatistics;
+using network::ZeroCopyStatistics;
 using logging::Logger;
 
 using namespace std::chrono_literals;
 
+// time the peer gets to close the connection after all data got sent (see closeAfterSending)
+#define LINGER_TIMEOUT   3s
+
+// time the zero-copy sends get to complete after closing the connection
+#define ZERO_COPY_TIMEOUT   3s
+
 int TcpConnection::getNextConnectionId() {
-   static int nextConnectionId = 1;
-   int idToReturn              = nextConnectionId;
-   nextConnectionId            = (nextConnectionId + 1) % 1000;
-   return idToReturn;
+   static std::atomic<int> nextConnectionId(1);
+   return nextConnectionId++;
 }
 
-std::unique_ptr<TcpConnection> TcpConnection::create(
-   boost::asio::io_context& ioContext, const std::string& name) {
-   return std::unique_ptr<TcpConnection>(new TcpConnection(ioContext, name));
+std::shared_ptr<TcpConnection> TcpConnection::create(
+   boost::asio::io_context& ioContext, const std::string& name, const ConnectionSettings& settings) {
+   return std::shared_ptr<TcpConnection>(new TcpConnection(ioContext, name, settings));
 }
 
-boost::asio::ip::tcp::socket& TcpConnection::getSocket() {
+network::Socket& TcpConnection::getSocket() {
    return socket;
 }
 
-void TcpConnection::start( std::function<void()> connectionClosedCallback, 
-                           std::function<void(const std::string&)> commandConsumer) {
+int TcpConnection::getId() const {
+   return id;
+}
+
+void TcpConnection::start( std::function<void(int)> connectionClosedCallback, 
+                           std::function<void(int, std::string_view)> commandConsumer) {
    log.info("starting ...");						   
+   settings.socketOptions.applyTo(socket, log);
+   if (settings.zeroCopyThreshold > 0) {
+      zeroCopySender.enable(socket.native_handle());
+   }
    this->connectionClosedCallback = connectionClosedCallback;
    this->commandConsumer          = commandConsumer;
    started                        = true;
-   readNextLine();
+   boost::asio::post(strand, std::bind(&TcpConnection::readIncomingData, shared_from_this()));
+   boost::asio::post(strand, std::bind(&TcpConnection::sendQueuedData, shared_from_this()));
 }
 
-TcpConnection::TcpConnection( boost::asio::io_context& ioContext, const std::string& name) 
-   :  log((std::string("TcpConnection-").append(name).append("-").append(std::to_string(TcpConnection::getNextConnectionId()))).c_str()), 
-      ioContext(ioContext),
+TcpConnection::TcpConnection( boost::asio::io_context& ioContext, const std::string& name,
+                              const ConnectionSettings& settings) 
+   :  id(TcpConnection::getNextConnectionId()),
+      log((std::string("TcpConnection-").append(name).append("-").append(std::to_string(id))).c_str()), 
+      strand(boost::asio::make_strand(ioContext)),
+      settings(settings),
       pendingOutputByteCount(0), 
+      writeInProgress(false),
 	  started(false),
       closed(false),
-	  connectionLost(false),
-      socket(ioContext),
-      readBuffer(),      
-      writeBuffer(boost::asio::const_buffer())
+      socket(strand),
+      closeWhenSent(false),
+      sendingShutDown(false),
+      lingerTimer(strand),
+      lineFramer(settings.maxLineLength),
+      writeBuffers(),
+      writeBufferSequence(),
+      sendQueue(settings.sendQueueLimits),
+      egressStream(settings.egressStream),
+      egressBudget(settings.egressStream.empty() ? EgressScheduler::get().createControlBudget() 
+                                                 : EgressScheduler::get().createStreamBudget(settings.egressStream)),
+      zeroCopySender(log),
+      zeroCopyByteCount(0),
+      zeroCopyOffset(0),
+      waitingForZeroCopyCompletions(false)
       {
 		  log.info("creating ...");					   
 	  }
 
 TcpConnection::~TcpConnection() {
-   close();
+   log.info("destroying ...");
 }
 
 void TcpConnection::sendQueuedData() {
-   if (!started || closed || connectionLost) {
+   if (!started || closed) {
       return;
    }
    
    size_t byteCountToSend = 0;
+   bool   pinnable        = true;   // all buffers of the write
    {
       const std::lock_guard<std::mutex> lock(mutex);
-      if (pendingOutputByteCount > 0) {
+      if (writeInProgress) {
          return;     // waiting for invocation of onWriteComplete
-      } else {
-         if (writeBuffer.size() > 0) {
-            std::free((void*)writeBuffer.data()); // necessary because the buffer does not own the data
-            writeBuffer = boost::asio::const_buffer();
-         }
       }
       
       if (sendQueue.empty()) {
+         if (closeWhenSent) {
+            boost::asio::post(strand, std::bind(&TcpConnection::shutDownSending, shared_from_this()));
+         }
          return;
       }
       
-      auto front = sendQueue.front();
-      writeBuffer = std::move(front);
-      sendQueue.pop();
-      byteCountToSend = writeBuffer.size();
+      // Gathering the queued frames into one buffer sequence allows the socket 
+      // to send them with a single system call (e.g. header, JPEG and trailer of
+      // a MPJPEG frame). Frames never get split.
+      byteCountToSend = sendQueue.popForWrite(writeBuffers, settings.maxBytesPerWrite, settings.maxBuffersPerWrite);
+      for (auto& buffer : writeBuffers) {
+         writeBufferSequence.push_back(buffer.asAsioBuffer());
+         pinnable = pinnable && buffer.isPinnable();
+      }
+      
       pendingOutputByteCount += byteCountToSend;
+      writeInProgress         = true;
    }
-   log.debug("enqueuing", byteCountToSend, "bytes for sending -> pending byte count:", pendingOutputByteCount);
-   boost::asio::async_write(socket, writeBuffer, std::bind(&TcpConnection::onWriteComplete, 
-         this, std::placeholders::_1, std::placeholders::_2));
+   log.debug("enqueuing", byteCountToSend, "bytes in", writeBufferSequence.size(), 
+             "buffer(s) for sending -> pending byte count:", pendingOutputByteCount);
+   
+   if (zeroCopySender.isEnabled() && pinnable && (byteCountToSend >= settings.zeroCopyThreshold)) {
+      zeroCopyByteCount = byteCountToSend;
+      zeroCopyOffset    = 0;
+      writeZeroCopy();
+      return;
+   }
+   boost::asio::async_write(socket, writeBufferSequence, std::bind(&TcpConnection::onWriteComplete, 
+         shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 }
 
-void TcpConnection::send(boost::asio::const_buffer& buffer) {
+void TcpConnection::writeZeroCopy() {
+   while (zeroCopyOffset < zeroCopyByteCount) {
+      ssize_t sentByteCount = zeroCopySender.send(socket.native_handle(), writeBufferSequence, zeroCopyOffset);
+      if (sentByteCount < 0) {
+         int errorNumber = errno;
+         if ((errorNumber == EAGAIN) || (errorNumber == EWOULDBLOCK) || (errorNumber == EINTR)) {
+            socket.async_wait(Socket::wait_write, 
+               std::bind(&TcpConnection::onWritableForZeroCopy, shared_from_this(), std::placeholders::_1));
+            return;
+         }
+         finishZeroCopyWrite(boost::system::error_code(errorNumber, boost::system::system_category()), 
+                             zeroCopyOffset);
+         return;
+      }
+      zeroCopyOffset += sentByteCount;
+   }
+   finishZeroCopyWrite(boost::system::error_code(), zeroCopyByteCount);
+}
+
+void TcpConnection::onWritableForZeroCopy(const boost::system::error_code& error) {
+   if (error || closed) {
+      finishZeroCopyWrite(error, zeroCopyOffset);
+      return;
+   }
+   writeZeroCopy();
+}
+
+void TcpConnection::finishZeroCopyWrite(const boost::system::error_code& error, size_t bytesTransferred) {
    {
+      // The kernel might still read the memory of the bytes sent so far (also 
+      // if a later send call failed) -> keep the buffers until it's done.
       const std::lock_guard<std::mutex> lock(mutex);
-      sendQueue.push(std::move(buffer));
+      zeroCopySender.retain(writeBuffers);
    }
-   sendQueuedData();
+   waitForZeroCopyCompletions();
+   onWriteComplete(error, bytesTransferred);
 }
 
-void TcpConnection::asyncSend(const std::string& message) {
-   if (!started || closed || connectionLost) {
+void TcpConnection::waitForZeroCopyCompletions() {
+   // Completions that arrived while not waiting would not trigger the (edge 
+   // triggered) wait, therefore the error queue gets read before waiting.
+   zeroCopySender.processCompletions(socket.native_handle());
+   if (closed && socket.is_open() && !zeroCopySender.hasIncompleteSends()) {
+      log.debug("zero-copy sends completed after closing");
+      releaseSocket(false);
+      return;
+   }
+   if (!socket.is_open() || waitingForZeroCopyCompletions || !zeroCopySender.hasIncompleteSends()) {
       return;
    }
+   waitingForZeroCopyCompletions = true;
+   socket.async_wait(Socket::wait_error, 
+      std::bind(&TcpConnection::onZeroCopyCompletionsAvailable, shared_from_this(), std::placeholders::_1));
+}
+
+void TcpConnection::onZeroCopyCompletionsAvailable(const boost::system::error_code& error) {
+   waitingForZeroCopyCompletions = false;
+   if (error || !socket.is_open()) {
+      return;
+   }
+   waitForZeroCopyCompletions();
+}
+
+void TcpConnection::send(std::initializer_list<SharedBuffer> parts, bool droppable) {
+   if (parts.size() > MAX_FRAME_PART_COUNT) {
+      // checked before the egress budget gets charged for it
+      log.error("frame consists of", parts.size(), "parts (max.", MAX_FRAME_PART_COUNT, ") -> not sent");
+      return;
+   }
+   
+   size_t size = 0;
+   for (auto& part : parts) {
+      size += part.size();
+   }
    
-   std::size_t charCount   = message.size();
-   std::size_t sizeInBytes = charCount * sizeof(char);
-   void* messageCopy       = std::malloc(sizeInBytes);
+   SendQueue::PushResult result;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (closeWhenSent) {
+         log.debug("closing after sending the queued data -> discarded frame");
+         return;
+      }
+      if (!droppable || (sendQueue.getLimits().overflowPolicy == OverflowPolicy::DISCONNECT)) {
+         egressBudget->account(size);
+         result = sendQueue.push(parts, droppable);
+      } else if (egressBudget->admit(size)) {
+         result = sendQueue.push(parts, droppable);
+      } else {
+         sendQueue.recordDroppedFrame(size);
+         log.debug("egress budget exceeded -> dropped frame");
+         return;
+      }
+   }
+   switch (result) {
+      case SendQueue::PushResult::QUEUED:
+         boost::asio::post(strand, std::bind(&TcpConnection::sendQueuedData, shared_from_this()));
+         break;
+      case SendQueue::PushResult::DROPPED:
+         log.debug("send queue full -> dropped frame");
+         break;
+      case SendQueue::PushResult::REJECTED:
+         log.warning("send queue full -> closing connection");
+         close();
+         break;
+      case SendQueue::PushResult::TOO_MANY_PARTS:
+         break;   // checked above
+   }
+}
+
+void TcpConnection::asyncSend(const std::string& message) {
+   if (closed) {
+      return;
+   }
    
-   std::memcpy(messageCopy, (void*)message.c_str(), sizeInBytes);
-   auto buffer = boost::asio::const_buffer(std::move(boost::asio::buffer(messageCopy, charCount)));
-   send(buffer);
+   send({SharedBuffer::copyOf(message)}, false);
 }   
 
 void TcpConnection::asyncSend(void *mem, size_t size) {
-   if (!started || closed || connectionLost) {
+   if (closed) {
       return;
    }
    
-   void* dataCopy = std::malloc(size);
-   std::memcpy(dataCopy, mem, size);
-   
-   auto buffer = boost::asio::const_buffer(std::move(boost::asio::buffer(dataCopy, size)));
-   send(buffer);
+   send({SharedBuffer::copyOf(mem, size)}, false);
 }
 
 void TcpConnection::asyncSendAndFree(void *mem, size_t size) {
-   if (!started || closed || connectionLost) {
+   if (closed) {
       return;
    }
    
-   auto buffer = boost::asio::const_buffer(std::move(boost::asio::buffer(mem, size)));
-   send(buffer);
+   std::shared_ptr<const uint8_t> memory((const uint8_t*)mem, [](const uint8_t* data) { 
+      std::free((void*)data); 
+   });
+   send({SharedBuffer(memory, size)}, false);
+}
+
+void TcpConnection::asyncSend(const SharedBuffer& buffer) {
+   if (closed) {
+      return;
+   }
+   
+   send({buffer}, false);
+}
+
+void TcpConnection::asyncSendFrame(std::initializer_list<SharedBuffer> parts) {
+   if (closed) {
+      return;
+   }
+   
+   send(parts, true);
+}
+
+void TcpConnection::asyncSendFileDescriptor(int fileDescriptor, const std::string& message) {
+   if (closed) {
+      return;
+   }
+   
+   boost::asio::post(strand, std::bind(&TcpConnection::sendFileDescriptor, shared_from_this(), 
+                                       fileDescriptor, message));
+}
+
+void TcpConnection::sendFileDescriptor(int fileDescriptor, const std::string& message) {
+   if (closed) {
+      return;
+   }
+   
+   struct iovec iov;
+   iov.iov_base = (void*)message.data();
+   iov.iov_len  = message.size();
+   
+   union {
+      char           buffer[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr alignment;
+   } control;
+   std::memset(&control, 0, sizeof(control));
+   
+   struct msghdr msg;
+   std::memset(&msg, 0, sizeof(msg));
+   msg.msg_iov        = &iov;
+   msg.msg_iovlen     = 1;
+   msg.msg_control    = control.buffer;
+   msg.msg_controllen = sizeof(control.buffer);
+   
+   struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level     = SOL_SOCKET;
+   cmsg->cmsg_type      = SCM_RIGHTS;
+   cmsg->cmsg_len       = CMSG_LEN(sizeof(int));
+   std::memcpy(CMSG_DATA(cmsg), &fileDescriptor, sizeof(int));
+   
+   if (sendmsg(socket.native_handle(), &msg, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)message.size()) {
+      log.error("failed to send file descriptor:", std::strerror(errno));
+      closeSocket();
+   }
 }
 
 bool TcpConnection::outputBufferEmpty() {
    const std::lock_guard<std::mutex> lock(mutex);
-   return ((sendQueue.size() <= 0) && (pendingOutputByteCount <= 0));
+   return (sendQueue.empty() && (pendingOutputByteCount <= 0));
+}
+
+bool TcpConnection::getRemoteIpAddress(boost::asio::ip::address& address) {
+   // getpeername instead of remote_endpoint because the socket belongs to the strand
+   struct sockaddr_storage peer;
+   socklen_t               peerLength = sizeof(peer);
+   if (getpeername(socket.native_handle(), (struct sockaddr*)&peer, &peerLength) != 0) {
+      return false;
+   }
+   
+   if (peer.ss_family == AF_INET) {
+      const struct sockaddr_in* ipv4 = (const struct sockaddr_in*)&peer;
+      address = boost::asio::ip::address_v4(ntohl(ipv4->sin_addr.s_addr));
+      return true;
+   }
+   
+   if (peer.ss_family == AF_INET6) {
+      const struct sockaddr_in6* ipv6 = (const struct sockaddr_in6*)&peer;
+      boost::asio::ip::address_v6::bytes_type bytes;
+      std::memcpy(bytes.data(), ipv6->sin6_addr.s6_addr, bytes.size());
+      address = boost::asio::ip::address_v6(bytes, ipv6->sin6_scope_id);
+      return true;
+   }
+   
+   return false;
+}
+
+void TcpConnection::switchToRawInput() {
+   // called on the strand (by the commandConsumer), which owns the line framer
+   lineFramer.switchToRawMode();
+}
+
+network::SendQueueStatistics TcpConnection::getSendQueueStatistics() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return sendQueue.getStatistics();
+}
+
+size_t TcpConnection::discardQueuedFrames() {
+   const std::lock_guard<std::mutex> lock(mutex);
+   return sendQueue.dropDroppableFrames();
+}
+
+bool TcpConnection::getTransportStatistics(TransportStatistics& statistics) {
+   // like getRemoteIpAddress, reading the state does not interfere with the strand
+   return TransportStatistics::read(socket.native_handle(), statistics);
+}
+
+void TcpConnection::setSendQueueLimits(const SendQueueLimits& limits) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   sendQueue.setLimits(limits);
+}
+
+void TcpConnection::setEgressStream(const std::string& streamName) {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (streamName == egressStream) {
+         return;
+      }
+   }
+   std::shared_ptr<EgressBudget> budget = streamName.empty() ? EgressScheduler::get().createControlBudget() 
+                                                             : EgressScheduler::get().createStreamBudget(streamName);
+   const std::lock_guard<std::mutex> lock(mutex);
+   egressStream = streamName;
+   egressBudget = budget;
+}
+
+void TcpConnection::closeAfterSending() {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      closeWhenSent = true;
+   }
+   boost::asio::post(strand, std::bind(&TcpConnection::sendQueuedData, shared_from_this()));
+}
+
+void TcpConnection::shutDownSending() {
+   if (closed || sendingShutDown) {
+      return;
+   }
+   
+   sendingShutDown = true;
+   log.info("all data sent -> shutting down sending");
+   boost::system::error_code error;
+   socket.shutdown(Socket::shutdown_send, error);
+   if (error) {
+      log.info("failed to shut down sending:", error.message());
+      closeSocket();
+      return;
+   }
+   // The peer sees the end of the stream and closes the connection (the 
+   // reading continues until then). A peer that doesn't gets disconnected.
+   lingerTimer.expires_after(LINGER_TIMEOUT);
+   lingerTimer.async_wait(std::bind(&TcpConnection::onLingerTimeout, shared_from_this(), std::placeholders::_1));
+}
+
+void TcpConnection::onLingerTimeout(const boost::system::error_code& error) {
+   if (error || closed) {
+      return;
+   }
+   log.info("peer did not close the connection -> closing it");
+   closeSocket();
 }
 
 void TcpConnection::close() {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      sendQueue.clear();
+   }
+   boost::asio::post(strand, std::bind(&TcpConnection::closeSocket, shared_from_this()));
+}
+
+void TcpConnection::closeSocket() {
    if (closed) {
       return;
    }
    
    closed = true;
+   lingerTimer.cancel();
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      sendQueue.clear();
+   }
+   if (zeroCopySender.getStatistics().zeroCopySends > 0) {
+      const ZeroCopyStatistics& statistics = zeroCopySender.getStatistics();
+      log.info("zero-copy sends:", statistics.zeroCopySends, ", copied by kernel:", statistics.copiedByKernel);
+   }
+   
+   zeroCopySender.processCompletions(socket.native_handle());
+   if (socket.is_open() && zeroCopySender.hasIncompleteSends()) {
+      // Closing the socket does not stop the kernel from sending the data it
+      // has not sent yet, it keeps reading the memory of the zero-copy sends
+      // -> the socket gets closed when they completed.
+      log.info("closing socket after the zero-copy sends completed");
+      boost::system::error_code error;
+      socket.shutdown(Socket::shutdown_both, error);
+      lingerTimer.expires_after(ZERO_COPY_TIMEOUT);
+      lingerTimer.async_wait(std::bind(&TcpConnection::onZeroCopyTimeout, shared_from_this(), 
+                                       std::placeholders::_1));
+      waitForZeroCopyCompletions();
+   } else {
+      releaseSocket(false);
+   }
+   
+   if (connectionClosedCallback) {
+      connectionClosedCallback(id);
+   }
+}
+
+void TcpConnection::releaseSocket(bool discardUnsentData) {
+   lingerTimer.cancel();
    if (socket.is_open()) {
       log.info("closing socket");
-      socket.close();
-   }
-   if (!ioContext.stopped()) {
-      log.info("stopping ioContext");
-      ioContext.stop();
-      log.info("waiting for boost::asio::io_context to stop");
-      int repetitions = 30;
-      while((repetitions > 0) && !ioContext.stopped()) {
-         std::this_thread::sleep_for(100ms);
-         repetitions--;
-      }
-      if (ioContext.stopped()) {
-         log.info("boost::asio::io_context stopped");
-      } else {
-         log.error("waiting for termination of boost::asio::io_context timed out");
+      boost::system::error_code error;
+      if (discardUnsentData) {
+         // the reset purges the send queue of the socket
+         socket.set_option(boost::asio::socket_base::linger(true, 0), error);
       }
+      socket.close(error);
    }
-   connectionClosedCallback();
+   zeroCopySender.clear();
+}
+
+void TcpConnection::onZeroCopyTimeout(const boost::system::error_code& error) {
+   if (error || !socket.is_open()) {
+      return;
+   }
+   log.warning("zero-copy sends did not complete after closing -> discarding the unsent data");
+   releaseSocket(true);
 }
 
 void TcpConnection::onWriteComplete(const boost::system::error_code& error, 
                                     size_t bytes_transferred) {
-   if (connectionLost) {
-      log.info("ignoring write complete information because connection got lost");
-      return;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      pendingOutputByteCount = 0;
+      writeInProgress        = false;
+      writeBufferSequence.clear();
+      writeBuffers.clear(); // informs the owners that the memory is no longer needed
    }
-   if (!started) {
-      log.info("ignoring write complete information because connection not started");
+   
+   if (closed) {
+      log.info("ignoring write complete information because connection got closed");
       return;
    }
    if (error) {
-      connectionLost = true;
       log.error("failed to write:", error.message());
-      close();
+      closeSocket();
       return;
    }
    
-   bool allBytesSent = false;
-   
-   {
-      const std::lock_guard<std::mutex> lock(mutex);
-      pendingOutputByteCount = std::max((size_t)0, pendingOutputByteCount - bytes_transferred);
-      allBytesSent           = pendingOutputByteCount == 0;
-   }
-   
-   log.debug("bytes transferred:", bytes_transferred, ", pending bytes:", pendingOutputByteCount);
-   
-   if (allBytesSent) {
-      sendQueuedData();
-   }
+   log.debug("bytes transferred:", bytes_transferred);
+   sendQueuedData();
 }
 
-void TcpConnection::readNextLine() {
-   if (connectionLost) {
-      log.info("ignoring request to read next line because connection got lost");
+void TcpConnection::readIncomingData() {
+   if (closed) {
+      log.info("ignoring request to read incoming data because connection got closed");
       return;
    }
-   log.debug("starting to read next line");
-   boost::asio::async_read_until(socket, readBuffer, "\n",
-      std::bind(&TcpConnection::onReadLineComplete, this, 
+   log.debug("starting to read incoming data");
+   socket.async_read_some(lineFramer.prepare(),
+      std::bind(&TcpConnection::onReadComplete, shared_from_this(), 
                   std::placeholders::_1, std::placeholders::_2));
 }      
   
-void TcpConnection::onReadLineComplete(const boost::system::error_code& error, 
-                                       size_t bytes_transferred) {
-   if (connectionLost) {
-      log.info("ignoring read line because connection got lost");
+void TcpConnection::onReadComplete(const boost::system::error_code& error, 
+                                   size_t bytes_transferred) {
+   if (closed) {
+      log.info("ignoring received data because connection got closed");
       return;
    }
-   if (!started) {
-      log.info("ignoring read complete information because connection not started");
-      return;
-   }   
    if (error == boost::asio::error::operation_aborted) {
       log.info("operation aborted");
       return;
    }
    
    if (error) {
-      connectionLost = true;
-      log.error("failed to read:", error.message());
-      close();
+      if (error == boost::asio::error::eof) {
+         log.info("connection closed by peer");
+      } else {
+         log.error("failed to read:", error.message());
+      }
+      closeSocket();
    } else {
-      std::istream is(&readBuffer);
-      char* line = new char[bytes_transferred];
-      is.read(line, bytes_transferred);
-      line[bytes_transferred - 1] = 0x00;
-      std::string command = line;
-      log.debug("received", bytes_transferred,"bytes:", command);
-      commandConsumer(command);
-      readNextLine();
+      log.debug("received", bytes_transferred, "bytes");
+      unsigned int discardedLineCount = lineFramer.commit(bytes_transferred, [this](std::string_view line) {
+         commandConsumer(id, line);
+      });
+      if (discardedLineCount > 0) {
+         log.warning("discarded", discardedLineCount, "line(s) longer than", settings.maxLineLength, "bytes");
+      }
+      readIncomingData();
    }
 }
 
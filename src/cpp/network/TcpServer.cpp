@@ -4,115 +4,176 @@
 #include <sstream>
 #include <thread>
 
+#include <unistd.h>
+
 #include "TcpServer.h"
 
 using network::Connection;
+using network::ListenAddress;
+using network::Reactor;
 using network::TcpConnection;
 using network::TcpServer;
 using logging::Logger;
 
 using namespace std::chrono_literals;
 
-TcpServer::TcpServer(unsigned int port, const std::string& name, TcpServer::Listener& tcpServerListener)
+TcpServer::TcpServer(const std::vector<ListenAddress>& addresses, const std::string& name, 
+                     TcpServer::Listener& tcpServerListener, unsigned int maxConnections, 
+                     const ConnectionSettings& connectionSettings)
  : log((std::string("TcpServer-").append(name)).c_str()),
    name(name),
-   port(port), 
+   addresses(addresses), 
+   maxConnections(maxConnections),
+   connectionSettings(connectionSettings),
    stopped(false),
-   listener(tcpServerListener) {}
+   pendingAcceptCount(0),
+   openConnectionCount(0),
+   listener(tcpServerListener),
+   ioContext(Reactor::get().getIoContext()),
+   strand(boost::asio::make_strand(ioContext)) {}
 
 TcpServer::~TcpServer() {
    stop();
-   if (thread) {
-      log.info("waiting for thread to finish its execution");
-      thread->join();
-      log.info("thread finished");
-   }
 }
 
 void TcpServer::start() {
-   ioContext.reset(new boost::asio::io_context());
-   acceptor.reset(new boost::asio::ip::tcp::acceptor(*ioContext, 
-                           boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port))); 
+   for (auto& address : addresses) {
+      if (address.type == ListenAddress::Type::UNIX_DOMAIN) {
+         // a socket file left behind by a previous run would make bind fail
+         ::unlink(address.path.c_str());
+         try {
+            listeningSockets.push_back({address, std::unique_ptr<Acceptor>(new Acceptor(strand, address.toEndpoint())), false});
+         } catch (const boost::system::system_error& e) {
+            log.error("failed to listen on", address.toString(), ":", e.what());
+            continue;
+         }
+      } else {
+         listeningSockets.push_back({address, std::unique_ptr<Acceptor>(new Acceptor(strand, address.toEndpoint())), false});
+      }
+      log.info("listening on", address.toString(), "( max.", maxConnections, "connection(s) )");
+   }
    
    stopped = false;
    
-   thread = std::unique_ptr<std::thread>(new std::thread([this](){
-      while(!stopped) {
-         std::unique_ptr<TcpConnection> newConnection = TcpConnection::create(*ioContext, name);
-         auto callback = [this, &newConnection](const boost::system::error_code& error){
-            handle_accept(std::move(newConnection), error);
-         };
-         log.info("listening on port", port);
-         acceptor->async_accept(newConnection->getSocket(), callback);
-         log.info("running ioContext");
-         ioContext->run();
-         log.info("finished running ioContext");
-         if (!stopped) {
-            log.info("restarting ioContext");
-            ioContext->restart();
-         }
-      }
-      log.info("left loop for accepting incoming connections");
-   }));
+   boost::asio::post(strand, [this]() {
+      const std::lock_guard<std::mutex> lock(stateMutex);
+      startAccepting();
+   });
 }
 
 void TcpServer::stop() {
-   if (stopped) {
+   if (stopped || listeningSockets.empty()) {
       return;
    }
    
    stopped = true;
    log.info("stopping");
+   boost::asio::post(strand, std::bind(&TcpServer::closeAcceptorAndConnections, this));
    
-   if (acceptor) {
-      log.info("canceling boost::asio::acceptor");
-      acceptor->cancel();
-      log.info("closing boost::asio::acceptor");
-      acceptor->close();
+   // The handlers of the pending accept and of the connections reference this
+   // server, therefore it has to wait for their completion.
+   log.info("waiting for connections to get closed");
+   std::unique_lock<std::mutex> lock(stateMutex);
+   if (stateChanged.wait_for(lock, 3s, [this]{ return (pendingAcceptCount == 0) && (openConnectionCount == 0); })) {
+      log.info("stopped");
+   } else {
+      log.error("waiting for connections to get closed timed out (", openConnectionCount, 
+                "connection(s) still open )");
+   }
+}
+
+void TcpServer::closeAcceptorAndConnections() {
+   for (auto& listeningSocket : listeningSockets) {
+      log.info("closing acceptor of", listeningSocket.address.toString());
+      boost::system::error_code error;
+      listeningSocket.acceptor->close(error);
+      if (listeningSocket.address.type == ListenAddress::Type::UNIX_DOMAIN) {
+         ::unlink(listeningSocket.address.path.c_str());
+      }
    }
    
-   if (ioContext) {
-      log.info("stopping boost::asio::io_context");
-      ioContext->stop();
-      log.info("waiting for boost::asio::io_context to stop");
-      int repetitions = 30;
-      while((repetitions > 0) && !ioContext->stopped()) {
-         std::this_thread::sleep_for(100ms);
-         repetitions--;
+   for (auto& entry : connections) {
+      std::shared_ptr<TcpConnection> connection = entry.second.lock();
+      if (connection) {
+         connection->close();
       }
-      if (ioContext->stopped()) {
-         log.info("boost::asio::io_context stopped");
-      } else {
-         log.error("waiting for termination of boost::asio::io_context timed out");
+   }
+}
+
+void TcpServer::startAccepting() {
+   // the caller holds the stateMutex
+   if (stopped || (connections.size() >= maxConnections)) {
+      return;
+   }
+   
+   for (size_t index = 0; index < listeningSockets.size(); index++) {
+      ListeningSocket& listeningSocket = listeningSockets[index];
+      if (listeningSocket.accepting) {
+         continue;
       }
+      listeningSocket.accepting = true;
+      pendingAcceptCount++;
+      std::shared_ptr<TcpConnection> newConnection = TcpConnection::create(ioContext, name, connectionSettings);
+      listeningSocket.acceptor->async_accept(newConnection->getSocket(), 
+         [this, index, newConnection](const boost::system::error_code& error) {
+            handle_accept(index, newConnection, error);
+         });
    }
 }
 
-void TcpServer::onConnectionClosed() {
-   listener.onConnectionClosed();
+void TcpServer::onConnectionClosed(int connectionId) {
+   // called by the strand of the connection
+   boost::asio::post(strand, [this, connectionId]() {
+      connections.erase(connectionId);
+      if (!stopped) {
+         listener.onConnectionClosed(connectionId);
+      }
+      // stop() waits for this decrement -> the server must not get used after 
+      // releasing the lock
+      const std::lock_guard<std::mutex> lock(stateMutex);
+      openConnectionCount--;
+      startAccepting();
+      stateChanged.notify_all();
+   });
 }
 
-void TcpServer::onCommandReceived(const std::string& command) {
-   listener.onCommandReceived(command);
+void TcpServer::onCommandReceived(int connectionId, std::string_view command) {
+   // Called by the strand of the connection. Passing the command to the strand
+   // of the server would require a copy of it.
+   if (!stopped) {
+      listener.onCommandReceived(connectionId, command);
+   }
 }
 
-void TcpServer::handle_accept(std::unique_ptr<TcpConnection> newConnection, 
+void TcpServer::handle_accept(size_t acceptorIndex, std::shared_ptr<TcpConnection> newConnection, 
                               const boost::system::error_code& error) {
-   if (stopped) {
-      return;
-   }
-   
-   if (error) {
-      if (error == boost::asio::error::operation_aborted) {
-         log.info("aborted async accept");
-      } else {
-         log.error("failed to accept connection:", error.message());
-      }
+   if (error == boost::asio::error::operation_aborted) {
+      log.info("aborted async accept");
+   } else if (stopped) {
+      log.info("ignoring accepted connection because server got stopped");
+   } else if (error) {
+      log.error("failed to accept connection:", error.message());
+   } else if (connections.size() >= maxConnections) {
+      // the other addresses accepted concurrently
+      log.info("closing accepted connection because max.", maxConnections, "connection(s) are open");
    } else {
+      {
+         const std::lock_guard<std::mutex> lock(stateMutex);
+         openConnectionCount++;
+      }
+      connections[newConnection->getId()] = newConnection;
+      log.info("accepted connection", newConnection->getId(), "(", connections.size(), "open connection(s) )");
+      // the listener has to know the connection before receiving its commands
+      std::shared_ptr<Connection> connection(new Connection(newConnection));
+      listener.onNewConnection(connection);
       newConnection->start(
-         std::bind(&TcpServer::onConnectionClosed, this),
-         std::bind(&TcpServer::onCommandReceived, this, std::placeholders::_1));
-      std::unique_ptr<Connection> connection(new Connection(std::move(newConnection)));
-      listener.onNewConnection(std::move(connection));
+         std::bind(&TcpServer::onConnectionClosed, this, std::placeholders::_1),
+         std::bind(&TcpServer::onCommandReceived, this, std::placeholders::_1, std::placeholders::_2));
    }
-}
+   
+   const std::lock_guard<std::mutex> lock(stateMutex);
+   listeningSockets[acceptorIndex].accepting = false;
+   pendingAcceptCount--;
+   startAccepting();
+   stateChanged.notify_all();
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include <algorithm>
+
+#include "TokenBucket.h"
+
+using network::TokenBucket;
+
+TokenBucket::TokenBucket(uint64_t bytesPerSecond, size_t burstBytes)
+   : bytesPerSecond(bytesPerSecond),
+     burstBytes(burstBytes),
+     tokens(burstBytes),
+     lastRefill(Clock::now()) {}
+
+bool TokenBucket::conforms(size_t bytes, Clock::time_point now) {
+   refill(now);
+   return tokens >= std::min((double)bytes, burstBytes);
+}
+
+void TokenBucket::consume(size_t bytes) {
+   tokens -= bytes;
+}
+
+uint64_t TokenBucket::getBytesPerSecond() const {
+   return bytesPerSecond;
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+   if (now <= lastRefill) {
+      return;
+   }
+   double elapsedSeconds = std::chrono::duration<double>(now - lastRefill).count();
+   tokens     = std::min(burstBytes, tokens + elapsedSeconds * bytesPerSecond);
+   lastRefill = now;
+}
@@ -0,0 +1,28 @@
+#include <cstring>
+
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "TransportStatistics.h"
+
+using network::TransportStatistics;
+
+bool TransportStatistics::read(int socketFileDescriptor, TransportStatistics& statistics) {
+   struct tcp_info info;
+   socklen_t       infoLength = sizeof(info);
+   std::memset(&info, 0, sizeof(info));
+   if (getsockopt(socketFileDescriptor, IPPROTO_TCP, TCP_INFO, &info, &infoLength) != 0) {
+      return false;
+   }
+
+   // fields unknown to an older kernel stay 0
+   statistics.rtt_us             = info.tcpi_rtt;
+   statistics.minRtt_us          = info.tcpi_min_rtt;
+   statistics.unackedSegments    = info.tcpi_unacked;
+   statistics.sendMss            = info.tcpi_snd_mss;
+   statistics.notSentBytes       = info.tcpi_notsent_bytes;
+   statistics.deliveryRate       = info.tcpi_delivery_rate;
+   statistics.deliveryAppLimited = info.tcpi_delivery_rate_app_limited;
+   return true;
+}
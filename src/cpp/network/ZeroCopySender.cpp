@@ -0,0 +1,173 @@
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "ZeroCopySender.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY    60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY   0x4000000
+#endif
+
+#define MAX_IOVEC_COUNT                 64
+#define MAX_CONSECUTIVE_COPIED_COUNT    16
+
+using logging::Logger;
+using network::SharedBuffer;
+using network::ZeroCopySender;
+using network::ZeroCopyStatistics;
+
+ZeroCopySender::ZeroCopySender(Logger& log) 
+   : log(log),
+     enabled(false),
+     nextSequence(0),
+     completedSequence(0),
+     retainedSequence(0),
+     consecutiveCopiedCount(0) {}
+
+bool ZeroCopySender::enable(int socketFd) {
+   int one = 1;
+   if (setsockopt(socketFd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+      log.info("zero-copy sending not supported:", std::strerror(errno));
+      enabled = false;
+   } else {
+      enabled = true;
+   }
+   return enabled;
+}
+
+bool ZeroCopySender::isEnabled() const {
+   return enabled;
+}
+
+ssize_t ZeroCopySender::send(int socketFd, const std::vector<boost::asio::const_buffer>& buffers, 
+                             size_t offset) {
+   struct iovec iov[MAX_IOVEC_COUNT];
+   size_t       iovCount = 0;
+   
+   for (auto& buffer : buffers) {
+      if (iovCount >= MAX_IOVEC_COUNT) {
+         break;
+      }
+      if (offset >= buffer.size()) {
+         offset -= buffer.size();
+         continue;
+      }
+      iov[iovCount].iov_base = (void*)((const uint8_t*)buffer.data() + offset);
+      iov[iovCount].iov_len  = buffer.size() - offset;
+      offset                 = 0;
+      iovCount++;
+   }
+   
+   struct msghdr message;
+   std::memset(&message, 0, sizeof(message));
+   message.msg_iov    = iov;
+   message.msg_iovlen = iovCount;
+   
+   if (enabled) {
+      ssize_t result = sendmsg(socketFd, &message, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (result >= 0) {
+         nextSequence++;
+         statistics.zeroCopySends++;
+         return result;
+      }
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+         return result;
+      }
+      // e.g. EFAULT for memory the kernel can't pin (like mmapped device buffers
+      // not marked as such). The data of the send calls so far stays retained.
+      log.warning("disabling zero-copy sending because sendmsg failed:", std::strerror(errno));
+      enabled = false;
+   }
+   return sendmsg(socketFd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void ZeroCopySender::retain(std::vector<SharedBuffer>& buffers) {
+   if (retainedSequence == nextSequence) {
+      buffers.clear();  // nothing got sent using MSG_ZEROCOPY
+      return;
+   }
+   retainedBuffers.emplace_back();
+   retainedBuffers.back().lastSequence = nextSequence - 1;
+   retainedBuffers.back().buffers.swap(buffers);
+   retainedSequence = nextSequence;
+}
+
+void ZeroCopySender::processCompletions(int socketFd) {
+   // Besides being pointless, reading the error queue of sockets not using 
+   // zero-copy (e.g. Unix domain sockets) might read their data instead.
+   while (hasIncompleteSends()) {
+      char          control[128];
+      struct msghdr message;
+      std::memset(&message, 0, sizeof(message));
+      message.msg_control    = control;
+      message.msg_controllen = sizeof(control);
+      
+      if (recvmsg(socketFd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+         return;  // error queue is empty
+      }
+      
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+         bool ipv4Error = (cmsg->cmsg_level == SOL_IP)   && (cmsg->cmsg_type == IP_RECVERR);
+         bool ipv6Error = (cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR);
+         if (!ipv4Error && !ipv6Error) {
+            continue;
+         }
+         
+         struct sock_extended_err error;
+         std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+         if ((error.ee_errno != 0) || (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+            continue;
+         }
+         
+         // the notification covers the send calls error.ee_info to error.ee_data
+         statistics.completedSends += error.ee_data - error.ee_info + 1;
+         if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+            statistics.copiedByKernel++;
+            consecutiveCopiedCount++;
+            if (enabled && (consecutiveCopiedCount >= MAX_CONSECUTIVE_COPIED_COUNT)) {
+               log.info("disabling zero-copy sending because the kernel copies the data anyway");
+               enabled = false;
+            }
+         } else {
+            consecutiveCopiedCount = 0;
+         }
+         if ((int32_t)(error.ee_data + 1 - completedSequence) > 0) {
+            completedSequence = error.ee_data + 1;
+         }
+         releaseUpTo(error.ee_data);
+      }
+   }
+}
+
+void ZeroCopySender::releaseUpTo(uint32_t sequence) {
+   // TCP completes the send calls in order
+   while (!retainedBuffers.empty() && ((int32_t)(sequence - retainedBuffers.front().lastSequence) >= 0)) {
+      retainedBuffers.pop_front();
+   }
+}
+
+bool ZeroCopySender::hasRetainedBuffers() const {
+   return !retainedBuffers.empty();
+}
+
+bool ZeroCopySender::hasIncompleteSends() const {
+   return completedSequence != nextSequence;
+}
+
+void ZeroCopySender::clear() {
+   retainedBuffers.clear();
+}
+
+const ZeroCopyStatistics& ZeroCopySender::getStatistics() const {
+   return statistics;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstring>
+
+#include "AnnexB.h"
+#include "H264Packetizer.h"
+
+using h264::AnnexB;
+using h264::NalUnitPosition;
+using network::SharedBuffer;
+using rtsp::H264Packetizer;
+using rtsp::RtpPayload;
+
+#define NAL_TYPE_STAP_A  24
+#define NAL_TYPE_FU_A    28
+
+#define FU_START_BIT   0x80
+#define FU_END_BIT     0x40
+
+H264Packetizer::H264Packetizer(size_t maxPayloadSize) : maxPayloadSize(maxPayloadSize) {}
+
+void H264Packetizer::packetize(const SharedBuffer& accessUnit, std::vector<RtpPayload>& payloads) {
+   AnnexB::findNalUnits(accessUnit.data(), accessUnit.size(), nalUnitPositions);
+
+   size_t firstPayload = payloads.size();
+   parameterSets.clear();
+   for (auto& position : nalUnitPositions) {
+      SharedBuffer nalUnit = accessUnit.slice(position.offset, position.size);
+      uint8_t      type    = position.type;
+      if (type == NAL_TYPE_AUD) {
+         continue;
+      }
+      if ((type == NAL_TYPE_SPS) || (type == NAL_TYPE_PPS)) {
+         std::string& parameterSet = (type == NAL_TYPE_SPS) ? sequenceParameterSet : pictureParameterSet;
+         parameterSet.assign((const char*)nalUnit.data(), nalUnit.size());
+         parameterSets.push_back(nalUnit);
+         continue;
+      }
+      appendParameterSets(parameterSets, payloads);
+      appendNalUnit(nalUnit, payloads);
+   }
+   appendParameterSets(parameterSets, payloads);
+
+   if (payloads.size() > firstPayload) {
+      payloads.back().marker = true;
+   }
+}
+
+void H264Packetizer::appendNalUnit(const SharedBuffer& nalUnit, std::vector<RtpPayload>& payloads) {
+   if (nalUnit.size() <= maxPayloadSize) {
+      RtpPayload payload;
+      payload.data = nalUnit;
+      payloads.push_back(std::move(payload));
+      return;
+   }
+
+   uint8_t nalHeader        = nalUnit.data()[0];
+   size_t  maxFragmentSize  = maxPayloadSize - 2;
+   size_t  offset           = 1; // the NAL header gets transmitted in the FU indicator and header
+   while (offset < nalUnit.size()) {
+      size_t fragmentSize = std::min(maxFragmentSize, nalUnit.size() - offset);
+      RtpPayload payload;
+      payload.payloadHeader[0]  = (nalHeader & 0xe0) | NAL_TYPE_FU_A;
+      payload.payloadHeader[1]  = nalHeader & 0x1f;
+      payload.payloadHeaderSize = 2;
+      if (offset == 1) {
+         payload.payloadHeader[1] |= FU_START_BIT;
+      }
+      if (offset + fragmentSize == nalUnit.size()) {
+         payload.payloadHeader[1] |= FU_END_BIT;
+      }
+      payload.data = nalUnit.slice(offset, fragmentSize);
+      payloads.push_back(std::move(payload));
+      offset += fragmentSize;
+   }
+}
+
+void H264Packetizer::appendParameterSets(std::vector<SharedBuffer>& nalUnitsToAggregate,
+                                         std::vector<RtpPayload>& payloads) {
+   if (nalUnitsToAggregate.empty()) {
+      return;
+   }
+
+   size_t  aggregatedSize = 1;
+   uint8_t nri            = 0;
+   for (auto& nalUnit : nalUnitsToAggregate) {
+      aggregatedSize += 2 + nalUnit.size();
+      nri             = std::max(nri, (uint8_t)(nalUnit.data()[0] & 0x60));
+   }
+
+   if ((nalUnitsToAggregate.size() == 1) || (aggregatedSize > maxPayloadSize)) {
+      for (auto& nalUnit : nalUnitsToAggregate) {
+         appendNalUnit(nalUnit, payloads);
+      }
+   } else {
+      std::vector<uint8_t> stapA;
+      stapA.reserve(aggregatedSize);
+      stapA.push_back(nri | NAL_TYPE_STAP_A);
+      for (auto& nalUnit : nalUnitsToAggregate) {
+         stapA.push_back((uint8_t)(nalUnit.size() >> 8));
+         stapA.push_back((uint8_t)(nalUnit.size() & 0xff));
+         stapA.insert(stapA.end(), nalUnit.data(), nalUnit.data() + nalUnit.size());
+      }
+      RtpPayload payload;
+      payload.data = SharedBuffer::copyOf(stapA.data(), stapA.size());
+      payloads.push_back(std::move(payload));
+   }
+   nalUnitsToAggregate.clear();
+}
+
+const std::string& H264Packetizer::getSequenceParameterSet() const {
+   return sequenceParameterSet;
+}
+
+const std::string& H264Packetizer::getPictureParameterSet() const {
+   return pictureParameterSet;
+}
+
+uint32_t H264Packetizer::toRtpTimestamp(int64_t timestamp_us) {
+   // split to avoid overflows of timestamp_us * RTP_CLOCK_RATE
+   return (uint32_t)((timestamp_us / 1000000) * RTP_CLOCK_RATE + 
+                     ((timestamp_us % 1000000) * RTP_CLOCK_RATE) / 1000000);
+}
+
+size_t H264Packetizer::writeHeaders(uint8_t* buffer, const RtpPayload& payload, uint8_t payloadType,
+                                    uint16_t sequenceNumber, uint32_t rtpTimestamp, uint32_t ssrc) {
+   buffer[0]  = 0x80; // version 2, no padding, no extension, no CSRC
+   buffer[1]  = (payload.marker ? 0x80 : 0x00) | payloadType;
+   buffer[2]  = sequenceNumber >> 8;
+   buffer[3]  = sequenceNumber & 0xff;
+   buffer[4]  = rtpTimestamp >> 24;
+   buffer[5]  = (rtpTimestamp >> 16) & 0xff;
+   buffer[6]  = (rtpTimestamp >> 8) & 0xff;
+   buffer[7]  = rtpTimestamp & 0xff;
+   buffer[8]  = ssrc >> 24;
+   buffer[9]  = (ssrc >> 16) & 0xff;
+   buffer[10] = (ssrc >> 8) & 0xff;
+   buffer[11] = ssrc & 0xff;
+   std::memcpy(buffer + RTP_HEADER_SIZE, payload.payloadHeader, payload.payloadHeaderSize);
+   return RTP_HEADER_SIZE + payload.payloadHeaderSize;
+}
@@ -0,0 +1,431 @@
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "Reactor.h"
+#include "RtspServer.h"
+#include "StringUtils.h"
+
+using boost::asio::ip::udp;
+using logging::Logger;
+using network::Connection;
+using network::ConnectionSettings;
+using network::ListenAddress;
+using network::OverflowPolicy;
+using network::Reactor;
+using network::SharedBuffer;
+using network::SocketOptions;
+using network::TcpServer;
+using rtsp::H264Packetizer;
+using rtsp::RtspRequest;
+using rtsp::RtspServer;
+using utils::String;
+
+#define RTP_PAYLOAD_TYPE          96
+#define MAX_REQUEST_LINES         64
+#define UDP_PORT_PAIR_ATTEMPTS    10
+
+// RTP packets of about 1.5 seconds of video at high bitrates
+#define MAX_QUEUED_PACKETS   4000
+#define MAX_QUEUED_BYTES     (8 * 1024 * 1024)
+
+std::string RtspRequest::getHeader(const std::string& name) const {
+   auto entry = headers.find(name);
+   return (entry == headers.end()) ? "" : entry->second;
+}
+
+static bool parseRequest(const std::vector<std::string>& lines, RtspRequest& request) {
+   std::istringstream requestLine(lines[0]);
+   std::string version;
+   if (!(requestLine >> request.method >> request.url >> version)) {
+      return false;
+   }
+   for (size_t index = 1; index < lines.size(); index++) {
+      size_t colon = lines[index].find(':');
+      if (colon != std::string::npos) {
+         std::string name = String::toLowerCase(String::trim(std::string_view(lines[index]).substr(0, colon)));
+         request.headers[name] = String::trim(std::string_view(lines[index]).substr(colon + 1));
+      }
+   }
+   return true;
+}
+
+RtspServer::RtspServer(const std::vector<ListenAddress>& addresses, unsigned int maxConnections,
+                       SessionsChangedCallback callback)
+   : log("RtspServer"),
+     addresses(addresses),
+     maxConnections(maxConnections),
+     sessionsChangedCallback(callback),
+     playingSessionCount(0),
+     random(std::random_device()()) {}
+
+RtspServer::~RtspServer() {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      clients.clear();
+   }
+   if (tcpServer) {
+      tcpServer->stop();
+   }
+}
+
+void RtspServer::start() {
+   openUdpSockets();
+
+   // Dropping single RTP packets would corrupt the stream until the next
+   // keyframe, therefore a client that can't keep up gets disconnected.
+   ConnectionSettings settings;
+   settings.sendQueueLimits.maxQueuedFrames = MAX_QUEUED_PACKETS;
+   settings.sendQueueLimits.maxQueuedBytes  = MAX_QUEUED_BYTES;
+   settings.sendQueueLimits.overflowPolicy  = OverflowPolicy::DISCONNECT;
+   settings.socketOptions                   = SocketOptions::streamingProfile();
+   settings.egressStream                    = "h264";
+
+   tcpServer.reset(new TcpServer(addresses, "RTSP", *this, maxConnections, settings));
+   tcpServer->start();
+}
+
+void RtspServer::openUdpSockets() {
+   boost::asio::io_context& ioContext = Reactor::get().getIoContext();
+
+   // RTP needs an even port and RTCP the next higher one
+   for (unsigned int attempt = 0; attempt < UDP_PORT_PAIR_ATTEMPTS; attempt++) {
+      try {
+         std::unique_ptr<udp::socket> rtp(new udp::socket(ioContext, udp::endpoint(udp::v4(), 0)));
+         unsigned short rtpPort = rtp->local_endpoint().port();
+         if ((rtpPort % 2) != 0) {
+            continue;
+         }
+         std::unique_ptr<udp::socket> rtcp(new udp::socket(ioContext, udp::endpoint(udp::v4(), rtpPort + 1)));
+         rtp->non_blocking(true);
+         rtpSocket  = std::move(rtp);
+         rtcpSocket = std::move(rtcp);
+         log.info("sending RTP via UDP from port", rtpPort);
+         return;
+      } catch (const boost::system::system_error& e) {
+         log.debug("failed to open UDP port pair:", e.what());
+      }
+   }
+   log.error("failed to open UDP ports -> only TCP interleaved transport available");
+}
+
+void RtspServer::send(const SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe) {
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (playingSessionCount == 0) {
+         return;
+      }
+   }
+
+   packetizer.packetize(accessUnit, payloads);
+   uint32_t rtpTimestamp = H264Packetizer::toRtpTimestamp(timestamp_us);
+
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (keyframe) {
+         sequenceParameterSet = packetizer.getSequenceParameterSet();
+         pictureParameterSet  = packetizer.getPictureParameterSet();
+      }
+
+      for (auto& entry : clients) {
+         Session& session = entry.second.session;
+         if (!session.playing) {
+            continue;
+         }
+         if (session.waitingForKeyframe) {
+            if (!keyframe) {
+               continue;
+            }
+            session.waitingForKeyframe = false;
+         }
+         for (auto& payload : payloads) {
+            sendPacket(session, entry.second.connection, payload, rtpTimestamp + session.timestampOffset);
+         }
+      }
+   }
+   payloads.clear();
+}
+
+void RtspServer::sendPacket(Session& session, const std::shared_ptr<Connection>& connection,
+                            const RtpPayload& payload, uint32_t rtpTimestamp) {
+   uint8_t buffer[4 + RTP_HEADER_SIZE + sizeof(payload.payloadHeader)];
+   size_t  prefixSize = (session.transport == Transport::TCP_INTERLEAVED) ? 4 : 0;
+   size_t  bufferSize = prefixSize + H264Packetizer::writeHeaders(buffer + prefixSize, payload, RTP_PAYLOAD_TYPE, 
+                                                                  session.sequenceNumber, rtpTimestamp, session.ssrc);
+
+   session.sequenceNumber++;   // wraps around
+   session.sentPackets++;
+
+   if (session.transport == Transport::TCP_INTERLEAVED) {
+      size_t packetSize = RTP_HEADER_SIZE + payload.size();
+      buffer[0] = '$';
+      buffer[1] = session.interleavedChannel;
+      buffer[2] = packetSize >> 8;
+      buffer[3] = packetSize & 0xff;
+      connection->asyncSendFrame({SharedBuffer::copyOf(buffer, bufferSize), payload.data});
+   } else {
+      std::array<boost::asio::const_buffer, 2> packet = {boost::asio::buffer(buffer, bufferSize),
+                                                         payload.data.asAsioBuffer()};
+      boost::system::error_code error;
+      rtpSocket->send_to(packet, session.rtpEndpoint, 0, error);
+      if (error) {
+         log.debug("failed to send RTP packet to", session.rtpEndpoint.address().to_string(), ":", error.message());
+      }
+   }
+}
+
+void RtspServer::onNewConnection(std::shared_ptr<Connection> connection) {
+   log.info("accepted new connection", connection->getId());
+   const std::lock_guard<std::mutex> lock(mutex);
+   clients[connection->getId()].connection = connection;
+}
+
+void RtspServer::onConnectionClosed(int connectionId) {
+   bool         sessionStopped = false;
+   unsigned int sessionCount   = 0;
+   uint64_t     sentPackets    = 0;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if (entry != clients.end()) {
+         sessionStopped = entry->second.session.playing;
+         sentPackets    = entry->second.session.sentPackets;
+         clients.erase(entry);
+      }
+      if (sessionStopped) {
+         playingSessionCount--;
+      }
+      sessionCount = playingSessionCount;
+   }
+   log.info("connection", connectionId, "lost (sent RTP packets:", sentPackets, ")");
+   if (sessionStopped) {
+      sessionsChangedCallback(sessionCount, false);
+   }
+}
+
+void RtspServer::onCommandReceived(int connectionId, std::string_view command) {
+   std::string_view line = command;
+   if (!line.empty() && (line.back() == '\r')) {
+      line.remove_suffix(1);
+   }
+
+   bool         sessionStateChanged = false;
+   bool         playing             = false;
+   unsigned int sessionCount        = 0;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if (entry == clients.end()) {
+         return;
+      }
+      Client& client = entry->second;
+
+      if (client.requestLines.empty()) {
+         // Lines not starting a request (e.g. fragments of interleaved RTCP
+         // packets sent by the client) get ignored.
+         const std::string_view version = " RTSP/1.0";
+         if ((line.size() < version.size()) || (line.substr(line.size() - version.size()) != version)) {
+            return;
+         }
+      }
+
+      if (!line.empty()) {
+         if (client.requestLines.size() < MAX_REQUEST_LINES) {
+            client.requestLines.emplace_back(line);
+         }
+         return;
+      }
+
+      RtspRequest request;
+      if (parseRequest(client.requestLines, request)) {
+         log.debug("connection", connectionId, "requested", request.method, request.url);
+         bool wasPlaying = client.session.playing;
+         handleRequest(client, request);
+         playing             = client.session.playing;
+         sessionStateChanged = (playing != wasPlaying);
+         if (sessionStateChanged) {
+            playingSessionCount = playing ? playingSessionCount + 1 : playingSessionCount - 1;
+         }
+         sessionCount = playingSessionCount;
+      }
+      client.requestLines.clear();
+   }
+
+   if (sessionStateChanged) {
+      log.info("connection", connectionId, playing ? "started" : "stopped", "playing (", sessionCount,
+               "playing session(s) )");
+      sessionsChangedCallback(sessionCount, playing);
+   }
+}
+
+void RtspServer::handleRequest(Client& client, const RtspRequest& request) {
+   Session&    session          = client.session;
+   std::string sessionHeader    = request.getHeader("session");
+   std::string requestedSession = sessionHeader.substr(0, sessionHeader.find(';'));
+   bool        sessionMatches   = !session.id.empty() && (requestedSession == session.id);
+
+   if (request.method == "OPTIONS") {
+      sendResponse(client, request, "200 OK",
+                   "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER, SET_PARAMETER\r\n");
+
+   } else if (request.method == "DESCRIBE") {
+      std::string contentBase = request.url;
+      if (contentBase.empty() || (contentBase.back() != '/')) {
+         contentBase.push_back('/');
+      }
+      sendResponse(client, request, "200 OK",
+                   "Content-Base: " + contentBase + "\r\nContent-Type: application/sdp\r\n",
+                   createSessionDescription());
+
+   } else if (request.method == "SETUP") {
+      if (session.playing) {
+         sendResponse(client, request, "455 Method Not Valid in This State");
+         return;
+      }
+      if (!requestedSession.empty() && !sessionMatches) {
+         sendResponse(client, request, "454 Session Not Found");
+         return;
+      }
+      std::string responseTransport;
+      if (!setUpTransport(client, request.getHeader("transport"), responseTransport)) {
+         sendResponse(client, request, "461 Unsupported Transport");
+         return;
+      }
+      sendResponse(client, request, "200 OK",
+                   "Transport: " + responseTransport + "\r\nSession: " + session.id + "\r\n");
+
+   } else if ((request.method == "PLAY") || (request.method == "PAUSE") || (request.method == "TEARDOWN")) {
+      if (!sessionMatches) {
+         sendResponse(client, request, "454 Session Not Found");
+         return;
+      }
+      std::string headers = "Session: " + session.id + "\r\n";
+      if (request.method == "PLAY") {
+         if (!session.playing) {
+            session.playing            = true;
+            session.waitingForKeyframe = true;
+         }
+         headers.append("Range: npt=0.000-\r\nRTP-Info: url=" + request.url + ";seq=" +
+                        std::to_string(session.sequenceNumber) + "\r\n");
+      } else {
+         session.playing = false;
+      }
+      sendResponse(client, request, "200 OK", headers);
+      if (request.method == "TEARDOWN") {
+         session = Session{};
+      }
+
+   } else if ((request.method == "GET_PARAMETER") || (request.method == "SET_PARAMETER")) {
+      sendResponse(client, request, "200 OK", sessionMatches ? ("Session: " + session.id + "\r\n") : "");
+
+   } else {
+      sendResponse(client, request, "501 Not Implemented");
+   }
+}
+
+bool RtspServer::setUpTransport(Client& client, const std::string& transportHeader,
+                                std::string& responseTransport) {
+   Session& session = client.session;
+   char     ssrc[16];
+
+   // the client lists the acceptable transports in the order of its preference
+   std::istringstream alternatives(transportHeader);
+   std::string        transport;
+   while (std::getline(alternatives, transport, ',')) {
+      if (transport.find("multicast") != std::string::npos) {
+         continue;
+      }
+
+      Session candidate = session;
+      if (candidate.id.empty()) {
+         char id[20];
+         std::snprintf(id, sizeof(id), "%08X%08X", (unsigned int)random(), (unsigned int)random());
+         candidate.id              = id;
+         candidate.ssrc            = random();
+         candidate.sequenceNumber  = random();
+         candidate.timestampOffset = random();
+      }
+      std::snprintf(ssrc, sizeof(ssrc), "%08X", candidate.ssrc);
+
+      unsigned int firstValue  = 0;
+      unsigned int secondValue = 0;
+
+      if (transport.rfind("RTP/AVP/TCP", 0) == 0) {
+         size_t position = transport.find("interleaved=");
+         if ((position == std::string::npos) ||
+             (std::sscanf(transport.c_str() + position, "interleaved=%u", &firstValue) != 1) ||
+             (firstValue > 254)) {
+            firstValue = 0;
+         }
+         candidate.transport          = Transport::TCP_INTERLEAVED;
+         candidate.interleavedChannel = firstValue;
+         responseTransport = "RTP/AVP/TCP;unicast;interleaved=" + std::to_string(firstValue) + "-" +
+                             std::to_string(firstValue + 1) + ";ssrc=" + ssrc;
+         session = candidate;
+         return true;
+      }
+
+      if (transport.rfind("RTP/AVP", 0) == 0) {
+         boost::asio::ip::address address;
+         size_t position = transport.find("client_port=");
+         if (!rtpSocket || (position == std::string::npos) ||
+             (std::sscanf(transport.c_str() + position, "client_port=%u-%u", &firstValue, &secondValue) < 1) ||
+             (firstValue == 0) || (firstValue > 65535) ||
+             !client.connection->getRemoteIpAddress(address) || !address.is_v4()) {
+            continue;
+         }
+         if (secondValue == 0) {
+            secondValue = firstValue + 1;
+         }
+         unsigned short rtpPort    = rtpSocket->local_endpoint().port();
+         candidate.transport       = Transport::UDP;
+         candidate.rtpEndpoint     = udp::endpoint(address, firstValue);
+         responseTransport = "RTP/AVP;unicast;client_port=" + std::to_string(firstValue) + "-" +
+                             std::to_string(secondValue) + ";server_port=" + std::to_string(rtpPort) + "-" +
+                             std::to_string(rtpPort + 1) + ";ssrc=" + ssrc;
+         session = candidate;
+         return true;
+      }
+   }
+   return false;
+}
+
+std::string RtspServer::createSessionDescription() {
+   std::ostringstream sdp;
+   sdp << "v=0\r\n"
+       << "o=- " << random() << " 1 IN IP4 0.0.0.0\r\n"
+       << "s=OctoWatch\r\n"
+       << "c=IN IP4 0.0.0.0\r\n"
+       << "t=0 0\r\n"
+       << "a=control:*\r\n"
+       << "m=video 0 RTP/AVP " << RTP_PAYLOAD_TYPE << "\r\n"
+       << "a=rtpmap:" << RTP_PAYLOAD_TYPE << " H264/90000\r\n"
+       << "a=fmtp:" << RTP_PAYLOAD_TYPE << " packetization-mode=1";
+
+   // the parameter sets are known as soon as the first keyframe got sent
+   if ((sequenceParameterSet.size() >= 4) && !pictureParameterSet.empty()) {
+      char profileLevelId[8];
+      std::snprintf(profileLevelId, sizeof(profileLevelId), "%02X%02X%02X", (uint8_t)sequenceParameterSet[1],
+                    (uint8_t)sequenceParameterSet[2], (uint8_t)sequenceParameterSet[3]);
+      sdp << ";profile-level-id=" << profileLevelId << ";sprop-parameter-sets="
+          << String::toBase64((const uint8_t*)sequenceParameterSet.data(), sequenceParameterSet.size()) << ","
+          << String::toBase64((const uint8_t*)pictureParameterSet.data(), pictureParameterSet.size());
+   }
+   sdp << "\r\n"
+       << "a=control:trackID=0\r\n";
+   return sdp.str();
+}
+
+void RtspServer::sendResponse(Client& client, const RtspRequest& request, const std::string& status,
+                              const std::string& headers, const std::string& body) {
+   std::ostringstream response;
+   response << "RTSP/1.0 " << status << "\r\n"
+            << "CSeq: " << request.getHeader("cseq") << "\r\n"
+            << headers;
+   if (!body.empty()) {
+      response << "Content-Length: " << body.size() << "\r\n";
+   }
+   response << "\r\n" << body;
+   client.connection->asyncSend(response.str());
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <sstream>
+
+#include "FrameGrabber.h"
+
+using libcamera::FrameBuffer;
+using logging::Logger;
+using network::Connection;
+using network::ListenAddress;
+using network::TcpServer;
+using sharedmemory::FrameGrabber;
+
+FrameGrabber::FrameGrabber(const std::string& socketPath, Camera& camera, unsigned int maxReaders,
+                           ReadersChangedCallback callback)
+   : log("FrameGrabber"),
+     socketPath(socketPath),
+     maxReaders(maxReaders),
+     readersChangedCallback(callback) {
+   
+   for (StreamType streamType : {HIGH_RESOLUTION, LOW_RESOLUTION}) {
+      auto& config                  = camera.getStreamConfiguration(streamType);
+      streams[streamType].buffers   = camera.getFrameBuffers(streamType);
+      streams[streamType].width     = config.size.width;
+      streams[streamType].height    = config.size.height;
+      streams[streamType].stride    = config.stride;
+      streams[streamType].frameSize = config.frameSize;
+   }
+}
+
+FrameGrabber::~FrameGrabber() {
+   std::map<int, LeasedFrame> framesToRelease;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      readers.clear();
+      framesToRelease.swap(leasedFrames);
+   }
+   framesToRelease.clear();
+   if (tcpServer) {
+      tcpServer->stop();
+   }
+}
+
+void FrameGrabber::start() {
+   tcpServer.reset(new TcpServer({ListenAddress::unixDomain(socketPath)}, "frame-grabber", *this, maxReaders));
+   tcpServer->start();
+}
+
+void FrameGrabber::onNewFrame(FrameBuffer *highResolutionFrameBuffer, int64_t timestamp, 
+                              const FrameLease& lease) {
+   auto& buffers = streams[HIGH_RESOLUTION].buffers;
+   auto iterator = std::find(buffers.begin(), buffers.end(), highResolutionFrameBuffer);
+   if (iterator == buffers.end()) {
+      return;
+   }
+   int index = iterator - buffers.begin();
+   
+   std::ostringstream message;
+   message << "frame " << index << " " << timestamp << "\n";
+   
+   const std::lock_guard<std::mutex> lock(mutex);
+   bool limitReached = leasedFrames.size() >= FRAME_GRABBER_MAX_LEASED_FRAMES;
+   LeasedFrame frame;
+   for (auto& [connectionId, reader] : readers) {
+      if (!reader.subscribed) {
+         continue;
+      }
+      if (limitReached || (reader.heldIndex >= 0)) {
+         reader.skippedFrames++;
+         continue;
+      }
+      reader.heldIndex = index;
+      frame.holders.insert(connectionId);
+      reader.connection->asyncSend(message.str());
+   }
+   
+   if (!frame.holders.empty()) {
+      frame.lease         = lease;
+      leasedFrames[index] = std::move(frame);
+   }
+}
+
+void FrameGrabber::onNewConnection(std::shared_ptr<Connection> connection) {
+   unsigned int readerCount = 0;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      readers[connection->getId()].connection = connection;
+      readerCount = readers.size();
+   }
+   log.info("reader", connection->getId(), "attached (", readerCount, "reader(s) )");
+   readersChangedCallback(readerCount, true);
+}
+
+void FrameGrabber::onConnectionClosed(int connectionId) {
+   unsigned int readerCount = 0;
+   FrameLease   leaseToRelease;
+   uint64_t     skippedFrames = 0;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto iterator = readers.find(connectionId);
+      if (iterator != readers.end()) {
+         leaseToRelease = releaseHeldFrame(iterator->second, connectionId);
+         skippedFrames  = iterator->second.skippedFrames;
+         readers.erase(iterator);
+      }
+      readerCount = readers.size();
+   }
+   log.info("reader", connectionId, "detached after skipping", skippedFrames, "frame(s) (", readerCount, "reader(s) )");
+   readersChangedCallback(readerCount, false);
+}
+
+void FrameGrabber::onCommandReceived(int connectionId, std::string_view command) {
+   size_t end = command.find_last_not_of(" \t\r");
+   std::string trimmedCommand(command.substr(0, (end == std::string_view::npos) ? 0 : end + 1));
+   
+   if (trimmedCommand == "subscribe low") {
+      subscribe(connectionId, LOW_RESOLUTION);
+      return;
+   }
+   
+   if (trimmedCommand == "subscribe high") {
+      subscribe(connectionId, HIGH_RESOLUTION);
+      return;
+   }
+   
+   int index = -1;
+   std::istringstream input(trimmedCommand);
+   std::string keyword;
+   if ((input >> keyword >> index) && (keyword == "release")) {
+      FrameLease leaseToRelease;
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto iterator = readers.find(connectionId);
+      if ((iterator != readers.end()) && (iterator->second.heldIndex == index)) {
+         leaseToRelease = releaseHeldFrame(iterator->second, connectionId);
+      } else {
+         log.warning("reader", connectionId, "released frame", index, "it does not hold");
+      }
+      return;
+   }
+   
+   log.warning("ignoring unknown command \"" + trimmedCommand + "\" of reader", connectionId);
+}
+
+void FrameGrabber::subscribe(int connectionId, StreamType streamType) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   auto iterator = readers.find(connectionId);
+   if ((iterator == readers.end()) || iterator->second.subscribed) {
+      return;
+   }
+   
+   StreamInfo& stream = streams[streamType];
+   for (unsigned int index = 0; index < stream.buffers.size(); index++) {
+      std::ostringstream message;
+      message << "buffer " << index << " " << stream.buffers.size() << " " << stream.width << " " 
+              << stream.height << " " << stream.stride << " " << stream.frameSize << "\n";
+      iterator->second.connection->asyncSendFileDescriptor(stream.buffers[index]->planes()[0].fd.get(), 
+                                                           message.str());
+   }
+   iterator->second.subscribed = true;
+   log.info("reader", connectionId, "subscribed to", (streamType == HIGH_RESOLUTION) ? "high" : "low", 
+            "resolution frames");
+}
+
+FrameLease FrameGrabber::releaseHeldFrame(Reader& reader, int connectionId) {
+   FrameLease leaseToRelease;
+   auto iterator = leasedFrames.find(reader.heldIndex);
+   if (iterator != leasedFrames.end()) {
+      iterator->second.holders.erase(connectionId);
+      if (iterator->second.holders.empty()) {
+         leaseToRelease = std::move(iterator->second.lease);
+         leasedFrames.erase(iterator);
+      }
+   }
+   reader.heldIndex = -1;
+   return leaseToRelease;
+}
@@ -0,0 +1,145 @@
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "FrameRing.h"
+
+#define ALIGNMENT   64
+
+// not defined by older C libraries (supported since Linux 5.1)
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE   0x0010
+#endif
+
+using logging::Logger;
+using sharedmemory::FrameRing;
+using sharedmemory::FrameRingHeader;
+using sharedmemory::FrameSlot;
+
+static uint64_t alignUp(uint64_t value) {
+   return (value + ALIGNMENT - 1) & ~((uint64_t)ALIGNMENT - 1);
+}
+
+FrameRing::FrameRing(const char* name, size_t requestedDataSize, uint32_t requestedSlotCount) 
+   : log("FrameRing"), fd(-1), readOnlyFd(-1), totalSize(0), memory(nullptr), dataSize(0), 
+     slotCount(requestedSlotCount), writeSequence(0), writePosition(0) {
+   
+   if ((slotCount == 0) || (requestedDataSize == 0)) {
+      throw std::invalid_argument("the ring buffer needs at least one slot and one byte of data");
+   }
+   
+   uint64_t dataOffset = alignUp(sizeof(FrameRingHeader) + slotCount * sizeof(FrameSlot));
+   totalSize           = dataOffset + alignUp(requestedDataSize);
+   dataSize            = totalSize - dataOffset;
+   
+   fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+   if (fd < 0) {
+      throw std::runtime_error(std::string("failed to create memfd: ").append(std::strerror(errno)));
+   }
+   if (ftruncate(fd, totalSize) != 0) {
+      close(fd);
+      throw std::runtime_error(std::string("failed to resize memfd: ").append(std::strerror(errno)));
+   }
+   
+   void* mapping = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(std::string("failed to map memfd: ").append(std::strerror(errno)));
+   }
+   
+   // The mapping of the writer stays writable, the readers cannot create
+   // writable mappings anymore.
+   if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) != 0) {
+      log.warning("failed to seal memfd:", std::strerror(errno));
+   }
+   
+   std::string fdPath = std::string("/proc/self/fd/").append(std::to_string(fd));
+   readOnlyFd = open(fdPath.c_str(), O_RDONLY | O_CLOEXEC);
+   if (readOnlyFd < 0) {
+      int error = errno;
+      munmap(mapping, totalSize);
+      close(fd);
+      throw std::runtime_error(std::string("failed to open memfd read-only: ").append(std::strerror(error)));
+   }
+   
+   memory = static_cast<uint8_t*>(mapping);
+   header = new (memory) FrameRingHeader();
+   slots  = reinterpret_cast<FrameSlot*>(memory + sizeof(FrameRingHeader));
+   data   = memory + dataOffset;
+   
+   for (uint32_t index = 0; index < slotCount; index++) {
+      new (&slots[index]) FrameSlot();
+      slots[index].sequence.store(UINT64_MAX, std::memory_order_relaxed);
+   }
+   
+   header->magic      = FRAME_RING_MAGIC;
+   header->version    = FRAME_RING_VERSION;
+   header->slotCount  = slotCount;
+   header->dataOffset = dataOffset;
+   header->dataSize   = dataSize;
+   header->writeSequence.store(0, std::memory_order_relaxed);
+   header->tailPosition.store(0, std::memory_order_release);
+   
+   log.info("created", name, "with", dataSize, "bytes for data and", slotCount, "slots");
+}
+
+FrameRing::~FrameRing() {
+   munmap(memory, totalSize);
+   close(readOnlyFd);
+   close(fd);
+}
+
+bool FrameRing::publish(const uint8_t* payload, size_t size, int64_t timestamp_us, bool keyframe) {
+   if (size > dataSize) {
+      log.warning("frame of", size, "bytes does not fit into the ring buffer");
+      return false;
+   }
+   
+   // frames are stored contiguously -> skip the rest of the data area if necessary
+   uint64_t position = writePosition;
+   uint64_t offset   = position % dataSize;
+   if (offset + size > dataSize) {
+      position += dataSize - offset;
+      offset    = 0;
+   }
+   uint64_t endPosition = alignUp(position + size);
+   
+   // Announce the overwritten region before writing (readers check it after
+   // consuming a payload).
+   if (endPosition > dataSize) {
+      header->tailPosition.store(endPosition - dataSize, std::memory_order_relaxed);
+   }
+   
+   uint64_t   sequence = writeSequence;
+   FrameSlot& slot     = slots[sequence % slotCount];
+   slot.sequence.store(UINT64_MAX, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   
+   std::memcpy(data + offset, payload, size);
+   
+   slot.position     = position;
+   slot.offset       = offset;
+   slot.size         = size;
+   slot.timestamp_us = timestamp_us;
+   slot.flags        = keyframe ? FRAME_FLAG_KEYFRAME : 0;
+   slot.sequence.store(sequence, std::memory_order_release);
+   writeSequence = sequence + 1;
+   header->writeSequence.store(writeSequence, std::memory_order_release);
+   
+   writePosition = endPosition;
+   return true;
+}
+
+int FrameRing::getFileDescriptor() const {
+   return readOnlyFd;
+}
+
+size_t FrameRing::getSize() const {
+   return totalSize;
+}
@@ -0,0 +1,66 @@
+#include <sstream>
+
+#include "FrameRingPublisher.h"
+
+using logging::Logger;
+using network::Connection;
+using network::ListenAddress;
+using network::TcpServer;
+using sharedmemory::FrameRingPublisher;
+
+FrameRingPublisher::FrameRingPublisher(const std::string& name, const std::string& socketPath, 
+                                       size_t dataSize, uint32_t slotCount, unsigned int maxReaders,
+                                       ReadersChangedCallback callback)
+   : log((std::string("FrameRingPublisher-").append(name)).c_str()),
+     name(name),
+     socketPath(socketPath),
+     maxReaders(maxReaders),
+     frameRing(name.c_str(), dataSize, slotCount),
+     readersChangedCallback(callback) {}
+
+FrameRingPublisher::~FrameRingPublisher() {
+   {
+      const std::lock_guard<std::mutex> lock(readersMutex);
+      readers.clear();
+   }
+   if (tcpServer) {
+      tcpServer->stop();
+   }
+}
+
+void FrameRingPublisher::start() {
+   tcpServer.reset(new TcpServer({ListenAddress::unixDomain(socketPath)}, name + "-ring", *this, maxReaders));
+   tcpServer->start();
+}
+
+void FrameRingPublisher::publish(const uint8_t* data, size_t size, int64_t timestamp_us, bool keyframe) {
+   frameRing.publish(data, size, timestamp_us, keyframe);
+}
+
+void FrameRingPublisher::onNewConnection(std::shared_ptr<Connection> connection) {
+   std::ostringstream message;
+   message << name << " " << FRAME_RING_VERSION << " " << frameRing.getSize() << "\n";
+   connection->asyncSendFileDescriptor(frameRing.getFileDescriptor(), message.str());
+   
+   unsigned int readerCount = 0;
+   {
+      const std::lock_guard<std::mutex> lock(readersMutex);
+      readers[connection->getId()] = connection;
+      readerCount = readers.size();
+   }
+   log.info("reader", connection->getId(), "attached (", readerCount, "reader(s) )");
+   readersChangedCallback(readerCount, true);
+}
+
+void FrameRingPublisher::onConnectionClosed(int connectionId) {
+   unsigned int readerCount = 0;
+   {
+      const std::lock_guard<std::mutex> lock(readersMutex);
+      readers.erase(connectionId);
+      readerCount = readers.size();
+   }
+   log.info("reader", connectionId, "detached (", readerCount, "reader(s) )");
+   readersChangedCallback(readerCount, false);
+}
+
+void FrameRingPublisher::onCommandReceived(int connectionId, std::string_view command) {}
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "Sha1.h"
+#include "StringUtils.h"
+#include "WebSocketStream.h"
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using logging::Logger;
+using network::Connection;
+using network::OverflowPolicy;
+using network::SendQueueLimits;
+using network::SendQueueStatistics;
+using network::SharedBuffer;
+using utils::Sha1;
+using utils::String;
+using websocket::PayloadFormat;
+using websocket::WebSocketStream;
+
+#define CRLF                   "\r\n"
+#define WEBSOCKET_GUID         "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WEBSOCKET_VERSION      "13"
+
+#define OPCODE_BINARY   0x2
+#define OPCODE_CLOSE    0x8
+#define OPCODE_PING     0x9
+#define OPCODE_PONG     0xa
+
+#define FLAG_KEYFRAME   0x01
+
+#define CLOSE_STATUS_PROTOCOL_ERROR      1002
+#define CLOSE_STATUS_MESSAGE_TOO_BIG     1009
+
+// The clients are not expected to send anything but control messages.
+#define MAX_RECEIVED_MESSAGE_SIZE   (64 * 1024)
+
+// H.264: about 2 seconds of video, JPEG: always send the latest one
+#define MAX_QUEUED_ACCESS_UNITS       60
+#define MAX_QUEUED_ACCESS_UNIT_BYTES  (8 * 1024 * 1024)
+#define MAX_QUEUED_JPEGS              2
+#define MAX_QUEUED_JPEG_BYTES         (2 * 1024 * 1024)
+
+static void writeBigEndian(uint8_t* destination, uint64_t value, size_t byteCount) {
+   for (size_t index = 0; index < byteCount; index++) {
+      destination[index] = (value >> (8 * (byteCount - 1 - index))) & 0xff;
+   }
+}
+
+WebSocketStream::WebSocketStream(const std::string& name, PayloadFormat format, HttpServer& httpServer,
+                                 const std::string& path, ClientsChangedCallback callback)
+   : log(name.c_str()),
+     format(format),
+     httpServer(httpServer),
+     path(path),
+     clientsChangedCallback(callback),
+     frameNumber(0) {}
+
+WebSocketStream::~WebSocketStream() {
+   httpServer.removeRoutes(*this);
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      clients.clear();
+   }
+}
+
+void WebSocketStream::start() {
+   httpServer.addRoute(path, *this);
+}
+
+void WebSocketStream::send(const SharedBuffer& frame, int64_t timestamp_us, bool keyframe) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   frameNumber++;
+   if (clients.empty()) {
+      return;
+   }
+
+   // frame header of the WebSocket (unmasked, with extended payload length
+   // if required) followed by the message header
+   uint8_t header[10 + WEBSOCKET_FRAME_HEADER_SIZE];
+   size_t  headerSize  = 2;
+   size_t  payloadSize = WEBSOCKET_FRAME_HEADER_SIZE + frame.size();
+   header[0] = 0x80 | OPCODE_BINARY;   // FIN
+   if (payloadSize < 126) {
+      header[1] = payloadSize;
+   } else if (payloadSize <= 0xffff) {
+      header[1] = 126;
+      writeBigEndian(header + 2, payloadSize, 2);
+      headerSize += 2;
+   } else {
+      header[1] = 127;
+      writeBigEndian(header + 2, payloadSize, 8);
+      headerSize += 8;
+   }
+
+   uint8_t* messageHeader = header + headerSize;
+   messageHeader[0] = (uint8_t)format;
+   messageHeader[1] = keyframe ? FLAG_KEYFRAME : 0;
+   messageHeader[2] = 0;
+   messageHeader[3] = 0;
+   writeBigEndian(messageHeader + 4, frameNumber, 4);
+   writeBigEndian(messageHeader + 8, (uint64_t)timestamp_us, 8);
+
+   SharedBuffer headerBuffer = SharedBuffer::copyOf(header, headerSize + WEBSOCKET_FRAME_HEADER_SIZE);
+
+   for (auto& entry : clients) {
+      Client& client = entry.second;
+      if (client.closing) {
+         continue;
+      }
+      if (format == PayloadFormat::H264) {
+         uint64_t droppedFrames = client.connection->getSendQueueStatistics().droppedFrames;
+         if (droppedFrames != client.droppedFrames) {
+            client.droppedFrames      = droppedFrames;
+            client.waitingForKeyframe = true;
+         }
+         if (client.waitingForKeyframe) {
+            if (!keyframe) {
+               continue;
+            }
+            client.waitingForKeyframe = false;
+         }
+      }
+      client.connection->asyncSendFrame({headerBuffer, frame});
+   }
+}
+
+WebSocketStream::Result WebSocketStream::onRequest(const HttpRequest& request, 
+                                                   std::shared_ptr<Connection> connection,
+                                                   HttpResponse& response) {
+   if (request.method != "GET") {
+      response = HttpResponse::text(405, "only GET is supported\n");
+      response.headers.emplace_back("Allow", "GET");
+      return Result::RESPONDED;
+   }
+
+   std::string key     = request.getHeader("sec-websocket-key");
+   bool        upgrade = (String::toLowerCase(request.getHeader("upgrade")) == "websocket") &&
+                         (String::toLowerCase(request.getHeader("connection")).find("upgrade") != std::string::npos);
+
+   if ((request.version != "HTTP/1.1") || !upgrade || key.empty()) {
+      log.warning("rejecting request of connection", connection->getId(),
+                  "because it is not a WebSocket handshake");
+      response = HttpResponse::text(400, "WebSocket handshake expected\n");
+      return Result::RESPONDED;
+   }
+
+   if (request.getHeader("sec-websocket-version") != WEBSOCKET_VERSION) {
+      response = HttpResponse::text(426, "unsupported WebSocket version\n");
+      response.headers.emplace_back("Sec-WebSocket-Version", WEBSOCKET_VERSION);
+      return Result::RESPONDED;
+   }
+
+   // Dropping the newest access unit (instead of an already queued one)
+   // guarantees that no access unit gets sent whose reference is missing,
+   // as long as the client waits for the next keyframe after a drop.
+   SendQueueLimits limits;
+   if (format == PayloadFormat::H264) {
+      limits.maxQueuedFrames = MAX_QUEUED_ACCESS_UNITS;
+      limits.maxQueuedBytes  = MAX_QUEUED_ACCESS_UNIT_BYTES;
+      limits.overflowPolicy  = OverflowPolicy::DROP_NEWEST_FRAME;
+   } else {
+      limits.maxQueuedFrames = MAX_QUEUED_JPEGS;
+      limits.maxQueuedBytes  = MAX_QUEUED_JPEG_BYTES;
+      limits.overflowPolicy  = OverflowPolicy::DROP_OLDEST_FRAME;
+   }
+   connection->setSendQueueLimits(limits);
+   connection->setEgressStream((format == PayloadFormat::H264) ? "h264" : "mjpeg");
+
+   auto digest = Sha1::digest(key + WEBSOCKET_GUID);
+   std::ostringstream handshakeResponse;
+   handshakeResponse << "HTTP/1.1 101 Switching Protocols" << CRLF;
+   handshakeResponse << "Upgrade: websocket" << CRLF;
+   handshakeResponse << "Connection: Upgrade" << CRLF;
+   handshakeResponse << "Sec-WebSocket-Accept: " << String::toBase64(digest.data(), digest.size()) << CRLF << CRLF;
+
+   unsigned int clientCount = 0;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      // sent while holding the mutex, no message must get sent before it
+      connection->asyncSend(handshakeResponse.str());
+      clients[connection->getId()] = Client{connection, false, true, 0, ""};
+      clientCount = clients.size();
+   }
+   log.info("connection", connection->getId(), "upgraded to WebSocket");
+   clientsChangedCallback(clientCount, true);
+   return Result::UPGRADED;
+}
+
+void WebSocketStream::onConnectionClosed(int connectionId) {
+   bool                clientRemoved = false;
+   unsigned int        clientCount   = 0;
+   SendQueueStatistics statistics;
+   {
+      const std::lock_guard<std::mutex> lock(mutex);
+      auto entry = clients.find(connectionId);
+      if (entry != clients.end()) {
+         statistics    = entry->second.connection->getSendQueueStatistics();
+         clientRemoved = true;
+         clients.erase(entry);
+      }
+      clientCount = clients.size();
+   }
+   if (clientRemoved) {
+      log.info("connection", connectionId, "lost (sent frames:", statistics.sentFrames,
+               ", dropped frames:", statistics.droppedFrames, ")");
+      clientsChangedCallback(clientCount, false);
+   }
+}
+
+void WebSocketStream::onDataReceived(int connectionId, std::string_view data) {
+   const std::lock_guard<std::mutex> lock(mutex);
+   auto entry = clients.find(connectionId);
+   if (entry != clients.end()) {
+      entry->second.receivedData.append(data);
+      processReceivedData(entry->second);
+   }
+}
+void WebSocketStream::processReceivedData(Client& client) {
+   while (client.receivedData.size() >= 2) {
+      const uint8_t* data          = (const uint8_t*)client.receivedData.data();
+      size_t         availableSize = client.receivedData.size();
+      uint8_t        opcode        = data[0] & 0x0f;
+      bool           masked        = (data[1] & 0x80) != 0;
+      uint64_t       payloadSize   = data[1] & 0x7f;
+      size_t         headerSize    = 2;
+
+      if (payloadSize == 126) {
+         if (availableSize < 4) {
+            return;
+         }
+         payloadSize = (data[2] << 8) | data[3];
+         headerSize  = 4;
+      } else if (payloadSize == 127) {
+         if (availableSize < 10) {
+            return;
+         }
+         payloadSize = 0;
+         for (size_t index = 2; index < 10; index++) {
+            payloadSize = (payloadSize << 8) | data[index];
+         }
+         headerSize = 10;
+      }
+
+      // frames sent by a client have to be masked
+      uint16_t closeStatus = !masked ? CLOSE_STATUS_PROTOCOL_ERROR :
+                             (payloadSize > MAX_RECEIVED_MESSAGE_SIZE) ? CLOSE_STATUS_MESSAGE_TOO_BIG : 0;
+      if (closeStatus != 0) {
+         log.warning("closing WebSocket of connection", client.connection->getId(), "with status",
+                     closeStatus);
+         if (!client.closing) {
+            uint8_t status[2] = {(uint8_t)(closeStatus >> 8), (uint8_t)(closeStatus & 0xff)};
+            sendControlMessage(client, OPCODE_CLOSE, std::string_view((const char*)status, 2));
+            client.closing = true;
+         }
+         client.receivedData.clear();
+         return;
+      }
+
+      size_t frameSize = headerSize + 4 + payloadSize;
+      if (availableSize < frameSize) {
+         return;
+      }
+
+      const uint8_t* mask = data + headerSize;
+      std::string    payload((const char*)data + headerSize + 4, payloadSize);
+      for (size_t index = 0; index < payload.size(); index++) {
+         payload[index] ^= mask[index % 4];
+      }
+      client.receivedData.erase(0, frameSize);
+
+      if (opcode == OPCODE_CLOSE) {
+         // The client is expected to close the TCP connection after
+         // receiving the echoed close message.
+         if (!client.closing) {
+            sendControlMessage(client, OPCODE_CLOSE, std::string_view(payload).substr(0, 2));
+            client.closing = true;
+         }
+      } else if ((opcode == OPCODE_PING) && !client.closing) {
+         sendControlMessage(client, OPCODE_PONG, payload);
+      }
+   }
+}
+
+void WebSocketStream::sendControlMessage(Client& client, uint8_t opcode, std::string_view payload) {
+   // the payload of control messages is limited to 125 bytes
+   std::string message;
+   message.push_back((char)(0x80 | opcode));
+   message.push_back((char)std::min(payload.size(), (size_t)125));
+   message.append(payload.substr(0, 125));
+   client.connection->asyncSend(message);
+}
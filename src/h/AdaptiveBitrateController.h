@@ -0,0 +1,110 @@
+#ifndef ADAPTIVEBITRATECONTROLLER_H
+#define ADAPTIVEBITRATECONTROLLER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Logging.h"
+#include "TransportStatistics.h"
+
+typedef std::function<void(unsigned int bitrate)> BitrateSetter;   // bits per second
+
+/**
+ * Congestion state of one client of the stream.
+ */
+struct CongestionSample {
+   network::TransportStatistics transport;
+   bool                         transportAvailable = false;   // false for Unix domain sockets
+   size_t                       queuedBytes        = 0;       // in the send queue of the connection
+};
+
+/**
+ * Adapts the bitrate of the encoder to the worst client. All clients get
+ * the same stream, therefore a single congested client lowers the bitrate
+ * for all of them.
+ *
+ * A client is congested if its backlog (send queue, unsent bytes in the
+ * socket and the data in flight beyond what the path holds at the current 
+ * bitrate within the lowest RTT) exceeds what the current bitrate produces in
+ * BACKLOG_HIGH or if its RTT grew well beyond the lowest RTT measured. It is
+ * clear if the backlog is below BACKLOG_LOW and the RTT is close to the
+ * lowest one. In between the bitrate stays unchanged (hysteresis).
+ *
+ * The bitrate decreases multiplicatively (or to the measured delivery rate
+ * of the client if that is not limited by the sender) after two congested
+ * samples in a row, unless the backlog is already shrinking. It increases in
+ * small steps after all clients have been clear for a while.
+ *
+ * The decisions get logged and exposed as metrics. This class is thread-safe.
+ */
+class AdaptiveBitrateController {
+   public:
+      typedef std::chrono::steady_clock Clock;
+
+      /**
+       * Calls the setter with the maxBitrate (the initial bitrate).
+       */
+      AdaptiveBitrateController(unsigned int minBitrate, unsigned int maxBitrate, BitrateSetter setter);
+
+      /**
+       * Gets called periodically with the samples of all clients.
+       */
+      void update(const std::vector<CongestionSample>& samples, Clock::time_point now);
+
+      unsigned int getBitrate();
+
+      unsigned int getMaxBitrate();
+
+      /**
+       * Changes the upper bound of the adaptation (e.g. requested by a client)
+       * and continues with this bitrate. The lower bound follows if it is
+       * above the new maximum.
+       */
+      void setMaxBitrate(unsigned int newMaxBitrate);
+
+      /**
+       * Appends the metrics in the Prometheus text format.
+       */
+      void writeMetrics(std::ostream& output);
+
+      /**
+       * Parses "<min kbit/s>-<max kbit/s>" from the env var. Returns false (and
+       * logs a warning) if it is invalid, the bitrates stay untouched in this
+       * case.
+       */
+      static bool parseBitrateRange(const char* envVarName, unsigned int& minBitrate, unsigned int& maxBitrate);
+
+   private:
+      enum class ClientState { CLEAR, NEUTRAL, CONGESTED };
+
+      ClientState classify(const CongestionSample& sample) const;
+
+      /**
+       * The caller has to hold the mutex.
+       */
+      uint64_t getBacklogBytes(const CongestionSample& sample) const;
+
+      void changeBitrate(unsigned int newBitrate, const std::string& reason, Clock::time_point now);
+
+      logging::Logger   log;
+      unsigned int      minBitrate;
+      unsigned int      maxBitrate;
+      BitrateSetter     setter;
+      unsigned int      bitrate;
+      unsigned int      congestedSampleCount;   // in a row
+      bool              clear;
+      Clock::time_point clearSince;
+      Clock::time_point lastChange;
+      uint64_t          decreaseCount;
+      uint64_t          increaseCount;
+      unsigned int      congestedClientCount;   // of the last update
+      uint64_t          lastMaxBacklogBytes;    // of the last update
+      std::mutex        mutex;
+};
+#endif
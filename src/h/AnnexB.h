@@ -0,0 +1,36 @@
+#ifndef ANNEXB_H
+#define ANNEXB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define NAL_TYPE_NON_IDR_SLICE   1
+#define NAL_TYPE_IDR_SLICE       5
+#define NAL_TYPE_SEI             6
+#define NAL_TYPE_SPS             7
+#define NAL_TYPE_PPS             8
+#define NAL_TYPE_AUD             9
+
+namespace h264 {
+
+   /**
+    * Position of a NAL unit (without start code) in an Annex B byte stream.
+    */
+   struct NalUnitPosition {
+      size_t  offset;
+      size_t  size;
+      uint8_t type;
+   };
+
+   class AnnexB {
+      public:
+         /**
+          * Replaces the content of nalUnits with the positions of the NAL units
+          * in the provided Annex B byte stream (e.g. an access unit of the 
+          * encoder). Trailing zero bytes do not belong to a NAL unit.
+          */
+         static void findNalUnits(const uint8_t* data, size_t size, std::vector<NalUnitPosition>& nalUnits);
+   };
+}
+#endif
@@ -0,0 +1,112 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "Logging.h"
+
+namespace network {
+   
+   struct BufferPoolStatistics {
+      uint64_t allocations       = 0;   // total number of requested blocks
+      uint64_t heapAllocations   = 0;   // requests that could not get served by the pool
+      uint64_t discardedBlocks   = 0;   // released blocks freed because of the high-water mark
+      size_t   retainedBytes     = 0;   // bytes of the blocks waiting for reuse
+      size_t   outstandingBytes  = 0;   // bytes of the blocks currently in use
+   };
+   
+   struct SizeClassStatistics {
+      uint64_t reusedBlocks    = 0;   // requests served by the pool
+      uint64_t heapAllocations = 0;   // requests allocated from the heap
+   };
+   
+   /**
+    * Recycles memory blocks of the network layer (payload buffers and the 
+    * control blocks of the std::shared_ptrs referencing them) to avoid heap 
+    * allocations while streaming. 
+    *
+    * The requested size gets rounded up to the next power of two (size class).
+    * Released blocks are kept for reuse as long as the retained bytes do not 
+    * exceed maxRetainedBytes (high-water mark). Blocks bigger than the largest
+    * size class get allocated from the heap directly.
+    *
+    * This class is thread-safe.
+    */
+   class BufferPool {
+      public:
+         BufferPool(size_t maxRetainedBytes);
+         
+         ~BufferPool();
+         
+         /**
+          * The pool used by SharedBuffer. It never gets destroyed because 
+          * buffers might get released during the shutdown of the process.
+          */
+         static BufferPool& getDefault();
+         
+         /**
+          * Returns a buffer providing at least size bytes. It returns to the 
+          * pool as soon as the last reference to it got released.
+          */
+         std::shared_ptr<uint8_t> allocate(size_t size);
+         
+         void* acquireBlock(size_t size);
+         
+         void releaseBlock(void* block, size_t size);
+         
+         BufferPoolStatistics getStatistics();
+         
+         /**
+          * Appends the metrics in the Prometheus text format.
+          */
+         void writeMetrics(std::ostream& output);
+         
+      private:
+         static int getSizeClass(size_t size);
+         
+         logging::Logger                  log;
+         size_t                           maxRetainedBytes;
+         std::vector<std::vector<void*>>  freeBlocks;   // per size class
+         BufferPoolStatistics             statistics;
+         std::vector<SizeClassStatistics> sizeClassStatistics;   // the last one of the bigger blocks
+         bool                             highWaterMarkReached;
+         std::mutex                       mutex;
+   };
+   
+   /**
+    * Allocator for the control blocks of std::shared_ptrs (e.g. 
+    * std::shared_ptr(pointer, deleter, PoolAllocator<T>(pool))).
+    */
+   template<typename T> class PoolAllocator {
+      public:
+         typedef T value_type;
+         
+         PoolAllocator(BufferPool& pool) : pool(&pool) {}
+         
+         template<typename U> PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+         
+         T* allocate(size_t count) {
+            return static_cast<T*>(pool->acquireBlock(count * sizeof(T)));
+         }
+         
+         void deallocate(T* pointer, size_t count) {
+            pool->releaseBlock(pointer, count * sizeof(T));
+         }
+         
+         template<typename U> bool operator==(const PoolAllocator<U>& other) const {
+            return pool == other.pool;
+         }
+         
+         template<typename U> bool operator!=(const PoolAllocator<U>& other) const {
+            return pool != other.pool;
+         }
+         
+         BufferPool* pool;
+   };
+}
+#endif
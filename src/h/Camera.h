@@ -1,9 +1,12 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <vector>
 
 #include "libcamera/camera.h"
@@ -16,9 +19,17 @@
 #include "DmaHeap.h"
 #include "Logging.h"
 
+/**
+ * Keeps the frame buffers of a completed request from getting reused. The
+ * request gets queued again as soon as the last copy of its lease got 
+ * destroyed.
+ */
+typedef std::shared_ptr<void> FrameLease;
+
 typedef std::function<void(libcamera::FrameBuffer *highResolutionFrameBuffer, 
                            libcamera::FrameBuffer *lowResolutionFrameBuffer,
-                           int64_t timestamp)> FrameConsumer;
+                           int64_t timestamp,
+                           const FrameLease& lease)> FrameConsumer;
 
 enum StreamType { HIGH_RESOLUTION = 0, LOW_RESOLUTION = 1 };
 
@@ -38,7 +49,8 @@ class Camera {
       /**
        * Starts the camera and returns true if success, otherwise false.
        * The frameConsumer needs to be fast enough to finish between two 
-       * frames, otherwise the frame rate degrades.
+       * frames, otherwise the frame rate degrades. Consumers keeping a copy 
+       * of the lease delay the reuse of the frame buffers.
        */      
       bool start(FrameConsumer frameConsumer);
       
@@ -58,6 +70,12 @@ class Camera {
        */
       libcamera::StreamConfiguration const & getStreamConfiguration(StreamType streamType);
       
+      /**
+       * Returns the frame buffers of the stream identified by HIGH_RESOLUTION or LOW_RESOLUTION
+       * in the order of the requests (the index of a buffer is the index of its request).
+       */
+      std::vector<libcamera::FrameBuffer*> getFrameBuffers(StreamType streamType);
+      
    private:
       bool initialize();
       
@@ -67,6 +85,8 @@ class Camera {
       
       void enqueueRequest(libcamera::Request *request);
       
+      void releaseLease(libcamera::Request *request);
+      
       /**
        * Gets called by the capabilities to change the value(s) of control(s).
        */
@@ -83,10 +103,14 @@ class Camera {
       FrameConsumer                                        frameConsumer;
       std::mutex                                           pendingRequestsMutex;
       std::mutex                                           controlsToSetMutex;
+      std::mutex                                           leasesMutex;
+      std::mutex                                           stateMutex;   // started and (re)queuing of requests
+      std::condition_variable                              leaseReleased;
       DmaHeap                                              dmaHeap;
-      bool                                                 started;
+      std::atomic<bool>                                    started;
       bool                                                 initialized;
       int                                                  pendingRequests;
+      std::set<libcamera::Request*>                        leasedRequests;   // guarded by leasesMutex
 };
 
 #endif
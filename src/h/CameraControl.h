@@ -1,18 +1,52 @@
 #ifndef CAMERACONTROL_H
 #define CAMERACONTROL_H
 
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+
 #include "Camera.h"
 #include "CameraCapabilities.h"
+#include "EncoderControl.h"
+#include "HttpServer.h"
 #include "Logging.h"
 #include "RemoteControl.h"
 
+/**
+ * Provides the capabilities and current values of the camera controls and 
+ * executes setControl commands received via the RemoteControl or via 
+ * "/controls" of the HttpServer (GET returns the capabilities and current 
+ * values messages as JSON array, POST executes the command in the body).
+ *
+ * "/events" streams the messages as Server-Sent Events ("capabilities" and
+ * "currentValues" events, the data is the message) to any number of 
+ * subscribers. A new subscriber receives the latest messages first. Each 
+ * event gets serialized once for all subscribers. Subscribers that can't 
+ * keep up skip outdated currentValues events.
+ *
+ * The parameters of the registered encoders (see EncoderControl) get 
+ * advertised in the same way as the camera controls (encoderCapabilities 
+ * message and event) and setEncoder commands change them while streaming.
+ */
 class CameraControl :   public capabilities::CameraCapabilities::Listener, 
-                        public remotecontrol::RemoteControl::Listener {
+                        public remotecontrol::RemoteControl::Listener,
+                        public http::RequestHandler {
    public:
-      CameraControl(Camera &camera);
+      CameraControl(Camera &camera, http::HttpServer& httpServer);
+      
+      ~CameraControl();
    
       void start();
       
+      /**
+       * Registers the encoder with the provided name ("h264" or "jpeg"). A
+       * nullptr removes it (the encoder must not get used anymore as soon as
+       * this method returns).
+       */
+      void setEncoderControl(const std::string& name, EncoderControl* control);
+      
       // CameraCapabilities listener callbacks
       void onCapabilitiesChanged(std::map<std::string, 
             capabilities::CameraCapabilities::Properties>& capabilities) override;
@@ -24,24 +58,63 @@ class CameraControl :   public capabilities::CameraCapabilities::Listener,
       
       void onConnectionClosed() override;
       
-      void onCommandReceived(const std::string& command) override;
+      void onCommandReceived(std::string_view command) override;
+      
+      // RequestHandler callbacks
+      Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                       http::HttpResponse& response) override;
+      
+      void onConnectionClosed(int connectionId) override;
+      
+      void writeMetrics(std::ostream& output) override;
       
    private:
+      enum class CommandResult { EXECUTED, UNKNOWN_COMMAND, FAILED };
+      
+      static network::SharedBuffer createEvent(const std::string& type, const std::string& message);
+      
+      /**
+       * The caller has to hold the messagesMutex.
+       */
+      void publishEvent(const network::SharedBuffer& event, bool droppable);
+      
+      CommandResult executeCommand(std::string_view command);
+      
       void sendCapabilitiesMessage();
       
       void sendCurrentValuesMessage();
       
+      void sendEncoderCapabilitiesMessage();
+      
+      /**
+       * Queries the parameters of all encoders and publishes them. The caller
+       * has to hold the encodersMutex.
+       */
+      void updateEncoderCapabilities();
+      
       std::string encodeCapabilities(std::map<std::string, 
             capabilities::CameraCapabilities::Properties>& capabilities) const;
       
       std::string encodeCurrentValues(const std::map<std::string, float>& currentValues) const;
       
+      std::string encodeEncoderCapabilities() const;
+      
       std::string error(const std::string& message);
       
       logging::Logger                  log;
       Camera &                         camera;
+      http::HttpServer&                httpServer;
       std::optional<std::string>       capabilitiesMessage;
       std::optional<std::string>       currentValuesMessage;
+      std::optional<std::string>       encoderCapabilitiesMessage;
+      std::map<std::string, float>     currentValues;
+      network::SharedBuffer            capabilitiesEvent;
+      network::SharedBuffer            currentValuesEvent;
+      network::SharedBuffer            encoderCapabilitiesEvent;
+      std::map<int, std::shared_ptr<network::Connection>> eventSubscribers;
+      std::mutex                       messagesMutex;   // messages, events and subscribers
+      std::map<std::string, EncoderControl*> encoderControls;
+      std::mutex                       encodersMutex;   // gets locked before the messagesMutex
       bool                             capabilitiesMessageNotYetSent;
       bool                             remoteControlConnected;
       remotecontrol::RemoteControl     remoteControl;
@@ -1,6 +1,7 @@
 #ifndef CPU_JPEG_ENCODER_H
 #define CPU_JPEG_ENCODER_H
 
+#include <atomic>
 #include <cstdint>
 #include <stdio.h>
 // stdio.h needs to get included before jpeglib.h 
@@ -43,6 +44,13 @@ class CpuJpegEncoder : public JpegEncoder {
        */
       void encode(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us) override;
       
+      std::map<std::string, EncoderParameter> getEncoderParameters() override;
+
+      /**
+       * The new quality applies to the next frame.
+       */
+      Result setEncoderParameter(const std::string& name, int value) override;
+      
    private:
       logging::Logger             log;
       struct jpeg_error_mgr       jerr;
@@ -50,6 +58,9 @@ class CpuJpegEncoder : public JpegEncoder {
       unsigned int                inputHeight;
       unsigned int                inputStride;
       bool                        firstFrame;
+      int                         initialQuality;
+      int                         quality;            // used by encode
+      std::atomic<int>            requestedQuality;
       JpegOutputReadyCallback     outputReadyCallback;
 };
 
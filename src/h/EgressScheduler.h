@@ -0,0 +1,126 @@
+#ifndef EGRESSSCHEDULER_H
+#define EGRESSSCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "Logging.h"
+#include "TokenBucket.h"
+
+namespace network {
+
+   /**
+    * Byte rates of the egress traffic. 0 means unlimited.
+    */
+   struct EgressLimits {
+      uint64_t                        linkBytesPerSecond   = 0;   // all connections together
+      uint64_t                        clientBytesPerSecond = 0;   // each stream connection
+      std::map<std::string, uint64_t> streamBytesPerSecond;       // all connections of a stream
+
+      /**
+       * Parses a comma separated list of <name>:<kbit/s> where name is "link",
+       * "client" or the name of a stream ("h264" or "mjpeg"). Invalid entries
+       * get logged and ignored.
+       */
+      static EgressLimits fromEnvironment(const char* envVarName);
+   };
+
+   class EgressBudget;
+
+   /**
+    * Shares the uplink between the streams and the control traffic (remote
+    * control, HTTP requests). Each connection gets an EgressBudget.
+    *
+    * The droppable frames of a stream connection have to conform to the
+    * token buckets of the client, of the stream and of the link, otherwise
+    * they get dropped as a whole. Control traffic and the frames that must not
+    * get dropped (e.g. protocol headers) never get held back, but they consume
+    * the tokens nevertheless. Therefore control traffic has strict priority:
+    * the streams get the rest of the link budget.
+    *
+    * The process-wide instance gets configured via the environment variable
+    * OCTOWATCH_EGRESS_LIMITS. The methods can get called by any thread.
+    */
+   class EgressScheduler {
+      public:
+         static EgressScheduler& get();
+
+         EgressScheduler(const EgressLimits& limits);
+
+         /**
+          * The budget must not outlive the scheduler.
+          */
+         std::shared_ptr<EgressBudget> createStreamBudget(const std::string& streamName);
+
+         std::shared_ptr<EgressBudget> createControlBudget();
+
+         /**
+          * Appends the metrics in the Prometheus text format.
+          */
+         void writeMetrics(std::ostream& output);
+
+      private:
+         friend class EgressBudget;
+
+         struct Stream {
+            std::unique_ptr<TokenBucket> bucket;          // nullptr if unlimited
+            bool                         control       = false;
+            uint64_t                     sentFrames    = 0;
+            uint64_t                     sentBytes     = 0;
+            uint64_t                     droppedFrames = 0;
+            uint64_t                     droppedBytes  = 0;
+         };
+
+         static std::unique_ptr<TokenBucket> createBucket(uint64_t bytesPerSecond);
+
+         Stream& getStream(const std::string& streamName);
+
+         bool admit(Stream& stream, TokenBucket* clientBucket, size_t bytes, TokenBucket::Clock::time_point now);
+
+         void account(Stream& stream, TokenBucket* clientBucket, size_t bytes);
+
+         logging::Logger                 log;
+         EgressLimits                    limits;
+         std::unique_ptr<TokenBucket>    linkBucket;   // nullptr if unlimited
+         std::map<std::string, Stream>   streams;      // including "control"
+         std::mutex                      mutex;
+   };
+
+   /**
+    * The share of the egress budget of one connection.
+    */
+   class EgressBudget {
+      public:
+         /**
+          * Returns false if the droppable frame exceeds the budget. In this
+          * case it has to get dropped (it got counted as dropped).
+          */
+         bool admit(size_t bytes);
+
+         /**
+          * Same as admit(bytes) but at the provided time instead of now.
+          */
+         bool admit(size_t bytes, TokenBucket::Clock::time_point now);
+
+         /**
+          * Accounts traffic that must not get dropped.
+          */
+         void account(size_t bytes);
+
+      private:
+         friend class EgressScheduler;
+
+         EgressBudget(EgressScheduler& scheduler, EgressScheduler::Stream& stream,
+                      std::unique_ptr<TokenBucket> clientBucket);
+
+         EgressScheduler&             scheduler;
+         EgressScheduler::Stream&     stream;
+         std::unique_ptr<TokenBucket> clientBucket;   // nullptr if unlimited
+   };
+}
+#endif
@@ -0,0 +1,51 @@
+#ifndef ENCODERCONTROL_H
+#define ENCODERCONTROL_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * A parameter of an encoder as advertised to the clients. The range and
+ * the menu entries are the ones reported by the device.
+ */
+struct EncoderParameter {
+   std::string                type;           // "integer", "boolean" or "menu"
+   int                        minimum      = 0;
+   int                        maximum      = 0;
+   int                        step         = 1;
+   int                        defaultValue = 0;
+   int                        value        = 0;
+   std::map<int, std::string> menuEntries;    // valid values of a menu and their names
+
+   /**
+    * Returns true if the value is within the range, a multiple of the step
+    * and (in case of a menu) one of its entries.
+    */
+   bool accepts(int value) const {
+      if ((value < minimum) || (value > maximum) || (((int64_t)value - minimum) % step != 0)) {
+         return false;
+      }
+      return (type != "menu") || (menuEntries.find(value) != menuEntries.end());
+   }
+};
+
+/**
+ * Changes the parameters of a running encoder (e.g. bitrate or JPEG
+ * quality) without restarting it. The methods can get called by any thread.
+ */
+class EncoderControl {
+   public:
+      enum class Result { APPLIED, UNKNOWN_PARAMETER, INVALID_VALUE, FAILED };
+
+      virtual ~EncoderControl() = default;
+
+      /**
+       * Provides the supported parameters by their names.
+       */
+      virtual std::map<std::string, EncoderParameter> getEncoderParameters() = 0;
+
+      virtual Result setEncoderParameter(const std::string& name, int value) = 0;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef ENCODEROUTPUTBUFFERS_H
+#define ENCODEROUTPUTBUFFERS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "Logging.h"
+
+typedef std::function<void()> RequeueFunction;
+
+/**
+ * Lends the memory mapped output buffers of an encoder to the consumers of
+ * the encoded data (e.g. the connections sending it). An output buffer gets
+ * given back to the encoder (by executing its requeue function) as soon as
+ * the last reference to its data got released.
+ *
+ * If maxLentBuffers are already lent, the data gets copied and the output
+ * buffer gets requeued immediately to keep the encoder running.
+ *
+ * The output buffers get mapped by this class because their mappings have to
+ * outlive the encoder if consumers still use lent buffers after closing.
+ */
+class EncoderOutputBuffers {
+   public:
+      EncoderOutputBuffers(const char* name, unsigned int maxLentBuffers);
+
+      /**
+       * Maps the buffer of the device (see mmap) and returns its address or
+       * MAP_FAILED. The mapping gets removed as soon as this instance got
+       * destroyed and all lent buffers got released.
+       */
+      void* map(int fileDescriptor, size_t length, off_t offset);
+
+      /**
+       * Returns a reference to the provided data. The requeue function gets
+       * executed as soon as the reference is no longer used by anyone.
+       */
+      std::shared_ptr<const uint8_t> lend(void *data, size_t bytesCount, RequeueFunction requeue);
+
+      /**
+       * Waits (at most 3 seconds) until all lent buffers got released. The
+       * requeue functions of buffers released afterwards do not get executed
+       * anymore. Requeue functions already executing get waited for.
+       */
+      void close();
+
+   private:
+      struct Mapping {
+         void*  address;
+         size_t length;
+      };
+
+      struct State {
+         ~State();
+
+         std::mutex              mutex;
+         std::condition_variable bufferReleased;
+         unsigned int            lentBufferCount;
+         unsigned int            requeuesInProgress;
+         bool                    closed;
+         std::vector<Mapping>    mappings;
+      };
+
+      logging::Logger        log;
+      unsigned int           maxLentBuffers;
+      std::shared_ptr<State> state;
+};
+
+#endif
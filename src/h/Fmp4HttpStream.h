@@ -0,0 +1,66 @@
+#ifndef FMP4HTTPSTREAM_H
+#define FMP4HTTPSTREAM_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "Fmp4Muxer.h"
+#include "HttpServer.h"
+#include "Logging.h"
+#include "SharedBuffer.h"
+
+/**
+ * Sends the H.264 stream as fragmented MP4 (see Fmp4Muxer) in the body of 
+ * the response to "/h264.mp4" of the HttpServer. Browsers can play it via Media Source Extensions (codec
+ * string from the init segment, e.g. 'video/mp4; codecs="avc1.640028"'). 
+ * Each client receives the init segment followed by the fragments, starting
+ * with a keyframe. The fragments get muxed only once for all clients. 
+ *
+ * The number of frames per fragment is defined by the env var 
+ * OCTOWATCH_FMP4_FRAMES_PER_FRAGMENT (default 1).
+ */
+class Fmp4HttpStream : public http::RequestHandler {
+   public:
+      /**
+       * Gets called with the number of streaming clients whenever a client 
+       * started (clientAdded = true) or stopped streaming.
+       */
+      typedef std::function<void(unsigned int clientCount, bool clientAdded)> ClientsChangedCallback;
+      
+      Fmp4HttpStream(http::HttpServer& httpServer, unsigned int width, unsigned int height, 
+                     ClientsChangedCallback callback);
+      
+      ~Fmp4HttpStream();
+      
+      void start();
+      
+      /**
+       * Must not get called concurrently.
+       */
+      void send(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe);
+      
+      // callbacks of the RequestHandler interface
+      Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                       http::HttpResponse& response) override;
+
+      void onConnectionClosed(int connectionId) override;
+      
+   private:
+      struct Client {
+         std::shared_ptr<network::Connection> connection;
+         bool                                 waitingForKeyframe;
+      };
+      
+      static unsigned int getConfiguredFramesPerFragment();
+      
+      logging::Logger                     log;
+      http::HttpServer&                   httpServer;
+      std::map<int, Client>               clients;
+      std::mutex                          clientsMutex;
+      mp4::Fmp4Muxer                      muxer;
+      ClientsChangedCallback              clientsChangedCallback;
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef FMP4MUXER_H
+#define FMP4MUXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AnnexB.h"
+#include "SharedBuffer.h"
+
+#define FMP4_TIMESCALE   90000
+
+namespace mp4 {
+
+   struct Fmp4Fragment {
+      network::SharedBuffer data;                 // moof + mdat
+      bool                  startsWithKeyframe;
+      uint64_t              decodeTime;           // in FMP4_TIMESCALE units
+      uint64_t              duration;             // in FMP4_TIMESCALE units
+      unsigned int          sampleCount;
+   };
+
+   /**
+    * Muxes H.264 access units (Annex B byte stream) into fragmented MP4
+    * (ISO/IEC 14496-12, CMAF compatible) with a single video track.
+    *
+    * The init segment (ftyp + moov) gets created from the SPS and PPS of the
+    * first keyframe. Each fragment (moof + mdat) contains framesPerFragment
+    * access units, a keyframe always starts a new fragment. The decode time
+    * of a sample is derived from the timestamp of its access unit and its
+    * duration from the timestamp of the following one. Therefore a fragment
+    * gets completed as soon as the first access unit of the next fragment got
+    * added, which delays the output by one frame. There are no B-frames, so
+    * the presentation time equals the decode time.
+    *
+    * This class is not thread-safe.
+    */
+   class Fmp4Muxer {
+      public:
+         Fmp4Muxer(unsigned int width, unsigned int height, unsigned int framesPerFragment);
+
+         /**
+          * Returns true if the provided fragment got filled with a completed
+          * fragment. Access units preceding the first keyframe (after 
+          * creation or reset) get dropped.
+          */
+         bool add(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe,
+                  Fmp4Fragment& fragment);
+
+         /**
+          * Returns an empty buffer if no keyframe was added so far.
+          */
+         network::SharedBuffer getInitSegment() const;
+
+         /**
+          * Drops the access units of the incomplete fragment. The next fragment
+          * starts with the next keyframe.
+          */
+         void reset();
+
+      private:
+         struct Sample {
+            size_t   offset;       // in mdatPayload
+            size_t   size;
+            int64_t  decodeTime;   // in FMP4_TIMESCALE units
+            uint32_t duration;
+            bool     keyframe;
+         };
+
+         void createInitSegment(const std::string& sps, const std::string& pps);
+
+         void createFragment(Fmp4Fragment& fragment);
+
+         unsigned int                       width;
+         unsigned int                       height;
+         unsigned int                       framesPerFragment;
+         network::SharedBuffer              initSegment;
+         std::vector<Sample>                samples;
+         std::vector<h264::NalUnitPosition> nalUnits;
+         std::vector<uint8_t>               mdatPayload;
+         std::vector<uint8_t>               moof;
+         int64_t                            firstTimestamp_us;
+         uint32_t                           sequenceNumber;
+   };
+}
+#endif
@@ -0,0 +1,114 @@
+#ifndef FRAMEGRABBER_H
+#define FRAMEGRABBER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "libcamera/framebuffer.h"
+
+#include "Camera.h"
+#include "Logging.h"
+#include "TcpServer.h"
+
+#define FRAME_GRABBER_MAX_LEASED_FRAMES   2
+
+namespace sharedmemory {
+
+   /**
+    * Hands out the dmabufs of the raw YUV420 frames captured by the camera
+    * to local processes connecting to a Unix domain socket. The frames do
+    * not get copied.
+    *
+    * Protocol (line based):
+    *
+    *    reader  -> service: "subscribe <low|high>\n"
+    *    service -> reader:  "buffer <index> <count> <width> <height> <stride> <size>\n"
+    *                        once per buffer, each line carries the dmabuf
+    *                        file descriptor (SCM_RIGHTS)
+    *    service -> reader:  "frame <index> <timestamp in us>\n"
+    *                        for each new frame
+    *    reader  -> service: "release <index>\n"
+    *                        as soon as the reader is done with the frame
+    *
+    * The request of a frame gets queued again when all readers released it.
+    * A reader holds at most one frame at a time, new frames get skipped for
+    * it until it released the previous one. To keep the camera running, at
+    * most FRAME_GRABBER_MAX_LEASED_FRAMES frames are held by readers; frames
+    * exceeding this limit get skipped for all readers. Closing the connection
+    * releases the held frame.
+    */
+   class FrameGrabber : network::TcpServer::Listener {
+      public:
+         /**
+          * Gets called with the number of attached readers whenever a reader
+          * attached (readerAttached = true) or detached.
+          */
+         typedef std::function<void(unsigned int readerCount, bool readerAttached)> ReadersChangedCallback;
+
+         FrameGrabber(const std::string& socketPath, Camera& camera, unsigned int maxReaders,
+                      ReadersChangedCallback callback);
+
+         ~FrameGrabber();
+
+         void start();
+
+         /**
+          * Offers the frame to all subscribed readers that do not hold a frame.
+          */
+         void onNewFrame(libcamera::FrameBuffer *highResolutionFrameBuffer, int64_t timestamp,
+                         const FrameLease& lease);
+
+         // callbacks of the listener interface of the TcpServer
+         void onNewConnection(std::shared_ptr<network::Connection> connection) override;
+
+         void onConnectionClosed(int connectionId) override;
+
+         void onCommandReceived(int connectionId, std::string_view command) override;
+
+      private:
+         struct StreamInfo {
+            std::vector<libcamera::FrameBuffer*> buffers;
+            unsigned int                         width;
+            unsigned int                         height;
+            unsigned int                         stride;
+            unsigned int                         frameSize;
+         };
+
+         struct Reader {
+            std::shared_ptr<network::Connection> connection;
+            bool                                 subscribed    = false;
+            int                                  heldIndex     = -1;
+            uint64_t                             skippedFrames = 0;
+         };
+
+         struct LeasedFrame {
+            FrameLease    lease;
+            std::set<int> holders;
+         };
+
+         void subscribe(int connectionId, StreamType streamType);
+
+         /**
+          * Returns the lease that needs to get destroyed (after unlocking the mutex)
+          * if the reader was the last one holding the frame.
+          */
+         FrameLease releaseHeldFrame(Reader& reader, int connectionId);
+
+         logging::Logger                     log;
+         std::string                         socketPath;
+         unsigned int                        maxReaders;
+         StreamInfo                          streams[2];
+         ReadersChangedCallback              readersChangedCallback;
+         std::unique_ptr<network::TcpServer> tcpServer;
+         std::map<int, Reader>               readers;
+         std::map<int, LeasedFrame>          leasedFrames;
+         std::mutex                          mutex;
+   };
+}
+#endif
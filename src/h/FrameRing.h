@@ -0,0 +1,102 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Logging.h"
+
+#define FRAME_RING_MAGIC     0x4f575246   // "FRWO"
+#define FRAME_RING_VERSION   1
+
+#define FRAME_FLAG_KEYFRAME  0x1
+
+namespace sharedmemory {
+   
+   static_assert(std::atomic<uint64_t>::is_always_lock_free, "atomics in shared memory have to be lock-free");
+   
+   /**
+    * Describes a published frame. The slot of the frame with sequence number n
+    * is slots[n % slotCount].
+    */
+   struct FrameSlot {
+      std::atomic<uint64_t> sequence;     // sequence number of the frame described by this slot
+      uint64_t              position;     // absolute byte position of the frame in the data stream
+      uint64_t              offset;       // offset of the payload relative to the data area
+      uint64_t              size;         // size of the payload in bytes
+      int64_t               timestamp_us;
+      uint32_t              flags;        // FRAME_FLAG_*
+      uint32_t              reserved;
+   };
+   
+   /**
+    * Located at the beginning of the shared memory, followed by slotCount
+    * FrameSlots and the data area (starting at dataOffset).
+    */
+   struct FrameRingHeader {
+      uint32_t              magic;
+      uint32_t              version;
+      uint32_t              slotCount;
+      uint32_t              reserved;
+      uint64_t              dataOffset;
+      uint64_t              dataSize;
+      std::atomic<uint64_t> writeSequence;   // sequence number of the next frame (0 = none published yet)
+      std::atomic<uint64_t> tailPosition;    // data before this absolute position got (or gets) overwritten
+   };
+   
+   /**
+    * Single-producer, multi-consumer ring buffer of frames in a memfd. The 
+    * writer never waits for readers, therefore readers that are too slow 
+    * miss frames (overrun).
+    *
+    * Reader protocol (lock-free, without copying the payload):
+    *  1. wait until writeSequence > n (n = sequence number of the next frame)
+    *  2. if writeSequence - n > slotCount, the frame got overwritten -> continue with writeSequence - 1
+    *  3. slot = slots[n % slotCount]; if slot.sequence != n (acquire) -> overrun
+    *  4. consume the payload at dataOffset + slot.offset
+    *  5. acquire fence; if slot.sequence != n or tailPosition > slot.position
+    *     the payload got overwritten while consuming it -> discard the result
+    *
+    * The writer keeps its own copy of the layout and the sequence number, it
+    * never reads the shared memory (readers must not be able to make it write
+    * out of bounds). Readers get a read-only file descriptor.
+    *
+    * This class is not thread-safe (single writer).
+    */
+   class FrameRing {
+      public:
+         FrameRing(const char* name, size_t dataSize, uint32_t slotCount);
+         
+         ~FrameRing();
+         
+         /**
+          * Returns false if the frame could not get published (e.g. because 
+          * it's bigger than the data area).
+          */
+         bool publish(const uint8_t* data, size_t size, int64_t timestamp_us, bool keyframe);
+         
+         /**
+          * Read-only file descriptor of the memfd for the readers (sealed 
+          * against resizing and new writable mappings).
+          */
+         int getFileDescriptor() const;
+         
+         size_t getSize() const;
+         
+      private:
+         logging::Logger   log;
+         int               fd;
+         int               readOnlyFd;
+         size_t            totalSize;
+         uint8_t*          memory;
+         FrameRingHeader*  header;
+         FrameSlot*        slots;
+         uint8_t*          data;
+         uint64_t          dataSize;
+         uint32_t          slotCount;
+         uint64_t          writeSequence;   // sequence number of the next frame
+         uint64_t          writePosition;   // absolute position where the next frame starts
+   };
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef FRAMERINGPUBLISHER_H
+#define FRAMERINGPUBLISHER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "FrameRing.h"
+#include "Logging.h"
+#include "TcpServer.h"
+
+namespace sharedmemory {
+   
+   /**
+    * Publishes frames into a FrameRing and hands out its file descriptor to 
+    * local readers connecting to a Unix domain socket. Each reader receives 
+    * the descriptor (SCM_RIGHTS) together with the line 
+    * "<name> <FRAME_RING_VERSION> <size of the memfd>\n" and stays attached 
+    * as long as it keeps the connection open.
+    */
+   class FrameRingPublisher : network::TcpServer::Listener {
+      public:
+         /**
+          * Gets called with the number of attached readers whenever a reader
+          * attached (readerAttached = true) or detached.
+          */
+         typedef std::function<void(unsigned int readerCount, bool readerAttached)> ReadersChangedCallback;
+         
+         FrameRingPublisher(const std::string& name, const std::string& socketPath, size_t dataSize, 
+                            uint32_t slotCount, unsigned int maxReaders, ReadersChangedCallback callback);
+         
+         ~FrameRingPublisher();
+         
+         void start();
+         
+         /**
+          * Copies the frame into the shared memory. Must not get called 
+          * concurrently.
+          */
+         void publish(const uint8_t* data, size_t size, int64_t timestamp_us, bool keyframe);
+         
+         // callbacks of the listener interface of the TcpServer
+         void onNewConnection(std::shared_ptr<network::Connection> connection) override;
+
+         void onConnectionClosed(int connectionId) override;
+         
+         void onCommandReceived(int connectionId, std::string_view command) override;
+         
+      private:
+         logging::Logger                                     log;
+         std::string                                         name;
+         std::string                                         socketPath;
+         unsigned int                                        maxReaders;
+         FrameRing                                           frameRing;
+         ReadersChangedCallback                              readersChangedCallback;
+         std::unique_ptr<network::TcpServer>                 tcpServer;
+         std::map<int, std::shared_ptr<network::Connection>> readers;
+         std::mutex                                          readersMutex;
+   };
+}
+#endif
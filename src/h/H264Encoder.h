@@ -2,7 +2,9 @@
 #define H264ENCODER_H
 
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -10,21 +12,26 @@
 #include "libcamera/color_space.h"
 #include "libcamera/stream.h"
 
+#include "EncoderControl.h"
+#include "EncoderOutputBuffers.h"
 #include "Logging.h"
+#include "V4l2Controls.h"
 
-#define H264_INPUT_BUFFER_COUNT    6
-#define H264_OUTPUT_BUFFER_COUNT   12
+#define H264_INPUT_BUFFER_COUNT        6
+#define H264_OUTPUT_BUFFER_COUNT       12
+#define H264_MAX_LENT_OUTPUT_BUFFERS   8
 
 /**
- * ATTENTION: The data pointer is only valid as long as you are
- *            in the callback!
+ * The data stays valid as long as a reference to it exists. The encoder 
+ * cannot reuse the output buffer before all references got released, 
+ * therefore keep them only as long as necessary.
  */
-typedef std::function<void(void    *data,       // pointer to the data of the NAL
-                           size_t  bytesCount,  // size of the NAL in bytes
+typedef std::function<void(std::shared_ptr<const uint8_t> data,  // the data of the NAL
+                           size_t  bytesCount,                   // size of the NAL in bytes
                            int64_t timestamp,   
                            bool    keyframe)>  OutputReadyCallback;
 
-class H264Encoder {
+class H264Encoder : public EncoderControl {
    public:
       H264Encoder(libcamera::StreamConfiguration const &streamConfig);
       
@@ -39,6 +46,26 @@ class H264Encoder {
        * Provides a new frame to the encoder for encoding.
        */
       void encode(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us);
+      
+      /**
+       * Forces the encoder to produce a keyframe (IDR) for the next frame. 
+       * The sequence headers (SPS and PPS) are part of every keyframe.
+       */
+      void requestKeyframe();
+      
+      /**
+       * Changes the target bitrate (bits per second) of the encoder while it
+       * is running. Failures get logged.
+       */
+      void setBitrate(unsigned int bitrate);
+
+      /**
+       * Supported parameters: bitrate, bitrateMode, iFramePeriod, profile, 
+       * level, minQp and maxQp (if the device provides them).
+       */
+      std::map<std::string, EncoderParameter> getEncoderParameters() override;
+
+      Result setEncoderParameter(const std::string& name, int value) override;
 
    private:
       struct H264Nal {
@@ -53,10 +80,14 @@ class H264Encoder {
       void v4l2Cmd(unsigned long ctl, void *arg, std::string errorMessage);
       int get_v4l2_colorspace(std::optional<libcamera::ColorSpace> const &libcameraColorSpace);
       
+      void requeueOutputBuffer(unsigned int index, size_t length);
+      
       void pollThreadTask();
       void outputThreadTask();
 
       logging::Logger         log;
+      EncoderOutputBuffers    outputBuffers;
+      V4l2Controls            controls;
       OutputReadyCallback     outputReadyCallback;
       bool                    quitPollThread;
       bool                    quitOutputThread;
@@ -0,0 +1,90 @@
+#ifndef H264PACKETIZER_H
+#define H264PACKETIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AnnexB.h"
+#include "SharedBuffer.h"
+
+#define RTP_HEADER_SIZE        12
+#define RTP_MAX_PAYLOAD_SIZE   1400
+#define RTP_CLOCK_RATE         90000   // of the timestamps of H.264 (RFC 6184)
+
+namespace rtsp {
+
+   /**
+    * Payload of a single RTP packet. The payload header (FU indicator and FU
+    * header of a FU-A fragment) is stored inline, the data references the
+    * NAL unit provided by the encoder.
+    */
+   struct RtpPayload {
+      uint8_t               payloadHeader[2];
+      uint8_t               payloadHeaderSize = 0;
+      network::SharedBuffer data;
+      bool                  marker            = false;
+
+      size_t size() const { return payloadHeaderSize + data.size(); }
+   };
+
+   /**
+    * Packetizes H.264 access units (Annex B byte stream) according to RFC 6184
+    * (packetization-mode=1):
+    *
+    *  * NAL units fitting into a packet get sent as single NAL unit packets.
+    *  * Larger NAL units get fragmented into FU-A packets.
+    *  * SPS and PPS get aggregated into one STAP-A packet.
+    *
+    * Except the STAP-A packets, no data gets copied. The marker bit is set on
+    * the last packet of the access unit. Access unit delimiters get skipped.
+    *
+    * This class is not thread-safe.
+    */
+   class H264Packetizer {
+      public:
+         H264Packetizer(size_t maxPayloadSize = RTP_MAX_PAYLOAD_SIZE);
+
+         /**
+          * Appends the payloads of the RTP packets of the access unit to the
+          * provided vector.
+          */
+         void packetize(const network::SharedBuffer& accessUnit, std::vector<RtpPayload>& payloads);
+
+         /**
+          * Returns the last SPS (without start code) seen in the stream or an
+          * empty string if none was seen so far.
+          */
+         const std::string& getSequenceParameterSet() const;
+
+         const std::string& getPictureParameterSet() const;
+
+         /**
+          * Converts the timestamp to the 90 kHz clock of the RTP timestamps.
+          * The result wraps around like the RTP timestamps do.
+          */
+         static uint32_t toRtpTimestamp(int64_t timestamp_us);
+
+         /**
+          * Writes the RTP header followed by the payload header of the payload
+          * into the buffer (at least RTP_HEADER_SIZE + 2 bytes) and returns 
+          * the number of bytes written. The data of the payload follows them.
+          */
+         static size_t writeHeaders(uint8_t* buffer, const RtpPayload& payload, uint8_t payloadType, 
+                                    uint16_t sequenceNumber, uint32_t rtpTimestamp, uint32_t ssrc);
+
+      private:
+         void appendNalUnit(const network::SharedBuffer& nalUnit, std::vector<RtpPayload>& payloads);
+
+         void appendParameterSets(std::vector<network::SharedBuffer>& parameterSets,
+                                  std::vector<RtpPayload>& payloads);
+
+         size_t                             maxPayloadSize;
+         std::string                        sequenceParameterSet;
+         std::string                        pictureParameterSet;
+         std::vector<h264::NalUnitPosition> nalUnitPositions;
+         std::vector<network::SharedBuffer> parameterSets;
+   };
+}
+#endif
@@ -1,20 +1,72 @@
 #ifndef H264STREAM_H
 #define H264STREAM_H
 
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+
 #include "libcamera/stream.h"
 
+#include "AdaptiveBitrateController.h"
+#include "EncoderControl.h"
+#include "Fmp4HttpStream.h"
+#include "FrameRingPublisher.h"
 #include "H264Encoder.h"
+#include "HlsServer.h"
+#include "HttpServer.h"
+#include "KeyframeGate.h"
 #include "Logging.h"
+#include "MpegTsUdpStream.h"
+#include "RtspServer.h"
 #include "TcpServer.h"
+#include "WebSocketStream.h"
 
 typedef std::function<void(bool)> ConnectedCallback;
 
 /**
- * This class sends the provided frame as a H.264 stream.
+ * This class sends the provided frame as a H.264 stream to all connected
+ * clients (raw TCP connections and clients requesting "/h264" from the 
+ * HttpServer). New clients start with the next keyframe, which gets requested
+ * from the encoder as soon as a client connects.
+ *
+ * If the env var OCTOWATCH_H264_FRAME_RING_SOCKET contains a path, the NAL 
+ * units additionally get published into a shared memory FrameRing for local
+ * readers attaching via this Unix domain socket.
+ *
+ * The stream is also offered via RTSP/RTP (see RtspServer) on the addresses
+ * defined by OCTOWATCH_RTSP_ADDRESSES (default: TCP port 8554). The 
+ * HttpServer additionally offers it as fragmented MP4 at "/h264.mp4" (see 
+ * Fmp4HttpStream), as Low-Latency HLS below "/hls/" (see HlsServer) and as 
+ * WebSocket messages at "/h264.ws" (see WebSocketStream).
+ *
+ * If the env var OCTOWATCH_MPEGTS_DESTINATION contains "<IPv4 address>:<port>",
+ * the stream additionally gets sent as MPEG-TS via UDP (see MpegTsUdpStream)
+ * to this (multicast) destination. Because the receivers are unknown, the
+ * encoder runs continuously in this case.
+ *
+ * The bitrate of the encoder adapts to the congestion of the clients (see
+ * AdaptiveBitrateController) within the range defined by the env var
+ * OCTOWATCH_H264_BITRATE (default: 1000-10000 kbit/s). Only the clients of
+ * the raw TCP server and of "/h264" get sampled, the other transports have
+ * their own flow control or none at all.
+ *
+ * A client of these two whose send queue stays backlogged (see 
+ * RECOVERY_BACKLOG_MS) skips to the next keyframe: its queued NAL units get
+ * discarded, a keyframe gets requested and it resumes with that keyframe 
+ * (see KeyframeGate). The other clients are not affected. Only if its queue
+ * overflows nonetheless, the client gets disconnected.
+ *
+ * The parameters of the encoder can get changed while streaming (see
+ * EncoderControl). A new bitrate becomes the upper bound of the adaptation.
  */
-class H264Stream : network::TcpServer::Listener {
+class H264Stream : network::TcpServer::Listener, public http::RequestHandler, public EncoderControl {
    public:
-      H264Stream(libcamera::StreamConfiguration const &streamConfig, ConnectedCallback callback);
+      using Result = http::RequestHandler::Result;
+      
+      H264Stream(libcamera::StreamConfiguration const &streamConfig, http::HttpServer& httpServer, 
+                 ConnectedCallback callback);
       
       ~H264Stream();
       
@@ -22,21 +74,85 @@ class H264Stream : network::TcpServer::Listener {
       
       void send(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us);
       
-      // callbacks of the listener interface of the TcpServer
-      void onNewConnection(std::unique_ptr<network::Connection> connection) override;
+      // callbacks of the listener interface of the TcpServer (onConnectionClosed
+      // is also the one of the RequestHandler interface)
+      void onNewConnection(std::shared_ptr<network::Connection> connection) override;
 
-      void onConnectionClosed() override;
+      void onConnectionClosed(int connectionId) override;
+      
+      void onCommandReceived(int connectionId, std::string_view command) override;
+      
+      // callbacks of the RequestHandler interface
+      Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                       http::HttpResponse& response) override;
       
-      void onCommandReceived(const std::string& command) override;
+      void writeMetrics(std::ostream& output) override;
+      
+      // callbacks of the EncoderControl interface
+      std::map<std::string, EncoderParameter> getEncoderParameters() override;
+      
+      EncoderControl::Result setEncoderParameter(const std::string& name, int value) override;
       
    private:
-      void onEncoderOutputReady(void *mem, size_t size, int64_t timestamp_us, bool keyframe);
-      
-      logging::Logger                      log;
-      std::unique_ptr<network::TcpServer>  tcpServer;
-      std::unique_ptr<network::Connection> connection;
-      std::mutex                           connectionMutex;
-      H264Encoder                          h264encoder;
-      ConnectedCallback                    connectedCallback;
+      struct Client {
+         std::shared_ptr<network::Connection> connection;
+         KeyframeGate                         keyframeGate;
+      };
+      
+      void onEncoderOutputReady(std::shared_ptr<const uint8_t> data, size_t size, 
+                                int64_t timestamp_us, bool keyframe);
+      
+      /**
+       * Passes the congestion state of the clients to the bitrate controller
+       * if the last sample is older than the sample interval.
+       */
+      void sampleCongestion();
+      
+      void onFrameRingReadersChanged(unsigned int readerCount, bool readerAttached);
+      
+      void onRtspSessionsChanged(unsigned int playingSessionCount, bool sessionStarted);
+      
+      void onFmp4ClientsChanged(unsigned int clientCount, bool clientAdded);
+      
+      void onHlsActivityChanged(bool active);
+      
+      void onWebSocketClientsChanged(unsigned int clientCount, bool clientAdded);
+      
+      /**
+       * Updates the number of consumers of the frame ring or the RTSP server
+       * and informs the connected callback.
+       */
+      void onConsumersChanged(unsigned int& consumerCount, unsigned int newConsumerCount, bool consumerAdded);
+      
+      /**
+       * Returns true if there is any consumer of the stream. The caller has to
+       * hold the clientsMutex.
+       */
+      bool hasConsumers() const;
+      
+      logging::Logger                                   log;
+      http::HttpServer&                                 httpServer;
+      std::unique_ptr<network::TcpServer>               tcpServer;
+      std::map<int, Client>                             clients;
+      std::mutex                                        clientsMutex;
+      uint64_t                                          accessUnitCount;
+      uint64_t                                          recoveryCountOfClosedClients;
+      uint64_t                                          recoveryDroppedBytesOfClosedClients;
+      unsigned int                                      frameRingReaderCount;
+      std::unique_ptr<sharedmemory::FrameRingPublisher> frameRingPublisher;
+      unsigned int                                      rtspSessionCount;
+      std::unique_ptr<rtsp::RtspServer>                 rtspServer;
+      unsigned int                                      fmp4ClientCount;
+      std::unique_ptr<Fmp4HttpStream>                   fmp4Stream;
+      unsigned int                                      hlsConsumerCount;
+      std::unique_ptr<hls::HlsServer>                   hlsServer;
+      unsigned int                                      webSocketClientCount;
+      std::unique_ptr<websocket::WebSocketStream>       webSocketStream;
+      unsigned int                                      mpegTsConsumerCount;
+      std::unique_ptr<mpegts::MpegTsUdpStream>          mpegTsStream;
+      H264Encoder                                       h264encoder;
+      std::unique_ptr<AdaptiveBitrateController>        bitrateController;
+      std::chrono::steady_clock::time_point             lastCongestionSample;
+      ConnectedCallback                                 connectedCallback;
 };
 #endif
@@ -10,10 +10,14 @@
 #include "libcamera/color_space.h"
 #include "libcamera/stream.h"
 
+#include "EncoderOutputBuffers.h"
 #include "JpegEncoder.h"
 #include "Logging.h"
+#include "V4l2Controls.h"
 
-#define HARDWARE_JPEG_ENCODER_BUFFER_COUNT    1
+#define HARDWARE_JPEG_ENCODER_INPUT_BUFFER_COUNT        1
+#define HARDWARE_JPEG_ENCODER_OUTPUT_BUFFER_COUNT       4
+#define HARDWARE_JPEG_ENCODER_MAX_LENT_OUTPUT_BUFFERS   3
 
 class HardwareJpegEncoder : public JpegEncoder {
    public:
@@ -34,6 +38,10 @@ class HardwareJpegEncoder : public JpegEncoder {
        */
       void encode(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us) override;
 
+      std::map<std::string, EncoderParameter> getEncoderParameters() override;
+
+      Result setEncoderParameter(const std::string& name, int value) override;
+
    private:
       struct JpegImage {
          void         *data;
@@ -54,17 +62,20 @@ class HardwareJpegEncoder : public JpegEncoder {
       void createOutputBuffers();
       void startInputStream();
       void startOutputStream();
+      void requeueOutputBuffer(unsigned int index, size_t length);
       
       void pollThreadTask();
       void outputThreadTask();
 
       logging::Logger         log;
+      EncoderOutputBuffers    outputBuffers;
+      V4l2Controls            controls;
       bool                    quitPollThread;
       bool                    quitOutputThread;
       bool                    v4l2CommandError;
       JpegOutputReadyCallback outputReadyCallback;
       int                     encoderFileDescriptor;
-      void*                   outputBufferData[HARDWARE_JPEG_ENCODER_BUFFER_COUNT];
+      void*                   outputBufferData[HARDWARE_JPEG_ENCODER_OUTPUT_BUFFER_COUNT];
       std::queue<int>         availableInputBuffers;
       std::queue<int>         inputBuffersReadyToReuse;
       std::queue<JpegImage>   jpegsReadyToConsume;
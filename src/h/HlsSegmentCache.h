@@ -0,0 +1,123 @@
+#ifndef HLSSEGMENTCACHE_H
+#define HLSSEGMENTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Fmp4Muxer.h"
+#include "SharedBuffer.h"
+
+namespace hls {
+
+   struct HlsPart {
+      network::SharedBuffer data;           // moof + mdat
+      uint64_t              duration;       // in FMP4_TIMESCALE units
+      bool                  independent;    // starts with a keyframe
+   };
+
+   /**
+    * A segment consists of its parts, it does not hold a copy of their data.
+    */
+   struct HlsSegment {
+      uint64_t             sequenceNumber;
+      std::vector<HlsPart> parts;
+      uint64_t             duration;        // in FMP4_TIMESCALE units
+      size_t               size;            // in bytes
+      bool                 complete;
+   };
+
+   struct HlsSegmentCacheStatistics {
+      unsigned int segmentCount = 0;   // including the segment in progress
+      unsigned int partCount    = 0;
+      size_t       size         = 0;   // in bytes, without the init segment
+   };
+
+   /**
+    * Holds the most recent segments of a Low-Latency HLS media playlist
+    * (RFC 8216bis) in memory and creates the playlist.
+    *
+    * The fMP4 fragments (see Fmp4Muxer) get added as partial segments. A
+    * part starting with a keyframe starts a new segment, unless the current
+    * segment is still empty. A segment that reached the target duration
+    * without a keyframe gets completed anyway to keep the durations within
+    * the announced target duration.
+    *
+    * Besides the segment in progress at most maxSegmentCount complete
+    * segments are kept, older ones get dropped. The memory consumption is
+    * therefore bounded by the segment count and the bitrate.
+    *
+    * The resources are named "init.mp4", "segment<msn>.m4s" and
+    * "part<msn>.<part index>.m4s" (msn = media sequence number).
+    *
+    * This class is not thread-safe.
+    */
+   class HlsSegmentCache {
+      public:
+         enum class Availability { AVAILABLE, PENDING, UNAVAILABLE };
+
+         HlsSegmentCache(unsigned int maxSegmentCount, unsigned int targetDuration_s,
+                         uint64_t partTargetDuration);
+
+         /**
+          * Returns true if a keyframe should get requested to be able to
+          * start the next segment in time.
+          */
+         bool addPart(const mp4::Fmp4Fragment& fragment);
+
+         void setInitSegment(const network::SharedBuffer& initSegment);
+
+         /**
+          * Returns an empty buffer if there is no init segment yet.
+          */
+         network::SharedBuffer getInitSegment() const;
+
+         /**
+          * Drops all segments. The media sequence numbers continue after the
+          * last dropped segment.
+          */
+         void clear();
+
+         bool empty() const;
+
+         /**
+          * Returns AVAILABLE if the playlist contains the part (or the whole
+          * segment if partIndex < 0) or already moved beyond it. PENDING gets
+          * returned if the part is going to be added soon (at most two
+          * segments ahead of the current one), UNAVAILABLE otherwise. A part
+          * index exceeding the last part of a complete segment refers to the
+          * first part of the following segment.
+          */
+         Availability getPlaylistAvailability(uint64_t sequenceNumber, int partIndex) const;
+
+         /**
+          * The provided segment gets filled if AVAILABLE gets returned. A
+          * segment in progress is PENDING.
+          */
+         Availability getSegment(uint64_t sequenceNumber, HlsSegment& segment) const;
+
+         /**
+          * The provided part gets filled if AVAILABLE gets returned. The part
+          * following the last one of the playlist is PENDING (preload hint).
+          */
+         Availability getPart(uint64_t sequenceNumber, unsigned int partIndex, HlsPart& part) const;
+
+         std::string createPlaylist() const;
+
+         HlsSegmentCacheStatistics getStatistics() const;
+
+      private:
+         const HlsSegment* findSegment(uint64_t sequenceNumber) const;
+
+         unsigned int           maxSegmentCount;
+         unsigned int           targetDuration_s;
+         uint64_t               partTargetDuration;    // in FMP4_TIMESCALE units
+         network::SharedBuffer  initSegment;
+         std::deque<HlsSegment> segments;              // the last one is in progress
+         uint64_t               nextSequenceNumber;
+         bool                   keyframeRequested;
+   };
+}
+#endif
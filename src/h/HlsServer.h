@@ -0,0 +1,112 @@
+#ifndef HLSSERVER_H
+#define HLSSERVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Fmp4Muxer.h"
+#include "HlsSegmentCache.h"
+#include "HttpServer.h"
+#include "Logging.h"
+#include "SharedBuffer.h"
+
+namespace hls {
+
+   /**
+    * Offers the H.264 stream as Low-Latency HLS via the HttpServer. The 
+    * playlist is available at any path below "/hls/" ending with ".m3u8" 
+    * (e.g. http://<host>:8887/hls/stream.m3u8), the other resources get 
+    * resolved relative to it (see HlsSegmentCache).
+    *
+    * The access units get muxed once into fMP4 parts and put into the cache,
+    * all viewers get served from there. Requests for playlists containing a
+    * given part (_HLS_msn and _HLS_part query parameters) and for the part
+    * announced by the preload hint block until the part got added, at most
+    * three target durations.
+    *
+    * HTTP does not tell when a viewer stopped watching. Therefore the server
+    * is considered active as long as requests keep coming in. The segments
+    * get dropped as soon as it is no longer active.
+    */
+   class HlsServer : public http::RequestHandler {
+      public:
+         /**
+          * Gets called whenever the server started or stopped being active.
+          */
+         typedef std::function<void(bool active)> ActivityChangedCallback;
+
+         typedef std::function<void()> KeyframeRequest;
+
+         HlsServer(http::HttpServer& httpServer, unsigned int width, unsigned int height,
+                   ActivityChangedCallback activityChangedCallback, KeyframeRequest keyframeRequest);
+
+         ~HlsServer();
+
+         void start();
+
+         /**
+          * Must not get called concurrently.
+          */
+         void send(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe);
+
+         // callbacks of the RequestHandler interface
+         Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                          http::HttpResponse& response) override;
+
+         void onConnectionClosed(int connectionId) override;
+
+         void writeMetrics(std::ostream& output) override;
+
+      private:
+         enum class Resource { PLAYLIST, INIT_SEGMENT, SEGMENT, PART, NOT_FOUND, BAD_REQUEST };
+
+         struct Request {
+            Resource                              resource;
+            uint64_t                              sequenceNumber;
+            int                                   partIndex;       // < 0 if not defined
+            bool                                  blockingReload;  // playlist request with _HLS_msn
+            std::chrono::steady_clock::time_point deadline;
+         };
+
+         static unsigned int getConfiguredSegmentCount();
+
+         static void parseRequest(const http::HttpRequest& httpRequest, Request& request);
+
+         /**
+          * Fills in the response and returns true if the requested resource
+          * is available (or the deadline passed). The caller has to hold the
+          * mutex.
+          */
+         bool createResponse(const Request& request, http::HttpResponse& response);
+
+         /**
+          * Responds to the blocking requests whose resource became available
+          * (or whose deadline passed).
+          */
+         void respondToPendingRequests();
+
+         void runHousekeeping();
+
+         logging::Logger                       log;
+         http::HttpServer&                     httpServer;
+         std::map<int, Request>                pendingRequests;   // by connection ID
+         mp4::Fmp4Muxer                        muxer;
+         HlsSegmentCache                       cache;
+         bool                                  active;
+         std::chrono::steady_clock::time_point lastRequestTime;
+         ActivityChangedCallback               activityChangedCallback;
+         KeyframeRequest                       keyframeRequest;
+         bool                                  quitHousekeeping;
+         std::condition_variable               housekeepingCondition;
+         std::thread                           housekeepingThread;
+         std::mutex                            mutex;
+   };
+}
+#endif
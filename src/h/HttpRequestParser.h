@@ -0,0 +1,86 @@
+#ifndef HTTPREQUESTPARSER_H
+#define HTTPREQUESTPARSER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace http {
+
+   struct HttpRequest {
+      std::string                        method;
+      std::string                        path;
+      std::string                        query;     // without the '?'
+      std::string                        version;   // "HTTP/1.0" or "HTTP/1.1"
+      std::map<std::string, std::string> headers;   // keys in lower case
+      std::string                        body;
+      bool                               keepAlive;
+
+      std::string getHeader(const std::string& name) const;
+   };
+
+   /**
+    * Incremental HTTP/1.1 (RFC 9112) request parser. The received bytes can
+    * get passed in chunks of any size, a request may span several chunks and
+    * a chunk may contain several (pipelined) requests.
+    *
+    * Bodies are supported only with a Content-Length (requests using
+    * Transfer-Encoding get rejected). Lines may be terminated by "\r\n" or
+    * "\n", empty lines preceding a request get ignored.
+    *
+    * This class is not thread-safe.
+    */
+   class HttpRequestParser {
+      public:
+         enum class Result { INCOMPLETE, COMPLETE, INVALID };
+
+         HttpRequestParser(size_t maxHeaderSize, size_t maxBodySize);
+
+         /**
+          * Consumes bytes of the provided data until a request is complete
+          * (COMPLETE, the remaining bytes stay in data) or all bytes got
+          * consumed (INCOMPLETE). The next call after COMPLETE starts a new
+          * request. After INVALID the connection has to get closed after
+          * responding with getErrorStatus(), because the start of the next
+          * request is unknown.
+          */
+         Result parse(std::string_view& data);
+
+         /**
+          * Valid after parse returned COMPLETE.
+          */
+         const HttpRequest& getRequest() const;
+
+         /**
+          * The HTTP status code to respond with after parse returned INVALID.
+          */
+         unsigned int getErrorStatus() const;
+
+      private:
+         enum class State { REQUEST_LINE, HEADERS, BODY, DONE, FAILED };
+
+         Result fail(unsigned int status);
+
+         /**
+          * Processes a complete line (without the line terminator).
+          */
+         Result processLine(std::string_view line);
+
+         Result processRequestLine(std::string_view line);
+
+         Result processHeaderLine(std::string_view line);
+
+         Result processEndOfHeaders();
+
+         size_t       maxHeaderSize;
+         size_t       maxBodySize;
+         State        state;
+         std::string  line;
+         size_t       headerSize;
+         size_t       contentLength;
+         unsigned int errorStatus;
+         HttpRequest  request;
+   };
+}
+#endif
@@ -0,0 +1,203 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "HttpRequestParser.h"
+#include "Logging.h"
+#include "SharedBuffer.h"
+#include "TcpServer.h"
+
+namespace http {
+
+   struct HttpResponse {
+      unsigned int                                     status = 200;
+      std::string                                      contentType;
+      std::string                                      cacheControl = "no-cache";
+      network::SharedBuffer                            body;
+      std::vector<network::SharedBuffer>               bodyParts;   // sent after the body without copying them
+      std::vector<std::pair<std::string, std::string>> headers;     // additional headers
+
+      /**
+       * Creates a response with a text/plain body.
+       */
+      static HttpResponse text(unsigned int status, const std::string& body);
+   };
+
+   /**
+    * Handles the requests of the paths it got registered for.
+    */
+   class RequestHandler {
+      public:
+         enum class Result {
+            RESPONDED,   // the response got filled in and gets sent by the server
+            DEFERRED,    // the handler is going to call HttpServer::respond later
+            STREAMING,   // the handler took over the connection (body lasts until it gets closed)
+            UPGRADED     // the handler sent "101 Switching Protocols" and receives all further data
+         };
+
+         virtual ~RequestHandler() = default;
+
+         virtual Result onRequest(const HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                                  HttpResponse& response) = 0;
+
+         /**
+          * Gets called if a connection closes whose request was DEFERRED,
+          * STREAMING or UPGRADED.
+          */
+         virtual void onConnectionClosed(int connectionId) = 0;
+
+         /**
+          * Provides the data received on an UPGRADED connection (in order,
+          * including the data received right after the request).
+          */
+         virtual void onDataReceived(int connectionId, std::string_view data) {}
+
+         /**
+          * Appends the metrics of the handler in the Prometheus text format.
+          */
+         virtual void writeMetrics(std::ostream& output) {}
+   };
+
+   /**
+    * A HTTP/1.1 server routing the requests by their path to the registered
+    * handlers. All streams and resources share one port (and the Reactor).
+    * Keep-alive and pipelining are supported, the responses get sent in the
+    * order of the requests. The server itself serves "/metrics" containing
+    * its own metrics and the ones of all handlers.
+    *
+    * A handler can respond immediately, later (e.g. when the next frame is
+    * available) or take over the connection to stream the response body. In
+    * the last case the server ignores all further data received from the
+    * client and forwards the closing of the connection to the handler.
+    * Requests containing an Upgrade header are the last ones the server 
+    * parses on their connection: either the handler switches the protocol
+    * (UPGRADED, e.g. WebSocket) or the connection gets closed after the 
+    * response.
+    */
+   class HttpServer : network::TcpServer::Listener {
+      public:
+         HttpServer();
+
+         ~HttpServer();
+
+         void start();
+
+         /**
+          * The handler has to get removed before it gets destroyed.
+          */
+         void addRoute(const std::string& path, RequestHandler& handler);
+
+         /**
+          * Routes all paths starting with the prefix (e.g. "/hls/") to the
+          * handler, unless there is a route for the exact path. The longest
+          * matching prefix wins.
+          */
+         void addPrefixRoute(const std::string& prefix, RequestHandler& handler);
+
+         /**
+          * Removes all routes of the handler. Deferred requests of the handler
+          * get answered with 503, the connections it took over get closed.
+          * Waits until the handler returned from all of its callbacks, hence
+          * it must not get called by a callback of the handler.
+          */
+         void removeRoutes(RequestHandler& handler);
+
+         /**
+          * Sends the response of a DEFERRED request. Can get called by any
+          * thread (but not while holding a lock the handler needs in onRequest).
+          */
+         void respond(int connectionId, const HttpResponse& response);
+
+         /**
+          * Creates the header of a response whose body lasts until the
+          * connection gets closed (STREAMING).
+          */
+         static std::string createStreamHeader(const std::string& contentType);
+
+         // callbacks of the listener interface of the TcpServer
+         void onNewConnection(std::shared_ptr<network::Connection> connection) override;
+
+         void onConnectionClosed(int connectionId) override;
+
+         void onCommandReceived(int connectionId, std::string_view command) override;
+
+      private:
+         struct Client {
+            std::shared_ptr<network::Connection>     connection;
+            HttpRequestParser                        parser;
+            bool                                     rawInput;
+            std::deque<std::shared_ptr<HttpRequest>> requests;         // the first one is in progress
+            bool                                     requestInProgress;
+            RequestHandler*                          handler;          // of the DEFERRED, STREAMING or UPGRADED request
+            bool                                     ignoringInput;    // streaming, failed or not keep-alive
+            bool                                     upgradePending;   // an upgrade request got queued
+            bool                                     upgraded;         // the handler receives the input
+            std::string                              bufferedInput;    // received while upgradePending
+         };
+
+         /**
+          * Parses the received data and queues the complete requests. The 
+          * caller has to hold the mutex.
+          */
+         void parseInput(int connectionId, Client& client, std::string_view data);
+
+         /**
+          * Passes the data received so far to the handler that upgraded the
+          * connection and forwards all further data.
+          */
+         void completeUpgrade(int connectionId, RequestHandler* handler);
+
+         /**
+          * Passes the queued requests of the client to the handlers until one
+          * of them does not respond immediately.
+          */
+         void processRequests(int connectionId);
+
+         /**
+          * Returns the handler of the path (or nullptr) and marks it as being
+          * called. The handlers get called without holding a lock of the
+          * server, releaseHandler has to get called when the call returned.
+          */
+         RequestHandler* acquireHandler(const std::string& path);
+
+         /**
+          * Returns the handler if it is still routed and marks it as being
+          * called, otherwise nullptr.
+          */
+         RequestHandler* acquireHandler(RequestHandler* handler);
+
+         void releaseHandler(RequestHandler* handler);
+
+         /**
+          * Sends the response to the first request of the client and removes
+          * it from the queue. The caller has to hold the mutex.
+          */
+         void sendResponse(Client& client, const HttpResponse& response);
+
+         HttpResponse createMetricsResponse();
+
+         logging::Logger                          log;
+         std::unique_ptr<network::TcpServer>      tcpServer;
+         std::map<int, Client>                    clients;
+         std::map<std::string, RequestHandler*>   routes;
+         std::map<std::string, RequestHandler*>   prefixRoutes;
+         std::map<RequestHandler*, unsigned int>  activeCalls;      // by handler
+         std::map<unsigned int, uint64_t>         responseCounts;   // by status
+         uint64_t                                 acceptedConnections;
+         std::mutex                               mutex;            // clients and counters
+         std::mutex                               handlersMutex;    // routes and activeCalls
+         std::condition_variable                  callReturned;
+   };
+}
+#endif
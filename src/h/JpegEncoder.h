@@ -1,18 +1,27 @@
 #ifndef JPEGENCODER_H
 #define JPEGENCODER_H
 
+#include <cstdint>
 #include <functional>
+#include <memory>
 
 #include "libcamera/framebuffer.h"
 
+#include "EncoderControl.h"
+
 /** 
- * ATTENTION: The data pointer is only valid as long as you are in the callback!
+ * The data stays valid as long as a reference to it exists. Hardware encoders
+ * cannot reuse the output buffer before all references got released, therefore
+ * keep them only as long as necessary.
  */
-typedef std::function<void(void    *data,       // pointer to the data of the NAL
-                           size_t  bytesCount,  // size of the NAL in bytes
+typedef std::function<void(std::shared_ptr<const uint8_t> data,  // the data of the JPEG
+                           size_t  bytesCount,                   // size of the JPEG in bytes
                            int64_t timestamp_us)>  JpegOutputReadyCallback;
 
-class JpegEncoder {
+/**
+ * The encoder parameters include at least "quality".
+ */
+class JpegEncoder : public EncoderControl {
    public:
       /**
        * The callback gets called as soon as a NAL is ready for sending.
@@ -0,0 +1,80 @@
+#ifndef KEYFRAMEGATE_H
+#define KEYFRAMEGATE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Logging.h"
+#include "SendQueue.h"
+
+/**
+ * Decides which access units of an H.264 stream a client gets. A client 
+ * can't decode anything before the first keyframe, therefore it joins the 
+ * stream with the next keyframe.
+ *
+ * A client whose send queue exceeded the backlog limit for longer than the
+ * recovery delay skips to the next keyframe: the caller discards its queued 
+ * access units (leaving a gap the keyframe closes) and requests a keyframe, 
+ * the client resumes with that keyframe.
+ *
+ * This class is not thread-safe.
+ */
+class KeyframeGate {
+   public:
+      typedef std::chrono::steady_clock Clock;
+
+      enum class Decision { 
+         SEND,      // also the keyframe a waiting client starts or resumes with
+         SKIP,      // the client waits for a keyframe
+         RECOVER    // skip, discard the queued access units (see onQueueDiscarded) and request a keyframe
+      };
+
+      struct BacklogLimit {
+         size_t bytes;
+         size_t frames;
+      };
+
+      struct Statistics {
+         Clock::duration timeToFirstKeyframe = Clock::duration::zero();   // zero while waiting
+         uint64_t        recoveryCount       = 0;
+         uint64_t        droppedBytes        = 0;   // discarded and skipped by all recoveries
+      };
+
+      KeyframeGate(int connectionId, std::chrono::milliseconds recoveryDelay, Clock::time_point connectTime);
+
+      /**
+       * Decides about the next access unit based on the state of the send 
+       * queue of the client before adding it.
+       */
+      Decision decide(size_t size, bool keyframe, const network::SendQueueStatistics& queue,
+                      const BacklogLimit& limit, Clock::time_point now);
+
+      /**
+       * Has to get called after RECOVER with the bytes discarded from the 
+       * send queue.
+       */
+      void onQueueDiscarded(size_t discardedBytes);
+
+      bool isWaitingForKeyframe() const;
+
+      const Statistics& getStatistics() const;
+
+   private:
+      bool hasSustainedBacklog(const network::SendQueueStatistics& queue, const BacklogLimit& limit,
+                               Clock::time_point now);
+
+      logging::Logger           log;
+      int                       connectionId;
+      std::chrono::milliseconds recoveryDelay;
+      Clock::time_point         connectTime;
+      bool                      waitingForKeyframe;
+      bool                      backlogged;
+      Clock::time_point         backlogSince;
+      bool                      recovering;
+      Clock::time_point         recoveryStart;
+      uint64_t                  recoveryDroppedBytes;   // of the current recovery
+      Statistics                statistics;
+};
+
+#endif
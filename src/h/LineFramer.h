@@ -0,0 +1,58 @@
+#ifndef LINEFRAMER_H
+#define LINEFRAMER_H
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace network {
+   
+   typedef std::function<void(std::string_view line)> LineConsumer;
+   
+   /**
+    * Splits the received bytes into lines terminated by '\n' without allocating
+    * memory per line. The buffer gets allocated once and its size limits the 
+    * length of a line. Longer lines get discarded completely.
+    *
+    * After switching to raw mode the received bytes get passed to the 
+    * consumer as they are (e.g. binary frames after a protocol upgrade).
+    *
+    * This class is not thread-safe.
+    */
+   class LineFramer {
+      public:
+         LineFramer(size_t maxLineLength);
+         
+         /**
+          * Returns the free part of the buffer where the next received bytes
+          * have to get written to.
+          */
+         boost::asio::mutable_buffer prepare();
+         
+         /**
+          * Processes byteCount bytes written to the buffer returned by prepare.
+          * The consumer gets called for each complete line (without the '\n').
+          * The provided string_view is only valid during the call.
+          *
+          * Returns the number of lines that got discarded because they were 
+          * too long.
+          */
+         unsigned int commit(size_t byteCount, const LineConsumer& consumer);
+         
+         /**
+          * Can get called by the consumer. The bytes following the current
+          * line get passed to the consumer without splitting them.
+          */
+         void switchToRawMode();
+         
+      private:
+         std::vector<char> buffer;
+         size_t            usedByteCount;
+         bool              discardingLine;
+         bool              rawMode;
+   };
+}
+#endif
@@ -0,0 +1,50 @@
+#ifndef LISTENADDRESS_H
+#define LISTENADDRESS_H
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace network {
+   
+   /**
+    * An address a server accepts connections on: either a TCP port (on all
+    * IPv4 interfaces or on the given IPv4 or IPv6 address) or the path of a
+    * Unix domain socket (for clients running on the same host).
+    */
+   struct ListenAddress {
+      enum class Type { TCP, UNIX_DOMAIN };
+      
+      Type                     type;
+      unsigned int             port;
+      std::string              path;
+      boost::asio::ip::address ipAddress;   // of TCP
+      
+      static ListenAddress tcp(unsigned int port);
+      
+      static ListenAddress tcp(const boost::asio::ip::address& ipAddress, unsigned int port);
+      
+      static ListenAddress unixDomain(const std::string& path);
+      
+      boost::asio::generic::stream_protocol::endpoint toEndpoint() const;
+      
+      std::string toString() const;
+      
+      /**
+       * Parses "tcp:<port>" (all IPv4 interfaces), "tcp:<IPv4 address>:<port>",
+       * "tcp:[<IPv6 address>]:<port>" or "unix:<path>". Returns false if the
+       * text is invalid.
+       */
+      static bool parse(const std::string& text, ListenAddress& address);
+      
+      /**
+       * Reads the addresses from the environment variable, which contains a 
+       * comma separated list of entries as accepted by parse (e.g. 
+       * "tcp:8887,tcp:[::1]:8887,unix:/run/octowatch/mpjpeg.sock"). If the 
+       * variable is not set or invalid, TCP on the default port gets used.
+       */
+      static std::vector<ListenAddress> fromEnvironment(const char* envVarName, unsigned int defaultTcpPort);
+   };
+}
+#endif
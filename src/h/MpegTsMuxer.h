@@ -0,0 +1,64 @@
+#ifndef MPEGTSMUXER_H
+#define MPEGTSMUXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnnexB.h"
+#include "SharedBuffer.h"
+
+#define TS_PACKET_SIZE   188
+#define TS_CLOCK_RATE    90000
+
+#define TS_PID_PAT     0x0000
+#define TS_PID_PMT     0x1000
+#define TS_PID_VIDEO   0x0100
+
+namespace mpegts {
+
+   /**
+    * Muxes H.264 access units (Annex B byte stream) into an MPEG transport
+    * stream (ISO/IEC 13818-1) with a single program containing one video
+    * stream.
+    *
+    * Each access unit becomes one PES packet (PTS only, there are no
+    * B-frames). Its first TS packet carries the PCR, which gets derived from
+    * the timestamp of the access unit. The PTS is 100 ms ahead of it to give
+    * the receivers time to buffer the access unit. PAT and PMT get sent
+    * in front of each keyframe and at least every 100 ms. An access unit
+    * delimiter gets inserted if the access unit does not start with one.
+    *
+    * This class is not thread-safe.
+    */
+   class MpegTsMuxer {
+      public:
+         MpegTsMuxer();
+
+         /**
+          * Appends the TS packets of the access unit to the provided vector.
+          */
+         void mux(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe,
+                  std::vector<uint8_t>& output);
+
+      private:
+         void writeProgramTables(std::vector<uint8_t>& output);
+
+         void writeSection(uint16_t pid, const std::vector<uint8_t>& section, std::vector<uint8_t>& output);
+
+         void writePes(const std::vector<uint8_t>& pesHeader, const uint8_t* data, size_t size, uint64_t pcr,
+                       bool keyframe, std::vector<uint8_t>& output);
+
+         uint8_t nextContinuityCounter(uint16_t pid);
+
+         std::vector<h264::NalUnitPosition> nalUnits;
+         std::vector<uint8_t>               pesHeader;
+         int64_t                            firstTimestamp_us;
+         int64_t                            previousTimestamp_us;
+         int64_t                            lastProgramTablesTimestamp_us;
+         uint8_t                            patContinuityCounter;
+         uint8_t                            pmtContinuityCounter;
+         uint8_t                            videoContinuityCounter;
+   };
+}
+#endif
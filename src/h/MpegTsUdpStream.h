@@ -0,0 +1,55 @@
+#ifndef MPEGTSUDPSTREAM_H
+#define MPEGTSUDPSTREAM_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "Logging.h"
+#include "MpegTsMuxer.h"
+#include "SharedBuffer.h"
+
+namespace mpegts {
+
+   /**
+    * Sends the H.264 access units as MPEG transport stream via UDP to a
+    * single destination, which is typically a multicast group. The cost of
+    * the stream does not depend on the number of receivers. Each datagram
+    * contains up to 7 TS packets (1316 bytes) to stay below the usual MTU.
+    *
+    * Datagrams that can't get sent immediately (full socket buffer) get
+    * dropped, because the encoder thread must never block.
+    */
+   class MpegTsUdpStream {
+      public:
+         MpegTsUdpStream(const boost::asio::ip::udp::endpoint& destination);
+
+         ~MpegTsUdpStream();
+
+         void start();
+
+         /**
+          * Must not get called concurrently.
+          */
+         void send(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe);
+
+         /**
+          * Parses a destination in the format "<IPv4 address>:<port>" (e.g.
+          * "239.255.0.1:5004"). Returns false if the text is invalid.
+          */
+         static bool parseDestination(const std::string& text, boost::asio::ip::udp::endpoint& destination);
+
+      private:
+         logging::Logger                               log;
+         boost::asio::ip::udp::endpoint                destination;
+         std::unique_ptr<boost::asio::ip::udp::socket> socket;
+         MpegTsMuxer                                   muxer;
+         std::vector<uint8_t>                          packets;
+         uint64_t                                      sentDatagrams;
+         uint64_t                                      droppedDatagrams;
+   };
+}
+#endif
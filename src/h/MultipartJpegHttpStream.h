@@ -6,13 +6,18 @@
 #include <cstdio>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <mutex>
+#include <ostream>
+#include <set>
 
 #include "libcamera/stream.h"
 
+#include "FrameRingPublisher.h"
+#include "HttpServer.h"
 #include "JpegEncoder.h"
 #include "Logging.h"
-#include "TcpServer.h"
+#include "WebSocketStream.h"
 
 #if JPEG_LIB_VERSION_MAJOR > 9 || (JPEG_LIB_VERSION_MAJOR == 9 && JPEG_LIB_VERSION_MINOR >= 4)
 typedef size_t jpeg_mem_len_t;
@@ -24,15 +29,25 @@ typedef std::function<void(bool)> ConnectedCallback;
 
 /**
  * This class converts the provided frame to an JPG image and sends it
- * as a HTTP multipart stream (RFC1341).
+ * as a HTTP multipart stream (RFC1341) to all clients requesting "/mjpeg" 
+ * (or "/") from the HttpServer. Each frame gets encoded only once. Clients 
+ * that can't keep up skip frames. A request for "/snapshot.jpg" gets answered
+ * with the next JPEG.
+ *
+ * If the env var OCTOWATCH_MPJPEG_FRAME_RING_SOCKET contains a path, the 
+ * JPEGs additionally get published into a shared memory FrameRing for local
+ * readers attaching via this Unix domain socket.
+ *
+ * The JPEGs are also offered as WebSocket messages (see WebSocketStream) at
+ * "/mjpeg.ws" of the HttpServer.
  *
  * https://www.w3.org/Protocols/rfc1341/7_2_Multipart.html
  * https://www.codeinsideout.com/blog/pi/stream-picamera-mjpeg/
  */
-class MultipartJpegHttpStream : network::TcpServer::Listener {
+class MultipartJpegHttpStream : public http::RequestHandler {
    public:
       MultipartJpegHttpStream(libcamera::StreamConfiguration const &streamConfig, 
-                              ConnectedCallback callback);
+                              http::HttpServer& httpServer, ConnectedCallback callback);
       
       ~MultipartJpegHttpStream();
       
@@ -45,23 +60,64 @@ class MultipartJpegHttpStream : network::TcpServer::Listener {
        */
       void send(libcamera::FrameBuffer *frameBuffer, int64_t timestamp_us);
       
-      // callbacks of the listener interface of the TcpServer
-      void onNewConnection(std::unique_ptr<network::Connection> connection) override;
+      /**
+       * Allows changing the JPEG quality while streaming.
+       */
+      EncoderControl& getEncoderControl();
+      
+      // callbacks of the RequestHandler interface
+      Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                       http::HttpResponse& response) override;
 
-      void onConnectionClosed() override;
+      void onConnectionClosed(int connectionId) override;
       
-      void onCommandReceived(const std::string& command) override;
+      void writeMetrics(std::ostream& output) override;
       
    private:
-      void sendJpeg(void *data, size_t size);
+      struct Client {
+         std::shared_ptr<network::Connection> connection;
+      };
+      
+      /**
+       * Answers the pending snapshot requests.
+       */
+      void sendSnapshot(const network::SharedBuffer& jpeg);
+      
+      void sendJpeg(const network::SharedBuffer& jpeg);
       
-      void onJpegAvailable(void *data, size_t bytesCount, int64_t timestamp);
+      void onJpegAvailable(std::shared_ptr<const uint8_t> data, size_t bytesCount, int64_t timestamp);
+      
+      void onFrameRingReadersChanged(unsigned int readerCount, bool readerAttached);
+      
+      void onWebSocketClientsChanged(unsigned int clientCount, bool clientAdded);
+      
+      /**
+       * Updates the number of consumers of the frame ring or the WebSocket 
+       * stream and informs the connected callback.
+       */
+      void onConsumersChanged(unsigned int& consumerCount, unsigned int newConsumerCount, bool consumerAdded);
+      
+      /**
+       * Returns true if there is any consumer of the JPEGs. The caller has to
+       * hold the clientsMutex.
+       */
+      bool hasConsumers() const;
 
-      logging::Logger                      log;
-      std::unique_ptr<JpegEncoder>         jpegEncoder;
-      std::unique_ptr<network::TcpServer>  tcpServer;
-      std::unique_ptr<network::Connection> connection;
-      std::mutex                           connectionMutex;
-      ConnectedCallback                    connectedCallback;
+      logging::Logger                                   log;
+      std::unique_ptr<JpegEncoder>                      jpegEncoder;
+      bool                                              jpegsPinnable;   // false for memory mapped output buffers
+      http::HttpServer&                                 httpServer;
+      std::map<int, Client>                             clients;
+      std::set<int>                                     snapshotRequests;   // connection IDs
+      uint64_t                                          jpegCount;
+      uint64_t                                          snapshotCount;
+      uint64_t                                          droppedFramesOfClosedClients;
+      std::mutex                                        clientsMutex;
+      unsigned int                                      frameRingReaderCount;
+      std::unique_ptr<sharedmemory::FrameRingPublisher> frameRingPublisher;
+      unsigned int                                      webSocketClientCount;
+      std::unique_ptr<websocket::WebSocketStream>       webSocketStream;
+      network::SharedBuffer                             partTrailer;
+      ConnectedCallback                                 connectedCallback;
 };
 #endif
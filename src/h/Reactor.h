@@ -0,0 +1,45 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "Logging.h"
+
+namespace network {
+   
+   /**
+    * The process-wide io_context executing the asynchronous operations of all 
+    * TcpServers and their connections. It gets run by a pool of threads whose 
+    * size can be configured via the environment variable OCTOWATCH_NETWORK_THREADS.
+    *
+    * Because several threads run the io_context, objects that need their
+    * handlers to be serialized have to use a strand.
+    */
+   class Reactor {
+      public:
+         static Reactor& get();
+         
+         ~Reactor();
+         
+         boost::asio::io_context& getIoContext();
+         
+         unsigned int getThreadCount() const;
+         
+      private:
+         Reactor(unsigned int threadCount);
+         
+         static unsigned int getConfiguredThreadCount();
+         
+         typedef boost::asio::executor_work_guard<boost::asio::io_context::executor_type> WorkGuard;
+         
+         logging::Logger            log;
+         boost::asio::io_context    ioContext;
+         WorkGuard                  workGuard;
+         std::vector<std::thread>   threads;
+   };
+}
+#endif
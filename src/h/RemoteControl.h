@@ -3,7 +3,9 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string_view>
 #include <boost/asio.hpp>
 
 #include "Logging.h"
@@ -22,7 +24,7 @@ namespace remotecontrol {
                public:
                   virtual void onNewConnection()    = 0;
                   virtual void onConnectionClosed() = 0;
-                  virtual void onCommandReceived(const std::string& command) = 0;
+                  virtual void onCommandReceived(std::string_view command) = 0;
          };
    
          RemoteControl();
@@ -42,25 +44,26 @@ namespace remotecontrol {
          void asyncSend(const std::string& message, bool appendEndl = true);
 
          // callbacks of the listener interface of the TcpServer
-         void onNewConnection(std::unique_ptr<network::Connection> connection) override;
+         void onNewConnection(std::shared_ptr<network::Connection> connection) override;
 
-         void onConnectionClosed() override;
+         void onConnectionClosed(int connectionId) override;
          
-         void onCommandReceived(const std::string& command) override;
+         void onCommandReceived(int connectionId, std::string_view command) override;
          
       private:
          class NoopListener : public Listener {
                public:
                   void onNewConnection() override {};
                   void onConnectionClosed() override {};
-                  virtual void onCommandReceived(const std::string& /*command*/) override {};
+                  virtual void onCommandReceived(std::string_view /*command*/) override {};
          };
    
          logging::Logger                      log;
          NoopListener                         noopListener;
          std::reference_wrapper<Listener>     listener{noopListener};
          std::unique_ptr<network::TcpServer>  tcpServer;
-         std::unique_ptr<network::Connection> connection;
+         std::shared_ptr<network::Connection> connection;
+         std::mutex                           connectionMutex;
    };
 }
 #endif
@@ -0,0 +1,125 @@
+#ifndef RTSPSERVER_H
+#define RTSPSERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "H264Packetizer.h"
+#include "Logging.h"
+#include "SharedBuffer.h"
+#include "TcpServer.h"
+
+namespace rtsp {
+
+   struct RtspRequest {
+      std::string                        method;
+      std::string                        url;
+      std::map<std::string, std::string> headers;   // keys in lower case
+
+      std::string getHeader(const std::string& name) const;
+   };
+
+   /**
+    * RTSP server (RFC 2326) offering the H.264 stream as a single video track.
+    * Supported methods: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN and
+    * GET_PARAMETER/SET_PARAMETER (keep alive). The URL path gets ignored.
+    *
+    * The RTP packets (RFC 6184, see H264Packetizer) get sent either via UDP
+    * (RTP/AVP) or interleaved on the RTSP connection (RTP/AVP/TCP). Each
+    * connection has at most one session, which ends when the connection gets
+    * closed. Sessions start with the next keyframe. The access units get
+    * packetized once for all sessions, only the RTP header is per session.
+    *
+    * No RTCP sender reports get sent and received RTCP packets get ignored.
+    */
+   class RtspServer : network::TcpServer::Listener {
+      public:
+         /**
+          * Gets called with the number of playing sessions whenever a session
+          * started (sessionStarted = true) or stopped playing.
+          */
+         typedef std::function<void(unsigned int playingSessionCount, bool sessionStarted)> SessionsChangedCallback;
+
+         RtspServer(const std::vector<network::ListenAddress>& addresses, unsigned int maxConnections,
+                    SessionsChangedCallback callback);
+
+         ~RtspServer();
+
+         void start();
+
+         /**
+          * Sends the access unit (Annex B byte stream) to all playing sessions.
+          * Must not get called concurrently.
+          */
+         void send(const network::SharedBuffer& accessUnit, int64_t timestamp_us, bool keyframe);
+
+         // callbacks of the listener interface of the TcpServer
+         void onNewConnection(std::shared_ptr<network::Connection> connection) override;
+
+         void onConnectionClosed(int connectionId) override;
+
+         void onCommandReceived(int connectionId, std::string_view command) override;
+
+      private:
+         enum class Transport { NONE, UDP, TCP_INTERLEAVED };
+
+         struct Session {
+            std::string                    id;
+            Transport                      transport          = Transport::NONE;
+            boost::asio::ip::udp::endpoint rtpEndpoint;
+            uint8_t                        interleavedChannel = 0;
+            uint16_t                       sequenceNumber     = 0;
+            uint32_t                       ssrc               = 0;
+            uint32_t                       timestampOffset    = 0;
+            bool                           playing            = false;
+            bool                           waitingForKeyframe = true;
+            uint64_t                       sentPackets        = 0;
+         };
+
+         struct Client {
+            std::shared_ptr<network::Connection> connection;
+            std::vector<std::string>             requestLines;
+            Session                              session;
+         };
+
+         void openUdpSockets();
+
+         void handleRequest(Client& client, const RtspRequest& request);
+
+         void sendResponse(Client& client, const RtspRequest& request, const std::string& status,
+                           const std::string& headers = "", const std::string& body = "");
+
+         bool setUpTransport(Client& client, const std::string& transportHeader, std::string& responseTransport);
+
+         std::string createSessionDescription();
+
+         void sendPacket(Session& session, const std::shared_ptr<network::Connection>& connection,
+                         const RtpPayload& payload, uint32_t rtpTimestamp);
+
+         logging::Logger                                      log;
+         std::vector<network::ListenAddress>                  addresses;
+         unsigned int                                         maxConnections;
+         SessionsChangedCallback                              sessionsChangedCallback;
+         std::unique_ptr<network::TcpServer>                  tcpServer;
+         std::unique_ptr<boost::asio::ip::udp::socket>        rtpSocket;
+         std::unique_ptr<boost::asio::ip::udp::socket>        rtcpSocket;
+         std::map<int, Client>                                clients;
+         unsigned int                                         playingSessionCount;
+         H264Packetizer                                       packetizer;
+         std::vector<RtpPayload>                              payloads;
+         std::string                                          sequenceParameterSet;
+         std::string                                          pictureParameterSet;
+         std::mt19937                                         random;
+         std::mutex                                           mutex;
+   };
+}
+#endif
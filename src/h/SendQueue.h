@@ -0,0 +1,137 @@
+#ifndef SENDQUEUE_H
+#define SENDQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "SharedBuffer.h"
+
+#define MAX_FRAME_PART_COUNT   4
+
+namespace network {
+
+   enum class OverflowPolicy { DROP_OLDEST_FRAME, DROP_NEWEST_FRAME, DISCONNECT };
+
+   /**
+    * Defines when the send queue of a connection is full and what happens in
+    * that case.
+    */
+   struct SendQueueLimits {
+      size_t         maxQueuedBytes  = 16 * 1024 * 1024;
+      size_t         maxQueuedFrames = 1000;
+      OverflowPolicy overflowPolicy  = OverflowPolicy::DISCONNECT;
+   };
+
+   struct SendQueueStatistics {
+      uint64_t sentFrames    = 0;
+      uint64_t sentBytes     = 0;
+      uint64_t droppedFrames = 0;
+      uint64_t droppedBytes  = 0;
+      size_t   queuedFrames  = 0;
+      size_t   queuedBytes   = 0;
+   };
+
+   /**
+    * A frame consists of up to MAX_FRAME_PART_COUNT buffers (e.g. header,
+    * payload and trailer of a multipart part) that always get sent or
+    * dropped together.
+    */
+   struct Frame {
+      SharedBuffer parts[MAX_FRAME_PART_COUNT];
+      unsigned int partCount = 0;
+      size_t       size      = 0;
+      bool         droppable = false;
+   };
+
+   /**
+    * Bounded FIFO of frames. Frames taken out of the queue (for sending) are
+    * no longer part of it, therefore dropping frames never affects data
+    * that is partially sent.
+    *
+    * Frames that are not droppable (e.g. protocol headers or control messages)
+    * get queued even if the limits are exceeded, unless the policy is
+    * DISCONNECT.
+    *
+    * This class is not thread-safe.
+    */
+   class SendQueue {
+      public:
+         enum class PushResult { QUEUED, DROPPED, REJECTED, TOO_MANY_PARTS };
+
+         SendQueue(const SendQueueLimits& limits);
+
+         /**
+          * Returns REJECTED if the limits got exceeded and the policy is
+          * DISCONNECT. In this case the frame does not get queued.
+          *
+          * Returns TOO_MANY_PARTS if the frame consists of more than 
+          * MAX_FRAME_PART_COUNT buffers. Such a frame neither gets queued
+          * nor counted.
+          */
+         PushResult push(std::initializer_list<SharedBuffer> buffers, bool droppable);
+
+         /**
+          * The new limits apply to the frames pushed from now on.
+          */
+         void setLimits(const SendQueueLimits& newLimits);
+
+         const SendQueueLimits& getLimits() const;
+
+         /**
+          * Counts a frame that got dropped before it reached the queue (e.g.
+          * because it exceeded the egress budget).
+          */
+         void recordDroppedFrame(size_t size);
+
+         bool empty() const;
+
+         /**
+          * Removes the oldest frame from the queue and appends its buffers
+          * to the provided vector.
+          */
+         void pop(std::vector<SharedBuffer>& buffers);
+
+         /**
+          * Removes the oldest frames from the queue as long as their total
+          * size and buffer count stay within the given limits and appends
+          * their buffers to the provided vector (to send them with a single
+          * system call). Frames never get split, the first frame gets taken
+          * even if it exceeds the limits on its own. Returns the number of
+          * bytes taken.
+          */
+         size_t popForWrite(std::vector<SharedBuffer>& buffers, size_t maxBytes, size_t maxBuffers);
+
+         /**
+          * Returns the size in bytes of the oldest frame.
+          */
+         size_t frontSize() const;
+
+         unsigned int frontPartCount() const;
+
+         void clear();
+
+         /**
+          * Drops all droppable frames (counted as dropped) and keeps the
+          * others in their order. Returns the number of dropped bytes.
+          */
+         size_t dropDroppableFrames();
+
+         const SendQueueStatistics& getStatistics() const;
+
+      private:
+         bool exceedsLimits(size_t additionalBytes) const;
+
+         bool dropOldestDroppableFrame();
+
+         void grow();
+
+         SendQueueLimits     limits;
+         SendQueueStatistics statistics;
+         std::vector<Frame>  ringBuffer;
+         size_t              head;
+         size_t              count;
+   };
+}
+#endif
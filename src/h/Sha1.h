@@ -0,0 +1,22 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define SHA1_DIGEST_SIZE   20
+
+namespace utils {
+   
+   /**
+    * SHA-1 (RFC 3174) as required by the WebSocket handshake. It must not get
+    * used for anything security related.
+    */
+   class Sha1 {
+      public:
+         static std::array<uint8_t, SHA1_DIGEST_SIZE> digest(const std::string& data);
+   };
+}
+#endif
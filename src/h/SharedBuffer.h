@@ -0,0 +1,59 @@
+#ifndef SHAREDBUFFER_H
+#define SHAREDBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+
+namespace network {
+
+   /**
+    * Read-only memory that gets shared between its producer (e.g. an encoder)
+    * and all connections sending it. No copy of the data gets created. The
+    * producer gets informed (by the deleter of the provided std::shared_ptr)
+    * as soon as the last SharedBuffer referencing the memory got destroyed.
+    */
+   class SharedBuffer {
+      public:
+         SharedBuffer();
+
+         /**
+          * Memory that the kernel can't pin (e.g. memory mapped output buffers
+          * of a V4L2 device) has to get marked as not pinnable, otherwise 
+          * sending it with MSG_ZEROCOPY fails.
+          */
+         SharedBuffer(std::shared_ptr<const uint8_t> memory, size_t size, bool pinnable = true);
+
+         /**
+          * Creates a SharedBuffer owning a copy of the provided memory. The 
+          * memory of the copy gets taken from the default BufferPool.
+          */
+         static SharedBuffer copyOf(const void *mem, size_t size);
+
+         static SharedBuffer copyOf(const std::string& text);
+
+         /**
+          * Returns a SharedBuffer referencing size bytes of this buffer 
+          * (starting at offset) without copying them. The slice keeps the 
+          * whole memory alive.
+          */
+         SharedBuffer slice(size_t offset, size_t size) const;
+
+         const uint8_t* data() const;
+
+         size_t size() const;
+
+         bool isPinnable() const;
+
+         boost::asio::const_buffer asAsioBuffer() const;
+
+      private:
+         std::shared_ptr<const uint8_t> memory;
+         size_t                         byteCount;
+         bool                           pinnable;
+   };
+}
+#endif
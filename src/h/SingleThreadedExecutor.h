@@ -33,10 +33,10 @@ class SingleThreadedExecutor {
       
       std::condition_variable   condition;
       std::mutex                mutex;
-      std::thread               thread;
       std::unique_ptr<NextTask> nextTask;
       FinishedCallback          finishedCallback;
       bool                      quit;
+      std::thread               thread;   // started after the other members got initialized
 };
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef SOCKETOPTIONS_H
+#define SOCKETOPTIONS_H
+
+#include <boost/asio.hpp>
+
+#include "Logging.h"
+
+namespace network {
+   
+   /**
+    * Options applied to the socket of a connection after it got accepted. 
+    * A value of 0 keeps the default of the kernel. Only sendBufferSize gets
+    * applied to Unix domain sockets.
+    */
+   struct SocketOptions {
+      bool         noDelay                  = false;  // disables Nagle's algorithm
+      int          sendBufferSize           = 0;      // SO_SNDBUF in bytes
+      int          notSentLowWatermark      = 0;      // TCP_NOTSENT_LOWAT in bytes
+      unsigned int userTimeoutMs            = 0;      // TCP_USER_TIMEOUT
+      bool         keepAlive                = false;
+      int          keepAliveIdleSeconds     = 0;      // TCP_KEEPIDLE
+      int          keepAliveIntervalSeconds = 0;      // TCP_KEEPINTVL
+      int          keepAliveProbeCount      = 0;      // TCP_KEEPCNT
+      int          priority                 = 0;      // SO_PRIORITY in the range [0, 6]
+      
+      /**
+       * For small interactive messages (e.g. remote control): no Nagle delay,
+       * fast detection of dead peers even if the connection is idle and the
+       * highest priority in the queueing discipline of the network interface.
+       */
+      static SocketOptions lowLatencyProfile();
+      
+      /**
+       * For video streams: the kernel only accepts new data if few bytes are 
+       * still unsent. Therefore frames wait in the (frame-aware) send queue of 
+       * the connection where they can get dropped, instead of in the kernel.
+       */
+      static SocketOptions streamingProfile();
+      
+      /**
+       * Errors get logged but do not prevent the usage of the socket.
+       */
+      void applyTo(boost::asio::generic::stream_protocol::socket& socket, logging::Logger& log) const;
+   };
+}
+#endif
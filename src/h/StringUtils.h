@@ -1,12 +1,22 @@
 #ifndef STRINGUTILS_H
 #define STRINGUTILS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace utils {
    class String {
       public:
          static std::string toLowerCase(const std::string& text);
+         
+         static std::string toBase64(const uint8_t* data, size_t size);
+         
+         /**
+          * Removes leading and trailing spaces, tabs and carriage returns.
+          */
+         static std::string trim(std::string_view text);
    };
 }
 #endif
@@ -1,28 +1,90 @@
 #ifndef TCPSERVER_H
 #define TCPSERVER_H
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <boost/asio.hpp>
 
+#include "LineFramer.h"
+#include "EgressScheduler.h"
+#include "ListenAddress.h"
 #include "Logging.h"
+#include "Reactor.h"
+#include "SendQueue.h"
+#include "SharedBuffer.h"
+#include "SocketOptions.h"
+#include "TransportStatistics.h"
+#include "ZeroCopySender.h"
 
 namespace network {
    
-   class TcpConnection {
+   /**
+    * Settings applied to the connections accepted by a TcpServer.
+    */
+   struct ConnectionSettings {
+      // The queued buffers get handed over to the socket as one buffer sequence
+      // (gathered write) as long as both of the following limits are not exceeded.
+      // A single buffer exceeding maxBytesPerWrite gets written on its own.
+      size_t maxBytesPerWrite   = 4 * 1024 * 1024;
+      size_t maxBuffersPerWrite = 64;
+      
+      SendQueueLimits sendQueueLimits;
+      SocketOptions   socketOptions;
+      
+      // received lines (commands) exceeding this length get discarded
+      size_t maxLineLength = 4096;
+      
+      // Writes of at least this size get sent using MSG_ZEROCOPY (if supported
+      // by the kernel). 0 disables zero-copy sending.
+      size_t zeroCopyThreshold = 0;
+      
+      // Name of the stream ("h264" or "mjpeg") whose EgressScheduler budget the 
+      // connection uses. Empty for control traffic. Frames exceeding the budget
+      // get dropped unless the OverflowPolicy is DISCONNECT (the protocol does
+      // not tolerate gaps), in that case they only consume the budget.
+      std::string egressStream;
+   };
+   
+   typedef boost::asio::strand<boost::asio::io_context::executor_type> Strand;
+   
+   // TCP or Unix domain socket
+   typedef boost::asio::generic::stream_protocol::socket                        Socket;
+   typedef boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol> Acceptor;
+   
+   /**
+    * All operations on the socket get executed by the strand of the connection. 
+    * The public methods can get called by any thread.
+    */
+   class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
       public:
-         static std::unique_ptr<TcpConnection> create(boost::asio::io_context& io_context, 
-                                                      const std::string& name);
+         static std::shared_ptr<TcpConnection> create(boost::asio::io_context& io_context, 
+                                                      const std::string& name,
+                                                      const ConnectionSettings& settings);
 
          ~TcpConnection();
          
-         boost::asio::ip::tcp::socket& getSocket();
+         Socket& getSocket();
+         
+         int getId() const;
 
-         void start( std::function<void()> connectionClosedCallback, 
-                     std::function<void(const std::string&)> commandConsumer);
+         /**
+          * The connectionClosedCallback gets called exactly once as soon as the 
+          * connection got closed (by the peer, because of an error or by calling 
+          * close). The commandConsumer gets called for each received line. The 
+          * provided string_view is only valid during the call. Data sent before
+          * start got called gets queued.
+          **/
+         void start( std::function<void(int connectionId)> connectionClosedCallback, 
+                     std::function<void(int connectionId, std::string_view)> commandConsumer);
          
          /**
           * A copy of the message gets send asynchronuously. The caller can
@@ -42,43 +104,169 @@ namespace network {
           **/
          void asyncSendAndFree(void *mem, size_t size);
          
+         /**
+          * The memory referenced by the buffer gets sent without creating a
+          * copy. The reference gets released as soon as the data got written
+          * to the socket (or the connection got closed).
+          **/
+         void asyncSend(const SharedBuffer& buffer);
+         
+         /**
+          * Sends the provided buffers (without copying them) as one frame. In 
+          * contrast to the other send methods, the frame can get dropped as a 
+          * whole if the send queue is full (depending on the OverflowPolicy).
+          **/
+         void asyncSendFrame(std::initializer_list<SharedBuffer> parts);
+         
+         /**
+          * Passes the file descriptor (SCM_RIGHTS) together with the message 
+          * to the peer. Only supported by Unix domain sockets. It gets sent 
+          * immediately (not queued), therefore it should get sent before any 
+          * other data. The file descriptor has to stay open until it got sent.
+          **/
+         void asyncSendFileDescriptor(int fileDescriptor, const std::string& message);
+         
          bool outputBufferEmpty();
          
+         SendQueueStatistics getSendQueueStatistics();
+         
+         /**
+          * Drops the droppable frames not sent yet (e.g. to skip to the next
+          * keyframe of a video stream). Returns the number of dropped bytes.
+          **/
+         size_t discardQueuedFrames();
+         
+         /**
+          * Returns false if the peer is not connected via TCP (e.g. Unix 
+          * domain socket) or the kernel does not provide the information.
+          **/
+         bool getTransportStatistics(TransportStatistics& statistics);
+         
+         /**
+          * Replaces the limits of the ConnectionSettings (e.g. when a 
+          * protocol serving different kinds of streams knows what the client
+          * requested).
+          **/
+         void setSendQueueLimits(const SendQueueLimits& limits);
+         
+         /**
+          * Replaces the egress budget of the ConnectionSettings (see 
+          * ConnectionSettings::egressStream). The budget is kept if the
+          * connection already sends on this stream.
+          **/
+         void setEgressStream(const std::string& streamName);
+         
+         /**
+          * Provides the IP address of the peer. Returns false if the peer is
+          * not connected via TCP (e.g. Unix domain socket) or no longer connected.
+          **/
+         bool getRemoteIpAddress(boost::asio::ip::address& address);
+         
+         /**
+          * From now on the commandConsumer receives the bytes as they got 
+          * received instead of lines (e.g. after an upgrade to WebSocket).
+          * Has to get called by the commandConsumer.
+          **/
+         void switchToRawInput();
+         
+         /**
+          * Asynchronously closes the socket. Data not sent yet gets discarded.
+          **/
+         void close();
+         
+         /**
+          * Closes the connection as soon as the data queued so far got sent
+          * (e.g. after a response with "Connection: close"). Data provided 
+          * afterwards gets discarded. The sending side gets shut down first, 
+          * the socket gets closed when the peer closed the connection, at the 
+          * latest after LINGER_TIMEOUT.
+          **/
+         void closeAfterSending();
+         
       private:
-         TcpConnection( boost::asio::io_context& io_context, const std::string& name);
+         TcpConnection( boost::asio::io_context& io_context, const std::string& name,
+                        const ConnectionSettings& settings);
 
-         void readNextLine();
+         void readIncomingData();
+         
+         void send(std::initializer_list<SharedBuffer> parts, bool droppable);
          
-         void send(boost::asio::const_buffer& buffer);
+         void sendFileDescriptor(int fileDescriptor, const std::string& message);
 
-         void close();
+         void closeSocket();
+         
+         /**
+          * Closes the socket, abortively (RST) if the unsent data has to get
+          * discarded, and releases the retained zero-copy buffers.
+          */
+         void releaseSocket(bool discardUnsentData);
+         
+         void onZeroCopyTimeout(const boost::system::error_code& error);
+         
+         void shutDownSending();
+         
+         void onLingerTimeout(const boost::system::error_code& error);
          
          void sendQueuedData();
          
+         void writeZeroCopy();
+         
+         void onWritableForZeroCopy(const boost::system::error_code& error);
+         
+         /**
+          * Retains the buffers of the write (see ZeroCopySender::retain) and
+          * completes it.
+          */
+         void finishZeroCopyWrite(const boost::system::error_code& error, size_t bytesTransferred);
+         
+         void waitForZeroCopyCompletions();
+         
+         void onZeroCopyCompletionsAvailable(const boost::system::error_code& error);
+         
          void onWriteComplete(const boost::system::error_code& error, size_t bytes_transferred);
          
-         void onReadLineComplete(const boost::system::error_code& error, size_t bytes_transferred);
+         void onReadComplete(const boost::system::error_code& error, size_t bytes_transferred);
 
          static int getNextConnectionId();
 		 
-         logging::Logger                        log;
-         boost::asio::io_context&               ioContext;
-         size_t                                 pendingOutputByteCount;
-		 bool                                   started;
-         bool                                   closed;
-         bool                                   connectionLost;
-         boost::asio::ip::tcp::socket           socket;
-         boost::asio::streambuf                 readBuffer;
-         boost::asio::const_buffer              writeBuffer;
-         std::function<void()>                  connectionClosedCallback;
-         std::function<void(std::string&)>      commandConsumer;
-         std::queue<boost::asio::const_buffer>  sendQueue;
-         std::mutex                             mutex;
+         int                                                  id;
+         logging::Logger                                      log;
+         Strand                                               strand;
+         ConnectionSettings                                   settings;
+         size_t                                               pendingOutputByteCount;
+         bool                                                 writeInProgress;
+         std::atomic<bool>                                    started;
+         std::atomic<bool>                                    closed;
+         Socket                                               socket;
+         bool                                                 closeWhenSent;     // guarded by the mutex
+         bool                                                 sendingShutDown;
+         boost::asio::steady_timer                            lingerTimer;       // also for the zero-copy completions when closing
+         LineFramer                                           lineFramer;
+         std::vector<SharedBuffer>                            writeBuffers;
+         std::vector<boost::asio::const_buffer>               writeBufferSequence;
+         std::function<void(int)>                             connectionClosedCallback;
+         std::function<void(int, std::string_view)>           commandConsumer;
+         SendQueue                                            sendQueue;
+         std::string                                          egressStream;
+         std::shared_ptr<EgressBudget>                        egressBudget;
+         ZeroCopySender                                       zeroCopySender;
+         size_t                                               zeroCopyByteCount;
+         size_t                                               zeroCopyOffset;
+         bool                                                 waitingForZeroCopyCompletions;
+         std::mutex                                           mutex;
    };
 
+   /**
+    * The socket of the connection gets closed as soon as the Connection gets 
+    * destroyed.
+    */
    class Connection {
       public:
-         Connection(std::unique_ptr<TcpConnection> tcpConnection);
+         Connection(std::shared_ptr<TcpConnection> tcpConnection);
+         
+         ~Connection();
+         
+         int getId() const;
          
          void asyncSend(const std::string& message);
 
@@ -86,45 +274,107 @@ namespace network {
          
          void asyncSendAndFree(void *mem, size_t size);
          
+         void asyncSend(const SharedBuffer& buffer);
+         
+         void asyncSendFrame(std::initializer_list<SharedBuffer> parts);
+         
+         void asyncSendFileDescriptor(int fileDescriptor, const std::string& message);
+         
          bool outputBufferEmpty() const;
          
+         SendQueueStatistics getSendQueueStatistics() const;
+         
+         size_t discardQueuedFrames();
+         
+         bool getTransportStatistics(TransportStatistics& statistics) const;
+         
+         void setSendQueueLimits(const SendQueueLimits& limits);
+         
+         void setEgressStream(const std::string& streamName);
+         
+         bool getRemoteIpAddress(boost::asio::ip::address& address) const;
+         
+         void switchToRawInput();
+         
+         void close();
+         
+         void closeAfterSending();
+         
       private:
-         std::unique_ptr<TcpConnection> tcpConnection;
+         std::shared_ptr<TcpConnection> tcpConnection;
    };   
 
+   /**
+    * Accepts up to maxConnections connections at the same time on all of its
+    * addresses (TCP ports and/or Unix domain sockets). Further clients have to 
+    * wait until one of the connections got closed. The protocol spoken on the
+    * connections does not depend on the type of the address.
+    *
+    * All servers share the io_context of the Reactor. The callbacks of a 
+    * listener get called by the threads of the Reactor. onNewConnection and
+    * onConnectionClosed get serialized by the strand of the server, 
+    * onCommandReceived gets called by the strand of the connection (without
+    * copying the received line). For each connection onNewConnection gets 
+    * called first and onConnectionClosed last. The listener has to release its
+    * connections before the server gets destroyed.
+    */
    class TcpServer {
       public:
          class Listener {
             public:
-               virtual void onNewConnection(std::unique_ptr<Connection> connection) = 0;
-               virtual void onConnectionClosed() = 0;
-               virtual void onCommandReceived(const std::string& command)  = 0;
+               virtual void onNewConnection(std::shared_ptr<Connection> connection) = 0;
+               virtual void onConnectionClosed(int connectionId) = 0;
+               virtual void onCommandReceived(int connectionId, std::string_view command)  = 0;
          };
 
-         TcpServer(unsigned int port, const std::string& name, Listener& tcpServerListener);
+         TcpServer(const std::vector<ListenAddress>& addresses, const std::string& name, 
+                   Listener& tcpServerListener, unsigned int maxConnections,
+                   const ConnectionSettings& connectionSettings = ConnectionSettings());
 
          ~TcpServer();
          
          void start();
          
+         /**
+          * Stops accepting connections, closes all open connections and waits
+          * (at most 3 seconds) until they got closed. Must not get called by
+          * a callback of the listener.
+          */
          void stop();
          
       private:
-         void onConnectionClosed();
+         void onConnectionClosed(int connectionId);
 
-         void onCommandReceived(const std::string& command);
+         void onCommandReceived(int connectionId, std::string_view command);
+         
+         void closeAcceptorAndConnections();
 
-         void handle_accept(std::unique_ptr<TcpConnection> newConnection, 
+         void startAccepting();
+         
+         void handle_accept(size_t acceptorIndex, std::shared_ptr<TcpConnection> newConnection, 
                               const boost::system::error_code& error);
+         
+         struct ListeningSocket {
+            ListenAddress             address;
+            std::unique_ptr<Acceptor> acceptor;
+            bool                      accepting;
+         };
 
          logging::Logger                                 log;
          std::string                                     name;
-         unsigned int                                    port;
-         bool                                            stopped;
+         std::vector<ListenAddress>                      addresses;
+         unsigned int                                    maxConnections;
+         ConnectionSettings                              connectionSettings;
+         std::atomic<bool>                               stopped;
+         unsigned int                                    pendingAcceptCount;
+         unsigned int                                    openConnectionCount;
          Listener&                                       listener;
-         std::unique_ptr<boost::asio::io_context>        ioContext;
-         std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor;
-         std::unique_ptr<std::thread>                    thread;
+         boost::asio::io_context&                        ioContext;
+         Strand                                          strand;
+         std::vector<ListeningSocket>                    listeningSockets;
+         std::map<int, std::weak_ptr<TcpConnection>>     connections;
+         std::mutex                                      stateMutex;
+         std::condition_variable                         stateChanged;
    };
 }
 #endif
@@ -0,0 +1,45 @@
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace network {
+
+   /**
+    * Token bucket limiting a byte rate. Tokens accumulate with bytesPerSecond
+    * up to burstBytes. A frame conforms if the bucket holds at least as many
+    * tokens as the frame has bytes (or is full, for frames exceeding the
+    * burst). Consuming may leave the bucket in debt, which gets paid back
+    * before the next frame conforms. Therefore the long-term rate never
+    * exceeds bytesPerSecond (plus one burst).
+    *
+    * This class is not thread-safe.
+    */
+   class TokenBucket {
+      public:
+         typedef std::chrono::steady_clock Clock;
+
+         TokenBucket(uint64_t bytesPerSecond, size_t burstBytes);
+
+         bool conforms(size_t bytes, Clock::time_point now);
+
+         /**
+          * Removes the tokens even if the frame does not conform (e.g. for
+          * traffic that must not get dropped).
+          */
+         void consume(size_t bytes);
+
+         uint64_t getBytesPerSecond() const;
+
+      private:
+         void refill(Clock::time_point now);
+
+         uint64_t          bytesPerSecond;
+         double            burstBytes;
+         double            tokens;
+         Clock::time_point lastRefill;
+   };
+}
+#endif
@@ -0,0 +1,28 @@
+#ifndef TRANSPORTSTATISTICS_H
+#define TRANSPORTSTATISTICS_H
+
+#include <cstdint>
+
+namespace network {
+
+   /**
+    * Congestion state of a TCP connection (TCP_INFO) as seen by the kernel.
+    */
+   struct TransportStatistics {
+      uint32_t rtt_us             = 0;       // smoothed round trip time
+      uint32_t minRtt_us          = 0;       // lowest round trip time measured
+      uint32_t unackedSegments    = 0;       // sent, not acknowledged yet (in flight)
+      uint32_t sendMss            = 0;       // bytes per segment
+      uint32_t notSentBytes       = 0;       // in the socket, not sent yet
+      uint64_t deliveryRate       = 0;       // bytes per second
+      bool     deliveryAppLimited = false;   // deliveryRate is limited by the sender, not the network
+
+      /**
+       * Returns false if the socket is not a TCP socket. Implemented in its
+       * own translation unit because the tcp_info of the C library lacks 
+       * the newer fields of the kernel header (which conflicts with it).
+       */
+      static bool read(int socketFileDescriptor, TransportStatistics& statistics);
+   };
+}
+#endif
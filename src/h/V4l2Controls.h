@@ -0,0 +1,37 @@
+#ifndef V4L2CONTROLS_H
+#define V4L2CONTROLS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "EncoderControl.h"
+#include "Logging.h"
+
+/**
+ * Maps parameter names to the V4L2 controls of an encoder device. The ranges
+ * get queried from the device (VIDIOC_QUERYCTRL and VIDIOC_QUERYMENU) each
+ * time, therefore they are always the ones the driver currently accepts.
+ */
+class V4l2Controls {
+   public:
+      V4l2Controls(const std::string& loggerName, const std::map<std::string, uint32_t>& controlIds);
+
+      /**
+       * Controls the device does not support (or disabled) get omitted.
+       */
+      std::map<std::string, EncoderParameter> query(int fileDescriptor);
+
+      /**
+       * Validates the value against the range of the control before setting it.
+       */
+      EncoderControl::Result set(int fileDescriptor, const std::string& name, int value);
+
+   private:
+      bool query(int fileDescriptor, uint32_t controlId, EncoderParameter& parameter);
+
+      logging::Logger                 log;
+      std::map<std::string, uint32_t> controlIds;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef WEBSOCKETSTREAM_H
+#define WEBSOCKETSTREAM_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "HttpServer.h"
+#include "Logging.h"
+#include "SharedBuffer.h"
+
+#define WEBSOCKET_FRAME_HEADER_SIZE   16
+
+namespace websocket {
+
+   enum class PayloadFormat : uint8_t { H264 = 1, JPEG = 2 };
+
+   /**
+    * Sends frames (H.264 access units or JPEGs) as binary messages of a
+    * WebSocket (RFC 6455) to all clients. The clients upgrade a request of
+    * the path the stream got registered for at the HttpServer.
+    * Each message starts with a header of WEBSOCKET_FRAME_HEADER_SIZE bytes
+    * (all values big endian):
+    *
+    *    offset 0: payload format (1 = H.264 access unit, 2 = JPEG)
+    *    offset 1: flags (bit 0 = keyframe)
+    *    offset 2: reserved (2 bytes)
+    *    offset 4: frame number (4 bytes), gaps indicate dropped frames
+    *    offset 8: timestamp in microseconds (8 bytes, signed)
+    *
+    * followed by the frame (Annex B byte stream or JPEG). The message header
+    * gets created once per frame for all clients.
+    *
+    * A client that can't keep up drops whole frames. If the frames depend on
+    * each other (H.264), the client skips the following frames up to the
+    * next keyframe. Ping and close messages of the clients get answered,
+    * other messages get ignored.
+    */
+   class WebSocketStream : public http::RequestHandler {
+      public:
+         /**
+          * Gets called with the number of clients whenever a client completed
+          * the handshake (clientAdded = true) or disconnected.
+          */
+         typedef std::function<void(unsigned int clientCount, bool clientAdded)> ClientsChangedCallback;
+
+         WebSocketStream(const std::string& name, PayloadFormat format, http::HttpServer& httpServer,
+                         const std::string& path, ClientsChangedCallback callback);
+
+         ~WebSocketStream();
+
+         void start();
+
+         /**
+          * Must not get called concurrently.
+          */
+         void send(const network::SharedBuffer& frame, int64_t timestamp_us, bool keyframe);
+
+         // callbacks of the RequestHandler interface
+         Result onRequest(const http::HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                          http::HttpResponse& response) override;
+
+         void onConnectionClosed(int connectionId) override;
+
+         void onDataReceived(int connectionId, std::string_view data) override;
+
+      private:
+         struct Client {
+            std::shared_ptr<network::Connection> connection;
+            bool                                 closing;               // close message sent
+            bool                                 waitingForKeyframe;
+            uint64_t                             droppedFrames;
+            std::string                          receivedData;          // incomplete message of the client
+         };
+
+         void processReceivedData(Client& client);
+
+         void sendControlMessage(Client& client, uint8_t opcode, std::string_view payload);
+
+         logging::Logger                     log;
+         PayloadFormat                       format;
+         http::HttpServer&                   httpServer;
+         std::string                         path;
+         ClientsChangedCallback              clientsChangedCallback;
+         std::map<int, Client>               clients;              // completed the handshake
+         uint32_t                            frameNumber;
+         std::mutex                          mutex;
+   };
+}
+#endif
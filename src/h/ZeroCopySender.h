@@ -0,0 +1,104 @@
+#ifndef ZEROCOPYSENDER_H
+#define ZEROCOPYSENDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <sys/types.h>
+
+#include "Logging.h"
+#include "SharedBuffer.h"
+
+namespace network {
+   
+   struct ZeroCopyStatistics {
+      uint64_t zeroCopySends     = 0;   // send calls using MSG_ZEROCOPY
+      uint64_t copiedByKernel    = 0;   // completions reporting that the kernel copied the data anyway
+      uint64_t completedSends    = 0;
+   };
+   
+   /**
+    * Sends data of a socket using MSG_ZEROCOPY. Because the kernel reads the 
+    * data after the send call returned, the sent buffers have to be retained
+    * until the kernel reports the completion of the send calls via the error
+    * queue of the socket.
+    *
+    * Zero-copy gets disabled (and the data gets sent the ordinary way) if the 
+    * kernel does not support it for the socket or the memory, or if the 
+    * kernel keeps copying the data anyway (e.g. on loopback). Memory the 
+    * kernel can't pin (see SharedBuffer::isPinnable) must not get sent this 
+    * way, it would disable zero-copy for all following writes.
+    *
+    * This class is not thread-safe.
+    */
+   class ZeroCopySender {
+      public:
+         ZeroCopySender(logging::Logger& log);
+         
+         /**
+          * Enables SO_ZEROCOPY on the socket. Returns false if not supported.
+          */
+         bool enable(int socketFd);
+         
+         bool isEnabled() const;
+         
+         /**
+          * Non-blocking send of the buffers, skipping the first offset bytes.
+          * Returns the number of bytes sent or -1 (errno set) like sendmsg.
+          */
+         ssize_t send(int socketFd, const std::vector<boost::asio::const_buffer>& buffers, size_t offset);
+         
+         /**
+          * Takes the buffers (the vector is empty afterwards) and keeps them 
+          * until all send calls executed so far are complete. Buffers not 
+          * sent with MSG_ZEROCOPY get released immediately. Has to get called
+          * after every write, also after a failed one, because the send calls
+          * before the failure might have used MSG_ZEROCOPY.
+          */
+         void retain(std::vector<SharedBuffer>& buffers);
+         
+         /**
+          * Reads the completion notifications from the error queue of the 
+          * socket and releases the buffers of completed send calls.
+          */
+         void processCompletions(int socketFd);
+         
+         bool hasRetainedBuffers() const;
+         
+         /**
+          * Returns true if the kernel did not report the completion of all 
+          * send calls using MSG_ZEROCOPY yet, no matter whether their buffers 
+          * got retained already.
+          */
+         bool hasIncompleteSends() const;
+         
+         /**
+          * Releases all retained buffers (e.g. after closing the socket). The
+          * kernel must no longer send their data.
+          */
+         void clear();
+         
+         const ZeroCopyStatistics& getStatistics() const;
+         
+      private:
+         struct RetainedBuffers {
+            uint32_t                  lastSequence;
+            std::vector<SharedBuffer> buffers;
+         };
+         
+         void releaseUpTo(uint32_t sequence);
+         
+         logging::Logger&            log;
+         bool                        enabled;
+         uint32_t                    nextSequence;
+         uint32_t                    completedSequence;  // next sequence not reported as complete
+         uint32_t                    retainedSequence;   // next sequence not covered by retain
+         unsigned int                consecutiveCopiedCount;
+         std::deque<RetainedBuffers> retainedBuffers;
+         ZeroCopyStatistics          statistics;
+   };
+}
+#endif
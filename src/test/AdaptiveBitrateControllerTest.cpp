@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include "AdaptiveBitrateController.h"
+#include "Check.h"
+
+using namespace std::chrono_literals;
+
+typedef AdaptiveBitrateController::Clock Clock;
+
+#define MIN_BITRATE   1000000
+#define MAX_BITRATE   10000000
+
+// rounding of the floating point factors
+static bool isNear(unsigned int actual, unsigned int expected) {
+   return (actual + 1 >= expected) && (actual <= expected + 1);
+}
+
+/**
+ * Feeds a scripted sequence of samples into a controller. The time starts
+ * at the current time because setMaxBitrate uses the real clock.
+ */
+class Script {
+   public:
+      Script(unsigned int maxBitrate = MAX_BITRATE)
+         : setterBitrate(0),
+           setterCallCount(0),
+           now(Clock::now()),
+           controller(MIN_BITRATE, maxBitrate, [this](unsigned int bitrate) {
+              setterBitrate = bitrate;
+              setterCallCount++;
+           }) {}
+
+      void update(const CongestionSample& sample, Clock::duration elapsed = 1s) {
+         now += elapsed;
+         controller.update({sample}, now);
+      }
+
+      unsigned int              setterBitrate;
+      unsigned int              setterCallCount;
+      Clock::time_point         now;
+      AdaptiveBitrateController controller;
+};
+
+static CongestionSample clearSample() {
+   return CongestionSample();
+}
+
+static CongestionSample sendQueueCongestedSample() {
+   CongestionSample sample;
+   sample.queuedBytes = 1000000;   // 800 ms at MAX_BITRATE
+   return sample;
+}
+
+static CongestionSample inFlightSample(uint32_t unackedSegments) {
+   CongestionSample sample;
+   sample.transportAvailable           = true;
+   sample.transport.rtt_us             = 20000;
+   sample.transport.minRtt_us          = 20000;
+   sample.transport.sendMss            = 1448;
+   sample.transport.unackedSegments    = unackedSegments;
+   sample.transport.deliveryAppLimited = true;
+   return sample;
+}
+
+static void testInitialBitrateIsTheMaximum() {
+   Script script;
+   CHECK_EQUAL(script.setterCallCount, 1u);
+   CHECK_EQUAL(script.setterBitrate, (unsigned int)MAX_BITRATE);
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MAX_BITRATE);
+}
+
+static void testDecreaseAfterTwoCongestedSamples() {
+   Script script;
+   script.update(sendQueueCongestedSample());
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MAX_BITRATE);
+   script.update(sendQueueCongestedSample());
+   CHECK_EQUAL(script.controller.getBitrate(), 7500000u);
+   CHECK_EQUAL(script.setterBitrate, 7500000u);
+}
+
+static void testNoDecreaseAfterInterruptedCongestion() {
+   Script script;
+   script.update(sendQueueCongestedSample());
+   script.update(clearSample());
+   script.update(sendQueueCongestedSample());
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MAX_BITRATE);
+}
+
+static void testNoDecreaseWhileTheBacklogDrains() {
+   Script script;
+   CongestionSample sample = sendQueueCongestedSample();
+   script.update(sample);
+   sample.queuedBytes -= 1000;
+   script.update(sample);
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MAX_BITRATE);
+}
+
+static void testDecreaseToTheDeliveryRate() {
+   Script script;
+   CongestionSample sample = sendQueueCongestedSample();
+   sample.transportAvailable     = true;
+   sample.transport.deliveryRate = 800000;   // 6.4 Mbit/s
+   script.update(sample);
+   script.update(sample);
+   CHECK(isNear(script.controller.getBitrate(), 5760000));   // with a margin of 10%
+}
+
+static void testIncreaseAfterFiveSecondsClear() {
+   Script script;
+   script.update(sendQueueCongestedSample());
+   script.update(sendQueueCongestedSample());
+   CHECK_EQUAL(script.controller.getBitrate(), 7500000u);
+
+   script.update(clearSample());   // clear since now
+   for (int i = 0; i < 4; i++) {
+      script.update(clearSample());
+      CHECK_EQUAL(script.controller.getBitrate(), 7500000u);
+   }
+   script.update(clearSample(), 999ms);
+   CHECK_EQUAL(script.controller.getBitrate(), 7500000u);
+   script.update(clearSample(), 1ms);
+   CHECK(isNear(script.controller.getBitrate(), 8625000));   // +15%
+   CHECK_EQUAL(script.setterBitrate, script.controller.getBitrate());
+
+   // the next increase follows after the increase interval
+   script.update(clearSample());
+   CHECK(isNear(script.controller.getBitrate(), 8625000));
+   script.update(clearSample());
+   CHECK(isNear(script.controller.getBitrate(), 9918750));
+}
+
+static void testIncreaseIsClampedToTheMaximum() {
+   Script script;
+   script.update(sendQueueCongestedSample());
+   script.update(sendQueueCongestedSample());
+   for (int i = 0; i < 30; i++) {
+      script.update(clearSample());
+      CHECK(script.controller.getBitrate() <= MAX_BITRATE);
+   }
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MAX_BITRATE);
+}
+
+static void testSetMaxBitrate() {
+   Script script;
+   script.controller.setMaxBitrate(5000000);
+   CHECK_EQUAL(script.controller.getMaxBitrate(), 5000000u);
+   CHECK_EQUAL(script.controller.getBitrate(), 5000000u);
+   CHECK_EQUAL(script.setterBitrate, 5000000u);
+
+   script.update(sendQueueCongestedSample());
+   script.update(sendQueueCongestedSample());
+   CHECK_EQUAL(script.controller.getBitrate(), 3750000u);
+   for (int i = 0; i < 30; i++) {
+      script.update(clearSample());
+      CHECK(script.controller.getBitrate() <= 5000000u);
+   }
+   CHECK_EQUAL(script.controller.getBitrate(), 5000000u);
+}
+
+static void testSetMaxBitrateBelowTheMinimum() {
+   Script script;
+   script.controller.setMaxBitrate(MIN_BITRATE / 2);
+   for (int i = 0; i < 5; i++) {
+      script.update(sendQueueCongestedSample());
+   }
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MIN_BITRATE / 2);
+}
+
+static void testDecreaseStopsAtTheMinimum() {
+   Script script;
+   for (int i = 0; i < 40; i++) {
+      script.update(sendQueueCongestedSample());
+   }
+   CHECK_EQUAL(script.controller.getBitrate(), (unsigned int)MIN_BITRATE);
+}
+
+static void testDataInFlightBeyondThePathIsCongestion() {
+   // the path holds 25000 bytes at 10 Mbit/s and 20 ms, 500 segments in
+   // flight exceed that by more than the backlog limit (625000 bytes)
+   Script script;
+   script.update(inFlightSample(500));
+   script.update(inFlightSample(500));
+   CHECK_EQUAL(script.controller.getBitrate(), 7500000u);
+}
+
+static void testDataInFlightWithinThePathIsClear() {
+   Script script;
+   script.update(sendQueueCongestedSample());
+   script.update(sendQueueCongestedSample());
+   for (int i = 0; i < 6; i++) {
+      script.update(inFlightSample(12));   // 17376 bytes, the path holds 18750 bytes at 7.5 Mbit/s
+   }
+   CHECK(isNear(script.controller.getBitrate(), 8625000));
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testInitialBitrateIsTheMaximum();
+   testDecreaseAfterTwoCongestedSamples();
+   testNoDecreaseAfterInterruptedCongestion();
+   testNoDecreaseWhileTheBacklogDrains();
+   testDecreaseToTheDeliveryRate();
+   testIncreaseAfterFiveSecondsClear();
+   testIncreaseIsClampedToTheMaximum();
+   testSetMaxBitrate();
+   testSetMaxBitrateBelowTheMinimum();
+   testDecreaseStopsAtTheMinimum();
+   testDataInFlightBeyondThePathIsCongestion();
+   testDataInFlightWithinThePathIsClear();
+   return test::exitCode();
+}
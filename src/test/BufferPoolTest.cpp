@@ -0,0 +1,69 @@
+#include <sstream>
+#include <string>
+
+#include "BufferPool.h"
+#include "Check.h"
+
+using network::BufferPool;
+
+static bool contains(const std::string& text, const std::string& expected) {
+   return text.find(expected) != std::string::npos;
+}
+
+static void testReuse() {
+   BufferPool pool(1024);
+   void*      block = pool.acquireBlock(100);
+   CHECK_EQUAL(pool.getStatistics().outstandingBytes, 128u);
+   pool.releaseBlock(block, 100);
+   CHECK_EQUAL(pool.getStatistics().retainedBytes, 128u);
+
+   // the same size class gets served by the pool
+   CHECK(pool.acquireBlock(128) == block);
+   CHECK_EQUAL(pool.getStatistics().allocations, 2u);
+   CHECK_EQUAL(pool.getStatistics().heapAllocations, 1u);
+   CHECK_EQUAL(pool.getStatistics().retainedBytes, 0u);
+   pool.releaseBlock(block, 128);
+}
+
+static void testHighWaterMark() {
+   BufferPool pool(1024);
+   void*      first  = pool.acquireBlock(1024);
+   void*      second = pool.acquireBlock(1000);
+   pool.releaseBlock(first, 1024);
+   pool.releaseBlock(second, 1000);
+   CHECK_EQUAL(pool.getStatistics().retainedBytes, 1024u);
+   CHECK_EQUAL(pool.getStatistics().discardedBlocks, 1u);
+   CHECK_EQUAL(pool.getStatistics().outstandingBytes, 0u);
+}
+
+static void testMetrics() {
+   BufferPool pool(1024);
+   void*      block = pool.acquireBlock(64);
+   pool.releaseBlock(block, 64);
+   block = pool.acquireBlock(10);
+   void* bigBlock = pool.acquireBlock(16 * 1024 * 1024);
+
+   std::ostringstream output;
+   pool.writeMetrics(output);
+   std::string metrics = output.str();
+   CHECK(contains(metrics, "octowatch_buffer_pool_allocations_total{size_class=\"64\",result=\"reused\"} 1\n"));
+   CHECK(contains(metrics, "octowatch_buffer_pool_allocations_total{size_class=\"64\",result=\"heap\"} 1\n"));
+   CHECK(contains(metrics, "octowatch_buffer_pool_allocations_total{size_class=\"larger\",result=\"heap\"} 1\n"));
+   CHECK(!contains(metrics, "size_class=\"128\""));
+   CHECK(contains(metrics, "octowatch_buffer_pool_max_retained_bytes 1024\n"));
+   CHECK(contains(metrics, "octowatch_buffer_pool_retained_bytes 0\n"));
+   CHECK(contains(metrics, "octowatch_buffer_pool_outstanding_bytes 16777280\n"));
+   CHECK(contains(metrics, "octowatch_buffer_pool_discarded_blocks_total 0\n"));
+
+   pool.releaseBlock(block, 10);
+   pool.releaseBlock(bigBlock, 16 * 1024 * 1024);
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testReuse();
+   testHighWaterMark();
+   testMetrics();
+   return test::exitCode();
+}
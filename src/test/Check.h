@@ -0,0 +1,44 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * Minimal checks for the unit tests (no test framework required). A failed
+ * check gets reported on stderr and the test continues. The main function of
+ * a test returns test::exitCode().
+ */
+namespace test {
+
+   inline unsigned int failureCount = 0;
+
+   template<typename A, typename B> void checkEqual(const A& actual, const B& expected, const char* actualText,
+                                                    const char* file, int line) {
+      if (!(actual == expected)) {
+         std::cerr << file << ":" << line << ": " << actualText << " is " << actual << ", expected "
+                   << expected << std::endl;
+         failureCount++;
+      }
+   }
+
+   inline void check(bool condition, const char* conditionText, const char* file, int line) {
+      if (!condition) {
+         std::cerr << file << ":" << line << ": " << conditionText << " is false" << std::endl;
+         failureCount++;
+      }
+   }
+
+   inline int exitCode() {
+      if (failureCount > 0) {
+         std::cerr << failureCount << " check(s) failed" << std::endl;
+         return EXIT_FAILURE;
+      }
+      return EXIT_SUCCESS;
+   }
+}
+
+#define CHECK(condition)              test::check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) test::checkEqual((actual), (expected), #actual, __FILE__, __LINE__)
+
+#endif
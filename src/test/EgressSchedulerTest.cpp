@@ -0,0 +1,178 @@
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+
+#include "Check.h"
+#include "EgressScheduler.h"
+
+using namespace std::chrono_literals;
+using network::EgressBudget;
+using network::EgressLimits;
+using network::EgressScheduler;
+
+typedef network::TokenBucket::Clock Clock;
+
+#define BYTES_PER_SECOND   100000
+#define BURST_BYTES        (64 * 1024)   // the minimum burst of the scheduler
+
+/**
+ * Offers frames of the given size in the given interval for the duration
+ * and returns the bytes that got admitted.
+ */
+static uint64_t offer(EgressBudget& budget, size_t frameBytes, Clock::duration interval, Clock::duration duration,
+                      Clock::time_point& now) {
+   uint64_t          admittedBytes = 0;
+   Clock::time_point end           = now + duration;
+   for (; now < end; now += interval) {
+      if (budget.admit(frameBytes, now)) {
+         admittedBytes += frameBytes;
+      }
+   }
+   return admittedBytes;
+}
+
+static EgressLimits streamLimits() {
+   EgressLimits limits;
+   limits.streamBytesPerSecond["h264"] = BYTES_PER_SECOND;
+   return limits;
+}
+
+static void testUnlimitedStream() {
+   EgressScheduler               scheduler{EgressLimits()};
+   std::shared_ptr<EgressBudget> budget = scheduler.createStreamBudget("h264");
+   Clock::time_point             now    = Clock::now();
+   CHECK_EQUAL(offer(*budget, 10000, 1ms, 1s, now), 10000000u);
+}
+
+static void testSustainedStreamRate() {
+   EgressScheduler               scheduler(streamLimits());
+   std::shared_ptr<EgressBudget> budget = scheduler.createStreamBudget("h264");
+   Clock::time_point             now    = Clock::now();
+
+   // offering ten times the rate for 10 s
+   uint64_t admittedBytes = offer(*budget, 10000, 10ms, 10s, now);
+   CHECK(admittedBytes <= 10 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(admittedBytes >= 10 * BYTES_PER_SECOND + BURST_BYTES - 20000);
+
+   // the limit of the stream is shared by its connections
+   std::shared_ptr<EgressBudget> otherBudget = scheduler.createStreamBudget("h264");
+   uint64_t                      sharedBytes = 0;
+   Clock::time_point             end         = now + 10s;
+   for (; now < end; now += 10ms) {
+      sharedBytes += budget->admit(10000, now) ? 10000 : 0;
+      sharedBytes += otherBudget->admit(10000, now) ? 10000 : 0;
+   }
+   CHECK(sharedBytes <= 10 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(sharedBytes >= 10 * BYTES_PER_SECOND - 20000);
+}
+
+static void testBurst() {
+   EgressScheduler               scheduler(streamLimits());
+   std::shared_ptr<EgressBudget> budget = scheduler.createStreamBudget("h264");
+   Clock::time_point             now    = Clock::now();
+
+   // a full bucket admits one burst at once, a frame exceeding it as a whole
+   unsigned int admittedFrames = 0;
+   while (budget->admit(1000, now)) {
+      admittedFrames++;
+   }
+   CHECK_EQUAL(admittedFrames, BURST_BYTES / 1000u);
+
+   now += 10s;
+   CHECK(budget->admit(10 * BURST_BYTES, now));
+   CHECK(!budget->admit(1, now + 1s));
+}
+
+static void testClientLimit() {
+   EgressLimits limits;
+   limits.clientBytesPerSecond = BYTES_PER_SECOND;
+   EgressScheduler               scheduler(limits);
+   std::shared_ptr<EgressBudget> budget      = scheduler.createStreamBudget("h264");
+   std::shared_ptr<EgressBudget> otherBudget = scheduler.createStreamBudget("mjpeg");
+   Clock::time_point             start       = Clock::now();
+
+   // each client gets its own budget
+   Clock::time_point now           = start;
+   uint64_t          admittedBytes = offer(*budget, 10000, 10ms, 10s, now);
+   CHECK(admittedBytes <= 10 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(admittedBytes >= 10 * BYTES_PER_SECOND + BURST_BYTES - 20000);
+   now = start;
+   CHECK_EQUAL(offer(*otherBudget, 10000, 10ms, 10s, now), admittedBytes);
+}
+
+static void testControlTrafficIsNeverDropped() {
+   EgressLimits limits;
+   limits.linkBytesPerSecond = BYTES_PER_SECOND;
+   EgressScheduler               scheduler(limits);
+   std::shared_ptr<EgressBudget> control = scheduler.createControlBudget();
+   std::shared_ptr<EgressBudget> stream  = scheduler.createStreamBudget("h264");
+   Clock::time_point             now     = Clock::now();
+
+   // offering ten times the link rate
+   CHECK_EQUAL(offer(*control, 10000, 10ms, 10s, now), 10000000u);
+
+   // the control traffic consumed the link budget of the streams
+   CHECK(!stream->admit(1000, now));
+   CHECK(!stream->admit(1000, now + 10s));
+}
+
+static void testControlTrafficHasPriority() {
+   EgressLimits limits;
+   limits.linkBytesPerSecond = BYTES_PER_SECOND;
+   EgressScheduler               scheduler(limits);
+   std::shared_ptr<EgressBudget> control       = scheduler.createControlBudget();
+   std::shared_ptr<EgressBudget> stream        = scheduler.createStreamBudget("h264");
+   Clock::time_point             now           = Clock::now();
+   Clock::time_point             end           = now + 10s;
+   uint64_t                      controlBytes  = 0;
+   uint64_t                      streamBytes   = 0;
+
+   // control traffic with half the link rate, the stream gets the rest
+   for (; now < end; now += 10ms) {
+      controlBytes += control->admit(500, now) ? 500 : 0;
+      streamBytes  += stream->admit(1000, now) ? 1000 : 0;
+   }
+   CHECK_EQUAL(controlBytes, 500000u);
+   CHECK(streamBytes <= 5 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(streamBytes >= 5 * BYTES_PER_SECOND + BURST_BYTES - 2000);
+}
+
+static void testAccountedTrafficIsNeverDropped() {
+   EgressScheduler               scheduler(streamLimits());
+   std::shared_ptr<EgressBudget> budget = scheduler.createStreamBudget("h264");
+   Clock::time_point             now    = Clock::now();
+
+   budget->account(10 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(!budget->admit(1000, now + 9s));
+   CHECK(budget->admit(1000, now + 11s));
+}
+
+static void testMetrics() {
+   EgressScheduler               scheduler(streamLimits());
+   std::shared_ptr<EgressBudget> budget = scheduler.createStreamBudget("h264");
+   Clock::time_point             now    = Clock::now();
+   CHECK(budget->admit(BURST_BYTES, now));
+   CHECK(!budget->admit(1000, now));
+
+   std::ostringstream output;
+   scheduler.writeMetrics(output);
+   CHECK(output.str().find("octowatch_egress_frames_total{stream=\"h264\",result=\"sent\"} 1\n") !=
+         std::string::npos);
+   CHECK(output.str().find("octowatch_egress_bytes_total{stream=\"h264\",result=\"dropped\"} 1000\n") !=
+         std::string::npos);
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testUnlimitedStream();
+   testSustainedStreamRate();
+   testBurst();
+   testClientLimit();
+   testControlTrafficIsNeverDropped();
+   testControlTrafficHasPriority();
+   testAccountedTrafficIsNeverDropped();
+   testMetrics();
+   return test::exitCode();
+}
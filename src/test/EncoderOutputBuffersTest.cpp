@@ -0,0 +1,123 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Check.h"
+#include "EncoderOutputBuffers.h"
+
+using namespace std::chrono_literals;
+
+#define BUFFER_SIZE   4096
+
+/**
+ * Maps a page of a temporary file (instead of a V4L2 buffer) and fills it
+ * with the provided value.
+ */
+static uint8_t* mapBuffer(EncoderOutputBuffers& buffers, uint8_t value) {
+   FILE* file = std::tmpfile();
+   CHECK(file != nullptr);
+   CHECK(ftruncate(fileno(file), BUFFER_SIZE) == 0);
+   void* address = buffers.map(fileno(file), BUFFER_SIZE, 0);
+   std::fclose(file);   // the mapping keeps the file
+   CHECK(address != MAP_FAILED);
+   std::memset(address, value, BUFFER_SIZE);
+   return (uint8_t*)address;
+}
+
+static bool isMapped(void* address) {
+   return (msync(address, BUFFER_SIZE, MS_ASYNC) == 0) || (errno != ENOMEM);
+}
+
+static void testRequeueAfterLastReference() {
+   EncoderOutputBuffers buffers("test", 2);
+   uint8_t*             data          = mapBuffer(buffers, 1);
+   unsigned int         requeueCount  = 0;
+   auto                 lentData      = buffers.lend(data, 10, [&requeueCount]{ requeueCount++; });
+   auto                 copyOfLease   = lentData;
+   CHECK(lentData.get() == data);
+
+   lentData.reset();
+   CHECK_EQUAL(requeueCount, 0u);
+   copyOfLease.reset();
+   CHECK_EQUAL(requeueCount, 1u);
+   buffers.close();
+}
+
+static void testCopyIfAllBuffersAreLent() {
+   EncoderOutputBuffers buffers("test", 1);
+   uint8_t*             data         = mapBuffer(buffers, 7);
+   unsigned int         requeueCount = 0;
+   auto                 lentData     = buffers.lend(data, 10, [&requeueCount]{ requeueCount++; });
+   auto                 copiedData   = buffers.lend(data + 10, 10, [&requeueCount]{ requeueCount++; });
+   CHECK(copiedData.get() != data + 10);
+   CHECK_EQUAL(copiedData.get()[9], 7u);
+   CHECK_EQUAL(requeueCount, 1u);
+
+   lentData.reset();
+   CHECK_EQUAL(requeueCount, 2u);
+   buffers.close();
+}
+
+static void testRequeueDoesNotHoldTheLock() {
+   EncoderOutputBuffers           buffers("test", 2);
+   uint8_t*                       data = mapBuffer(buffers, 1);
+   std::shared_ptr<const uint8_t> lentAgain;
+
+   // lending from within the requeue function would dead-lock otherwise
+   auto lentData = buffers.lend(data, 10, [&buffers, &lentAgain, data]{
+      lentAgain = buffers.lend(data, 10, []{});
+   });
+   lentData.reset();
+   CHECK(lentAgain.get() == data);
+   lentAgain.reset();
+   buffers.close();
+}
+
+static void testCloseWaitsForRelease() {
+   EncoderOutputBuffers buffers("test", 2);
+   uint8_t*             data     = mapBuffer(buffers, 1);
+   auto                 lentData = buffers.lend(data, 10, []{});
+   std::thread releasingThread([&lentData]{
+      std::this_thread::sleep_for(100ms);
+      lentData.reset();
+   });
+   auto start = std::chrono::steady_clock::now();
+   buffers.close();
+   CHECK(std::chrono::steady_clock::now() - start >= 100ms);
+   CHECK(lentData == nullptr);
+   releasingThread.join();
+}
+
+static void testMappingOutlivesClosedBuffers() {
+   std::shared_ptr<const uint8_t> lentData;
+   uint8_t*                       data;
+   unsigned int                   requeueCount = 0;
+   {
+      EncoderOutputBuffers buffers("test", 2);
+      data     = mapBuffer(buffers, 42);
+      lentData = buffers.lend(data, 10, [&requeueCount]{ requeueCount++; });
+      buffers.close();   // times out
+   }
+   CHECK(isMapped(data));
+   CHECK_EQUAL(lentData.get()[9], 42u);
+
+   lentData.reset();
+   CHECK_EQUAL(requeueCount, 0u);
+   CHECK(!isMapped(data));
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testRequeueAfterLastReference();
+   testCopyIfAllBuffersAreLent();
+   testRequeueDoesNotHoldTheLock();
+   testCloseWaitsForRelease();
+   testMappingOutlivesClosedBuffers();
+   return test::exitCode();
+}
@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <vector>
+
+#include "Check.h"
+#include "H264Packetizer.h"
+
+using network::SharedBuffer;
+using rtsp::H264Packetizer;
+using rtsp::RtpPayload;
+
+#define MAX_PAYLOAD_SIZE   100
+
+#define FU_START_BIT   0x80
+#define FU_END_BIT     0x40
+
+/**
+ * Appends a NAL unit with a 4 byte start code, the header byte and size - 1
+ * bytes of data (without emulation prevention, the data never contains a
+ * start code).
+ */
+static void appendNalUnit(std::vector<uint8_t>& accessUnit, uint8_t header, size_t size) {
+   accessUnit.insert(accessUnit.end(), {0, 0, 0, 1, header});
+   for (size_t index = 1; index < size; index++) {
+      accessUnit.push_back((uint8_t)(index % 200) + 1);
+   }
+}
+
+static SharedBuffer keyframe(size_t idrSize) {
+   std::vector<uint8_t> accessUnit;
+   appendNalUnit(accessUnit, 0x09, 2);         // access unit delimiter
+   appendNalUnit(accessUnit, 0x67, 10);        // SPS
+   appendNalUnit(accessUnit, 0x68, 4);         // PPS
+   appendNalUnit(accessUnit, 0x65, idrSize);   // IDR slice
+   return SharedBuffer::copyOf(accessUnit.data(), accessUnit.size());
+}
+
+static void testFragmentation() {
+   H264Packetizer          packetizer(MAX_PAYLOAD_SIZE);
+   std::vector<RtpPayload> payloads;
+   packetizer.packetize(keyframe(250), payloads);
+
+   // STAP-A with SPS and PPS followed by the fragments of the IDR slice
+   CHECK_EQUAL(payloads.size(), 4u);
+   CHECK_EQUAL(payloads[0].data.data()[0] & 0x1f, 24);
+   CHECK_EQUAL(payloads[0].size(), 1u + 2 + 10 + 2 + 4);
+   CHECK_EQUAL(packetizer.getSequenceParameterSet().size(), 10u);
+   CHECK_EQUAL(packetizer.getPictureParameterSet().size(), 4u);
+
+   size_t fragmentedBytes = 0;
+   for (size_t index = 1; index < payloads.size(); index++) {
+      const RtpPayload& payload = payloads[index];
+      CHECK_EQUAL(payload.payloadHeaderSize, 2u);
+      CHECK_EQUAL(payload.payloadHeader[0], (0x65 & 0xe0) | 28);   // FU indicator
+      CHECK_EQUAL(payload.payloadHeader[1] & 0x1f, 5);             // type of the fragmented NAL unit
+      CHECK_EQUAL((payload.payloadHeader[1] & FU_START_BIT) != 0, index == 1);
+      CHECK_EQUAL((payload.payloadHeader[1] & FU_END_BIT) != 0, index == payloads.size() - 1);
+      CHECK(payload.size() <= MAX_PAYLOAD_SIZE);
+      fragmentedBytes += payload.data.size();
+   }
+   CHECK_EQUAL(fragmentedBytes, 249u);   // without the NAL header
+
+   // the marker bit is set on the last packet of the access unit only
+   for (size_t index = 0; index < payloads.size(); index++) {
+      CHECK_EQUAL(payloads[index].marker, index == payloads.size() - 1);
+   }
+}
+
+static void testSingleNalUnitPackets() {
+   H264Packetizer          packetizer(MAX_PAYLOAD_SIZE);
+   std::vector<RtpPayload> payloads;
+   std::vector<uint8_t>    accessUnit;
+   appendNalUnit(accessUnit, 0x41, MAX_PAYLOAD_SIZE);   // non-IDR slice of the maximum size
+   packetizer.packetize(SharedBuffer::copyOf(accessUnit.data(), accessUnit.size()), payloads);
+
+   CHECK_EQUAL(payloads.size(), 1u);
+   CHECK_EQUAL(payloads[0].payloadHeaderSize, 0u);
+   CHECK_EQUAL(payloads[0].size(), (size_t)MAX_PAYLOAD_SIZE);
+   CHECK_EQUAL(payloads[0].data.data()[0], 0x41);
+   CHECK(payloads[0].marker);
+   CHECK(packetizer.getSequenceParameterSet().empty());
+}
+
+static void testRtpHeaders() {
+   H264Packetizer          packetizer(MAX_PAYLOAD_SIZE);
+   std::vector<RtpPayload> payloads;
+   packetizer.packetize(keyframe(250), payloads);
+
+   uint16_t sequenceNumber = 0xfffe;
+   uint32_t rtpTimestamp   = H264Packetizer::toRtpTimestamp(1000000);
+   CHECK_EQUAL(rtpTimestamp, 90000u);
+
+   for (size_t index = 0; index < payloads.size(); index++) {
+      uint8_t buffer[RTP_HEADER_SIZE + 2];
+      size_t  size = H264Packetizer::writeHeaders(buffer, payloads[index], 96, sequenceNumber++, rtpTimestamp,
+                                                  0x12345678);
+      CHECK_EQUAL(size, (size_t)RTP_HEADER_SIZE + payloads[index].payloadHeaderSize);
+      CHECK_EQUAL(buffer[0], 0x80);
+      CHECK_EQUAL(buffer[1], (index == payloads.size() - 1) ? 0x80 | 96 : 96);
+      CHECK_EQUAL((size_t)((buffer[2] << 8) | buffer[3]), (0xfffe + index) & 0xffff);
+      CHECK_EQUAL(((uint32_t)buffer[4] << 24) | (buffer[5] << 16) | (buffer[6] << 8) | buffer[7], 90000u);
+      CHECK_EQUAL(((uint32_t)buffer[8] << 24) | (buffer[9] << 16) | (buffer[10] << 8) | buffer[11], 0x12345678u);
+   }
+   CHECK_EQUAL(sequenceNumber, 2u);   // wrapped around
+}
+
+static void testRtpTimestamps() {
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(0), 0u);
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(33333), 2999u);
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(33334), 3000u);
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(1000011), 90000u);
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(1000012), 90001u);
+
+   // frames at 30 fps advance by 3000
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(10000000 + 100000) - H264Packetizer::toRtpTimestamp(10000000 + 66667),
+               3000u);
+
+   // the timestamps wrap around after 2^32 ticks (about 13.25 hours)
+   int64_t wrap_us = (int64_t)(((uint64_t)1 << 32) * 1000000 / 90000);
+   CHECK(H264Packetizer::toRtpTimestamp(wrap_us - 1000) > 0xffff0000u);
+   CHECK(H264Packetizer::toRtpTimestamp(wrap_us + 1000) < 0x10000u);
+   CHECK_EQUAL(H264Packetizer::toRtpTimestamp(wrap_us + 1000000) - H264Packetizer::toRtpTimestamp(wrap_us), 90000u);
+}
+
+int main() {
+   testFragmentation();
+   testSingleNalUnitPackets();
+   testRtpHeaders();
+   testRtpTimestamps();
+   return test::exitCode();
+}
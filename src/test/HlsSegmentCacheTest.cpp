@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "HlsSegmentCache.h"
+
+using hls::HlsPart;
+using hls::HlsSegment;
+using hls::HlsSegmentCache;
+using mp4::Fmp4Fragment;
+using network::SharedBuffer;
+
+typedef HlsSegmentCache::Availability Availability;
+
+#define TARGET_DURATION_S      2
+#define PART_TARGET_DURATION   (FMP4_TIMESCALE / 5)   // 10 parts per segment
+#define PART_SIZE              100
+
+static Fmp4Fragment fragment(bool keyframe) {
+   std::vector<uint8_t> data(PART_SIZE, 0);
+   return Fmp4Fragment{SharedBuffer::copyOf(data.data(), data.size()), keyframe, 0, PART_TARGET_DURATION, 6};
+}
+
+static bool contains(const std::string& playlist, const std::string& text) {
+   return playlist.find(text) != std::string::npos;
+}
+
+static void testPartAndSegmentBoundaries() {
+   HlsSegmentCache cache(6, TARGET_DURATION_S, PART_TARGET_DURATION);
+
+   // a playlist has to start with a keyframe
+   CHECK(!cache.addPart(fragment(false)));
+   CHECK(cache.empty());
+
+   // a keyframe starts a new segment
+   cache.addPart(fragment(true));
+   cache.addPart(fragment(false));
+   cache.addPart(fragment(false));
+   cache.addPart(fragment(true));
+
+   HlsSegment segment;
+   CHECK(cache.getSegment(0, segment) == Availability::AVAILABLE);
+   CHECK_EQUAL(segment.parts.size(), 3u);
+   CHECK_EQUAL(segment.duration, 3u * PART_TARGET_DURATION);
+   CHECK_EQUAL(segment.size, 3u * PART_SIZE);
+   CHECK(segment.parts[0].independent);
+   CHECK(!segment.parts[1].independent);
+   CHECK(cache.getSegment(1, segment) == Availability::PENDING);
+   CHECK(cache.getSegment(2, segment) == Availability::UNAVAILABLE);
+
+   // the part following the last one is the preload hint
+   HlsPart part;
+   CHECK(cache.getPart(0, 2, part) == Availability::AVAILABLE);
+   CHECK(cache.getPart(0, 3, part) == Availability::UNAVAILABLE);
+   CHECK(cache.getPart(1, 0, part) == Availability::AVAILABLE);
+   CHECK(cache.getPart(1, 1, part) == Availability::PENDING);
+   CHECK(cache.getPart(1, 2, part) == Availability::UNAVAILABLE);
+
+   // the keyframe gets requested one part before reaching the target duration
+   for (int partIndex = 1; partIndex < 8; partIndex++) {
+      CHECK(!cache.addPart(fragment(false)));
+   }
+   CHECK(cache.addPart(fragment(false)));
+   CHECK(!cache.addPart(fragment(false)));
+
+   // a segment without a keyframe gets completed at the target duration
+   cache.addPart(fragment(false));
+   CHECK(cache.getSegment(1, segment) == Availability::AVAILABLE);
+   CHECK_EQUAL(segment.duration, (uint64_t)TARGET_DURATION_S * FMP4_TIMESCALE);
+   CHECK(cache.getPart(2, 0, part) == Availability::AVAILABLE);
+   CHECK(!part.independent);
+
+   std::string playlist = cache.createPlaylist();
+   CHECK(contains(playlist, "#EXT-X-TARGETDURATION:2\n"));
+   CHECK(contains(playlist, "#EXT-X-PART-INF:PART-TARGET=0.20000\n"));
+   CHECK(contains(playlist, "#EXT-X-MEDIA-SEQUENCE:0\n"));
+   CHECK(contains(playlist, "#EXT-X-PART:DURATION=0.20000,URI=\"part0.0.m4s\",INDEPENDENT=YES\n"
+                            "#EXT-X-PART:DURATION=0.20000,URI=\"part0.1.m4s\"\n"));
+   CHECK(contains(playlist, "#EXTINF:0.60000,\nsegment0.m4s\n"));
+   CHECK(contains(playlist, "#EXTINF:2.00000,\nsegment1.m4s\n"));
+   CHECK(contains(playlist, "URI=\"part2.0.m4s\"\n#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part2.1.m4s\"\n"));
+   CHECK(!contains(playlist, "segment2.m4s"));
+
+   auto statistics = cache.getStatistics();
+   CHECK_EQUAL(statistics.segmentCount, 3u);
+   CHECK_EQUAL(statistics.partCount, 14u);
+   CHECK_EQUAL(statistics.size, 14u * PART_SIZE);
+}
+
+static void testMediaSequenceContinuity() {
+   HlsSegmentCache cache(2, TARGET_DURATION_S, PART_TARGET_DURATION);
+   HlsSegment      segment;
+   for (int segmentCount = 0; segmentCount < 6; segmentCount++) {
+      cache.addPart(fragment(true));
+   }
+
+   // two complete segments are kept besides the one in progress
+   CHECK(contains(cache.createPlaylist(), "#EXT-X-MEDIA-SEQUENCE:3\n"));
+   CHECK(cache.getSegment(2, segment) == Availability::UNAVAILABLE);
+   CHECK(cache.getSegment(3, segment) == Availability::AVAILABLE);
+   CHECK_EQUAL(segment.sequenceNumber, 3u);
+   CHECK_EQUAL(cache.getStatistics().segmentCount, 3u);
+
+   // the media sequence numbers continue after the dropped segments
+   cache.clear();
+   CHECK(cache.empty());
+   CHECK(contains(cache.createPlaylist(), "#EXT-X-MEDIA-SEQUENCE:6\n"));
+   CHECK(!contains(cache.createPlaylist(), "#EXT-X-PRELOAD-HINT"));
+   CHECK(!cache.addPart(fragment(false)));
+   cache.addPart(fragment(true));
+   cache.addPart(fragment(true));
+   CHECK(contains(cache.createPlaylist(), "#EXT-X-MEDIA-SEQUENCE:6\n"));
+   CHECK(cache.getSegment(6, segment) == Availability::AVAILABLE);
+   CHECK(cache.getSegment(7, segment) == Availability::PENDING);
+}
+
+static void testBlockingReload() {
+   HlsSegmentCache cache(2, TARGET_DURATION_S, PART_TARGET_DURATION);
+
+   // before the first part the next two segments are about to get added
+   CHECK(cache.getPlaylistAvailability(0, 0) == Availability::PENDING);
+   CHECK(cache.getPlaylistAvailability(2, -1) == Availability::PENDING);
+   CHECK(cache.getPlaylistAvailability(3, -1) == Availability::UNAVAILABLE);
+
+   cache.addPart(fragment(true));
+   cache.addPart(fragment(false));
+   cache.addPart(fragment(true));
+
+   CHECK(cache.getPlaylistAvailability(0, -1) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(0, 1) == Availability::AVAILABLE);
+   // beyond the last part of a complete segment is the first part of the next one
+   CHECK(cache.getPlaylistAvailability(0, 2) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(1, -1) == Availability::PENDING);
+   CHECK(cache.getPlaylistAvailability(1, 0) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(1, 1) == Availability::PENDING);
+   CHECK(cache.getPlaylistAvailability(3, 0) == Availability::PENDING);
+   CHECK(cache.getPlaylistAvailability(4, 0) == Availability::UNAVAILABLE);
+
+   cache.addPart(fragment(false));
+   CHECK(cache.getPlaylistAvailability(1, 1) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(1, 2) == Availability::PENDING);
+
+   // segments that already got dropped are available
+   for (int segmentCount = 0; segmentCount < 4; segmentCount++) {
+      cache.addPart(fragment(true));
+   }
+   CHECK(contains(cache.createPlaylist(), "#EXT-X-MEDIA-SEQUENCE:3\n"));
+   CHECK(cache.getPlaylistAvailability(1, 0) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(5, 0) == Availability::AVAILABLE);
+   CHECK(cache.getPlaylistAvailability(5, 1) == Availability::PENDING);
+}
+
+int main() {
+   testPartAndSegmentBoundaries();
+   testMediaSequenceContinuity();
+   testBlockingReload();
+   return test::exitCode();
+}
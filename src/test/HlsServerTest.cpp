@@ -0,0 +1,105 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Check.h"
+#include "HlsServer.h"
+#include "HttpServer.h"
+#include "TestClient.h"
+
+using namespace std::chrono_literals;
+using hls::HlsServer;
+using http::HttpServer;
+using network::SharedBuffer;
+using test::TestClient;
+
+#define FRAMES_PER_PART    6    // configured in HlsServer
+#define FRAME_INTERVAL_US  33333
+
+static std::string       socketPath;
+static std::atomic<bool> active(false);
+
+/**
+ * Returns an access unit with fake parameter sets, only their presence
+ * matters to the muxer.
+ */
+static SharedBuffer accessUnit(bool keyframe) {
+   std::vector<uint8_t> data;
+   if (keyframe) {
+      data.insert(data.end(), {0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1f, 0xe9});   // SPS
+      data.insert(data.end(), {0, 0, 0, 1, 0x68, 0xce, 0x3c, 0x80});         // PPS
+   }
+   data.insert(data.end(), {0, 0, 0, 1, (uint8_t)(keyframe ? 0x65 : 0x41), 0x88, 0x84, 0x21});
+   return SharedBuffer::copyOf(data.data(), data.size());
+}
+
+static void sendFrames(HlsServer& server, int& frameIndex, int frameCount) {
+   for (int count = 0; count < frameCount; count++, frameIndex++) {
+      server.send(accessUnit(frameIndex == 0), (int64_t)frameIndex * FRAME_INTERVAL_US, frameIndex == 0);
+   }
+}
+
+static std::string request(const std::string& path) {
+   return "GET " + path + " HTTP/1.1\r\nHost: test\r\n\r\n";
+}
+
+static void testBlockingReload(HlsServer& server) {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(socketPath));
+
+   // the first request activates the server
+   CHECK(client.send(request("/hls/stream.m3u8?_HLS_msn=0&_HLS_part=1")));
+   for (int attempt = 0; (attempt < 100) && !active; attempt++) {
+      std::this_thread::sleep_for(10ms);
+   }
+   CHECK(active);
+
+   // a fragment gets completed by the first access unit of the next one
+   int frameIndex = 0;
+   sendFrames(server, frameIndex, FRAMES_PER_PART + 1);
+   CHECK(!client.receive(response, "\r\n\r\n", 300ms));
+
+   sendFrames(server, frameIndex, FRAMES_PER_PART);
+   CHECK(client.receive(response, "#EXT-X-PRELOAD-HINT", 2s));
+   CHECK(response.find("HTTP/1.1 200 OK\r\n") == 0);
+   CHECK(response.find("#EXT-X-MEDIA-SEQUENCE:0\n") != std::string::npos);
+   CHECK(response.find("URI=\"part0.1.m4s\"") != std::string::npos);
+   CHECK(response.find("PRELOAD-HINT:TYPE=PART,URI=\"part0.2.m4s\"") != std::string::npos);
+
+   // the part of the preload hint blocks as well
+   response.clear();
+   CHECK(client.send(request("/hls/part0.2.m4s")));
+   CHECK(!client.receive(response, "\r\n\r\n", 300ms));
+   sendFrames(server, frameIndex, FRAMES_PER_PART);
+   CHECK(client.receive(response, "Content-Type: video/mp4\r\n", 2s));
+   CHECK(response.find("HTTP/1.1 200 OK\r\n") == 0);
+
+   // too far in the future
+   response.clear();
+   CHECK(client.send(request("/hls/stream.m3u8?_HLS_msn=3")));
+   CHECK(client.receive(response, "HTTP/1.1 400 ", 2s));
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   socketPath = "/tmp/octowatch-hls-server-test-" + std::to_string(getpid()) + ".sock";
+   setenv("OCTOWATCH_HTTP_ADDRESSES", ("unix:" + socketPath).c_str(), 1);
+
+   HttpServer httpServer;
+   {
+      HlsServer server(httpServer, 640, 480, [](bool serverActive) { active = serverActive; }, []() {});
+      server.start();
+      httpServer.start();
+
+      testBlockingReload(server);
+   }
+   return test::exitCode();
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "Check.h"
+#include "HttpServer.h"
+#include "TestClient.h"
+
+using namespace std::chrono_literals;
+using http::HttpRequest;
+using http::HttpResponse;
+using http::HttpServer;
+using http::RequestHandler;
+using test::TestClient;
+
+#define RESPONSE_BODY   "hello\n"
+
+class TextHandler : public RequestHandler {
+   public:
+      Result onRequest(const HttpRequest& request, std::shared_ptr<network::Connection> connection,
+                       HttpResponse& response) override {
+         response = HttpResponse::text(200, RESPONSE_BODY);
+         return Result::RESPONDED;
+      }
+
+      void onConnectionClosed(int connectionId) override {}
+};
+
+class PrefixHandler : public TextHandler {
+   public:
+      void writeMetrics(std::ostream& output) override {
+         output << "prefix_handler_metric 1\n";
+      }
+};
+
+static std::string socketPath;
+
+/**
+ * Sends the request and checks that the response arrives and that the
+ * server closes the connection without the client closing it.
+ */
+static void checkClosedAfterResponse(const std::string& request, const std::string& expectedStatusLine) {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send(request));
+   CHECK(client.receive(response, expectedStatusLine, 2s));
+   CHECK(response.find("Connection: close\r\n") != std::string::npos);
+   CHECK(client.waitForClose(2s));
+}
+
+static void testKeepAliveConnectionStaysOpen() {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send("GET /text HTTP/1.1\r\nHost: test\r\n\r\n"));
+   CHECK(client.receive(response, RESPONSE_BODY, 2s));
+   CHECK(response.find("HTTP/1.1 200 OK\r\n") == 0);
+   CHECK(!client.waitForClose(500ms));
+
+   response.clear();
+   CHECK(client.send("GET /text HTTP/1.1\r\nHost: test\r\n\r\n"));
+   CHECK(client.receive(response, RESPONSE_BODY, 2s));
+}
+
+static void testConnectionCloseRequested() {
+   checkClosedAfterResponse("GET /text HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n", RESPONSE_BODY);
+}
+
+static void testHttp10() {
+   checkClosedAfterResponse("GET /text HTTP/1.0\r\n\r\n", RESPONSE_BODY);
+}
+
+static void testMalformedRequest() {
+   checkClosedAfterResponse("this is not HTTP\r\n\r\n", "HTTP/1.1 400 ");
+}
+
+static void testUnsupportedVersion() {
+   checkClosedAfterResponse("GET /text HTTP/2.0\r\n\r\n", "HTTP/1.1 505 ");
+}
+
+static void testRejectedUpgrade() {
+   checkClosedAfterResponse("GET /text HTTP/1.1\r\nHost: test\r\nUpgrade: websocket\r\n\r\n", RESPONSE_BODY);
+}
+
+static void testPipelinedRequestsAfterCloseGetIgnored() {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send("GET /text HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n"
+                     "GET /text HTTP/1.1\r\nHost: test\r\n\r\n"));
+   CHECK(client.receive(response, "", 2s));   // closed by the server
+   CHECK(response.find(RESPONSE_BODY) != std::string::npos);
+   CHECK_EQUAL(response.find(RESPONSE_BODY), response.rfind(RESPONSE_BODY));
+}
+
+static void testClientNotClosingGetsDisconnected() {
+   // the client keeps its end open, the server closes its socket after the
+   // linger timeout and releases the connection slot
+   TestClient client;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send("GET /text HTTP/1.0\r\n\r\n"));
+   CHECK(client.waitForClose(2s));
+
+   std::string connectionsGauge = "octowatch_http_connections 1\n";   // the metrics request
+   std::string metrics;
+   for (int attempt = 0; (attempt < 50) && (metrics.find(connectionsGauge) == std::string::npos); attempt++) {
+      TestClient metricsClient;
+      metrics.clear();
+      CHECK(metricsClient.connectTo(socketPath));
+      CHECK(metricsClient.send("GET /metrics HTTP/1.0\r\n\r\n"));
+      metricsClient.receive(metrics, "", 2s);
+      if (metrics.find(connectionsGauge) == std::string::npos) {
+         std::this_thread::sleep_for(100ms);
+      }
+   }
+   CHECK(metrics.find(connectionsGauge) != std::string::npos);
+}
+
+static void testMetricsOfPrefixRoutes() {
+   TestClient  client;
+   std::string metrics;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send("GET /metrics HTTP/1.0\r\n\r\n"));
+   CHECK(client.receive(metrics, "", 2s));
+   CHECK(metrics.find("prefix_handler_metric 1\n") != std::string::npos);
+}
+
+static void testBufferPoolMetrics() {
+   TestClient  client;
+   std::string metrics;
+   CHECK(client.connectTo(socketPath));
+   CHECK(client.send("GET /metrics HTTP/1.0\r\n\r\n"));
+   CHECK(client.receive(metrics, "", 2s));
+   CHECK(metrics.find("octowatch_buffer_pool_max_retained_bytes 33554432\n") != std::string::npos);
+   CHECK(metrics.find("octowatch_buffer_pool_allocations_total{size_class=") != std::string::npos);
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   socketPath = "/tmp/octowatch-http-server-test-" + std::to_string(getpid()) + ".sock";
+   setenv("OCTOWATCH_HTTP_ADDRESSES", ("unix:" + socketPath).c_str(), 1);
+
+   TextHandler   handler;
+   PrefixHandler prefixHandler;
+   {
+      HttpServer server;
+      server.addRoute("/text", handler);
+      server.addPrefixRoute("/prefix/", prefixHandler);
+      server.start();
+
+      testKeepAliveConnectionStaysOpen();
+      testConnectionCloseRequested();
+      testHttp10();
+      testMalformedRequest();
+      testUnsupportedVersion();
+      testRejectedUpgrade();
+      testPipelinedRequestsAfterCloseGetIgnored();
+      testClientNotClosingGetsDisconnected();
+      testMetricsOfPrefixRoutes();
+      testBufferPoolMetrics();
+
+      server.removeRoutes(handler);
+      server.removeRoutes(prefixHandler);
+   }
+   return test::exitCode();
+}
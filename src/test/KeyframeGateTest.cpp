@@ -0,0 +1,149 @@
+#include <chrono>
+
+#include "Check.h"
+#include "KeyframeGate.h"
+
+using namespace std::chrono_literals;
+using network::SendQueueStatistics;
+
+typedef KeyframeGate::Clock    Clock;
+typedef KeyframeGate::Decision Decision;
+
+#define RECOVERY_DELAY   1000ms
+#define UNIT_SIZE        1000
+
+static const KeyframeGate::BacklogLimit LIMIT = {100000, 100};
+
+static void testJoinAtKeyframe() {
+   Clock::time_point   connectTime = Clock::now();
+   Clock::time_point   now         = connectTime;
+   KeyframeGate        gate(1, RECOVERY_DELAY, connectTime);
+   SendQueueStatistics queue;
+
+   // the client can't decode anything before the first IDR frame
+   for (int frame = 0; frame < 10; frame++) {
+      now += 33ms;
+      CHECK(gate.decide(UNIT_SIZE, false, queue, LIMIT, now) == Decision::SKIP);
+      CHECK(gate.isWaitingForKeyframe());
+   }
+   CHECK(gate.getStatistics().timeToFirstKeyframe == Clock::duration::zero());
+
+   now += 33ms;
+   CHECK(gate.decide(UNIT_SIZE, true, queue, LIMIT, now) == Decision::SEND);
+   CHECK(!gate.isWaitingForKeyframe());
+   CHECK(gate.getStatistics().timeToFirstKeyframe == 11 * 33ms);
+
+   // skipping the units before the first keyframe is not a recovery
+   CHECK_EQUAL(gate.getStatistics().recoveryCount, 0u);
+   CHECK_EQUAL(gate.getStatistics().droppedBytes, 0u);
+}
+
+static void testAllUnitsAfterJoining() {
+   Clock::time_point   now = Clock::now();
+   KeyframeGate        gate(1, RECOVERY_DELAY, now);
+   SendQueueStatistics queue;
+   CHECK(gate.decide(UNIT_SIZE, true, queue, LIMIT, now) == Decision::SEND);
+   CHECK(gate.getStatistics().timeToFirstKeyframe == Clock::duration::zero());
+
+   for (int frame = 0; frame < 100; frame++) {
+      now += 33ms;
+      CHECK(gate.decide(UNIT_SIZE, (frame % 30) == 29, queue, LIMIT, now) == Decision::SEND);
+   }
+}
+
+static SendQueueStatistics backlog(size_t queuedBytes) {
+   SendQueueStatistics queue;
+   queue.queuedBytes  = queuedBytes;
+   queue.queuedFrames = queuedBytes / UNIT_SIZE;
+   return queue;
+}
+
+/**
+ * Returns a gate of a client that already joined the stream.
+ */
+static KeyframeGate joinedGate(Clock::time_point now) {
+   KeyframeGate gate(1, RECOVERY_DELAY, now);
+   CHECK(gate.decide(UNIT_SIZE, true, SendQueueStatistics(), LIMIT, now) == Decision::SEND);
+   return gate;
+}
+
+static void testShortBacklogIsTolerated() {
+   Clock::time_point now  = Clock::now();
+   KeyframeGate      gate = joinedGate(now);
+
+   for (int frame = 0; frame < 29; frame++) {
+      now += 33ms;
+      CHECK(gate.decide(UNIT_SIZE, false, backlog(LIMIT.bytes + 1), LIMIT, now) == Decision::SEND);
+   }
+   // the backlog got cleared before the recovery delay passed
+   now += 33ms;
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(LIMIT.bytes), LIMIT, now) == Decision::SEND);
+   for (int frame = 0; frame < 29; frame++) {
+      now += 33ms;
+      CHECK(gate.decide(UNIT_SIZE, false, backlog(LIMIT.bytes + 1), LIMIT, now) == Decision::SEND);
+   }
+   CHECK_EQUAL(gate.getStatistics().recoveryCount, 0u);
+}
+
+static void testRecoveryResumesAtKeyframe() {
+   Clock::time_point start = Clock::now();
+   Clock::time_point now   = start;
+   KeyframeGate      gate  = joinedGate(now);
+
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::SEND);
+   now += RECOVERY_DELAY - 1ms;
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::SEND);
+   now += 1ms;
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::RECOVER);
+   gate.onQueueDiscarded(2 * LIMIT.bytes);
+   CHECK(gate.isWaitingForKeyframe());
+
+   // no NAL unit gets sent until the requested keyframe arrives
+   for (int frame = 0; frame < 10; frame++) {
+      now += 33ms;
+      CHECK(gate.decide(UNIT_SIZE, false, backlog(0), LIMIT, now) == Decision::SKIP);
+   }
+   now += 33ms;
+   CHECK(gate.decide(UNIT_SIZE, true, backlog(0), LIMIT, now) == Decision::SEND);
+   CHECK(!gate.isWaitingForKeyframe());
+   now += 33ms;
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(0), LIMIT, now) == Decision::SEND);
+
+   CHECK_EQUAL(gate.getStatistics().recoveryCount, 1u);
+   CHECK_EQUAL(gate.getStatistics().droppedBytes, 2u * LIMIT.bytes + 11 * UNIT_SIZE);
+   CHECK(gate.getStatistics().timeToFirstKeyframe == Clock::duration::zero());
+}
+
+static void testQueuedFramesLimit() {
+   Clock::time_point   now   = Clock::now();
+   KeyframeGate        gate  = joinedGate(now);
+   SendQueueStatistics queue;
+   queue.queuedFrames = LIMIT.frames + 1;
+
+   CHECK(gate.decide(10, false, queue, LIMIT, now) == Decision::SEND);
+   now += RECOVERY_DELAY;
+   CHECK(gate.decide(10, false, queue, LIMIT, now) == Decision::RECOVER);
+}
+
+static void testKeyframeDoesNotStartRecovery() {
+   // the keyframe fixes the stream anyway, it gets queued
+   Clock::time_point now  = Clock::now();
+   KeyframeGate      gate = joinedGate(now);
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::SEND);
+   now += 2 * RECOVERY_DELAY;
+   CHECK(gate.decide(UNIT_SIZE, true, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::SEND);
+   now += 33ms;
+   CHECK(gate.decide(UNIT_SIZE, false, backlog(2 * LIMIT.bytes), LIMIT, now) == Decision::RECOVER);
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testJoinAtKeyframe();
+   testAllUnitsAfterJoining();
+   testShortBacklogIsTolerated();
+   testRecoveryResumesAtKeyframe();
+   testQueuedFramesLimit();
+   testKeyframeDoesNotStartRecovery();
+   return test::exitCode();
+}
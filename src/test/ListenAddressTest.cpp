@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "ListenAddress.h"
+#include "Logging.h"
+
+using network::ListenAddress;
+
+typedef ListenAddress::Type Type;
+
+/**
+ * Returns the address parsed from the text or "invalid".
+ */
+static std::string parse(const std::string& text) {
+   ListenAddress address;
+   return ListenAddress::parse(text, address) ? address.toString() : "invalid";
+}
+
+static void testTcp() {
+   ListenAddress address;
+   CHECK(ListenAddress::parse(" tcp:8887 ", address));
+   CHECK(address.type == Type::TCP);
+   CHECK_EQUAL(address.port, 8887u);
+   CHECK(address.ipAddress == boost::asio::ip::address(boost::asio::ip::address_v4::any()));
+   CHECK_EQUAL(address.toString(), std::string("tcp:8887"));
+
+   CHECK_EQUAL(parse("tcp:1"), std::string("tcp:1"));
+   CHECK_EQUAL(parse("tcp:65535"), std::string("tcp:65535"));
+   CHECK_EQUAL(parse("tcp:0"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:65536"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:123456"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:http"), std::string("invalid"));
+   CHECK_EQUAL(parse("udp:8887"), std::string("invalid"));
+   CHECK_EQUAL(parse("8887"), std::string("invalid"));
+}
+
+static void testTcpIpv4() {
+   ListenAddress address;
+   CHECK(ListenAddress::parse("tcp:127.0.0.1:8887", address));
+   CHECK(address.type == Type::TCP);
+   CHECK_EQUAL(address.port, 8887u);
+   CHECK(address.ipAddress == boost::asio::ip::make_address("127.0.0.1"));
+   CHECK_EQUAL(address.toString(), std::string("tcp:127.0.0.1:8887"));
+
+   auto endpoint = address.toEndpoint();
+   CHECK_EQUAL(endpoint.protocol().family(), AF_INET);
+
+   CHECK_EQUAL(parse("tcp:0.0.0.0:80"), std::string("tcp:80"));
+   CHECK_EQUAL(parse("tcp:192.168.1.10:80"), std::string("tcp:192.168.1.10:80"));
+   CHECK_EQUAL(parse("tcp:256.0.0.1:80"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:127.0.0.1"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:127.0.0:80"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:localhost:80"), std::string("invalid"));
+}
+
+static void testTcpIpv6() {
+   ListenAddress address;
+   CHECK(ListenAddress::parse("tcp:[::1]:8887", address));
+   CHECK(address.type == Type::TCP);
+   CHECK_EQUAL(address.port, 8887u);
+   CHECK(address.ipAddress == boost::asio::ip::make_address("::1"));
+   CHECK_EQUAL(address.toString(), std::string("tcp:[::1]:8887"));
+
+   auto endpoint = address.toEndpoint();
+   CHECK_EQUAL(endpoint.protocol().family(), AF_INET6);
+
+   CHECK_EQUAL(parse("tcp:[::]:8554"), std::string("tcp:[::]:8554"));
+   CHECK_EQUAL(parse("tcp:[FE80:0:0:0:0:0:0:1]:80"), std::string("tcp:[fe80::1]:80"));
+   CHECK_EQUAL(parse("tcp:[::ffff:192.168.1.10]:80"), std::string("tcp:[::ffff:192.168.1.10]:80"));
+   CHECK_EQUAL(parse("tcp:[::1]"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:::1:80"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:[1:2:3:4:5:6:7:8:9]:80"), std::string("invalid"));
+   CHECK_EQUAL(parse("tcp:[::1]:0"), std::string("invalid"));
+}
+
+static void testUnixDomain() {
+   ListenAddress address;
+   CHECK(ListenAddress::parse(" unix:/run/octowatch/mpjpeg.sock", address));
+   CHECK(address.type == Type::UNIX_DOMAIN);
+   CHECK_EQUAL(address.path, std::string("/run/octowatch/mpjpeg.sock"));
+   CHECK_EQUAL(address.toString(), std::string("unix:/run/octowatch/mpjpeg.sock"));
+   CHECK_EQUAL(address.toEndpoint().protocol().family(), AF_UNIX);
+
+   CHECK_EQUAL(parse("unix:"), std::string("invalid"));
+   CHECK_EQUAL(parse("unix:/tmp/with space.sock"), std::string("invalid"));
+}
+
+static void testFromEnvironment() {
+   setenv("OCTOWATCH_TEST_ADDRESSES", "tcp:8887, tcp:[::1]:8888,invalid,unix:/tmp/test.sock", 1);
+   std::vector<ListenAddress> addresses = ListenAddress::fromEnvironment("OCTOWATCH_TEST_ADDRESSES", 1234);
+   CHECK_EQUAL(addresses.size(), 3u);
+   if (addresses.size() == 3) {
+      CHECK_EQUAL(addresses[0].toString(), std::string("tcp:8887"));
+      CHECK_EQUAL(addresses[1].toString(), std::string("tcp:[::1]:8888"));
+      CHECK_EQUAL(addresses[2].toString(), std::string("unix:/tmp/test.sock"));
+   }
+
+   // the default port if none of the entries is valid
+   setenv("OCTOWATCH_TEST_ADDRESSES", "tcp:[::1],unix:", 1);
+   addresses = ListenAddress::fromEnvironment("OCTOWATCH_TEST_ADDRESSES", 1234);
+   CHECK_EQUAL(addresses.size(), 1u);
+   CHECK_EQUAL(addresses[0].toString(), std::string("tcp:1234"));
+
+   unsetenv("OCTOWATCH_TEST_ADDRESSES");
+   addresses = ListenAddress::fromEnvironment("OCTOWATCH_TEST_ADDRESSES", 1234);
+   CHECK_EQUAL(addresses.size(), 1u);
+   CHECK_EQUAL(addresses[0].toString(), std::string("tcp:1234"));
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testTcp();
+   testTcpIpv4();
+   testTcpIpv6();
+   testUnixDomain();
+   testFromEnvironment();
+   return test::exitCode();
+}
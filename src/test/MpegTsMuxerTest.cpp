@@ -0,0 +1,185 @@
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "Check.h"
+#include "MpegTsMuxer.h"
+
+using mpegts::MpegTsMuxer;
+using network::SharedBuffer;
+
+#define FRAME_INTERVAL_US   33333
+#define PCR_PER_US          27   // 27 MHz
+
+/**
+ * The fields of a TS packet the tests are interested in.
+ */
+struct TsPacket {
+   uint16_t pid;
+   bool     payloadUnitStart;
+   uint8_t  continuityCounter;
+   bool     randomAccess;
+   bool     hasPcr;
+   uint64_t pcr;
+   size_t   payloadOffset;   // in the packet
+};
+
+static TsPacket parse(const uint8_t* packet) {
+   TsPacket result = {(uint16_t)(((packet[1] & 0x1f) << 8) | packet[2]), (packet[1] & 0x40) != 0,
+                      (uint8_t)(packet[3] & 0x0f), false, false, 0, 4};
+   if (packet[3] & 0x20) {
+      uint8_t adaptationFieldLength = packet[4];
+      if ((adaptationFieldLength > 0) && (packet[5] & 0x10)) {
+         uint64_t base = ((uint64_t)packet[6] << 25) | (packet[7] << 17) | (packet[8] << 9) | (packet[9] << 1) |
+                         (packet[10] >> 7);
+         result.hasPcr = true;
+         result.pcr    = base * 300 + (((packet[10] & 0x01) << 8) | packet[11]);
+      }
+      result.randomAccess  = (adaptationFieldLength > 0) && (packet[5] & 0x40);
+      result.payloadOffset = 5 + adaptationFieldLength;
+   }
+   return result;
+}
+
+static SharedBuffer accessUnit(size_t size, bool keyframe) {
+   std::vector<uint8_t> data = {0, 0, 0, 1, (uint8_t)(keyframe ? 0x65 : 0x41)};
+   for (size_t index = data.size(); index < size; index++) {
+      data.push_back((uint8_t)(index % 250) + 1);
+   }
+   return SharedBuffer::copyOf(data.data(), data.size());
+}
+
+static void testContinuityCounters() {
+   MpegTsMuxer          muxer;
+   std::vector<uint8_t> output;
+   for (int frame = 0; frame < 60; frame++) {
+      // sizes covering single packets, exact multiples and the stuffing
+      muxer.mux(accessUnit(100 + frame * 97, (frame % 30) == 0), (int64_t)frame * FRAME_INTERVAL_US, (frame % 30) == 0,
+                output);
+   }
+   CHECK_EQUAL(output.size() % TS_PACKET_SIZE, 0u);
+
+   std::map<uint16_t, int> lastCounters;
+   for (size_t offset = 0; offset < output.size(); offset += TS_PACKET_SIZE) {
+      CHECK_EQUAL(output[offset], 0x47);
+      TsPacket packet = parse(&output[offset]);
+      CHECK(packet.payloadOffset <= TS_PACKET_SIZE);
+      auto entry = lastCounters.find(packet.pid);
+      if (entry != lastCounters.end()) {
+         CHECK_EQUAL((int)packet.continuityCounter, (entry->second + 1) & 0x0f);
+      } else {
+         CHECK_EQUAL((int)packet.continuityCounter, 0);
+      }
+      lastCounters[packet.pid] = packet.continuityCounter;
+   }
+   CHECK_EQUAL(lastCounters.size(), 3u);
+}
+
+static void testProgramTablesCadence() {
+   MpegTsMuxer          muxer;
+   std::vector<uint8_t> output;
+   std::vector<int64_t> tableTimestamps_us;
+   std::vector<bool>    keyframes;
+
+   for (int frame = 0; frame < 90; frame++) {
+      bool    keyframe     = (frame % 45) == 0;
+      int64_t timestamp_us = 1000000 + (int64_t)frame * FRAME_INTERVAL_US;
+      output.clear();
+      muxer.mux(accessUnit(500, keyframe), timestamp_us, keyframe, output);
+
+      TsPacket first = parse(&output[0]);
+      if (first.pid == TS_PID_PAT) {
+         // the PAT is followed by the PMT and the PES
+         CHECK_EQUAL(parse(&output[TS_PACKET_SIZE]).pid, TS_PID_PMT);
+         CHECK_EQUAL(parse(&output[2 * TS_PACKET_SIZE]).pid, TS_PID_VIDEO);
+         tableTimestamps_us.push_back(timestamp_us);
+      } else {
+         CHECK_EQUAL(first.pid, TS_PID_VIDEO);
+      }
+      keyframes.push_back(keyframe);
+
+      // the keyframes get sent with PAT and PMT and are random access points
+      if (keyframe) {
+         CHECK_EQUAL(first.pid, TS_PID_PAT);
+         CHECK(parse(&output[2 * TS_PACKET_SIZE]).randomAccess);
+      }
+   }
+
+   CHECK(tableTimestamps_us.size() >= 90 / 3);
+   for (size_t index = 1; index < tableTimestamps_us.size(); index++) {
+      CHECK(tableTimestamps_us[index] - tableTimestamps_us[index - 1] <= 100000);
+   }
+
+   // a stream starting without a keyframe starts with the tables as well
+   MpegTsMuxer otherMuxer;
+   output.clear();
+   otherMuxer.mux(accessUnit(500, false), 0, false, output);
+   CHECK_EQUAL(parse(&output[0]).pid, TS_PID_PAT);
+}
+
+static void testPcr() {
+   MpegTsMuxer          muxer;
+   std::vector<uint8_t> output;
+   int64_t              firstTimestamp_us = 5000000;
+   uint64_t             lastPcr           = 0;
+
+   for (int frame = 0; frame < 100; frame++) {
+      int64_t timestamp_us = firstTimestamp_us + (int64_t)frame * FRAME_INTERVAL_US;
+      output.clear();
+      muxer.mux(accessUnit(1000, frame == 0), timestamp_us, frame == 0, output);
+
+      // the PCR is carried by the first packet of each PES only
+      int pcrCount = 0;
+      for (size_t offset = 0; offset < output.size(); offset += TS_PACKET_SIZE) {
+         TsPacket packet = parse(&output[offset]);
+         if (packet.hasPcr) {
+            CHECK_EQUAL(packet.pid, TS_PID_VIDEO);
+            CHECK(packet.payloadUnitStart);
+            CHECK_EQUAL(packet.pcr, (uint64_t)(timestamp_us - firstTimestamp_us) * PCR_PER_US);
+            if (frame > 0) {
+               CHECK(packet.pcr > lastPcr);
+            }
+            lastPcr = packet.pcr;
+            pcrCount++;
+         }
+      }
+      CHECK_EQUAL(pcrCount, 1);
+   }
+
+   // a timestamp going backwards does not move the PCR before the start
+   output.clear();
+   muxer.mux(accessUnit(1000, false), firstTimestamp_us - 1000, false, output);
+   size_t offset = (parse(&output[0]).pid == TS_PID_PAT) ? 2 * TS_PACKET_SIZE : 0;
+   CHECK_EQUAL(parse(&output[offset]).pcr, 0u);
+}
+
+static void testPesPayload() {
+   MpegTsMuxer          muxer;
+   std::vector<uint8_t> output;
+   SharedBuffer         frame = accessUnit(1000, true);
+   muxer.mux(frame, 0, true, output);
+
+   std::vector<uint8_t> payload;
+   for (size_t offset = 0; offset < output.size(); offset += TS_PACKET_SIZE) {
+      TsPacket packet = parse(&output[offset]);
+      if (packet.pid == TS_PID_VIDEO) {
+         payload.insert(payload.end(), output.begin() + offset + packet.payloadOffset,
+                        output.begin() + offset + TS_PACKET_SIZE);
+      }
+   }
+
+   // PES header with PTS, the inserted access unit delimiter, the access unit
+   const std::vector<uint8_t> start = {0x00, 0x00, 0x01, 0xe0, 0x00, 0x00, 0x80, 0x80, 0x05};
+   CHECK(std::equal(start.begin(), start.end(), payload.begin()));
+   CHECK_EQUAL(payload.size(), 14u + 6u + frame.size());
+   CHECK_EQUAL(payload[14 + 4], 0x09);
+   CHECK(std::equal(frame.data(), frame.data() + frame.size(), payload.begin() + 20));
+}
+
+int main() {
+   testContinuityCounters();
+   testProgramTablesCadence();
+   testPcr();
+   testPesPayload();
+   return test::exitCode();
+}
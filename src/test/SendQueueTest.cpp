@@ -0,0 +1,166 @@
+#include <memory>
+#include <vector>
+
+#include "Check.h"
+#include "SendQueue.h"
+
+using network::OverflowPolicy;
+using network::SendQueue;
+using network::SendQueueLimits;
+using network::SharedBuffer;
+
+typedef SendQueue::PushResult PushResult;
+
+static SharedBuffer buffer(size_t size) {
+   std::shared_ptr<const uint8_t> memory(new uint8_t[size](), std::default_delete<const uint8_t[]>());
+   return SharedBuffer(memory, size);
+}
+
+static SendQueueLimits limits(size_t maxQueuedFrames, OverflowPolicy overflowPolicy) {
+   SendQueueLimits limits;
+   limits.maxQueuedFrames = maxQueuedFrames;
+   limits.overflowPolicy  = overflowPolicy;
+   return limits;
+}
+
+static void testFrameWithMaxPartCount() {
+   SendQueue queue(SendQueueLimits{});
+   CHECK(queue.push({buffer(1), buffer(2), buffer(3), buffer(4)}, true) == PushResult::QUEUED);
+   CHECK_EQUAL(queue.frontPartCount(), 4u);
+   CHECK_EQUAL(queue.frontSize(), 10u);
+
+   std::vector<SharedBuffer> buffers;
+   queue.pop(buffers);
+   CHECK_EQUAL(buffers.size(), 4u);
+   CHECK_EQUAL(queue.getStatistics().sentBytes, 10u);
+}
+
+static void testFrameWithTooManyPartsGetsRejected() {
+   SendQueue queue(SendQueueLimits{});
+   CHECK(queue.push({buffer(1), buffer(2), buffer(3), buffer(4), buffer(5)}, true) == PushResult::TOO_MANY_PARTS);
+   CHECK(queue.empty());
+   CHECK_EQUAL(queue.getStatistics().queuedFrames, 0u);
+   CHECK_EQUAL(queue.getStatistics().queuedBytes, 0u);
+   CHECK_EQUAL(queue.getStatistics().droppedFrames, 0u);
+}
+
+static void testDropNewestFrame() {
+   SendQueue queue(limits(2, OverflowPolicy::DROP_NEWEST_FRAME));
+   CHECK(queue.push({buffer(1)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(2)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(3)}, true) == PushResult::DROPPED);
+   CHECK(queue.push({buffer(4)}, false) == PushResult::QUEUED);
+   CHECK_EQUAL(queue.frontSize(), 1u);
+   CHECK_EQUAL(queue.getStatistics().droppedBytes, 3u);
+}
+
+static void testDropOldestFrame() {
+   SendQueue queue(limits(2, OverflowPolicy::DROP_OLDEST_FRAME));
+   CHECK(queue.push({buffer(1)}, false) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(2)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(3)}, true) == PushResult::QUEUED);
+   CHECK_EQUAL(queue.getStatistics().droppedBytes, 2u);
+
+   std::vector<SharedBuffer> buffers;
+   queue.pop(buffers);
+   queue.pop(buffers);
+   CHECK_EQUAL(buffers.size(), 2u);
+   CHECK_EQUAL(buffers[0].size(), 1u);
+   CHECK_EQUAL(buffers[1].size(), 3u);
+}
+
+static void testDisconnect() {
+   SendQueue queue(limits(1, OverflowPolicy::DISCONNECT));
+   CHECK(queue.push({buffer(1)}, false) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(2)}, false) == PushResult::REJECTED);
+   CHECK_EQUAL(queue.getStatistics().queuedFrames, 1u);
+}
+
+static void testDropDroppableFrames() {
+   SendQueue queue(SendQueueLimits{});
+   std::vector<SharedBuffer> buffers;
+
+   // moves the head of the ring buffer to let the frames wrap around
+   for (size_t size = 1; size <= 6; size++) {
+      CHECK(queue.push({buffer(size)}, true) == PushResult::QUEUED);
+   }
+   for (int frame = 0; frame < 6; frame++) {
+      queue.pop(buffers);
+   }
+
+   CHECK(queue.push({buffer(10)}, false) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(20)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(30), buffer(1)}, false) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(40)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(50)}, true) == PushResult::QUEUED);
+   CHECK(queue.push({buffer(60)}, false) == PushResult::QUEUED);
+
+   CHECK_EQUAL(queue.dropDroppableFrames(), 110u);
+   CHECK_EQUAL(queue.getStatistics().droppedFrames, 3u);
+   CHECK_EQUAL(queue.getStatistics().droppedBytes, 110u);
+   CHECK_EQUAL(queue.getStatistics().queuedFrames, 3u);
+   CHECK_EQUAL(queue.getStatistics().queuedBytes, 101u);
+
+   // the frames that are not droppable survive in their order
+   CHECK_EQUAL(queue.frontSize(), 10u);
+   buffers.clear();
+   queue.pop(buffers);
+   CHECK_EQUAL(queue.frontSize(), 31u);
+   CHECK_EQUAL(queue.frontPartCount(), 2u);
+   queue.pop(buffers);
+   CHECK_EQUAL(queue.frontSize(), 60u);
+   queue.pop(buffers);
+   CHECK(queue.empty());
+   CHECK_EQUAL(buffers.size(), 4u);
+   CHECK_EQUAL(queue.getStatistics().queuedBytes, 0u);
+   CHECK_EQUAL(queue.getStatistics().sentBytes, 21u + 101u);
+
+   // a queue without droppable frames stays untouched
+   CHECK(queue.push({buffer(70)}, false) == PushResult::QUEUED);
+   CHECK_EQUAL(queue.dropDroppableFrames(), 0u);
+   CHECK_EQUAL(queue.getStatistics().queuedFrames, 1u);
+}
+
+static void testPopForWrite() {
+   SendQueue                 queue(SendQueueLimits{});
+   std::vector<SharedBuffer> buffers;
+
+   // frames of 3 buffers and 30 bytes each
+   for (int frame = 0; frame < 5; frame++) {
+      CHECK(queue.push({buffer(10), buffer(15), buffer(5)}, true) == PushResult::QUEUED);
+   }
+
+   // limited by the byte count
+   CHECK_EQUAL(queue.popForWrite(buffers, 70, 100), 60u);
+   CHECK_EQUAL(buffers.size(), 6u);
+   CHECK_EQUAL(queue.getStatistics().queuedFrames, 3u);
+
+   // limited by the buffer count, frames never get split
+   buffers.clear();
+   CHECK_EQUAL(queue.popForWrite(buffers, 1000, 8), 60u);
+   CHECK_EQUAL(buffers.size(), 6u);
+   CHECK_EQUAL(buffers[3].size(), 10u);
+
+   // the first frame gets taken even if it exceeds the limits
+   buffers.clear();
+   CHECK(queue.push({buffer(100)}, true) == PushResult::QUEUED);
+   CHECK_EQUAL(queue.popForWrite(buffers, 20, 2), 30u);
+   CHECK_EQUAL(queue.popForWrite(buffers, 20, 2), 100u);
+   CHECK_EQUAL(buffers.size(), 4u);
+   CHECK(queue.empty());
+   CHECK_EQUAL(queue.popForWrite(buffers, 20, 2), 0u);
+   CHECK_EQUAL(buffers.size(), 4u);
+   CHECK_EQUAL(queue.getStatistics().sentFrames, 6u);
+   CHECK_EQUAL(queue.getStatistics().sentBytes, 250u);
+}
+
+int main() {
+   testFrameWithMaxPartCount();
+   testFrameWithTooManyPartsGetsRejected();
+   testDropNewestFrame();
+   testDropOldestFrame();
+   testDisconnect();
+   testDropDroppableFrames();
+   testPopForWrite();
+   return test::exitCode();
+}
@@ -0,0 +1,174 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Check.h"
+#include "TcpServer.h"
+#include "TestClient.h"
+
+using namespace std::chrono_literals;
+using network::Connection;
+using network::ListenAddress;
+using network::SharedBuffer;
+using network::TcpServer;
+using test::TestClient;
+
+#define LARGE_FRAME_SIZE   (10 * 1024 * 1024)   // exceeds ConnectionSettings::maxBytesPerWrite
+
+/**
+ * Echoes the received lines. The line "large" gets answered with a frame of
+ * LARGE_FRAME_SIZE bytes ending with "end\n".
+ */
+class EchoListener : public TcpServer::Listener {
+   public:
+      void onNewConnection(std::shared_ptr<Connection> connection) override {
+         const std::lock_guard<std::mutex> lock(mutex);
+         connections[connection->getId()] = connection;
+      }
+
+      void onConnectionClosed(int connectionId) override {
+         const std::lock_guard<std::mutex> lock(mutex);
+         connections.erase(connectionId);
+         closedConnections.insert(connectionId);
+         connectionClosed.notify_all();
+      }
+
+      void onCommandReceived(int connectionId, std::string_view command) override {
+         std::shared_ptr<Connection> connection;
+         {
+            const std::lock_guard<std::mutex> lock(mutex);
+            connection = connections[connectionId];
+         }
+         if (command == "large") {
+            std::string frame(LARGE_FRAME_SIZE, 'x');
+            frame.replace(frame.size() - 4, 4, "end\n");
+            connection->asyncSendFrame({SharedBuffer::copyOf(frame)});
+         } else {
+            connection->asyncSend(std::string(command) + "\n");
+         }
+      }
+
+      /**
+       * Returns the number of connections closed so far once it reached the
+       * expected count or the timeout expired.
+       */
+      size_t waitForClosedConnections(size_t expectedCount, std::chrono::milliseconds timeout) {
+         std::unique_lock<std::mutex> lock(mutex);
+         connectionClosed.wait_for(lock, timeout, [&] { return closedConnections.size() >= expectedCount; });
+         return closedConnections.size();
+      }
+
+      void releaseConnections() {
+         const std::lock_guard<std::mutex> lock(mutex);
+         connections.clear();
+      }
+
+   private:
+      std::map<int, std::shared_ptr<Connection>> connections;
+      std::set<int>                              closedConnections;
+      std::condition_variable                    connectionClosed;
+      std::mutex                                 mutex;
+};
+
+/**
+ * Returns a TCP port that was free a moment ago.
+ */
+static unsigned int findFreePort() {
+   struct sockaddr_in address;
+   socklen_t          addressSize = sizeof(address);
+   std::memset(&address, 0, sizeof(address));
+   address.sin_family      = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   int fileDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+   bind(fileDescriptor, (struct sockaddr*)&address, sizeof(address));
+   getsockname(fileDescriptor, (struct sockaddr*)&address, &addressSize);
+   close(fileDescriptor);
+   return ntohs(address.sin_port);
+}
+
+static const char* getBackendName() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+   return "io_uring";
+#else
+   return "epoll";
+#endif
+}
+
+static void testEcho(unsigned int port) {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(port));
+   CHECK(client.send("hello\nworld\n"));
+   CHECK(client.receive(response, "world\n", 2s));
+   CHECK_EQUAL(response, std::string("hello\nworld\n"));
+}
+
+static void testLargeFrame(unsigned int port) {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(port));
+   CHECK(client.send("large\n"));
+   CHECK(client.receive(response, "end\n", 10s));
+   CHECK_EQUAL(response.size(), (size_t)LARGE_FRAME_SIZE);
+   CHECK_EQUAL(response.find_first_not_of('x'), (size_t)LARGE_FRAME_SIZE - 4);
+}
+
+static void testMaxConnections(unsigned int port, EchoListener& listener) {
+   // the connections of the previous tests have to be closed
+   size_t      closedCount = listener.waitForClosedConnections(2, 2s);
+   TestClient  firstClient;
+   TestClient  secondClient;
+   std::string response;
+   CHECK(firstClient.connectTo(port));
+   CHECK(firstClient.send("first\n"));
+   CHECK(firstClient.receive(response, "first\n", 2s));
+
+   // the second connection waits in the backlog until the first one got closed
+   response.clear();
+   CHECK(secondClient.connectTo(port));
+   CHECK(secondClient.send("second\n"));
+   CHECK(!secondClient.receive(response, "second\n", 300ms));
+   firstClient.disconnect();
+   CHECK_EQUAL(listener.waitForClosedConnections(closedCount + 1, 2s), closedCount + 1);
+   CHECK(secondClient.receive(response, "second\n", 2s));
+}
+
+static void testStopClosesConnections(TcpServer& server, unsigned int port) {
+   TestClient  client;
+   std::string response;
+   CHECK(client.connectTo(port));
+   CHECK(client.send("ping\n"));
+   CHECK(client.receive(response, "ping\n", 2s));
+   server.stop();
+   CHECK(client.waitForClose(2s));
+}
+
+int main() {
+   logging::minLevel = OFF;
+   std::cout << "running on the " << getBackendName() << " backend of Boost.Asio" << std::endl;
+
+   unsigned int port = findFreePort();
+   EchoListener listener;
+   {
+      TcpServer server({ListenAddress::tcp(port)}, "test", listener, 1);
+      server.start();
+
+      testEcho(port);
+      testLargeFrame(port);
+      testMaxConnections(port, listener);
+      testStopClosesConnections(server, port);
+      listener.releaseConnections();
+   }
+   return test::exitCode();
+}
@@ -0,0 +1,101 @@
+#ifndef TESTCLIENT_H
+#define TESTCLIENT_H
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace test {
+
+   /**
+    * Blocking client of the servers under test, connecting via a Unix domain
+    * socket or TCP (IPv4 loopback).
+    */
+   class TestClient {
+      public:
+         TestClient() : fileDescriptor(-1), peerClosed(false) {}
+
+         ~TestClient() {
+            disconnect();
+         }
+
+         bool connectTo(const std::string& socketPath) {
+            struct sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+            fileDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+            return (fileDescriptor >= 0) && (connect(fileDescriptor, (struct sockaddr*)&address, sizeof(address)) == 0);
+         }
+
+         bool connectTo(unsigned int port) {
+            struct sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family      = AF_INET;
+            address.sin_port        = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            fileDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+            return (fileDescriptor >= 0) && (connect(fileDescriptor, (struct sockaddr*)&address, sizeof(address)) == 0);
+         }
+
+         bool send(const std::string& data) {
+            return ::send(fileDescriptor, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+         }
+
+         /**
+          * Appends the received data to the output until the output contains
+          * the expected text, the peer closed the connection or the timeout
+          * expired. Returns true if the expected text got received (or the
+          * peer closed the connection if the expected text is empty).
+          */
+         bool receive(std::string& output, const std::string& expected, std::chrono::milliseconds timeout) {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (expected.empty() || (output.find(expected) == std::string::npos)) {
+               auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   deadline - std::chrono::steady_clock::now());
+               if (peerClosed || (remaining.count() <= 0)) {
+                  return expected.empty() && peerClosed;
+               }
+               struct pollfd pollFd = {fileDescriptor, POLLIN, 0};
+               if (poll(&pollFd, 1, remaining.count()) <= 0) {
+                  continue;
+               }
+               char    buffer[4096];
+               ssize_t byteCount = recv(fileDescriptor, buffer, sizeof(buffer), 0);
+               if (byteCount <= 0) {
+                  peerClosed = true;
+                  continue;
+               }
+               output.append(buffer, byteCount);
+            }
+            return true;
+         }
+
+         /**
+          * Returns true if the peer closed the connection within the timeout.
+          * The received data gets discarded.
+          */
+         bool waitForClose(std::chrono::milliseconds timeout) {
+            std::string output;
+            return receive(output, "", timeout);
+         }
+
+         void disconnect() {
+            if (fileDescriptor >= 0) {
+               close(fileDescriptor);
+               fileDescriptor = -1;
+            }
+         }
+
+      private:
+         int  fileDescriptor;
+         bool peerClosed;
+   };
+}
+#endif
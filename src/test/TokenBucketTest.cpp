@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdint>
+
+#include "Check.h"
+#include "TokenBucket.h"
+
+using namespace std::chrono_literals;
+using network::TokenBucket;
+
+typedef TokenBucket::Clock Clock;
+
+#define BYTES_PER_SECOND   100000
+#define BURST_BYTES        10000
+
+/**
+ * Offers frames of the given size in the given interval for the duration
+ * and returns the bytes that conformed.
+ */
+static uint64_t offer(TokenBucket& bucket, size_t frameBytes, Clock::duration interval, Clock::duration duration,
+                      Clock::time_point& now) {
+   uint64_t          conformingBytes = 0;
+   Clock::time_point end             = now + duration;
+   for (; now < end; now += interval) {
+      if (bucket.conforms(frameBytes, now)) {
+         bucket.consume(frameBytes);
+         conformingBytes += frameBytes;
+      }
+   }
+   return conformingBytes;
+}
+
+static void testBucketStartsFull() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+   CHECK(bucket.conforms(BURST_BYTES, now));
+   bucket.consume(BURST_BYTES);
+   CHECK(!bucket.conforms(1, now));
+}
+
+static void testBurst() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+
+   unsigned int conformingFrames = 0;
+   while (bucket.conforms(1000, now)) {
+      bucket.consume(1000);
+      conformingFrames++;
+   }
+   CHECK_EQUAL(conformingFrames, BURST_BYTES / 1000u);
+
+   // an idle bucket does not accumulate more than the burst
+   now += 10s;
+   conformingFrames = 0;
+   while (bucket.conforms(1000, now)) {
+      bucket.consume(1000);
+      conformingFrames++;
+   }
+   CHECK_EQUAL(conformingFrames, BURST_BYTES / 1000u);
+}
+
+static void testSustainedRate() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+
+   // offering ten times the rate for 10 s
+   uint64_t conformingBytes = offer(bucket, 1000, 1ms, 10s, now);
+   CHECK(conformingBytes <= 10 * BYTES_PER_SECOND + BURST_BYTES);
+   CHECK(conformingBytes >= 10 * BYTES_PER_SECOND + BURST_BYTES - 2000);
+
+   // offering less than the rate lets everything conform (after refilling)
+   now += 1s;
+   CHECK_EQUAL(offer(bucket, 1000, 20ms, 10s, now), 500000u);
+}
+
+static void testFrameLargerThanTheBurst() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+   CHECK(bucket.conforms(3 * BURST_BYTES, now));
+   bucket.consume(3 * BURST_BYTES);
+
+   // the debt of 20000 bytes takes 200 ms to get paid back
+   CHECK(!bucket.conforms(1, now + 199ms));
+   CHECK(!bucket.conforms(1, now + 200ms));
+   CHECK(bucket.conforms(1, now + 201ms));
+}
+
+static void testConsumingWithoutConformingCreatesDebt() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+   bucket.consume(BURST_BYTES + BYTES_PER_SECOND);
+   CHECK(!bucket.conforms(1, now + 999ms));
+   CHECK(bucket.conforms(1, now + 1001ms));
+}
+
+static void testTimeGoingBackwardsIsIgnored() {
+   TokenBucket       bucket(BYTES_PER_SECOND, BURST_BYTES);
+   Clock::time_point now = Clock::now();
+   bucket.consume(BURST_BYTES);
+   CHECK(!bucket.conforms(1000, now + 1ms));
+   CHECK(!bucket.conforms(1000, now));
+   CHECK(bucket.conforms(1000, now + 11ms));
+}
+
+int main() {
+   testBucketStartsFull();
+   testBurst();
+   testSustainedRate();
+   testFrameLargerThanTheBurst();
+   testConsumingWithoutConformingCreatesDebt();
+   testTimeGoingBackwardsIsIgnored();
+   return test::exitCode();
+}
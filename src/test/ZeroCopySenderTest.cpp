@@ -0,0 +1,179 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Check.h"
+#include "ZeroCopySender.h"
+
+using network::SharedBuffer;
+using network::ZeroCopySender;
+
+#define BUFFER_SIZE   (64 * 1024)
+
+/**
+ * A connected pair of TCP sockets on the loopback interface.
+ */
+struct SocketPair {
+   SocketPair() {
+      struct sockaddr_in address;
+      socklen_t          addressLength = sizeof(address);
+      std::memset(&address, 0, sizeof(address));
+      address.sin_family      = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      int listeningSocket = socket(AF_INET, SOCK_STREAM, 0);
+      bind(listeningSocket, (struct sockaddr*)&address, sizeof(address));
+      listen(listeningSocket, 1);
+      getsockname(listeningSocket, (struct sockaddr*)&address, &addressLength);
+      sender = socket(AF_INET, SOCK_STREAM, 0);
+      CHECK(connect(sender, (struct sockaddr*)&address, sizeof(address)) == 0);
+      receiver = accept(listeningSocket, nullptr, nullptr);
+      CHECK(receiver >= 0);
+      close(listeningSocket);
+   }
+
+   ~SocketPair() {
+      close(sender);
+      close(receiver);
+   }
+
+   size_t receive(size_t byteCount) {
+      std::vector<uint8_t> data(byteCount);
+      size_t               receivedByteCount = 0;
+      while (receivedByteCount < byteCount) {
+         ssize_t result = recv(receiver, data.data() + receivedByteCount, byteCount - receivedByteCount, 0);
+         if (result <= 0) {
+            break;
+         }
+         receivedByteCount += result;
+      }
+      return receivedByteCount;
+   }
+
+   /**
+    * Waits (at most 1 s) until the error queue of the sender contains
+    * notifications and processes them.
+    */
+   void processCompletions(ZeroCopySender& zeroCopySender) {
+      struct pollfd pollFd = {sender, 0, 0};   // POLLERR gets reported anyway
+      poll(&pollFd, 1, 1000);
+      zeroCopySender.processCompletions(sender);
+   }
+
+   int sender;
+   int receiver;
+};
+
+/**
+ * The flag (if provided) gets set when the memory got released.
+ */
+static SharedBuffer buffer(size_t size, bool* released = nullptr) {
+   std::shared_ptr<const uint8_t> memory(new uint8_t[size](), [released](const uint8_t* memory) {
+      delete[] memory;
+      if (released != nullptr) {
+         *released = true;
+      }
+   });
+   return SharedBuffer(memory, size);
+}
+
+static std::vector<boost::asio::const_buffer> sequenceOf(const std::vector<SharedBuffer>& buffers) {
+   std::vector<boost::asio::const_buffer> sequence;
+   for (auto& buffer : buffers) {
+      sequence.push_back(buffer.asAsioBuffer());
+   }
+   return sequence;
+}
+
+static void testBuffersGetRetainedUntilCompletion() {
+   logging::Logger log("ZeroCopySenderTest");
+   ZeroCopySender  zeroCopySender(log);
+   SocketPair      sockets;
+   CHECK(zeroCopySender.enable(sockets.sender));
+
+   bool                      released = false;
+   std::vector<SharedBuffer> buffers  = {buffer(BUFFER_SIZE, &released), buffer(BUFFER_SIZE)};
+   CHECK_EQUAL(zeroCopySender.send(sockets.sender, sequenceOf(buffers), 10), 2 * BUFFER_SIZE - 10);
+   CHECK(zeroCopySender.hasIncompleteSends());
+
+   zeroCopySender.retain(buffers);
+   CHECK(buffers.empty());
+   CHECK(zeroCopySender.hasRetainedBuffers());
+   CHECK(!released);
+
+   CHECK_EQUAL(sockets.receive(2 * BUFFER_SIZE - 10), 2u * BUFFER_SIZE - 10);
+   for (int attempt = 0; (attempt < 10) && zeroCopySender.hasIncompleteSends(); attempt++) {
+      sockets.processCompletions(zeroCopySender);
+   }
+   CHECK(!zeroCopySender.hasIncompleteSends());
+   CHECK(!zeroCopySender.hasRetainedBuffers());
+   CHECK(released);
+   CHECK_EQUAL(zeroCopySender.getStatistics().completedSends, 1u);
+}
+
+static void testIncompleteSendsBeforeRetaining() {
+   logging::Logger log("ZeroCopySenderTest");
+   ZeroCopySender  zeroCopySender(log);
+   SocketPair      sockets;
+   CHECK(zeroCopySender.enable(sockets.sender));
+
+   // a write consisting of several send calls is retained after the last one
+   std::vector<SharedBuffer> buffers = {buffer(BUFFER_SIZE)};
+   CHECK_EQUAL(zeroCopySender.send(sockets.sender, sequenceOf(buffers), 0), BUFFER_SIZE);
+   CHECK_EQUAL(zeroCopySender.send(sockets.sender, sequenceOf(buffers), 0), BUFFER_SIZE);
+   CHECK(!zeroCopySender.hasRetainedBuffers());
+   CHECK(zeroCopySender.hasIncompleteSends());
+
+   zeroCopySender.retain(buffers);
+   CHECK_EQUAL(sockets.receive(2 * BUFFER_SIZE), 2u * BUFFER_SIZE);
+   for (int attempt = 0; (attempt < 10) && zeroCopySender.hasIncompleteSends(); attempt++) {
+      sockets.processCompletions(zeroCopySender);
+   }
+   CHECK(!zeroCopySender.hasIncompleteSends());
+   CHECK(!zeroCopySender.hasRetainedBuffers());
+}
+
+static void testBuffersOfOrdinarySendsGetReleased() {
+   logging::Logger log("ZeroCopySenderTest");
+   ZeroCopySender  zeroCopySender(log);
+   SocketPair      sockets;
+
+   std::vector<SharedBuffer> buffers = {buffer(BUFFER_SIZE)};
+   CHECK_EQUAL(zeroCopySender.send(sockets.sender, sequenceOf(buffers), 0), BUFFER_SIZE);
+   zeroCopySender.retain(buffers);
+   CHECK(buffers.empty());
+   CHECK(!zeroCopySender.hasRetainedBuffers());
+   CHECK(!zeroCopySender.hasIncompleteSends());
+}
+
+static void testClearReleasesRetainedBuffers() {
+   logging::Logger log("ZeroCopySenderTest");
+   ZeroCopySender  zeroCopySender(log);
+   SocketPair      sockets;
+   CHECK(zeroCopySender.enable(sockets.sender));
+
+   bool                      released = false;
+   std::vector<SharedBuffer> buffers  = {buffer(BUFFER_SIZE, &released)};
+   CHECK_EQUAL(zeroCopySender.send(sockets.sender, sequenceOf(buffers), 0), BUFFER_SIZE);
+   zeroCopySender.retain(buffers);
+   CHECK(!released);
+   zeroCopySender.clear();
+   CHECK(!zeroCopySender.hasRetainedBuffers());
+   CHECK(released);
+}
+
+int main() {
+   logging::minLevel = OFF;
+
+   testBuffersGetRetainedUntilCompletion();
+   testIncompleteSendsBeforeRetaining();
+   testBuffersOfOrdinarySendsGetReleased();
+   testClearReleasesRetainedBuffers();
+   return test::exitCode();
+}